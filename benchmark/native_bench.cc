@@ -0,0 +1,532 @@
+/**
+ * Micro-benchmarks for the native code, without V8 in between.
+ *
+ * Every benchmark runs for a number of rounds. The iteration count per
+ * round is calibrated first, so a round takes at least --min-time
+ * milliseconds. The result is printed as JSON, with percentiles over the
+ * rounds:
+ *
+ *   {"sha256": "...", "verifier": "...", "rounds": 20, "results": [
+ *     {"name": "sign", "threads": 1, "iterations": 512,
+ *      "ns_per_op": {"min": ..., "p50": ..., "p90": ..., "max": ...},
+ *      "ops_per_sec": {"min": ..., "p50": ..., "p90": ..., "max": ...}}]}
+ *
+ * ops_per_sec percentiles correspond to the ns_per_op ones, i.e. p90 is the
+ * throughput of the round at the 90th percentile of time per operation.
+ *
+ * Usage: native_bench [--filter text] [--rounds n] [--min-time ms]
+ *                     [--threads 1,2,4]
+ *
+ * benchmark/native_compare.js compares the output against a baseline.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <pthread.h>
+#include <uv.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include <openssl/ripemd.h>
+#include <openssl/sha.h>
+
+#include "base58.h"
+#include "ecdsa.h"
+#include "pubkeycache.h"
+#include "secp256k1.h"
+#include "sha256.h"
+#include "sigcache.h"
+
+using namespace std;
+
+// Distinct keys and signatures to cycle through
+#define KEY_COUNT 64
+
+#define MAX_THREADS 64
+
+struct test_key_t {
+  unsigned char priv[32];
+  unsigned char pub[65];
+  unsigned char compressed[33];
+  unsigned char digest[32];
+  unsigned char sig[72];
+  int sigLen;
+};
+
+static test_key_t keys[KEY_COUNT];
+
+static unsigned char header[80];
+static unsigned char payload[25];
+static char encoded[64];
+static size_t encodedLen;
+static char encodedCheck[64];
+static size_t encodedCheckLen;
+
+// Keeps results alive, so the compiler can't drop the work
+static volatile unsigned int sink;
+
+static uint64_t
+now_ns ()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * A benchmark runs iterations operations, using threads threads.
+ */
+typedef void (*bench_fn_t)(size_t iterations, int threads);
+
+static void
+bench_base58_encode (size_t iterations, int threads)
+{
+  char out[64];
+  for (size_t i = 0; i < iterations; i++) {
+    sink += Base58::Encode(out, payload, sizeof(payload));
+  }
+}
+
+static void
+bench_base58_decode (size_t iterations, int threads)
+{
+  unsigned char out[64];
+  size_t len;
+  for (size_t i = 0; i < iterations; i++) {
+    sink += Base58::Decode(out, &len, encoded, encodedLen);
+  }
+}
+
+static void
+bench_base58check_encode (size_t iterations, int threads)
+{
+  char out[64];
+  for (size_t i = 0; i < iterations; i++) {
+    sink += Base58::EncodeCheck(out, payload, 21);
+  }
+}
+
+static void
+bench_base58check_decode (size_t iterations, int threads)
+{
+  unsigned char out[64];
+  size_t len;
+  for (size_t i = 0; i < iterations; i++) {
+    sink += Base58::DecodeCheck(out, &len, encodedCheck, encodedCheckLen);
+  }
+}
+
+/**
+ * Public key to Base58Check address, like pubkey_to_address256 followed
+ * by base58_encode.
+ */
+static void
+bench_address (size_t iterations, int threads)
+{
+  unsigned char hash[32];
+  unsigned char address[21];
+  char out[64];
+  for (size_t i = 0; i < iterations; i++) {
+    const test_key_t *key = &keys[i % KEY_COUNT];
+    Sha256::Single(hash, key->pub, sizeof(key->pub));
+    address[0] = 0;
+    RIPEMD160(hash, 32, address + 1);
+    sink += Base58::EncodeCheck(out, address, sizeof(address));
+  }
+}
+
+/**
+ * Same steps as sha256_midstate in src/main.cc.
+ */
+static void
+bench_sha256_midstate (size_t iterations, int threads)
+{
+  unsigned char data[128];
+  for (size_t i = 0; i < iterations; i++) {
+    memcpy(data, header, 80);
+    memset(data + 80, 0, sizeof(data) - 80);
+    data[80] = 0x80;
+    data[126] = (80 * 8) >> 8;
+    data[127] = (80 * 8) & 0xff;
+
+    SHA256_CTX c;
+    SHA256_Init(&c);
+    SHA256_Transform(&c, data);
+    sink += c.h[0];
+  }
+}
+
+static void
+bench_sha256d (size_t iterations, int threads)
+{
+  unsigned char out[32];
+  for (size_t i = 0; i < iterations; i++) {
+    header[76] = i;
+    Sha256::Double(out, header, sizeof(header));
+    sink += out[0];
+  }
+}
+
+struct verify_job_t {
+  bool compressed;
+  size_t begin;
+  size_t end;
+};
+
+static void
+verify_range (void *arg)
+{
+  verify_job_t *job = (verify_job_t *) arg;
+
+#ifdef USE_SECP256K1
+  EC_KEY *ec = NULL;
+#else
+  EC_KEY *ec = EC_KEY_new_by_curve_name(NID_secp256k1);
+#endif
+
+  for (size_t i = job->begin; i < job->end; i++) {
+    const test_key_t *key = &keys[i % KEY_COUNT];
+    if (job->compressed) {
+      sink += Ecdsa::Verify(ec, key->compressed, sizeof(key->compressed),
+                            key->digest, key->sig, key->sigLen);
+    } else {
+      sink += Ecdsa::Verify(ec, key->pub, sizeof(key->pub),
+                            key->digest, key->sig, key->sigLen);
+    }
+  }
+
+#ifndef USE_SECP256K1
+  EC_KEY_free(ec);
+#endif
+}
+
+/**
+ * Split the items over threads, like the verification pool does.
+ */
+static void
+verify_many (size_t iterations, int threads, bool compressed)
+{
+  verify_job_t jobs[MAX_THREADS];
+  uv_thread_t tids[MAX_THREADS];
+
+  for (int t = 0; t < threads; t++) {
+    jobs[t].compressed = compressed;
+    jobs[t].begin = iterations * t / threads;
+    jobs[t].end = iterations * (t + 1) / threads;
+  }
+
+  if (threads == 1) {
+    verify_range(&jobs[0]);
+    return;
+  }
+
+  for (int t = 0; t < threads; t++) {
+    uv_thread_create(&tids[t], verify_range, &jobs[t]);
+  }
+  for (int t = 0; t < threads; t++) {
+    uv_thread_join(&tids[t]);
+  }
+}
+
+static void
+bench_verify (size_t iterations, int threads)
+{
+  verify_many(iterations, threads, false);
+}
+
+static void
+bench_verify_compressed (size_t iterations, int threads)
+{
+  verify_many(iterations, threads, true);
+}
+
+static void
+bench_sign (size_t iterations, int threads)
+{
+  Ecdsa::sign_ctx_t *ctx = Ecdsa::NewSignContext();
+  unsigned char sig[72];
+  int sigLen;
+  for (size_t i = 0; i < iterations; i++) {
+    const test_key_t *key = &keys[i % KEY_COUNT];
+    Ecdsa::Sign(ctx, key->priv, key->digest, sig, &sigLen);
+    sink += sigLen;
+  }
+  Ecdsa::FreeSignContext(ctx);
+}
+
+struct bench_t {
+  const char *name;
+  bench_fn_t fn;
+  // Whether to run once per entry of --threads
+  bool threaded;
+};
+
+static const bench_t benches[] = {
+  { "base58_encode", bench_base58_encode, false },
+  { "base58_decode", bench_base58_decode, false },
+  { "base58check_encode", bench_base58check_encode, false },
+  { "base58check_decode", bench_base58check_decode, false },
+  { "address", bench_address, false },
+  { "sha256_midstate", bench_sha256_midstate, false },
+  { "sha256d", bench_sha256d, false },
+  { "verify", bench_verify, true },
+  { "verify_compressed", bench_verify_compressed, true },
+  { "sign", bench_sign, false }
+};
+
+static bool
+setup ()
+{
+  EC_KEY *ec = EC_KEY_new_by_curve_name(NID_secp256k1);
+  Ecdsa::sign_ctx_t *ctx = Ecdsa::NewSignContext();
+  if (ec == NULL || ctx == NULL) return false;
+
+  const EC_GROUP *group = EC_KEY_get0_group(ec);
+
+  for (int i = 0; i < KEY_COUNT; i++) {
+    test_key_t *key = &keys[i];
+    if (!EC_KEY_generate_key(ec)) return false;
+
+    const BIGNUM *priv = EC_KEY_get0_private_key(ec);
+    memset(key->priv, 0, 32);
+    BN_bn2bin(priv, key->priv + 32 - BN_num_bytes(priv));
+
+    const EC_POINT *point = EC_KEY_get0_public_key(ec);
+    EC_POINT_point2oct(group, point, POINT_CONVERSION_UNCOMPRESSED,
+                       key->pub, sizeof(key->pub), NULL);
+    EC_POINT_point2oct(group, point, POINT_CONVERSION_COMPRESSED,
+                       key->compressed, sizeof(key->compressed), NULL);
+
+    Sha256::Single(key->digest, (const unsigned char *) &i, sizeof(i));
+    if (!Ecdsa::Sign(ctx, key->priv, key->digest, key->sig, &key->sigLen)) {
+      return false;
+    }
+  }
+
+  EC_KEY_free(ec);
+  Ecdsa::FreeSignContext(ctx);
+
+  for (int i = 0; i < 80; i++) header[i] = i;
+  for (int i = 0; i < 25; i++) payload[i] = 0x80 + i;
+  encodedLen = Base58::Encode(encoded, payload, sizeof(payload));
+  encodedCheckLen = Base58::EncodeCheck(encodedCheck, payload, 21);
+  return true;
+}
+
+static double
+percentile (const vector<double>& sorted, double q)
+{
+  return sorted[(size_t) (q * (sorted.size() - 1) + 0.5)];
+}
+
+static void
+run (const bench_t *bench, int threads, int rounds, uint64_t minTime, bool first)
+{
+  // Double the iterations until a round is long enough
+  size_t iterations = threads;
+  for (;;) {
+    uint64_t start = now_ns();
+    bench->fn(iterations, threads);
+    if (now_ns() - start >= minTime || iterations >= ((size_t) 1 << 40)) break;
+    iterations *= 2;
+  }
+
+  vector<double> ns;
+  for (int r = 0; r < rounds; r++) {
+    uint64_t start = now_ns();
+    bench->fn(iterations, threads);
+    ns.push_back((double) (now_ns() - start) / iterations);
+  }
+  sort(ns.begin(), ns.end());
+
+  static const char *labels[] = { "min", "p50", "p90", "max" };
+  static const double quantiles[] = { 0, 0.5, 0.9, 1 };
+
+  printf("%s\n    {\"name\": \"%s\", \"threads\": %d, \"iterations\": %lu,\n",
+         first ? "" : ",", bench->name, threads, (unsigned long) iterations);
+  printf("     \"ns_per_op\": {");
+  for (int i = 0; i < 4; i++) {
+    printf("%s\"%s\": %.1f", i ? ", " : "", labels[i], percentile(ns, quantiles[i]));
+  }
+  printf("},\n     \"ops_per_sec\": {");
+  for (int i = 0; i < 4; i++) {
+    printf("%s\"%s\": %.0f", i ? ", " : "", labels[i],
+           1e9 / percentile(ns, quantiles[i]));
+  }
+  printf("}}");
+  fflush(stdout);
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *filter = NULL;
+  int rounds = 20;
+  uint64_t minTime = 10 * 1000000;
+  vector<int> threadCounts;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+      rounds = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--min-time") && i + 1 < argc) {
+      minTime = (uint64_t) atoi(argv[++i]) * 1000000;
+    } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      for (char *p = strtok(argv[++i], ","); p; p = strtok(NULL, ",")) {
+        int n = atoi(p);
+        if (n >= 1 && n <= MAX_THREADS) threadCounts.push_back(n);
+      }
+    } else {
+      fprintf(stderr, "Usage: %s [--filter text] [--rounds n] [--min-time ms]"
+              " [--threads 1,2,4]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (rounds < 1) rounds = 1;
+
+  // One, two, four, ... threads up to the number of cores
+  if (threadCounts.empty()) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores > MAX_THREADS) cores = MAX_THREADS;
+    for (int n = 1; n < cores; n *= 2) threadCounts.push_back(n);
+    threadCounts.push_back(cores > 1 ? (int) cores : 1);
+  }
+
+  Sha256::Init();
+  Secp256k1::Init();
+  PubKeyCache::Init(8192);
+  // Measure the verification itself, not the cache
+  SigCache::Init(0);
+
+  if (!setup()) {
+    fprintf(stderr, "Could not set up test keys\n");
+    return 1;
+  }
+
+  printf("{\"sha256\": \"%s\",\n", Sha256::GetImplementation());
+#ifdef USE_SECP256K1
+  printf(" \"verifier\": \"secp256k1\",\n");
+#else
+  printf(" \"verifier\": \"openssl\",\n");
+#endif
+  printf(" \"rounds\": %d,\n \"results\": [", rounds);
+
+  bool first = true;
+  for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+    const bench_t *bench = &benches[b];
+    if (filter != NULL && strstr(bench->name, filter) == NULL) continue;
+
+    if (!bench->threaded) {
+      run(bench, 1, rounds, minTime, first);
+      first = false;
+      continue;
+    }
+    for (size_t t = 0; t < threadCounts.size(); t++) {
+      run(bench, threadCounts[t], rounds, minTime, first);
+      first = false;
+    }
+  }
+
+  printf("\n ]}\n");
+  return 0;
+}
+
+/*
+ * The shared code locks with libuv, which lives inside the node binary.
+ * On Unix its primitives are thin pthread wrappers, so provide them here
+ * instead of linking against libuv.
+ */
+extern "C" {
+
+int uv_mutex_init(uv_mutex_t *mutex)
+{
+  return pthread_mutex_init(mutex, NULL) ? -1 : 0;
+}
+
+void uv_mutex_destroy(uv_mutex_t *mutex)
+{
+  pthread_mutex_destroy(mutex);
+}
+
+void uv_mutex_lock(uv_mutex_t *mutex)
+{
+  pthread_mutex_lock(mutex);
+}
+
+void uv_mutex_unlock(uv_mutex_t *mutex)
+{
+  pthread_mutex_unlock(mutex);
+}
+
+int uv_rwlock_init(uv_rwlock_t *rwlock)
+{
+  return pthread_rwlock_init(rwlock, NULL) ? -1 : 0;
+}
+
+void uv_rwlock_destroy(uv_rwlock_t *rwlock)
+{
+  pthread_rwlock_destroy(rwlock);
+}
+
+void uv_rwlock_rdlock(uv_rwlock_t *rwlock)
+{
+  pthread_rwlock_rdlock(rwlock);
+}
+
+void uv_rwlock_rdunlock(uv_rwlock_t *rwlock)
+{
+  pthread_rwlock_unlock(rwlock);
+}
+
+void uv_rwlock_wrlock(uv_rwlock_t *rwlock)
+{
+  pthread_rwlock_wrlock(rwlock);
+}
+
+void uv_rwlock_wrunlock(uv_rwlock_t *rwlock)
+{
+  pthread_rwlock_unlock(rwlock);
+}
+
+struct thread_start_t {
+  void (*entry)(void *arg);
+  void *arg;
+};
+
+static void *
+thread_start (void *arg)
+{
+  thread_start_t start = *(thread_start_t *) arg;
+  free(arg);
+  start.entry(start.arg);
+  return NULL;
+}
+
+int uv_thread_create(uv_thread_t *tid, void (*entry)(void *arg), void *arg)
+{
+  thread_start_t *start = (thread_start_t *) malloc(sizeof(thread_start_t));
+  start->entry = entry;
+  start->arg = arg;
+  if (pthread_create(tid, NULL, thread_start, start)) {
+    free(start);
+    return -1;
+  }
+  return 0;
+}
+
+int uv_thread_join(uv_thread_t *tid)
+{
+  return pthread_join(*tid, NULL) ? -1 : 0;
+}
+
+}
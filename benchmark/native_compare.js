@@ -0,0 +1,123 @@
+/**
+ * Compare native_bench results against a stored baseline.
+ *
+ * Usage: node benchmark/native_compare.js [options] [results.json]
+ *
+ *   --baseline file   Baseline to compare against
+ *                     (default: benchmark/native_baseline.json)
+ *   --threshold pct   Allowed slowdown of the median ns/op (default: 10)
+ *   --save            Store the results as the new baseline
+ *
+ * Without a results file, build/Release/native_bench is run and any other
+ * arguments after "--" are passed on to it. Exits with status 1 if a
+ * benchmark got slower than the threshold allows.
+ */
+var fs = require('fs');
+var path = require('path');
+var childProcess = require('child_process');
+
+var baselineFile = path.resolve(__dirname, 'native_baseline.json');
+var threshold = 10;
+var save = false;
+var resultsFile = null;
+var benchArgs = [];
+
+var args = process.argv.slice(2);
+for (var i = 0; i < args.length; i++) {
+  switch (args[i]) {
+  case '--baseline':
+    baselineFile = path.resolve(args[++i]);
+    break;
+  case '--threshold':
+    threshold = +args[++i];
+    break;
+  case '--save':
+    save = true;
+    break;
+  case '--':
+    benchArgs = args.slice(i + 1);
+    i = args.length;
+    break;
+  default:
+    resultsFile = args[i];
+  }
+}
+
+function keyOf(result) {
+  return result.name + ' x' + result.threads;
+}
+
+function pad(str, len) {
+  str = String(str);
+  while (str.length < len) str += ' ';
+  return str;
+}
+
+function compare(current) {
+  if (save) {
+    fs.writeFileSync(baselineFile, JSON.stringify(current, null, 2) + '\n');
+    console.log('Saved baseline to ' + baselineFile);
+    return 0;
+  }
+
+  if (!fs.existsSync(baselineFile)) {
+    console.error('No baseline at ' + baselineFile + ', run with --save first');
+    return 1;
+  }
+
+  var baseline = JSON.parse(fs.readFileSync(baselineFile, 'utf8'));
+  if (baseline.sha256 !== current.sha256 ||
+      baseline.verifier !== current.verifier) {
+    console.log('Warning: baseline used sha256 ' + baseline.sha256 +
+                ' and ' + baseline.verifier + ', now ' + current.sha256 +
+                ' and ' + current.verifier);
+  }
+
+  var before = {};
+  baseline.results.forEach(function (result) {
+    before[keyOf(result)] = result;
+  });
+
+  var regressions = 0;
+  current.results.forEach(function (result) {
+    var key = keyOf(result);
+    var old = before[key];
+    if (!old) {
+      console.log(pad(key, 28) + pad(result.ns_per_op.p50.toFixed(1), 14) +
+                  'new');
+      return;
+    }
+
+    var change = (result.ns_per_op.p50 / old.ns_per_op.p50 - 1) * 100;
+    var status = '';
+    if (change > threshold) {
+      status = '  REGRESSION';
+      regressions++;
+    }
+    console.log(pad(key, 28) +
+                pad(old.ns_per_op.p50.toFixed(1), 14) +
+                pad(result.ns_per_op.p50.toFixed(1), 14) +
+                (change >= 0 ? '+' : '') + change.toFixed(1) + '%' + status);
+  });
+
+  if (regressions) {
+    console.log(regressions + ' benchmark(s) more than ' + threshold +
+                '% slower than the baseline');
+    return 1;
+  }
+  return 0;
+}
+
+if (resultsFile) {
+  process.exit(compare(JSON.parse(fs.readFileSync(resultsFile, 'utf8'))));
+} else {
+  var bench = path.resolve(__dirname, '../build/Release/native_bench');
+  childProcess.execFile(bench, benchArgs, {maxBuffer: 16 * 1024 * 1024},
+                        function (err, stdout, stderr) {
+    if (err) {
+      console.error('Failed to run ' + bench + ': ' + (stderr || err.message));
+      process.exit(1);
+    }
+    process.exit(compare(JSON.parse(stdout)));
+  });
+}
@@ -1,15 +1,46 @@
 {
   'variables': {
-    'node_shared_openssl%': 'true'
+    'node_shared_openssl%': 'true',
+    # Verify signatures with the in-tree secp256k1 code instead of OpenSSL
+    'use_secp256k1%': 'true',
+    # Per-operation counters and latency histograms, see src/stats.h
+    'native_stats%': 'true'
   },
   'targets': [
     {
       'target_name': 'native',
       'sources': [
         'src/main.cc',
-        'src/eckey.cc'
+        'src/base58.cc',
+        'src/coincache.cc',
+        'src/ecdsa.cc',
+        'src/eckey.cc',
+        'src/framer.cc',
+        'src/headers.cc',
+        'src/interpreter.cc',
+        'src/mempool.cc',
+        'src/merkle.cc',
+        'src/noncescanner.cc',
+        'src/pubkeycache.cc',
+        'src/secp256k1.cc',
+        'src/sha256.cc',
+        'src/sigcache.cc',
+        'src/sighash.cc',
+        'src/sighashtx.cc',
+        'src/standardinput.cc',
+        'src/stats.cc',
+        'src/txparser.cc',
+        'src/uint256.cc',
+        'src/workpool.cc',
+        'src/worktemplate.cc'
       ],
       'conditions': [
+        ['use_secp256k1=="true"', {
+          'defines': [ 'USE_SECP256K1' ]
+        }],
+        ['native_stats=="false"', {
+          'defines': [ 'DISABLE_STATS' ]
+        }],
         ['node_shared_openssl=="false"', {
           # so when "node_shared_openssl" is "false", then OpenSSL has been
           # bundled into the node executable. So we need to include the same
@@ -30,6 +61,31 @@
           ]
         }]
       ]
+    },
+    {
+      # Micro-benchmarks of the native code, see benchmark/native_compare.js
+      'target_name': 'native_bench',
+      'type': 'executable',
+      'sources': [
+        'benchmark/native_bench.cc',
+        'src/base58.cc',
+        'src/ecdsa.cc',
+        'src/pubkeycache.cc',
+        'src/secp256k1.cc',
+        'src/sha256.cc',
+        'src/sigcache.cc'
+      ],
+      'include_dirs': [ 'src' ],
+      'libraries': [ '-lcrypto', '-lpthread' ],
+      'conditions': [
+        ['OS=="win"', {
+          # Relies on pthreads and clock_gettime
+          'type': 'none'
+        }],
+        ['use_secp256k1=="true"', {
+          'defines': [ 'USE_SECP256K1' ]
+        }]
+      ]
     }
   ]
 }
@@ -9,6 +9,22 @@
 //
 //cfg.datadir = process.env.HOME + '/.bitcoinjs';
 
+// Signature verification runs on its own thread pool, separate from the one
+// used for disk I/O. By default it starts one thread per core.
+//
+//cfg.verifyThreads = 8;
+
+// Signatures that verified successfully are remembered, so transactions from
+// the memory pool don't have to be checked again when they show up in a
+// block. Each entry takes 32 bytes; setting this to 0 disables the cache.
+//
+//cfg.sigCacheSize = 65536;
+
+// Once the memory pool takes more than this many megabytes, the oldest
+// transactions are dropped from it.
+//
+//cfg.memPoolSize = 300;
+
 // JSON-RPC SECTION
 // -----------------------------------------------------------------------------
 //
@@ -5,14 +5,14 @@ var cryptoHashing = require('crypto-hashing');
 var ecdsa = require('ecdsa');
 var BigInteger = require('bigi')
 
-module.exports = {
+var shim = {
     base58_encode: bs58.encode,
     base58_decode: function(input) {
         return new Buffer(bs58.decode(input));
     }, 
-    pubkey_to_address256: function(pkBuffer) {
+    pubkey_to_address256: function(pkBuffer, version) {
         var hash160 = cryptoHashing.ripemd160(cryptoHashing.sha256(pkBuffer));
-        var version = 0x00;
+        version = (version || 0x00) & 0xff;
         // Get a copy of the hash
         var hash = hash160.slice(0);
       
@@ -68,3 +68,187 @@ module.exports = {
     }
 */
 }
+
+/**
+ * Verify one signature by a public key, synchronously or with a callback.
+ */
+shim.BitcoinKey.verify = function (pubkey, hash, sig, cb) {
+  var result;
+  try {
+    var key = new shim.BitcoinKey();
+    key.public = pubkey;
+    result = key.verifySignatureSync(hash, sig);
+  } catch (err) {
+    result = false;
+  }
+
+  if ("function" !== typeof cb) {
+    return result;
+  }
+  process.nextTick(function () {
+    cb(null, result);
+  });
+};
+
+/**
+ * Verify many signatures at once.
+ *
+ * Takes an array of {pubkey, hash, sig} objects and calls back with a bitmap
+ * Buffer, where bit i is set if signature i is valid.
+ */
+shim.BitcoinKey.verifyBatch = function (items, cb) {
+  var bitmap = new Buffer((items.length + 7) >> 3);
+  bitmap.fill(0);
+  items.forEach(function (item, i) {
+    try {
+      var key = new shim.BitcoinKey();
+      key.public = item.pubkey;
+      if (key.verifySignatureSync(item.hash, item.sig)) {
+        bitmap[i >> 3] |= 1 << (i & 7);
+      }
+    } catch (err) {
+      // Errors count as invalid signatures
+    }
+  });
+  process.nextTick(function () {
+    cb(null, bitmap);
+  });
+};
+
+/**
+ * Memory pool of transactions keyed by binary hash.
+ *
+ * Same interface as the native MemPool, see src/mempool.h.
+ */
+shim.MemPool = function (maxBytes) {
+  this.maxBytes = maxBytes;
+  this.entries = {};
+  this.spends = {};
+  this.memory = 0;
+  this.evictions = 0;
+};
+
+shim.MemPool.prototype.put = function (hash, value, size, outpoints) {
+  var key = hash.toString('binary');
+  var entry = this.entries[key];
+  var isNew = !entry;
+  if (isNew) {
+    entry = this.entries[key] = {hash: hash, size: 0, outpoints: []};
+  } else {
+    this._removeSpends(entry);
+  }
+
+  entry.value = value;
+  this.memory += (size || 0) - entry.size;
+  entry.size = size || 0;
+  if (outpoints) {
+    for (var i = 0; i < outpoints.length; i += 36) {
+      var outpoint = outpoints.slice(i, i + 36).toString('binary');
+      entry.outpoints.push(outpoint);
+      if (!this.spends[outpoint]) this.spends[outpoint] = entry;
+    }
+    this.memory += outpoints.length;
+  }
+  return isNew;
+};
+
+shim.MemPool.prototype._removeSpends = function (entry) {
+  var self = this;
+  entry.outpoints.forEach(function (outpoint) {
+    if (self.spends[outpoint] === entry) delete self.spends[outpoint];
+  });
+  this.memory -= entry.outpoints.length * 36;
+  entry.outpoints = [];
+};
+
+shim.MemPool.prototype.get = function (hash) {
+  var entry = this.entries[hash.toString('binary')];
+  return entry ? entry.value : undefined;
+};
+
+shim.MemPool.prototype.has = function (hash) {
+  return !!this.entries[hash.toString('binary')];
+};
+
+shim.MemPool.prototype.remove = function (hash) {
+  var key = hash.toString('binary');
+  var entry = this.entries[key];
+  if (!entry) return undefined;
+
+  this._removeSpends(entry);
+  this.memory -= entry.size;
+  delete this.entries[key];
+  return entry.value;
+};
+
+shim.MemPool.prototype.getMany = function (hashes) {
+  return hashes.map(this.get, this);
+};
+
+shim.MemPool.prototype.hasMany = function (hashes) {
+  return hashes.map(this.has, this);
+};
+
+shim.MemPool.prototype.getSpenders = function (outpoints) {
+  var result = [];
+  for (var i = 0; i < outpoints.length; i += 36) {
+    var entry = this.spends[outpoints.slice(i, i + 36).toString('binary')];
+    result.push(entry ? entry.hash : null);
+  }
+  return result;
+};
+
+shim.MemPool.prototype.getAll = function () {
+  var self = this;
+  return Object.keys(this.entries).map(function (key) {
+    return self.entries[key].value;
+  });
+};
+
+shim.MemPool.prototype.trim = function () {
+  var self = this;
+  var evicted = [];
+  Object.keys(this.entries).some(function (key) {
+    if (self.memory <= self.maxBytes) return true;
+    var entry = self.entries[key];
+    if (entry.size > 0) {
+      evicted.push(self.remove(entry.hash));
+      self.evictions++;
+    }
+    return false;
+  });
+  return evicted;
+};
+
+shim.MemPool.prototype.count = function () {
+  return Object.keys(this.entries).length;
+};
+
+shim.MemPool.prototype.stats = function () {
+  return {
+    count: this.count(),
+    spends: Object.keys(this.spends).length,
+    memory: this.memory,
+    maxBytes: this.maxBytes,
+    evictions: this.evictions
+  };
+};
+
+/**
+ * Native operation statistics, not collected by the JavaScript fallbacks.
+ */
+shim.stats = function () {
+  return {enabled: false, ops: {}};
+};
+
+shim.reset_stats = function () {};
+
+// Use the compiled addon if it has been built
+var native = null;
+try {
+  native = require('../build/Release/native');
+} catch (err) {
+  // Fall back to the JavaScript implementations
+}
+
+module.exports = native || shim;
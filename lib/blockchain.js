@@ -196,6 +196,21 @@ var BlockChain = exports.BlockChain = function BlockChain(storage, settings) {
   var getConflictingTransactions = this.getConflictingTransactions =
   storage.getConflictingTransactions.bind(storage);
 
+  /**
+   * Look up unspent outputs by their 36 byte outpoints.
+   *
+   * Calls back with an Array of {v, s, height} objects, with null for outputs
+   * the storage backend doesn't know without loading their transactions.
+   */
+  var getCoins = this.getCoins =
+  function getCoins(outpoints, callback) {
+    if ("function" === typeof storage.getCoins) {
+      storage.getCoins(outpoints, callback);
+    } else {
+      callback(null, outpoints.map(function () { return null; }));
+    }
+  };
+
   /**
    * Whether the blockchain has reached the last hardcoded checkpoint.
    *
@@ -855,7 +870,7 @@ var BlockChain = exports.BlockChain = function BlockChain(storage, settings) {
       });
 
       callback(null);
-    });
+    }, block.height);
   };
 
   this.findFork = function findFork(bOld, bNew, toDisconnect, toConnect, callback) {
@@ -1052,7 +1067,7 @@ var BlockChain = exports.BlockChain = function BlockChain(storage, settings) {
                 }
 
                 // Connect the inputs for these transactions
-                storage.connectTransactions(txs, callback);
+                storage.connectTransactions(txs, callback, block.height);
               };
             });
 
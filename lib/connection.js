@@ -4,11 +4,14 @@ var Buffers = require('buffers');
 var logger = require('./logger');
 var Binary = require('./binary');
 var Parser = require('./parser').Parser;
+var TxTable = require('./txview').TxTable;
 var Util = require('./util');
 var Block = require('./schema/block').Block;
 
 var bitcoin = require('./bitcoin');
 
+var Framer = Util.ccmodule.Framer;
+
 Buffers.prototype.skip = function (i) {
   return this.splice(0, i);
 };
@@ -36,12 +39,17 @@ var Connection = exports.Connection = function Connection(node, socket, peer) {
   this.getaddr = false;
 
   // Receive buffer
-  this.buffers = new Buffers();
+  if (Framer) {
+    this.framer = new Framer(node.cfg.network.magicBytes,
+                             this.handleFrame.bind(this));
+  } else {
+    this.buffers = new Buffers();
+  }
 
   // Starting 20 Feb 2012, Version 0.2 is obsolete
   // This is the same behavior as the official client
   if (new Date().getTime() > 1329696000000) {
-    this.recvVer = 209;
+    this.setRecvVer(209);
     this.sendVer = 209;
   }
 
@@ -124,19 +132,19 @@ Connection.prototype.handleMessage = function (message) {
       }
       this.sendVer = Math.min(message.version, this.node.version);
       if (message.version < 209) {
-        this.recvVer = Math.min(message.version, this.node.version);
+        this.setRecvVer(Math.min(message.version, this.node.version));
       } else {
         // We won't start expecting a checksum until after we've received
         // the "verack" message.
         this.once('verack', (function () {
-          this.recvVer = message.version;
+          this.setRecvVer(message.version);
         }).bind(this));
       }
       this.bestHeight = message.start_height;
       break;
 
     case 'verack':
-      this.recvVer = Math.min(message.version, this.node.version);
+      this.setRecvVer(Math.min(message.version, this.node.version));
       this.active = true;
       break;
 
@@ -316,17 +324,52 @@ Connection.prototype.sendMessage = function (command, payload) {
   }
 };
 
+/**
+ * Set the version incoming messages are interpreted as. Only messages from
+ * version 209 on carry a checksum.
+ */
+Connection.prototype.setRecvVer = function (version) {
+  this.recvVer = version;
+  if (this.framer) {
+    this.framer.checksum = version >= 209;
+  }
+};
+
 Connection.prototype.handleData = function (data) {
-  this.buffers.push(data);
+  var buffered;
+  if (this.framer) {
+    this.framer.push(data);
+    buffered = this.framer.length;
+  } else {
+    this.buffers.push(data);
+    buffered = this.buffers.length;
+  }
 
-  if (this.buffers.length > (this.node.cfg.maxReceiveBuffer * 1000)) {
-    logger.error("Peer "+this.peer+" exceeded maxreceivebuffer, disconnecting."+
-                 (err.stack ? err.stack : err.toString()));
+  if (buffered > (this.node.cfg.maxReceiveBuffer * 1000)) {
+    logger.error("Peer "+this.peer+" exceeded maxreceivebuffer, disconnecting.");
     this.socket.destroy();
     return;
   }
 
-  this.processData();
+  if (!this.framer) {
+    this.processData();
+  }
+};
+
+/**
+ * Called by the native framer for each complete message.
+ */
+Connection.prototype.handleFrame = function (err, command, payload) {
+  logger.netdbg('['+this.peer+'] ' +
+                "Received message " + command +
+                " (" + payload.length + " bytes)");
+
+  if (err) {
+    logger.error('['+this.peer+'] '+err.message, { cmd: command });
+    return;
+  }
+
+  this.handleMessage(this.tryParseMessage(command, payload));
 };
 
 Connection.prototype.processData = function () {
@@ -388,15 +431,7 @@ Connection.prototype.processData = function () {
     }
   }
 
-  var message;
-  try {
-    message = this.parseMessage(command, payload);
-  } catch (e) {
-    logger.error('Error while parsing message '+command+' from ' +
-                 this.peer + ':\n' +
-                 (e.stack ? e.stack : e.toString()));
-  }
-
+  var message = this.tryParseMessage(command, payload);
   if (message) {
     this.handleMessage(message);
   }
@@ -405,6 +440,17 @@ Connection.prototype.processData = function () {
   this.processData();
 };
 
+Connection.prototype.tryParseMessage = function (command, payload) {
+  try {
+    return this.parseMessage(command, payload);
+  } catch (e) {
+    logger.error('Error while parsing message '+command+' from ' +
+                 this.peer + ':\n' +
+                 (e.stack ? e.stack : e.toString()));
+    return null;
+  }
+};
+
 Connection.prototype.parseMessage = function (command, payload) {
   var parser = new Parser(payload);
 
@@ -447,17 +493,27 @@ Connection.prototype.parseMessage = function (command, payload) {
     data.bits = parser.word32le();
     data.nonce = parser.word32le();
 
-    var txCount = Connection.parseVarInt(parser);
+    if (TxTable.isAvailable()) {
+      data.txs = TxTable.parseBlock(payload).getAll();
+    } else {
+      var txCount = Connection.parseVarInt(parser);
 
-    data.txs = [];
-    for (i = 0; i < txCount; i++) {
-      data.txs.push(Connection.parseTx(parser));
+      data.txs = [];
+      for (i = 0; i < txCount; i++) {
+        data.txs.push(Connection.parseTx(parser));
+      }
     }
 
     data.size = payload.length;
     break;
 
   case 'tx':
+    if (TxTable.isAvailable()) {
+      var view = TxTable.parseTx(payload).get(0);
+      view.command = command;
+      return view;
+    }
+
     var txData = Connection.parseTx(parser);
     return {
       command: command,
@@ -555,6 +611,9 @@ Connection.parseVarStr = function (parser) {
 
 Connection.parseTx = function (parser) {
   if (Buffer.isBuffer(parser)) {
+    if (TxTable.isAvailable()) {
+      return TxTable.parseTx(parser).get(0);
+    }
     parser = new Parser(parser);
   }
 
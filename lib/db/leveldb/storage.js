@@ -11,6 +11,7 @@ var mkdirp = require('mkdirp');
 var existsSync = fs.existsSync || path.existsSync;
 
 var leveldown = require('leveldown'); // database
+var binding = require('../../binding');
 
 var Block = require('../../schema/block').Block;
 var Transaction = require('../../schema/transaction').Transaction;
@@ -109,6 +110,14 @@ var LevelDownStorage = exports.LevelDownStorage = exports.Storage =
         var metadata;
         var currentBatch = null;
 
+        // Cache of unspent outputs in front of the database, size in MB
+        var coins = null;
+        if ("function" === typeof binding.CoinCache) {
+            var coinCacheSize = +url.parse(uri, true).query.coinCacheSize;
+            if (isNaN(coinCacheSize)) coinCacheSize = 64;
+            coins = new binding.CoinCache(coinCacheSize * 1024 * 1024);
+        }
+
         var connect = this.connect = function connect(callback) {
             if (connected) {
                 callback(null);
@@ -355,6 +364,9 @@ var LevelDownStorage = exports.LevelDownStorage = exports.Storage =
 
         var endTransaction = this.endTransaction = function (callback) {
             if (currentBatch) {
+                if (coins) {
+                    currentBatch = currentBatch.concat(coins.flush());
+                }
                 hMain.batch(currentBatch, callback);
             } else {
                 if ("function" === typeof callback) {
@@ -415,10 +427,14 @@ var LevelDownStorage = exports.LevelDownStorage = exports.Storage =
             };
 
         var connectTransactions = this.connectTransactions =
-            function connectTransactions(txs, callback) {
+            function connectTransactions(txs, callback, height) {
                 Step(
                     function saveSpent() {
                         var wb = currentBatch ? currentBatch : [];
+                        if (coins) {
+                            coins.connect(txs.map(serializeTransaction), height || 0);
+                            if (!currentBatch) wb = wb.concat(coins.flush());
+                        }
                         txs.forEach(function (tx) {
                             if (tx.isCoinBase()) {
                                 return;
@@ -462,6 +478,10 @@ var LevelDownStorage = exports.LevelDownStorage = exports.Storage =
                         wb.push({type: 'del', key: txin.o});
                     });
                 });
+                if (coins) {
+                    coins.disconnect(txs.map(serializeTransaction));
+                    if (!currentBatch) wb = wb.concat(coins.flush());
+                }
                 if (!currentBatch) hMain.write(wb, callback);
                 else callback(null);
             };
@@ -514,6 +534,56 @@ var LevelDownStorage = exports.LevelDownStorage = exports.Storage =
             getTransactionsByHashes(hashes, callback);
         };
 
+        /**
+         * Look up unspent outputs by their outpoints.
+         *
+         * Calls back with an Array of {v, s, height} objects, or null for
+         * outputs that have to be looked up in their transactions.
+         */
+        var getCoins = this.getCoins =
+            function getCoins(outpoints, callback) {
+                if (!coins) {
+                    callback(null, outpoints.map(function () { return null; }));
+                    return;
+                }
+
+                var result = coins.getMany(Buffer.concat(outpoints));
+                Step(
+                    function readMissesStep() {
+                        var group = this.group();
+                        result.forEach(function (coin, i) {
+                            if (coin) return;
+                            var key = Buffer.concat([new Buffer('c'), outpoints[i]]);
+                            var cb = group();
+                            hMain.get(key, defaultGetOpts, function (err, data) {
+                                if (err && !keyNotFound(err)) {
+                                    cb(err);
+                                    return;
+                                }
+                                if (data) {
+                                    coins.put(outpoints[i], data);
+                                    result[i] = {
+                                        v: data.slice(0, 8),
+                                        s: data.slice(16),
+                                        height: data.readUInt32LE(8)
+                                    };
+                                }
+                                cb(null);
+                            });
+                        });
+                    },
+                    function (err) {
+                        if (err) throw err;
+                        this(null, result);
+                    },
+                    callback
+                );
+            };
+
+        this.getCoinCacheStats = function () {
+            return coins ? coins.stats() : null;
+        };
+
         var getBlockByHash = this.getBlockByHash =
             function getBlockByHash(hash, callback) {
                 hMain.get(hash, defaultGetOpts, function getBlockByHashCallback(err, data) {
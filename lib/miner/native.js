@@ -0,0 +1,65 @@
+var Util = require('../util.js');
+var JavaScriptMiner = require('./javascript.js').JavaScriptMiner;
+
+var ccmodule = Util.ccmodule;
+
+/**
+ * Miner using the native multi-threaded nonce scanner.
+ *
+ * Options:
+ *   threads     Number of threads (default: one per core)
+ *   blockChain  Cancel the current scan whenever a new block is added
+ */
+var NativeMiner = exports.NativeMiner = function NativeMiner(opts) {
+  var self = this;
+
+  opts = opts || {};
+
+  this.threads = opts.threads || 0;
+  this.job = null;
+  this.lastStats = null;
+
+  if (opts.blockChain) {
+    opts.blockChain.on('blockAdd', function () {
+      self.cancel();
+    });
+  }
+};
+
+NativeMiner.prototype.solve = function (header, target, callback) {
+  var self = this;
+
+  // Only one scan at a time
+  this.cancel();
+
+  var job = ccmodule.scan_nonce(header, target, this.threads,
+                                function (err, nonce, stats) {
+    if (self.job === job) {
+      self.job = null;
+    }
+    self.lastStats = stats;
+    callback(err, nonce);
+  });
+  this.job = job;
+};
+
+NativeMiner.prototype.cancel = function () {
+  if (this.job !== null) {
+    ccmodule.scan_nonce_cancel(this.job);
+    this.job = null;
+  }
+};
+
+/**
+ * Hashes per second of the running scan, or of the last one.
+ */
+NativeMiner.prototype.getHashrate = function () {
+  var stats = this.job !== null ? ccmodule.scan_nonce_stats(this.job)
+                                : this.lastStats;
+  return stats ? stats.hashrate : 0;
+};
+
+// Without the native module, fall back to the JavaScript miner
+if ("function" !== typeof ccmodule.scan_nonce) {
+  exports.NativeMiner = JavaScriptMiner;
+}
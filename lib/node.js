@@ -89,6 +89,26 @@ var Node = function Node(cfg) {
     return;
   }
 
+  // Size the native verification thread pool
+  if (this.cfg.verifyThreads &&
+      "function" === typeof Util.ccmodule.verify_pool_threads) {
+    try {
+      Util.ccmodule.verify_pool_threads(this.cfg.verifyThreads);
+    } catch (err) {
+      logger.warn("Could not set verification threads: " + err.message);
+    }
+  }
+
+  // Size the native signature cache
+  if ("number" === typeof this.cfg.sigCacheSize &&
+      "function" === typeof Util.ccmodule.sig_cache_resize) {
+    try {
+      Util.ccmodule.sig_cache_resize(this.cfg.sigCacheSize);
+    } catch (err) {
+      logger.warn("Could not set signature cache size: " + err.message);
+    }
+  }
+
   var storageUri = this.cfg.storage.uri;
   if (!storageUri) {
     storageUri = 'leveldb://' + dataDir + '/leveldb/';
@@ -3,20 +3,35 @@ var Binary = require('binary');
 var logger = require('../logger');
 var Step = require('step');
 
-var newBlocksCache = {};
+var WorkTemplate = Util.ccmodule.WorkTemplate;
+
+// Work units are generated in batches sharing the same timestamp
+var WORK_BATCH_SIZE = 64;
+
+var templates = {};
+var template = null;
+var workQueue = [];
+var workTime = 0;
 var blockData = null;
 var lastPrevHeight = -1;
 var lastTxCount = 0;
 var lastTime = 0;
-var enonce = 0;
-var enoncePrevBlock = Util.NULL_HASH;
 
-function updateEnonce(block, txs, enonce) {
-  // Update coinbase tx script
-  txs[0].ins[0].script = Binary.put()
+// Offset of the extra-nonce in the coinbase: version, input count,
+// outpoint, script length and the difficulty bits before it
+var ENONCE_OFFSET = 4 + 1 + 36 + 1 + 4;
+
+function setCoinbaseScript(block, txs, enonce) {
+  txs[0].ins[0].s = Binary.put()
     .word32le(block.bits)  // Difficulty bits
     .word32le(enonce)      // Extra-nonce
     .buffer();
+  delete txs[0]._buffer;
+};
+
+function updateEnonce(block, txs, enonce) {
+  // Update coinbase tx script
+  setCoinbaseScript(block, txs, enonce);
 
   // Update coinbase tx hash
   txs[0].hash = txs[0].calcHash();
@@ -25,6 +40,24 @@ function updateEnonce(block, txs, enonce) {
   block.merkle_root = block.calcMerkleRoot(txs);
 };
 
+/**
+ * Native template that rolls the extra-nonce of this block's coinbase.
+ */
+function createTemplate(block, txs, enonce) {
+  setCoinbaseScript(block, txs, 0);
+  var coinbase = txs[0].serialize();
+
+  return new WorkTemplate({
+    version: block.version,
+    prevHash: block.prev_hash,
+    bits: block.bits,
+    coinbase1: coinbase.slice(0, ENONCE_OFFSET),
+    coinbase2: coinbase.slice(ENONCE_OFFSET + 4),
+    branch: Buffer.concat(block.getMerkleBranch(txs, 0)),
+    extranonce: enonce
+  });
+};
+
 exports.getwork = function getwork(args, opt, callback) {
   if (args.length == 0) { // Request for work
     var self = this;
@@ -42,7 +75,8 @@ exports.getwork = function getwork(args, opt, callback) {
         (lastTxCount != txCount && time - lastTime > 60)) {
       steps.push(function () {
         if (lastPrevHeight != +topBlock.height) {
-          newBlocksCache = {};
+          templates = {};
+          template = null;
           lastPrevHeight = +topBlock.height;
         }
 
@@ -59,6 +93,13 @@ exports.getwork = function getwork(args, opt, callback) {
         if (err) throw err;
         blockData = data;
         lastTime = time;
+
+        // Keep counting at the same height, so no two templates hand out
+        // the same coinbase
+        template = createTemplate(data.block, data.txs,
+                                  template ? template.getExtranonce() : 0);
+        templates[template.id] = data;
+        workQueue = [];
         this(null);
       });
     }
@@ -68,39 +109,12 @@ exports.getwork = function getwork(args, opt, callback) {
       // TODO: Implement GetAdjustedTime
       var timestamp = time;
 
-      blockData.block.timestamp = timestamp;
-
-      // Update extra nonce, start over at 1 when timestamp increases
-      if (enoncePrevBlock.compare(blockData.block.prev_hash) != 0) {
-        enonce = 0;
-        enoncePrevBlock = new Buffer(blockData.block.prev_hash);
+      if (!workQueue.length || workTime != timestamp) {
+        workQueue = template.getWork(WORK_BATCH_SIZE, timestamp);
+        workTime = timestamp;
       }
-      ++enonce;
-
-      updateEnonce(blockData.block, blockData.txs, enonce);
-
-      var header = blockData.block.getHeader();
 
-      var result = {
-        midstate: Util.encodeHex(Util.sha256midstate(header)),
-        data: Util.encodeHex(Util.reverseBytes32(header))
-          + "0000008000000000000000000000000000000000000000000000000000000000"
-          + "00000000000000000000000080020000",
-        target: Util.encodeHex(Util.decodeDiffBits(blockData.block.bits).reverse()),
-        hash1: "0000000000000000000000000000000000000000000000000000000000000000"
-          + "0000008000000000000000000000000000000000000000000000000000010000"
-      };
-
-      var cache = {
-        block: blockData.block,
-        txs: blockData.txs,
-        time: timestamp,
-        enonce: enonce
-      };
-
-      newBlocksCache[blockData.block.merkle_root.toString('base64')] = cache;
-
-      this(null, result);
+      this(null, workQueue.shift());
     });
 
     steps.push(callback);
@@ -116,20 +130,19 @@ exports.getwork = function getwork(args, opt, callback) {
 
     data = Util.reverseBytes32(data);
 
-    var nb = newBlocksCache[data.slice(36,68).toString('base64')];
+    // Look up the template, extra-nonce and time by the merkle root
+    var unit = WorkTemplate.find(data);
+    var nb = unit && templates[unit.id];
     if (!nb) {
       this.log("getwork: Received stale solution");
       callback(null, false);
       return;
     }
 
-    // Extract nonce from data block
-    var nonce = Binary.parse(data.slice(76, 80)).word32le('nonce').vars.nonce;
-
     // Update stored block
-    nb.block.nonce = nonce;
-    nb.block.timestamp = nb.time;
-    updateEnonce(nb.block, nb.txs, nb.enonce);
+    nb.block.nonce = unit.nonce;
+    nb.block.timestamp = unit.time;
+    updateEnonce(nb.block, nb.txs, unit.extranonce);
 
     // Check solution
     try {
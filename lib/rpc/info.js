@@ -40,3 +40,16 @@ exports.getinfo = function getinfo(args, opt, callback) {
   };
   callback(null, info);
 };
+
+/**
+ * Counters and latency histograms of the native addon, see src/stats.h.
+ *
+ * Pass true to reset the statistics after reading them.
+ */
+exports.getnativestats = function getnativestats(args, opt, callback) {
+  var stats = Util.ccmodule.stats();
+  if (args[0]) {
+    Util.ccmodule.reset_stats();
+  }
+  callback(null, stats);
+};
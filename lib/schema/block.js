@@ -92,6 +92,9 @@ Block.prototype.checkProofOfWork = function checkProofOfWork() {
  */
 Block.prototype.getWork = function getWork() {
   var target = Util.decodeDiffBits(this.bits, true);
+  if ("function" === typeof target.getWork) { // native UInt256
+    return target.getWork();
+  }
   return BlockRules.largestHash.div(target.add(1));
 };
 
@@ -151,6 +154,15 @@ Block.prototype.getMerkleTree = function getMerkleTree(txs) {
     return tx instanceof Transaction ? tx.getHash() : tx;
   });
 
+  if (Util.ccmodule.merkle_tree) {
+    var nodes = Util.ccmodule.merkle_tree(Buffer.concat(tree));
+    tree = [];
+    for (var k = 0; k < nodes.length; k += 32) {
+      tree.push(nodes.slice(k, k + 32));
+    }
+    return tree;
+  }
+
   var j = 0;
   // Now step through each level ...
   for (var size = txs.length; size > 1; size = Math.floor((size + 1) / 2)) {
@@ -167,6 +179,34 @@ Block.prototype.getMerkleTree = function getMerkleTree(txs) {
   return tree;
 };
 
+/**
+ * Get the merkle branch proving that the transaction at index is part of
+ * this block, as an array of hashes from the bottom of the tree upwards.
+ */
+Block.prototype.getMerkleBranch = function getMerkleBranch(txs, index) {
+  var hashes = txs.map(function (tx) {
+    return tx instanceof Transaction ? tx.getHash() : tx;
+  });
+
+  var branch = [];
+  if (Util.ccmodule.merkle_branch) {
+    var nodes = Util.ccmodule.merkle_branch(Buffer.concat(hashes), index);
+    for (var k = 0; k < nodes.length; k += 32) {
+      branch.push(nodes.slice(k, k + 32));
+    }
+    return branch;
+  }
+
+  var tree = this.getMerkleTree(hashes);
+  var j = 0;
+  for (var size = hashes.length; size > 1; size = Math.floor((size + 1) / 2)) {
+    branch.push(tree[j + Math.min(index ^ 1, size - 1)]);
+    index >>= 1;
+    j += size;
+  }
+  return branch;
+};
+
 Block.prototype.calcMerkleRoot = function calcMerkleRoot(txs) {
   var tree = this.getMerkleTree(txs);
   return tree[tree.length - 1];
@@ -235,6 +275,9 @@ Block.prototype.setChainWork = function setChainWork(chainWork) {
 };
 
 Block.prototype.getChainWork = function getChainWork() {
+  if (Util.ccmodule.UInt256) {
+    return Util.ccmodule.UInt256.fromBuffer(this.chainWork);
+  }
   return bignum.fromBuffer(this.chainWork);
 };
 
@@ -245,6 +288,60 @@ Block.prototype.moreWorkThan = function moreWorkThan(otherBlock) {
   return this.getChainWork().cmp(otherBlock.getChainWork()) > 0;
 };
 
+/**
+ * Checks a run of concatenated 80 byte headers for headers-first sync.
+ *
+ * Every header must link to the one before it, starting at prevHash, and
+ * meet the target of its own difficulty bits. Returns the index of the
+ * first invalid header (-1 if there is none) and why it failed, along with
+ * the hash and chain work of the last valid header.
+ */
+Block.validateHeaders =
+function validateHeaders(headers, prevHash, prevChainWork) {
+  if ("function" === typeof prevChainWork.toBuffer) { // duck-typing bignum
+    prevChainWork = prevChainWork.toBuffer();
+  }
+
+  if (Util.ccmodule.validate_headers) {
+    return Util.ccmodule.validate_headers(headers, prevHash, prevChainWork);
+  }
+
+  var result = {
+    failed: -1,
+    error: null,
+    hash: prevHash,
+    chainWork: bignum.fromBuffer(prevChainWork)
+  };
+  for (var i = 0; i < headers.length / 80; i++) {
+    var p = Binary.parse(headers.slice(i * 80, i * 80 + 80))
+      .word32lu('version')
+      .buffer('prev_hash', 32)
+      .buffer('merkle_root', 32)
+      .word32lu('timestamp')
+      .word32lu('bits')
+      .word32lu('nonce')
+      .vars;
+    var block = new Block(p);
+
+    try {
+      if (block.prev_hash.compare(result.hash) != 0) {
+        throw new VerificationError('Header does not link to the previous one');
+      }
+      block.hash = block.calcHash();
+      block.checkProofOfWork();
+    } catch (e) {
+      result.failed = i;
+      result.error = e.message;
+      break;
+    }
+
+    result.hash = block.hash;
+    result.chainWork = result.chainWork.add(block.getWork());
+  }
+  result.chainWork = result.chainWork.toBuffer();
+  return result;
+};
+
 /**
  * Returns the difficulty target for the next block after this one.
  */
@@ -1,11 +1,12 @@
 var Script = require('../script').Script;
 var ScriptInterpreter = require('../scriptinterpreter').ScriptInterpreter;
 var Util = require('../util');
-var bignum = require('bignum');
 var Binary = require('../binary');
 var error = require('../error');
 var logger = require('../logger');
 var Step = require('step');
+var TxView = require('../txview').TxView;
+var defineLazy = require('../txview').defineLazy;
 
 var VerificationError = error.VerificationError;
 var MissingSourceError = error.MissingSourceError;
@@ -96,20 +97,34 @@ var Transaction = exports.Transaction = function Transaction (data) {
   this.hash = data.hash || null;
   this.version = data.version;
   this.lock_time = data.lock_time;
-  this.ins = Array.isArray(data.ins) ? data.ins.map(function (data) {
+  if (data instanceof TxView) {
+    // Inputs and outputs are only decoded once they are used
+    defineLazy(this, 'ins', function () { return copyIns(data.ins); });
+    defineLazy(this, 'outs', function () { return copyOuts(data.outs); });
+  } else {
+    this.ins = Array.isArray(data.ins) ? copyIns(data.ins) : [];
+    this.outs = Array.isArray(data.outs) ? copyOuts(data.outs) : [];
+  }
+  if (data.buffer) this._buffer = data.buffer;
+};
+
+function copyIns(ins) {
+  return ins.map(function (data) {
     var txin = new TransactionIn();
     txin.s = data.s;
     txin.q = data.q;
     txin.o = data.o;
     return txin;
-  }) : [];
-  this.outs = Array.isArray(data.outs) ? data.outs.map(function (data) {
+  });
+};
+
+function copyOuts(outs) {
+  return outs.map(function (data) {
     var txout = new TransactionOut();
     txout.v = data.v;
     txout.s = data.s;
     return txout;
-  }) : [];
-  if (data.buffer) this._buffer = data.buffer;
+  });
 };
 
 Transaction.prototype.isCoinBase = function () {
@@ -199,8 +214,8 @@ Transaction.prototype.verify = function verify(txCache, blockChain, callback) {
 
   var outpoints = [];
 
-  var valueIn = bignum(0);
-  var valueOut = bignum(0);
+  var valueIn;
+  var valueOut;
 
   function getTxOut(txin, n) {
     var outHash = txin.getOutpointHash();
@@ -230,21 +245,35 @@ Transaction.prototype.verify = function verify(txCache, blockChain, callback) {
 
   Step(
     function verifyInputs() {
-      var group = this.group();
-
       if (self.isCoinBase()) {
         throw new Error("Coinbase tx are invalid unless part of a block");
       }
 
-      self.ins.forEach(function (txin, n) {
+      var txouts = self.ins.map(function (txin, n) {
         var txout = getTxOut(txin, n);
 
         // TODO: Verify coinbase maturity
 
-        valueIn = valueIn.add(Util.valueToBigInt(txout.v));
-
         outpoints.push(txin.o);
 
+        return txout;
+      });
+
+      valueIn = Util.sumValues(txouts.map(function (txout) {
+        return txout.v;
+      }));
+
+      // The native interpreter runs all inputs in one go
+      if ("function" === typeof Util.ccmodule.verify_transaction) {
+        var scriptPubKeys = txouts.map(function (txout) {
+          return txout.s;
+        });
+        Util.ccmodule.verify_transaction(self.getBuffer(), scriptPubKeys, this);
+        return;
+      }
+
+      var group = this.group();
+      txouts.forEach(function (txout, n) {
         self.verifyInput(n, txout.getScript(), group());
       });
     },
@@ -253,6 +282,9 @@ Transaction.prototype.verify = function verify(txCache, blockChain, callback) {
       if (err) throw err;
 
       for (var i = 0, l = results.length; i < l; i++) {
+        if (results[i] instanceof Error) {
+          throw results[i];
+        }
         if (!results[i]) {
           var txout = getTxOut(self.ins[i]);
           logger.scrdbg('Script evaluated to false');
@@ -274,9 +306,9 @@ Transaction.prototype.verify = function verify(txCache, blockChain, callback) {
     function checkConflicts(err, count) {
       if (err) throw err;
 
-      self.outs.forEach(function (txout) {
-        valueOut = valueOut.add(Util.valueToBigInt(txout.v));
-      });
+      valueOut = Util.sumValues(self.outs.map(function (txout) {
+        return txout.v;
+      }));
 
       if (valueIn.cmp(valueOut) < 0) {
         var outValue = Util.formatValue(valueOut);
@@ -337,16 +369,26 @@ Transaction.prototype.getAffectedKeys = function getAffectedKeys(txCache) {
   if (!(this.affects && this.affects.length)) {
     this.affects = [];
 
+    // Pubkeys are collected and hashed together at the end
+    var pubKeys = [];
+    var addScript = function (script) {
+      switch (script.getOutType()) {
+      case 'Address':
+        this.affects.push(script.chunks[2]);
+        break;
+      case 'Pubkey':
+        pubKeys.push(script.chunks[0]);
+        break;
+      default:
+        logger.scrdbg("Encountered non-standard scriptPubKey");
+        logger.scrdbg("Strange script was: " + script.toString());
+      }
+    }.bind(this);
+
     // Index any pubkeys affected by the outputs of this transaction
     for (var i = 0, l = this.outs.length; i < l; i++) {
       try {
-        var txout = this.outs[i];
-        var script = txout.getScript();
-
-        var outPubKey = script.simpleOutPubKeyHash();
-        if (outPubKey) {
-          this.affects.push(outPubKey);
-        }
+        addScript(this.outs[i].getScript());
       } catch (err) {
         // It's not our job to validate, so we just ignore any errors and issue
         // a very low level log message.
@@ -375,13 +417,7 @@ Transaction.prototype.getAffectedKeys = function getAffectedKeys(txCache) {
           throw new Error("Input not found!");
         }
 
-        var txout = fromTxOuts[outIndex];
-        var script = txout.getScript();
-
-        var outPubKey = script.simpleOutPubKeyHash();
-        if (outPubKey) {
-          this.affects.push(outPubKey);
-        }
+        addScript(fromTxOuts[outIndex].getScript());
       } catch (err) {
         // It's not our job to validate, so we just ignore any errors and issue
         // a very low level log message.
@@ -389,6 +425,8 @@ Transaction.prototype.getAffectedKeys = function getAffectedKeys(txCache) {
                      (err.stack ? err.stack : ""+err));
       }
     }
+
+    this.affects = this.affects.concat(Util.sha256ripe160Many(pubKeys));
   }
 
   var affectedKeys = {};
@@ -405,7 +443,7 @@ var OP_CODESEPARATOR = 171;
 var SIGHASH_ALL = 1;
 var SIGHASH_NONE = 2;
 var SIGHASH_SINGLE = 3;
-var SIGHASH_ANYONECANPAY = 80;
+var SIGHASH_ANYONECANPAY = 0x80;
 
 Transaction.prototype.hashForSignature =
 function hashForSignature(script, inIndex, hashType) {
@@ -415,22 +453,22 @@ function hashForSignature(script, inIndex, hashType) {
                     "("+this.ins.length+" inputs)");
   }
 
-  // Clone transaction
-  var txTmp = new Transaction();
-  this.ins.forEach(function (txin, i) {
-    txTmp.ins.push(new TransactionIn(txin));
-  });
-  this.outs.forEach(function (txout) {
-    txTmp.outs.push(new TransactionOut(txout));
-  });
-  txTmp.version = this.version;
-  txTmp.lock_time = this.lock_time;
-
   // In case concatenating two scripts ends up with two codeseparators,
   // or an extra one at the end, this prevents all those possible
   // incompatibilities.
   script.findAndDelete(OP_CODESEPARATOR);
 
+  // The script interpreter asks for one input after another, so the
+  // parsed transaction is kept until it is serialized again
+  if (Util.ccmodule.SigHashTx) {
+    var buffer = this.getBuffer();
+    if (!this._sigHashTx || this._sigHashBuffer !== buffer) {
+      this._sigHashTx = new Util.ccmodule.SigHashTx(buffer);
+      this._sigHashBuffer = buffer;
+    }
+    return this._sigHashTx.hash(inIndex, script.buffer, +hashType);
+  }
+
   // Get mode portion of hashtype
   var hashTypeMode = hashType & 0x1f;
 
@@ -462,7 +500,8 @@ function hashForSignature(script, inIndex, hashType) {
         bytes.varint(0);
       }
 
-      if (hashTypeMode === SIGHASH_NONE && inIndex !== i) {
+      if ((hashTypeMode === SIGHASH_NONE ||
+           hashTypeMode === SIGHASH_SINGLE) && inIndex !== i) {
         bytes.word32le(0);
       } else {
         bytes.word32le(this.ins[i].q);
@@ -477,7 +516,7 @@ function hashForSignature(script, inIndex, hashType) {
     var outsLen;
     if (hashTypeMode === SIGHASH_SINGLE) {
       // TODO: Untested
-      if (inIndex >= txTmp.outs.length) {
+      if (inIndex >= this.outs.length) {
         throw new Error("Transaction.hashForSignature(): SIGHASH_SINGLE " +
                         "no corresponding txout found - out of bounds");
       }
@@ -512,6 +551,42 @@ function hashForSignature(script, inIndex, hashType) {
   return Util.twoSha256(buffer);
 };
 
+/**
+ * Signature hashes for all inputs.
+ *
+ * Takes an array with one script per input and either one hash type for
+ * all inputs or an array of them. Returns an array of hashes.
+ */
+Transaction.prototype.hashesForSignature =
+function hashesForSignature(scripts, hashTypes) {
+  if (scripts.length !== this.ins.length) {
+    throw new Error("Expected "+this.ins.length+" scripts, got "+
+                    scripts.length);
+  }
+
+  scripts.forEach(function (script) {
+    script.findAndDelete(OP_CODESEPARATOR);
+  });
+
+  if (Util.ccmodule.sighash_many) {
+    var hashes = Util.ccmodule.sighash_many(
+      this.getBuffer(),
+      scripts.map(function (script) { return script.buffer; }),
+      hashTypes
+    );
+    var result = [];
+    for (var i = 0; i < scripts.length; i++) {
+      result.push(hashes.slice(32 * i, 32 * (i + 1)));
+    }
+    return result;
+  }
+
+  return scripts.map(function (script, i) {
+    var hashType = Array.isArray(hashTypes) ? hashTypes[i] : hashTypes;
+    return this.hashForSignature(script, i, hashType);
+  }, this);
+};
+
 /**
  * Returns an object with the same field names as jgarzik's getblock patch.
  */
@@ -639,14 +714,73 @@ TransactionInputsCache.prototype.buffer = function buffer(blockChain, txStore, w
       }
     },
     indexTxs,
-    // Second find and index persistent transactions
+    // Second look up the outputs that are still missing in the coin cache
+    function findCachedCoins(err) {
+      if (err) throw err;
+
+      var missingHashes = Object.keys(missingTx);
+      if (!missingHashes.length ||
+          "function" !== typeof blockChain.getCoins) {
+        this(null);
+        return;
+      }
+
+      var outpoints = [];
+      var owners = [];
+      missingHashes.forEach(function (hash64) {
+        var hash = new Buffer(hash64, 'base64');
+        Object.keys(self.requiredOuts[hash64]).forEach(function (o) {
+          var outpoint = new Buffer(36);
+          hash.copy(outpoint);
+          outpoint.writeUInt32LE(+o, 32);
+          outpoints.push(outpoint);
+          owners.push([hash64, +o]);
+        });
+      });
+
+      var callback = this;
+      blockChain.getCoins(outpoints, function (err, coins) {
+        if (err) {
+          callback(err);
+          return;
+        }
+
+        // Only transactions whose outputs were all found are complete
+        var found = {};
+        coins.forEach(function (coin, i) {
+          var hash64 = owners[i][0];
+          if (!coin) {
+            found[hash64] = false;
+            return;
+          }
+          if (!found.hasOwnProperty(hash64)) found[hash64] = {};
+          if (found[hash64]) {
+            found[hash64][owners[i][1]] = new TransactionOut(coin);
+          }
+        });
+        Object.keys(found).forEach(function (hash64) {
+          if (found[hash64]) {
+            self.txIndex[hash64] = found[hash64];
+            delete missingTx[hash64];
+          }
+        });
+        callback(null);
+      });
+    },
+    // Third find and index persistent transactions
     function findBlockChainTx(err) {
       if (err) throw err;
 
-      // TODO: Major speedup should be possible if we load only the outs and not
-      //       whole transactions.
+      var missingHashes = Object.keys(missingTx);
+      if (!missingHashes.length) {
+        this(null, []);
+        return;
+      }
+
       var callback = this;
-      blockChain.getOutputsByHashes(self.txList, function (err, result) {
+      blockChain.getOutputsByHashes(missingHashes.map(function (hash64) {
+        return new Buffer(hash64, 'base64');
+      }), function (err, result) {
         callback(err, result);
       });
     },
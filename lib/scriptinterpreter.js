@@ -886,6 +886,35 @@ function verify(scriptSig, scriptPubKey, txTo, n, hashType, callback)
   // Create execution environment
   var si = new ScriptInterpreter();
 
+  // Standard inputs are verified natively without running the scripts. The
+  // final stack is what the scripts would have left.
+  if (hashType === 0 && "function" === typeof Util.ccmodule.verify_standard_input &&
+      Util.ccmodule.verify_standard_input(txTo.getBuffer(), n,
+                                        scriptSig.buffer, scriptPubKey.buffer,
+                                        function (err, result) {
+        if (!err) {
+          si.stack = [new Buffer([result ? 1 : 0])];
+        }
+        callback(err, result);
+      })) {
+    return si;
+  }
+
+  // Everything else goes through the native interpreter if there is one
+  if ("function" === typeof Util.ccmodule.verify_script) {
+    Util.ccmodule.verify_script(txTo.getBuffer(), n,
+                               scriptSig.buffer, scriptPubKey.buffer, hashType,
+                               function (err, result, stack) {
+      if (err) {
+        callback(err);
+        return;
+      }
+      si.stack = stack;
+      callback(null, result);
+    });
+    return si;
+  }
+
   // Evaluate scripts
   si.evalTwo(scriptSig, scriptPubKey, txTo, n, hashType, function (err) {
     if (err) {
@@ -927,10 +956,52 @@ function (sig, pubkey, scriptCode, tx, n, hashType, callback) {
     var hash = tx.hashForSignature(scriptCode, n, hashType);
 
     // Verify signature
-    var key = new Util.BitcoinKey();
-    key.public = pubkey;
-    key.verifySignature(hash, sig, callback);
+    queueSigCheck(pubkey, hash, sig, callback);
   } catch (err) {
     callback(null, false);
   }
 };
+
+/**
+ * Signature checks are collected and verified in batches.
+ *
+ * All checks requested during one turn of the event loop (e.g. the inputs of
+ * all transactions in a block) are handed to the native module as a single
+ * job.
+ */
+var MAX_SIG_BATCH = 4096;
+var sigBatch = [];
+
+function queueSigCheck(pubkey, hash, sig, callback) {
+  if (!sigBatch.length) {
+    setImmediate(flushSigChecks);
+  }
+  sigBatch.push({pubkey: pubkey, hash: hash, sig: sig, callback: callback});
+  if (sigBatch.length >= MAX_SIG_BATCH) {
+    flushSigChecks();
+  }
+};
+
+function flushSigChecks() {
+  var batch = sigBatch;
+  if (!batch.length) return;
+  sigBatch = [];
+
+  function done(err, bitmap) {
+    for (var i = 0, l = batch.length; i < l; i++) {
+      if (err) {
+        batch[i].callback(err);
+      } else {
+        batch[i].callback(null, !!(bitmap[i >> 3] & (1 << (i & 7))));
+      }
+    }
+  }
+
+  // Bad arguments throw before the job is queued, every check in the batch
+  // has to hear about it
+  try {
+    Util.BitcoinKey.verifyBatch(batch, done);
+  } catch (err) {
+    done(err);
+  }
+};
@@ -41,6 +41,15 @@ Settings.prototype.setGeneralDefaults = function () {
 
   // Switch for disabling script/signature verification
   this.verifyScripts = true;
+
+  // Number of signature verification threads (null = one per core)
+  this.verifyThreads = null;
+
+  // Number of verified signatures to remember (null = native default)
+  this.sigCacheSize = null;
+
+  // Memory pool size limit in megabytes
+  this.memPoolSize = 300;
 };
 
 Settings.prototype.setStorageDefaults = function () {
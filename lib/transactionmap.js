@@ -5,10 +5,22 @@ var Util = require('./util');
 var error = require('./error');
 var events = require('events');
 
+var MemPool = Util.ccmodule.MemPool;
+
+function toHash(hash) {
+  if ("string" === typeof hash) {
+    return new Buffer(hash, 'base64');
+  }
+
+  assert.ok(Buffer.isBuffer(hash));
+  return hash;
+};
+
 var TransactionMap = exports.TransactionMap = function () {
   events.EventEmitter.call(this);
 
-  this.txIndex = {};
+  // Never trimmed, so the limit doesn't matter
+  this.pool = new MemPool(0);
 };
 
 util.inherits(TransactionMap, events.EventEmitter);
@@ -19,28 +31,11 @@ util.inherits(TransactionMap, events.EventEmitter);
  * @return Boolean Whether the transaction was new.
  */
 TransactionMap.prototype.add = function (tx) {
-  var hash = tx.hash.toString('binary');
-  var isNew = !this.txIndex[hash];
-  this.txIndex[hash] = tx;
-  return isNew;
+  return this.pool.put(tx.hash, tx);
 };
 
 TransactionMap.prototype.get = function (hash, callback) {
-  if ("string" === typeof hash) {
-    hash = new Buffer(hash, 'base64').toString('binary');
-  } else if (Buffer.isBuffer(hash)) {
-    hash = hash.toString('binary');
-  }
-
-  assert.equal(typeof hash, 'string');
-
-  var returnValue;
-
-  if (this.txIndex[hash]) {
-    returnValue = this.txIndex[hash];
-  } else {
-    returnValue = null;
-  }
+  var returnValue = this.pool.get(toHash(hash)) || null;
 
   if ("function" == typeof callback) {
     callback(null, returnValue);
@@ -50,70 +45,24 @@ TransactionMap.prototype.get = function (hash, callback) {
 };
 
 TransactionMap.prototype.getAll = function getAll() {
-  var self = this;
-  return Object.keys(this.txIndex).map(function (key) {
-    return self.txIndex[key];
-  });
+  return this.pool.getAll();
 };
 
 TransactionMap.prototype.remove = function (hash) {
-  if ("string" === typeof hash) {
-    hash = new Buffer(hash, 'base64').toString('binary');
-  } else if (Buffer.isBuffer(hash)) {
-    hash = hash.toString('binary');
-  }
-
-  assert.equal(typeof hash, 'string');
-
-  delete this.txIndex[hash];
+  this.pool.remove(toHash(hash));
 };
 
 TransactionMap.prototype.isKnown = function (hash) {
-  if ("string" === typeof hash) {
-    hash = new Buffer(hash, 'base64').toString('binary');
-  } else if (Buffer.isBuffer(hash)) {
-    hash = hash.toString('binary');
-  }
-
-  assert.equal(typeof hash, 'string');
-
-  return !!this.txIndex[hash];
+  return this.pool.has(toHash(hash));
 };
 
 TransactionMap.prototype.find = function (hashes, callback) {
-  var self = this;
-  var callbacks = hashes.length;
-  var disable = false;
-
-  if (!hashes.length) {
-    callback(null, []);
-  }
-
-  var result = [];
-  hashes.forEach(function (hash) {
-    self.get(hash, function (err, tx) {
-      if (disable) {
-        return;
-      }
-
-      if (err) {
-        callback(err);
-        disable = true;
-      }
-
-      callbacks--;
-
-      if (tx) {
-        result.push(tx);
-      }
-
-      if (callbacks === 0) {
-        callback(null, result);
-      }
-    });
+  var result = this.pool.getMany(hashes.map(toHash)).filter(function (tx) {
+    return !!tx;
   });
+  callback(null, result);
 };
 
 TransactionMap.prototype.getCount = function () {
-  return Object.keys(this.txIndex).length;
+  return this.pool.count();
 };
@@ -6,21 +6,84 @@ var error = require('./error');
 var events = require('events');
 
 var MissingSourceError = error.MissingSourceError;
+var VerificationError = error.VerificationError;
+
+var MemPool = Util.ccmodule.MemPool;
+
+/**
+ * Convert a hash given as Buffer or base64 string to a Buffer.
+ */
+function toHash(hash) {
+  if (Buffer.isBuffer(hash)) {
+    return hash;
+  }
+
+  assert.equal(typeof hash, 'string');
+  return new Buffer(hash, 'base64');
+};
+
+/**
+ * Concatenated outpoints spent by a transaction.
+ */
+function getOutpoints(tx) {
+  if (tx.isCoinBase()) {
+    return new Buffer(0);
+  }
+  return Buffer.concat(tx.ins.map(function (txin) { return txin.o; }));
+};
 
 var TransactionStore = exports.TransactionStore = function (node) {
   events.EventEmitter.call(this);
 
   this.node = node;
   this.blockChain = node.getBlockChain();
-  this.txIndex = {};
+
+  // Verified transactions, or the queue of callbacks waiting for one that
+  // is still being verified
+  var maxBytes = (node.cfg && node.cfg.memPoolSize || 300) * 1024 * 1024;
+  this.pool = new MemPool(maxBytes);
   this.txIndexByKey = {};
 
-  this.orphanTxIndex = {};
+  this.orphans = new MemPool(maxBytes);
   this.orphanTxByPrev = {};
 };
 
 util.inherits(TransactionStore, events.EventEmitter);
 
+/**
+ * Keep a transaction whose source transaction is missing.
+ *
+ * Orphans are indexed by the missing hash (base64), so they can be retried
+ * when it arrives. Once the orphan pool is over its limit the oldest ones
+ * are evicted from both.
+ */
+TransactionStore.prototype.addOrphan = function (tx, missingTxHash) {
+  var self = this;
+
+  var orphan = {tx: tx, prev: missingTxHash};
+  if (this.orphans.put(tx.getHash(), orphan, tx.getBuffer().length)) {
+    if (!this.orphanTxByPrev[missingTxHash]) {
+      this.orphanTxByPrev[missingTxHash] = [tx];
+    } else {
+      this.orphanTxByPrev[missingTxHash].push(tx);
+    }
+  }
+
+  this.orphans.trim().forEach(function (evicted) {
+    var waiting = self.orphanTxByPrev[evicted.prev];
+    if (!waiting) return;
+
+    waiting = waiting.filter(function (tx) {
+      return tx !== evicted.tx;
+    });
+    if (waiting.length) {
+      self.orphanTxByPrev[evicted.prev] = waiting;
+    } else {
+      delete self.orphanTxByPrev[evicted.prev];
+    }
+  });
+};
+
 /**
  * Add transaction to memory pool.
  *
@@ -32,15 +95,16 @@ util.inherits(TransactionStore, events.EventEmitter);
 TransactionStore.prototype.add = function (tx, callback) {
   var self = this;
 
-  var txHash = tx.getHash().toString('base64');
+  var txHash = tx.getHash();
+  var known = this.pool.get(txHash);
 
-  if (Array.isArray(this.txIndex[txHash])) {
+  if (Array.isArray(known)) {
     // Transaction is currently being verified, add callback to queue
     if ("function" === typeof callback) {
-      this.txIndex[txHash].push(callback);
+      known.push(callback);
     }
     return false;
-  } else if (this.txIndex[txHash]) {
+  } else if (known) {
     // Transaction is already known and verified, call callback immediately
     if ("function" === typeof callback) {
       callback(null, tx);
@@ -52,15 +116,14 @@ TransactionStore.prototype.add = function (tx, callback) {
     }
 
     // Create a new queue of callbacks to run after verification
-    this.txIndex[txHash] = [callback];
+    this.pool.put(txHash, [callback]);
   } else {
     // No callbacks to call after verification
-    this.txIndex[txHash] = [];
+    this.pool.put(txHash, []);
   }
 
   function runCallbacks(err, tx) {
-    var callbackQueue = self.txIndex[txHash];
-    delete self.txIndex[txHash];
+    var callbackQueue = self.pool.get(txHash);
     if (!Array.isArray(callbackQueue)) {
       // This should never happen and if it does indicates an error in
       // this library.
@@ -69,12 +132,15 @@ TransactionStore.prototype.add = function (tx, callback) {
     }
     if (!err) {
       // Transaction is valid, add to memory pool
-      self.txIndex[txHash] = tx;
+      self.pool.put(txHash, tx, tx.getBuffer().length, getOutpoints(tx));
+      self.pool.trim().forEach(function (evicted) {
+        self.cancel(evicted.getHash(), evicted);
+      });
     } else {
       // Transaction is not valid, remove from memory pool
       // Note that the transaction may have been added to the orphan pool
       // instead by the verification routine.
-      delete self.txIndex[txHash];
+      self.pool.remove(txHash);
     }
     callbackQueue.forEach(function (cb) { cb(err, tx); });
   };
@@ -101,33 +167,40 @@ TransactionStore.prototype.add = function (tx, callback) {
             // Verification couldn't proceed because of a missing source
             // transaction. We'll add this one to the orphans and try
             // again later.
-            this.orphanTxIndex[txHash] = tx;
-
+            //
             // Note that we'll call the callback now instead of waiting for
             // the missing source transaction, because we might never get it.
             // If the caller needs to handle this case, they should check for
             // a MissingSourceError themselves.
-            if (!this.orphanTxByPrev[err.missingTxHash]) {
-              this.orphanTxByPrev[err.missingTxHash] = [tx];
-            } else {
-              this.orphanTxByPrev[err.missingTxHash].push(tx);
-            }
+            this.addOrphan(tx, err.missingTxHash);
           }
 
           runCallbacks(err, tx);
           return;
         }
 
-        // TODO: Check conflicts with other in-memory transactions
+        // Reject double spends of outputs other pool transactions spend
+        var spenders = this.pool.getSpenders(getOutpoints(tx));
+        for (var j = 0, l = spenders.length; j < l; j++) {
+          if (spenders[j] && spenders[j].compare(txHash) !== 0) {
+            runCallbacks(new VerificationError(
+              "Conflicts with memory pool transaction " +
+                Util.formatHash(spenders[j])), tx);
+            return;
+          }
+        }
 
         runCallbacks(err, tx);
 
         // Process any orphan transactions that are waiting for this one
-        if (this.orphanTxByPrev[txHash]) {
-          this.orphanTxByPrev[txHash].forEach(function (tx) {
+        var txHash64;
+        if (this.orphans.count() &&
+            this.orphanTxByPrev[(txHash64 = txHash.toString('base64'))]) {
+          this.orphanTxByPrev[txHash64].forEach(function (tx) {
+            self.orphans.remove(tx.getHash());
             self.add(tx);
           });
-          delete this.orphanTxByPrev[txHash];
+          delete this.orphanTxByPrev[txHash64];
         }
 
         var eventData = {
@@ -163,48 +236,41 @@ TransactionStore.prototype.add = function (tx, callback) {
 };
 
 TransactionStore.prototype.get = function (hash, callback) {
-  if (Buffer.isBuffer(hash)) {
-    hash = hash.toString('base64');
-  }
-
-  assert.equal(typeof hash, 'string');
+  var tx = this.pool.get(toHash(hash));
 
   // If the transaction is currently being verified, we'll return null.
-  if (Array.isArray(this.txIndex[hash])) {
+  if (Array.isArray(tx)) {
     // But if there is a callback we'll return the transaction as soon as
     // it's ready.
     if ("function" === typeof callback) {
-      this.txIndex[hash].push(callback);
+      tx.push(callback);
     }
     return null;
   } else {
     // Note that we will return undefined if the transaction is not known
     if ("function" === typeof callback) {
-      callback(null, this.txIndex[hash]);
+      callback(null, tx);
     }
-    return this.txIndex[hash];
+    return tx;
   }
 };
 
 TransactionStore.prototype.getAll = function getAll() {
-  var self = this;
-  return Object.keys(this.txIndex).map(function (key) {
-    return self.txIndex[key];
+  return this.pool.getAll().filter(function (tx) {
+    return !Array.isArray(tx);
   });
 };
 
 TransactionStore.prototype.remove = function (hash) {
   var self = this;
-  if (Buffer.isBuffer(hash)) {
-    hash = hash.toString('base64');
-  }
+  hash = toHash(hash);
 
-  assert.equal(typeof hash, 'string');
+  var tx = this.pool.get(hash);
 
   // If the transaction is currently being verified, we'll wait and
-    // delete it later.
-  if (Array.isArray(this.txIndex[hash])) {
-    this.txIndex[hash].push(function (err, tx) {
+  // delete it later.
+  if (Array.isArray(tx)) {
+    tx.push(function (err, tx) {
       if (err) {
         // The transaction didn't make it anyway, we're done
         return;
@@ -212,24 +278,30 @@ TransactionStore.prototype.remove = function (hash) {
 
       self.remove(hash);
     });
-  } else if (this.txIndex[hash]) {
-    var tx = this.txIndex[hash];
-    delete this.txIndex[hash];
-    var eventData = {
-      store: this,
-      tx: tx,
-      txHash: hash
-    };
-    this.emit('txCancel', eventData);
-
-    // Create separate events for each address affected by this tx
-    if (this.node.cfg.feature.liveAccounting) {
-      var affectedKeys = tx.getAffectedKeys();
-
-      for (var i in affectedKeys) {
-        if (affectedKeys.hasOwnProperty(i)) {
-          this.emit('txCancel:'+i, eventData);
-        }
+  } else if (tx) {
+    this.pool.remove(hash);
+    this.cancel(hash, tx);
+  }
+};
+
+/**
+ * Announce that a transaction has left the memory pool.
+ */
+TransactionStore.prototype.cancel = function (hash, tx) {
+  var eventData = {
+    store: this,
+    tx: tx,
+    txHash: hash.toString('base64')
+  };
+  this.emit('txCancel', eventData);
+
+  // Create separate events for each address affected by this tx
+  if (this.node.cfg.feature.liveAccounting) {
+    var affectedKeys = tx.getAffectedKeys();
+
+    for (var i in affectedKeys) {
+      if (affectedKeys.hasOwnProperty(i)) {
+        this.emit('txCancel:'+i, eventData);
       }
     }
   }
@@ -237,50 +309,45 @@ TransactionStore.prototype.remove = function (hash) {
 
 
 TransactionStore.prototype.isKnown = function (hash) {
-  if (Buffer.isBuffer(hash)) {
-    hash = hash.toString('base64');
-  }
-
-  assert.equal(typeof hash, 'string');
+  hash = toHash(hash);
 
   // Note that a transaction will return true here even is it is still
   // being verified.
-  return !!(this.txIndex[hash] || this.orphanTxIndex[hash]);
+  return this.pool.has(hash) || this.orphans.has(hash);
 };
 
 
 TransactionStore.prototype.find = function (hashes, callback) {
   var self = this;
-  var callbacks = hashes.length;
-  var disable = false;
 
   if (!hashes.length) {
     callback(null, []);
+    return;
   }
 
   var result = [];
-  hashes.forEach(function (hash) {
-    self.get(hash, function (err, tx) {
-      if (disable) {
-        return;
-      }
-
-      if (err) {
-        callback(err);
-        disable = true;
-      }
-
-      callbacks--;
-
-      if (tx) {
-        result.push(tx);
-      }
-
-      if (callbacks === 0) {
-        callback(null, result);
-      }
-    });
+  var pending = 0;
+  var txs = this.pool.getMany(hashes.map(toHash));
+  txs.forEach(function (tx, i) {
+    if (Array.isArray(tx)) {
+      // Wait for the transactions that are still being verified
+      pending++;
+      tx.push(function (err, tx) {
+        if (!err && tx) {
+          result.push(tx);
+        }
+        if (--pending === 0) {
+          callback(null, result);
+        }
+      });
+    } else if (tx) {
+      result.push(tx);
+    }
   });
+
+  if (pending === 0) {
+    callback(null, result);
+  }
 };
 
 TransactionStore.prototype.getByKey = function (pubKeyHash) {
@@ -293,8 +360,9 @@ TransactionStore.prototype.getByKey = function (pubKeyHash) {
   if (!accIndex) {
     return [];
   } else {
+    var txs = this.pool.getMany(accIndex);
     for (var i = 0, l = accIndex.length; i < l; i++) {
-      var tx = this.txIndex[accIndex[i]];
+      var tx = txs[i];
       if (tx) {
         // We use this opportunity to create a new index where the
         // tx that no longer exist in the pool are removed
@@ -302,7 +370,7 @@ TransactionStore.prototype.getByKey = function (pubKeyHash) {
         newIndex.push(accIndex[i]);
 
         // TODO: Create the asynchronous version of this function
-        if ("function" !== typeof tx) {
+        if (!Array.isArray(tx)) {
           txList.push(tx);
         }
       }
@@ -338,22 +406,26 @@ TransactionStore.prototype.findByKey = function (pubKeyHashes, callback) {
  * and any conflicting transactions from the memory pool.
  */
 TransactionStore.prototype.handleTxAdd = function (e) {
+  var self = this;
+
   // Remove transaction from memory pool
-  var txHash = e.tx.getHash().toString('base64');
+  var txHash = e.tx.getHash();
   this.remove(txHash);
 
-  // Notify other components about spent inputs
+  // Remove the memory pool transactions that spend the same outputs
   if (!e.tx.isCoinBase()) {
-    for (var i = 0, l = e.tx.ins.length; i < l; i++) {
-      // TODO: Implement removal of conflicting tx
-      // 1. Find transaction depending on this output
-      // If there is none, we're done, otherwise:
-      // 2. Remove it from the pool
-      // 3. Issue txCancel messages
-    }
+    this.pool.getSpenders(getOutpoints(e.tx)).forEach(function (spender) {
+      if (spender && spender.compare(txHash) !== 0) {
+        self.remove(spender);
+      }
+    });
   }
 };
 
 TransactionStore.prototype.getCount = function () {
-  return Object.keys(this.txIndex).length;
+  return this.pool.count();
+};
+
+TransactionStore.prototype.getStats = function () {
+  return this.pool.stats();
 };
@@ -0,0 +1,137 @@
+/**
+ * Lazy views over transactions parsed by the native parser.
+ *
+ * ccmodule.parse_tx() and ccmodule.parse_block() don't decode anything, they
+ * return a table with the offsets of all fields (see src/txparser.h) and
+ * the transaction hashes. A TxView reads the scalar fields from the table
+ * and only slices inputs and outputs out of the message when they are
+ * first accessed.
+ */
+var Util = require('./util');
+
+var ccmodule = Util.ccmodule;
+
+// Sizes of the table records in 32 bit words
+var TX_WORDS = 8;
+var IN_WORDS = 4;
+var OUT_WORDS = 3;
+
+/**
+ * Define a property that is computed on first access and then stored as a
+ * plain value. Assigning to it before that skips the computation.
+ */
+var defineLazy = exports.defineLazy = function defineLazy(obj, name, fn) {
+  function store(obj, value) {
+    Object.defineProperty(obj, name, {
+      value: value,
+      writable: true,
+      enumerable: true,
+      configurable: true
+    });
+    return value;
+  }
+
+  Object.defineProperty(obj, name, {
+    get: function () {
+      return store(this, fn.call(this));
+    },
+    set: function (value) {
+      store(this, value);
+    },
+    enumerable: true,
+    configurable: true
+  });
+};
+
+var TxTable = exports.TxTable = function TxTable(buffer, parsed) {
+  this.buffer = buffer;
+  this.table = parsed.table;
+  this.hashes = parsed.hashes;
+  this.count = parsed.count;
+  this.end = parsed.end;
+};
+
+/**
+ * Parse the transaction at offset in buffer.
+ */
+TxTable.parseTx = function parseTx(buffer, offset) {
+  return new TxTable(buffer, ccmodule.parse_tx(buffer, offset || 0));
+};
+
+/**
+ * Parse all transactions of a serialized block.
+ */
+TxTable.parseBlock = function parseBlock(buffer) {
+  return new TxTable(buffer, ccmodule.parse_block(buffer));
+};
+
+TxTable.isAvailable = function isAvailable() {
+  return "function" === typeof ccmodule.parse_block;
+};
+
+TxTable.prototype.word = function word(i) {
+  return this.table.readUInt32LE(4 * i);
+};
+
+TxTable.prototype.get = function get(index) {
+  return new TxView(this, index);
+};
+
+TxTable.prototype.getAll = function getAll() {
+  var views = [];
+  for (var i = 0; i < this.count; i++) {
+    views.push(new TxView(this, i));
+  }
+  return views;
+};
+
+/**
+ * Transaction data in the same shape as Connection.parseTx() returns.
+ */
+var TxView = exports.TxView = function TxView(table, index) {
+  var rec = TX_WORDS * index;
+  var start = table.word(rec);
+
+  this._table = table;
+  this._index = index;
+
+  this.hash = table.hashes.slice(32 * index, 32 * (index + 1));
+  this.buffer = table.buffer.slice(start, start + table.word(rec + 1));
+  this.version = table.word(rec + 2);
+  this.lock_time = table.word(rec + 3);
+};
+
+defineLazy(TxView.prototype, 'ins', function () {
+  var table = this._table, buffer = table.buffer;
+  var rec = TX_WORDS * this._index;
+  var count = table.word(rec + 4), first = table.word(rec + 5);
+
+  var ins = [];
+  for (var i = 0; i < count; i++) {
+    var inRec = first + IN_WORDS * i;
+    var outpoint = table.word(inRec), script = table.word(inRec + 1);
+    ins.push({
+      o: buffer.slice(outpoint, outpoint + 36),
+      s: buffer.slice(script, script + table.word(inRec + 2)),
+      q: table.word(inRec + 3)
+    });
+  }
+  return ins;
+});
+
+defineLazy(TxView.prototype, 'outs', function () {
+  var table = this._table, buffer = table.buffer;
+  var rec = TX_WORDS * this._index;
+  var count = table.word(rec + 6), first = table.word(rec + 7);
+
+  var outs = [];
+  for (var i = 0; i < count; i++) {
+    var outRec = first + OUT_WORDS * i;
+    var value = table.word(outRec), script = table.word(outRec + 1);
+    outs.push({
+      v: buffer.slice(value, value + 8),
+      s: buffer.slice(script, script + table.word(outRec + 2))
+    });
+  }
+  return outs;
+});
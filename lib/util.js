@@ -26,13 +26,69 @@ var sha1 = exports.sha1 = function (data) {
 };
 
 var twoSha256 = exports.twoSha256 = function (data) {
+  if (ccmodule.sha256d && Buffer.isBuffer(data)) {
+    return ccmodule.sha256d(data);
+  }
   return sha256(sha256(data));
 };
 
+/**
+ * Double SHA-256 of many Buffers at once.
+ *
+ * Takes an Array of Buffers, or a single Buffer and a stride to hash it in
+ * fixed size chunks. Returns one Buffer with the hashes back to back.
+ */
+var twoSha256Many = exports.twoSha256Many = function (data, stride) {
+  if (ccmodule.sha256d_many) {
+    return stride ? ccmodule.sha256d_many(data, stride)
+                  : ccmodule.sha256d_many(data);
+  }
+
+  var hashes = [];
+  var i;
+  if (stride) {
+    for (i = 0; i < data.length; i += stride) {
+      hashes.push(twoSha256(data.slice(i, i + stride)));
+    }
+  } else {
+    for (i = 0; i < data.length; i++) {
+      hashes.push(twoSha256(data[i]));
+    }
+  }
+  return Buffer.concat(hashes);
+};
+
 var sha256ripe160 = exports.sha256ripe160 = function (data) {
   return ripe160(sha256(data));
 };
 
+/**
+ * hash160 of each Buffer in an Array, returned as an Array of 20 byte
+ * Buffers.
+ */
+var sha256ripe160Many = exports.sha256ripe160Many = function (buffers) {
+  if (!buffers.length) {
+    return [];
+  }
+
+  if ("function" !== typeof ccmodule.hash160_many) {
+    return buffers.map(sha256ripe160);
+  }
+
+  var offsets = [], offset = 0;
+  for (var i = 0; i < buffers.length; i++) {
+    offsets.push(offset);
+    offset += buffers[i].length;
+  }
+  var hashes = ccmodule.hash160_many(Buffer.concat(buffers, offset), offsets);
+
+  var result = [];
+  for (i = 0; i < buffers.length; i++) {
+    result.push(hashes.slice(20 * i, 20 * (i + 1)));
+  }
+  return result;
+};
+
 var sha256midstate = exports.sha256midstate = ccmodule.sha256_midstate;
 
 var encodeHex = exports.encodeHex = function (buffer) {
@@ -48,11 +104,32 @@ var encodeBase58 = exports.encodeBase58 = ccmodule.base58_encode;
 
 var decodeBase58 = exports.decodeBase58 = ccmodule.base58_decode;
 
+/**
+ * Base58 encode data followed by a four byte checksum.
+ */
+var encodeBase58Check = exports.encodeBase58Check =
+ccmodule.base58check_encode || function (data) {
+  return encodeBase58(Buffer.concat([data, twoSha256(data).slice(0, 4)]));
+};
+
+/**
+ * Decode a Base58Check string. Returns null if the checksum doesn't match.
+ */
+var decodeBase58Check = exports.decodeBase58Check =
+ccmodule.base58check_decode || function (str) {
+  var buffer = decodeBase58(str);
+  if (buffer.length < 4) return null;
+
+  var data = buffer.slice(0, buffer.length - 4);
+  var checksum = twoSha256(data).slice(0, 4);
+  if (checksum.compare(buffer.slice(buffer.length - 4)) !== 0) return null;
+
+  return data;
+};
+
 // DEPRECATED, use BitcoinKey
 var verifySig = exports.verifySig = function (sig, pubkey, hash) {
-  var key = new ccmodule.BitcoinKey();
-  key.public = pubkey;
-  return key.verifySignatureSync(hash, sig);
+  return ccmodule.BitcoinKey.verify(pubkey, hash, sig);
 };
 
 /**
@@ -117,6 +194,21 @@ var valueToBigInt = exports.valueToBigInt = function (valueBuffer) {
   }
 };
 
+/**
+ * Total of an Array of 8 byte output values.
+ *
+ * Uses the native UInt256 if available, which sums all values in one call.
+ */
+var sumValues = exports.sumValues = function (values) {
+  if (ccmodule.UInt256) {
+    return ccmodule.UInt256.sumValues(values);
+  }
+
+  return values.reduce(function (sum, value) {
+    return sum.add(valueToBigInt(value));
+  }, bignum(0));
+};
+
 var bigIntToValue = exports.bigIntToValue = function (valueBigInt) {
   if (Buffer.isBuffer(valueBigInt)) {
     return valueBigInt;
@@ -151,43 +243,68 @@ var pubKeyHashToAddress = exports.pubKeyHashToAddress = function (pubKeyHash, ve
 
   version = version || 0;
 
-  var put = Binary.put();
-  // Version
-  put.word8le(version & 0xff);
-  // Hash
-  put.put(pubKeyHash);
-  // Checksum (four bytes)
-  put.put(twoSha256(put.buffer()).slice(0,4));
-  return encodeBase58(put.buffer());
+  return encodeBase58Check(Buffer.concat([new Buffer([version & 0xff]),
+                                          pubKeyHash]));
 };
 
-var addressToPubKeyHash = exports.addressToPubKeyHash = function (address) {
-  // Trim
-  address = String(address).replace(/\s/g, '');
+/**
+ * Convert many pubkey hashes at once, all with the same version.
+ */
+var pubKeyHashesToAddresses = exports.pubKeyHashesToAddresses = function (pubKeyHashes, version) {
+  version = version || 0;
 
-  // Check sanity
-  if (!address.match(/^[1-9A-HJ-NP-Za-km-z]{27,35}$/)) {
-    logger.warn("Not a valid Bitcoin address");
-    return null;
+  if ("function" !== typeof ccmodule.address_many) {
+    return pubKeyHashes.map(function (pubKeyHash) {
+      return pubKeyHashToAddress(pubKeyHash, version);
+    });
   }
 
-  // Decode
-  var buffer = decodeBase58(address);
+  return ccmodule.address_many(Buffer.concat(pubKeyHashes), version & 0xff);
+};
+
+var addressToPubKeyHash = exports.addressToPubKeyHash = function (address) {
+  return addressesToPubKeyHashes([address])[0];
+};
+
+/**
+ * Convert many addresses at once. Invalid addresses map to null.
+ */
+var addressesToPubKeyHashes = exports.addressesToPubKeyHashes = function (addresses) {
+  addresses = addresses.map(function (address) {
+    // Trim
+    return String(address).replace(/\s/g, '');
+  });
 
-  // Parse
-  var parser = Binary.parse(buffer);
-  parser.word8('version');
-  parser.buffer('hash', 20);
-  parser.buffer('checksum', 4);
+  // Check sanity
+  var valid = addresses.map(function (address) {
+    return !!address.match(/^[1-9A-HJ-NP-Za-km-z]{27,35}$/);
+  });
+
+  // Decode and check checksums
+  var candidates = addresses.filter(function (address, i) {
+    return valid[i];
+  });
+  var decoded = ccmodule.base58check_decode_many ?
+    ccmodule.base58check_decode_many(candidates) :
+    candidates.map(function (address) {
+      return decodeBase58Check(address);
+    });
+
+  var j = 0;
+  return addresses.map(function (address, i) {
+    if (!valid[i]) {
+      logger.warn("Not a valid Bitcoin address");
+      return null;
+    }
 
-  // Check checksum
-  var checksum = twoSha256(buffer.slice(0, 21)).slice(0, 4);
-  if (checksum.compare(parser.vars.checksum) !== 0) {
-    logger.warn("Checksum comparison failed");
-    return null;
-  }
+    var buffer = decoded[j++];
+    if (!buffer || buffer.length !== 21) {
+      logger.warn("Checksum comparison failed");
+      return null;
+    }
 
-  return parser.vars.hash;
+    return buffer.slice(1);
+  });
 };
 
 // Utility that synchronizes function calls based on a key
@@ -254,8 +371,13 @@ var generateNonce = exports.generateNonce = function () {
  */
 var decodeDiffBits = exports.decodeDiffBits = function (diffBits, asBigInt) {
   diffBits = +diffBits;
-  var target = bignum(diffBits & 0xffffff);
-  target = target.shiftLeft(8*((diffBits >>> 24) - 3));
+  var target;
+  if (ccmodule.UInt256) {
+    target = ccmodule.UInt256.fromCompact(diffBits);
+  } else {
+    target = bignum(diffBits & 0xffffff);
+    target = target.shiftLeft(8*((diffBits >>> 24) - 3));
+  }
 
   if (asBigInt) {
     return target;
@@ -274,6 +396,15 @@ var decodeDiffBits = exports.decodeDiffBits = function (diffBits, asBigInt) {
  * This function calculates the compact difficulty, given a difficulty target.
  */
 var encodeDiffBits = exports.encodeDiffBits = function encodeDiffBits(target) {
+  if (ccmodule.UInt256) {
+    if (Buffer.isBuffer(target)) {
+      target = ccmodule.UInt256.fromBuffer(target);
+    }
+    if (target instanceof ccmodule.UInt256) {
+      return target.toCompact();
+    }
+  }
+
   if (Buffer.isBuffer(target)) {
     target = bignum.fromBuffer(target);
   } else if ("function" === typeof target.toBuffer) { // duck-typing bignum
@@ -303,6 +434,10 @@ var calcDifficulty = exports.calcDifficulty = function (target) {
   if (!Buffer.isBuffer(target)) {
     target = decodeDiffBits(target);
   }
+  if (ccmodule.UInt256) {
+    return ccmodule.UInt256.fromBuffer(MAX_TARGET)
+      .div(ccmodule.UInt256.fromBuffer(target)).toNumber();
+  }
   var targetBigint = bignum.fromBuffer(target, {order: 'forward'});
   var maxBigint = bignum.fromBuffer(MAX_TARGET, {order: 'forward'});
   return maxBigint.div(targetBigint).toNumber();
@@ -28,3 +28,44 @@ Block.method('status', {
     callback(null, data);
   }
 });
+
+Block.method('branch', {
+  schema: {
+    block: { type: String, required: true },
+    tx: { type: String, required: true }
+  },
+  handler: function (params, callback) {
+    var blockHash = new Buffer(params.block.toString(), 'base64');
+    var txHash = new Buffer(params.tx.toString(), 'base64');
+
+    this.node.blockChain.getBlockByHash(blockHash, function (err, block) {
+      if (err) {
+        callback(err);
+        return;
+      }
+      if (!block) {
+        callback(new Error("Block not found"));
+        return;
+      }
+
+      var index = -1;
+      for (var i = 0; i < block.txs.length; i++) {
+        if (block.txs[i].compare(txHash) == 0) {
+          index = i;
+          break;
+        }
+      }
+      if (index < 0) {
+        callback(new Error("Transaction not in block"));
+        return;
+      }
+
+      callback(null, {
+        index: index,
+        branch: block.getMerkleBranch(block.txs, index).map(function (hash) {
+          return hash.toString('base64');
+        })
+      });
+    });
+  }
+});
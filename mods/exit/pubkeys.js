@@ -240,26 +240,21 @@ Pubkeys.method('register', {
     var storage = this.node.getStorage();
     var blockChain = this.node.getBlockChain();
 
-    // Validate keys
-    var keys = params.keys.split(',');
-    var pubKeyHashes = [];
-    for (var i = 0; i < keys.length; i++) {
-      // Trim whitespace
-      var key = keys[i].replace(/^\s+|\s+$/g, '');
-
-      // Ignore empty keys
-      if (!key.length) continue;
+    // Validate keys, ignoring empty ones
+    var keys = params.keys.split(',').filter(function (key) {
+      return !!key.replace(/^\s+|\s+$/g, '').length;
+    });
 
-      // Convert Bitcoin address to pubkey hash
-      var pubKeyHash = Util.addressToPubKeyHash(keys[i]);
-      if (!pubKeyHash) {
+    // Convert Bitcoin addresses to pubkey hashes
+    var pubKeyHashes = Util.addressesToPubKeyHashes(keys);
+    for (var i = 0; i < keys.length; i++) {
+      if (!pubKeyHashes[i]) {
         callback({
           type: "InvalidKeys",
           message: "This is not a valid Bitcoin address: '"+keys[i]+"'"
         });
         return;
       }
-      pubKeyHashes.push(pubKeyHash);
     }
 
     // Make sure we have at least one key
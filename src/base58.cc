@@ -0,0 +1,235 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base58.h"
+#include "sha256.h"
+
+static const char ALPHABET[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+// Digit values by character, -1 for characters outside the alphabet
+static const signed char DIGITS[256] = {
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1, 0, 1, 2, 3, 4, 5, 6, 7, 8,-1,-1,-1,-1,-1,-1,
+  -1, 9,10,11,12,13,14,15,16,-1,17,18,19,20,21,-1,
+  22,23,24,25,26,27,28,29,30,31,32,-1,-1,-1,-1,-1,
+  -1,33,34,35,36,37,38,39,40,41,42,43,-1,44,45,46,
+  47,48,49,50,51,52,53,54,55,56,57,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+};
+
+// 58^5, the largest power of 58 that fits in 32 bits
+#define LIMB_BASE 656356768U
+#define LIMB_DIGITS 5
+
+// Limbs kept on the stack, enough for 230 byte inputs
+#define STACK_LIMBS 64
+
+static const uint32_t POW58[LIMB_DIGITS + 1] = {
+  1, 58, 3364, 195112, 11316496, 656356768U
+};
+
+static inline bool IsSpace(char c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+size_t Base58::EncodedSize(size_t len)
+{
+  // log(256) / log(58) < 1.38
+  return len * 138 / 100 + 1;
+}
+
+size_t Base58::Encode(char *out, const unsigned char *data, size_t len)
+{
+  size_t zeros = 0;
+  while (zeros < len && data[zeros] == 0) {
+    zeros++;
+  }
+
+  size_t maxLimbs = EncodedSize(len - zeros) / LIMB_DIGITS + 1;
+  uint32_t stackLimbs[STACK_LIMBS];
+  uint32_t *limbs = maxLimbs <= STACK_LIMBS ? stackLimbs :
+                    (uint32_t *) malloc(4 * maxLimbs);
+  size_t used = 0;
+
+  // Feed the bytes in big endian 32 bit words, the short one first
+  const unsigned char *p = data + zeros;
+  const unsigned char *end = data + len;
+  size_t chunk = (end - p) % 4;
+  if (chunk == 0) chunk = 4;
+
+  while (p < end) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < chunk; i++) {
+      carry = (carry << 8) | p[i];
+    }
+    p += chunk;
+
+    int shift = 8 * chunk;
+    for (size_t i = 0; i < used; i++) {
+      uint64_t x = ((uint64_t) limbs[i] << shift) + carry;
+      limbs[i] = (uint32_t) (x % LIMB_BASE);
+      carry = x / LIMB_BASE;
+    }
+    while (carry) {
+      limbs[used++] = (uint32_t) (carry % LIMB_BASE);
+      carry /= LIMB_BASE;
+    }
+
+    chunk = 4;
+  }
+
+  char *o = out;
+  memset(o, ALPHABET[0], zeros);
+  o += zeros;
+
+  if (used) {
+    // The top limb without leading zero digits, the others in full
+    char digits[LIMB_DIGITS];
+    int n = 0;
+    for (uint32_t top = limbs[used - 1]; top; top /= 58) {
+      digits[n++] = ALPHABET[top % 58];
+    }
+    while (n) {
+      *o++ = digits[--n];
+    }
+
+    for (size_t i = used - 1; i-- > 0;) {
+      uint32_t limb = limbs[i];
+      for (int j = LIMB_DIGITS - 1; j >= 0; j--) {
+        o[j] = ALPHABET[limb % 58];
+        limb /= 58;
+      }
+      o += LIMB_DIGITS;
+    }
+  }
+
+  if (limbs != stackLimbs) {
+    free(limbs);
+  }
+  return o - out;
+}
+
+bool Base58::Decode(unsigned char *out, size_t *outLen, const char *str, size_t len)
+{
+  const char *p = str;
+  const char *end = str + len;
+
+  while (p < end && IsSpace(*p)) p++;
+  while (end > p && IsSpace(end[-1])) end--;
+
+  size_t zeros = 0;
+  while (p + zeros < end && p[zeros] == ALPHABET[0]) {
+    zeros++;
+  }
+  p += zeros;
+
+  size_t maxLimbs = (end - p) / 4 + 1;
+  uint32_t stackLimbs[STACK_LIMBS];
+  uint32_t *limbs = maxLimbs <= STACK_LIMBS ? stackLimbs :
+                    (uint32_t *) malloc(4 * maxLimbs);
+  size_t used = 0;
+
+  // Feed the digits in groups of five, the short one first
+  size_t chunk = (end - p) % LIMB_DIGITS;
+  if (chunk == 0) chunk = LIMB_DIGITS;
+
+  while (p < end) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < chunk; i++) {
+      int digit = DIGITS[(unsigned char) p[i]];
+      if (digit < 0) {
+        if (limbs != stackLimbs) free(limbs);
+        return false;
+      }
+      carry = carry * 58 + digit;
+    }
+    p += chunk;
+
+    uint64_t mul = POW58[chunk];
+    for (size_t i = 0; i < used; i++) {
+      uint64_t x = limbs[i] * mul + carry;
+      limbs[i] = (uint32_t) x;
+      carry = x >> 32;
+    }
+    while (carry) {
+      limbs[used++] = (uint32_t) carry;
+      carry >>= 32;
+    }
+
+    chunk = LIMB_DIGITS;
+  }
+
+  unsigned char *o = out;
+  memset(o, 0, zeros);
+  o += zeros;
+
+  if (used) {
+    uint32_t top = limbs[used - 1];
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      if (o == out + zeros && (top >> shift) == 0) continue;
+      *o++ = (top >> shift) & 0xff;
+    }
+
+    for (size_t i = used - 1; i-- > 0;) {
+      uint32_t limb = limbs[i];
+      o[0] = limb >> 24;
+      o[1] = limb >> 16;
+      o[2] = limb >> 8;
+      o[3] = limb;
+      o += 4;
+    }
+  }
+
+  if (limbs != stackLimbs) {
+    free(limbs);
+  }
+  *outLen = o - out;
+  return true;
+}
+
+size_t Base58::EncodeCheck(char *out, const unsigned char *data, size_t len)
+{
+  unsigned char stackBuf[256];
+  unsigned char *buf = len + 4 <= sizeof(stackBuf) ? stackBuf :
+                       (unsigned char *) malloc(len + 4);
+
+  unsigned char hash[32];
+  Sha256::Double(hash, data, len);
+  memcpy(buf, data, len);
+  memcpy(buf + len, hash, 4);
+
+  size_t outLen = Encode(out, buf, len + 4);
+
+  if (buf != stackBuf) {
+    free(buf);
+  }
+  return outLen;
+}
+
+bool Base58::DecodeCheck(unsigned char *out, size_t *outLen, const char *str, size_t len)
+{
+  size_t decodedLen;
+  if (!Decode(out, &decodedLen, str, len) || decodedLen < 4) {
+    return false;
+  }
+
+  unsigned char hash[32];
+  Sha256::Double(hash, out, decodedLen - 4);
+  if (memcmp(hash, out + decodedLen - 4, 4) != 0) {
+    return false;
+  }
+
+  *outLen = decodedLen - 4;
+  return true;
+}
@@ -0,0 +1,48 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_BASE58_H_
+#define BITCOINJS_SERVER_INCLUDE_BASE58_H_
+
+#include <stddef.h>
+
+/**
+ * Base58 and Base58Check without bignums.
+ *
+ * The number is kept in 32 bit limbs. Encoding feeds in four bytes at a
+ * time and keeps limbs in base 58^5, decoding feeds in five digits at a
+ * time and keeps limbs in base 2^32, so every step is one 64 bit multiply
+ * and divide per limb.
+ */
+class Base58
+{
+public:
+
+  /**
+   * Upper bound for the encoded length of len bytes.
+   */
+  static size_t EncodedSize(size_t len);
+
+  /**
+   * Encode len bytes. Returns the number of characters written to out,
+   * which must have room for EncodedSize(len).
+   */
+  static size_t Encode(char *out, const unsigned char *data, size_t len);
+
+  /**
+   * Decode a string, ignoring leading and trailing whitespace. out must
+   * have room for len bytes. Returns false on invalid characters.
+   */
+  static bool Decode(unsigned char *out, size_t *outLen, const char *str, size_t len);
+
+  /**
+   * Encode data followed by the first four bytes of its double SHA-256.
+   * out must have room for EncodedSize(len + 4).
+   */
+  static size_t EncodeCheck(char *out, const unsigned char *data, size_t len);
+
+  /**
+   * Decode and verify a Base58Check string, outLen excludes the checksum.
+   * Returns false on invalid characters or a checksum mismatch.
+   */
+  static bool DecodeCheck(unsigned char *out, size_t *outLen, const char *str, size_t len);
+};
+
+#endif
@@ -0,0 +1,644 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <v8.h>
+
+#include <node.h>
+#include <node_buffer.h>
+
+#include <openssl/rand.h>
+
+#include "coincache.h"
+#include "common.h"
+#include "txparser.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+
+// Database keys are the outpoint behind this prefix
+#define KEY_PREFIX 'c'
+
+#define INITIAL_CAPACITY 1024
+
+Persistent<FunctionTemplate> CoinCache::s_ct;
+
+void CoinCache::Init(Handle<Object> target)
+{
+  HandleScope scope;
+  Local<FunctionTemplate> t = FunctionTemplate::New(New);
+
+  s_ct = Persistent<FunctionTemplate>::New(t);
+  s_ct->InstanceTemplate()->SetInternalFieldCount(1);
+  s_ct->SetClassName(String::NewSymbol("CoinCache"));
+
+  // Methods
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "connect", Connect);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "disconnect", Disconnect);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "getMany", GetMany);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "put", Put);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "flush", Flush);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "stats", Stats);
+
+  target->Set(String::NewSymbol("CoinCache"),
+              s_ct->GetFunction());
+}
+
+CoinCache::CoinCache(size_t budget) :
+  budget(budget),
+  mask(INITIAL_CAPACITY - 1),
+  size(0),
+  hand(0),
+  used(0),
+  slabBytes(0),
+  hits(0),
+  misses(0),
+  evictions(0)
+{
+  // Outpoints are chosen by whoever creates the transactions, so the table
+  // layout must not be predictable
+  if (!RAND_bytes((unsigned char *)&salt, sizeof(salt))) {
+    salt = (uint32_t)(uintptr_t)this;
+  }
+
+  table = (entry_t *) calloc(INITIAL_CAPACITY, sizeof(entry_t));
+  used = INITIAL_CAPACITY * sizeof(entry_t);
+  memset(freeLists, 0, sizeof(freeLists));
+  memset(slabPos, 0, sizeof(slabPos));
+  memset(slabLeft, 0, sizeof(slabLeft));
+}
+
+CoinCache::~CoinCache()
+{
+  // Records from size classes go away with their slabs
+  for (size_t i = 0; i <= mask; i++) {
+    if (table[i].record != NULL && SizeClass(RecordSize(table[i].record)) < 0) {
+      free(table[i].record);
+    }
+  }
+  for (size_t i = 0; i < slabs.size(); i++) {
+    free(slabs[i]);
+  }
+  free(table);
+}
+
+uint32_t CoinCache::Hash(const unsigned char *outpoint)
+{
+  // FNV-1a
+  uint32_t hash = 2166136261u ^ salt;
+  for (int i = 0; i < OUTPOINT_SIZE; i++) {
+    hash ^= outpoint[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Slot of the entry for outpoint, or the empty slot where it would go.
+ */
+size_t CoinCache::Find(const unsigned char *outpoint, uint32_t hash)
+{
+  size_t slot = hash & mask;
+  while (table[slot].record != NULL) {
+    if (table[slot].hash == hash &&
+        memcmp(table[slot].record, outpoint, OUTPOINT_SIZE) == 0) {
+      break;
+    }
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+void CoinCache::Grow()
+{
+  entry_t *old = table;
+  size_t oldCapacity = mask + 1;
+
+  table = (entry_t *) calloc(oldCapacity * 2, sizeof(entry_t));
+  mask = oldCapacity * 2 - 1;
+  hand = 0;
+  used += oldCapacity * sizeof(entry_t);
+
+  for (size_t i = 0; i < oldCapacity; i++) {
+    if (old[i].record == NULL) continue;
+
+    size_t slot = old[i].hash & mask;
+    while (table[slot].record != NULL) {
+      slot = (slot + 1) & mask;
+    }
+    table[slot] = old[i];
+  }
+
+  free(old);
+}
+
+/**
+ * Free the record in slot and close the gap by moving later entries of the
+ * probe sequence back (no tombstones).
+ */
+void CoinCache::Remove(size_t slot)
+{
+  FreeRecord(table[slot].record);
+  size--;
+
+  size_t i = slot;
+  size_t j = slot;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (table[j].record == NULL) break;
+
+    // The entry at j may move to i unless its home slot lies in (i, j]
+    size_t home = table[j].hash & mask;
+    bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+    if (!stays) {
+      table[i] = table[j];
+      i = j;
+    }
+  }
+  table[i].record = NULL;
+}
+
+/**
+ * Evict clean coins until the cache fits its budget. Coins that were read
+ * since the hand last passed get a second chance. Returns false if only
+ * unflushed coins are left.
+ */
+bool CoinCache::Evict()
+{
+  size_t scanned = 0;
+  size_t limit = 2 * (mask + 1);
+
+  while (used > budget && size > 0 && scanned < limit) {
+    entry_t *entry = &table[hand];
+    scanned++;
+
+    if (entry->record != NULL && !(entry->flags & FLAG_DIRTY)) {
+      if (entry->flags & FLAG_REFERENCED) {
+        entry->flags &= ~FLAG_REFERENCED;
+      } else {
+        // Another entry may move into this slot, look at it again
+        Remove(hand);
+        evictions++;
+        continue;
+      }
+    }
+    hand = (hand + 1) & mask;
+  }
+
+  return used <= budget;
+}
+
+int CoinCache::SizeClass(size_t len)
+{
+  for (int c = 0; c < CLASS_COUNT; c++) {
+    if (len <= ((size_t) 1 << (MIN_CLASS_SHIFT + c))) {
+      return c;
+    }
+  }
+  return -1;
+}
+
+size_t CoinCache::RecordSize(const unsigned char *record)
+{
+  return HEADER_SIZE + ReadLE32(record + OUTPOINT_SIZE + 12);
+}
+
+unsigned char *CoinCache::AllocRecord(size_t len)
+{
+  int c = SizeClass(len);
+  if (c < 0) {
+    used += len;
+    return (unsigned char *) malloc(len);
+  }
+
+  size_t chunk = (size_t) 1 << (MIN_CLASS_SHIFT + c);
+  used += chunk;
+
+  unsigned char *record = freeLists[c];
+  if (record != NULL) {
+    memcpy(&freeLists[c], record, sizeof(unsigned char *));
+    return record;
+  }
+
+  // Carve a new chunk from the current slab of this class
+  if (slabLeft[c] < chunk) {
+    size_t slabSize = chunk > (size_t) SLAB_SIZE ? chunk : (size_t) SLAB_SIZE;
+    unsigned char *slab = (unsigned char *) malloc(slabSize);
+    if (slab == NULL) {
+      used -= chunk;
+      return NULL;
+    }
+    slabs.push_back(slab);
+    slabBytes += slabSize;
+    slabPos[c] = slab;
+    slabLeft[c] = slabSize;
+  }
+
+  record = slabPos[c];
+  slabPos[c] += chunk;
+  slabLeft[c] -= chunk;
+  return record;
+}
+
+void CoinCache::FreeRecord(unsigned char *record)
+{
+  size_t len = RecordSize(record);
+  int c = SizeClass(len);
+  if (c < 0) {
+    used -= len;
+    free(record);
+    return;
+  }
+
+  used -= (size_t) 1 << (MIN_CLASS_SHIFT + c);
+  memcpy(record, &freeLists[c], sizeof(unsigned char *));
+  freeLists[c] = record;
+}
+
+bool CoinCache::Insert(const unsigned char *outpoint, const unsigned char *value,
+                       uint32_t height, const unsigned char *script, size_t scriptLen,
+                       bool dirty)
+{
+  if ((size + 1) * 4 > (mask + 1) * 3) {
+    Grow();
+  }
+
+  uint32_t hash = Hash(outpoint);
+  size_t slot = Find(outpoint, hash);
+
+  if (table[slot].record != NULL) {
+    // Only a connect may replace a coin (duplicate transactions)
+    if (!dirty) return true;
+    Remove(slot);
+    slot = Find(outpoint, hash);
+  }
+
+  unsigned char *record = AllocRecord(HEADER_SIZE + scriptLen);
+  if (record == NULL) return false;
+
+  memcpy(record, outpoint, OUTPOINT_SIZE);
+  memcpy(record + OUTPOINT_SIZE, value, 8);
+  WriteLE32(record + OUTPOINT_SIZE + 8, height);
+  WriteLE32(record + OUTPOINT_SIZE + 12, scriptLen);
+  memcpy(record + HEADER_SIZE, script, scriptLen);
+
+  table[slot].record = record;
+  table[slot].hash = hash;
+  table[slot].flags = dirty ? FLAG_DIRTY : 0;
+  size++;
+
+  if (dirty) {
+    op_t op;
+    memcpy(op.outpoint, outpoint, OUTPOINT_SIZE);
+    op.put = true;
+    ops.push_back(op);
+  }
+
+  if (used > budget) {
+    Evict();
+  }
+  return true;
+}
+
+/**
+ * Drop a coin. If record is set, the database copy is deleted on the next
+ * flush() as well.
+ */
+bool CoinCache::Spend(const unsigned char *outpoint, bool record)
+{
+  size_t slot = Find(outpoint, Hash(outpoint));
+  bool found = table[slot].record != NULL;
+  if (found) {
+    Remove(slot);
+  }
+
+  if (record) {
+    op_t op;
+    memcpy(op.outpoint, outpoint, OUTPOINT_SIZE);
+    op.put = false;
+    ops.push_back(op);
+  }
+  return found;
+}
+
+static bool
+is_null_outpoint (const unsigned char *outpoint)
+{
+  for (int i = 0; i < 32; i++) {
+    if (outpoint[i]) return false;
+  }
+  return ReadLE32(outpoint + 32) == 0xffffffff;
+}
+
+bool CoinCache::Connect(const unsigned char *data, size_t len, uint32_t height)
+{
+  TxParser::table_t parsed;
+  unsigned char outpoint[OUTPOINT_SIZE];
+  size_t pos = 0;
+
+  TxParser::Init(&parsed, 1);
+  if (!TxParser::ParseTx(&parsed, 0, outpoint, data, len, &pos)) {
+    TxParser::Free(&parsed);
+    return false;
+  }
+
+  const uint32_t *tx = parsed.words;
+  const uint32_t *ins = parsed.words + tx[5];
+  const uint32_t *outs = parsed.words + tx[7];
+
+  bool ok = true;
+  for (uint32_t i = 0; i < tx[4]; i++) {
+    const unsigned char *spent = data + ins[TxParser::IN_WORDS * i];
+    if (!is_null_outpoint(spent)) {
+      Spend(spent, true);
+    }
+  }
+
+  // The outpoints of the outputs are the transaction hash and their index
+  for (uint32_t i = 0; ok && i < tx[6]; i++) {
+    const uint32_t *out = outs + TxParser::OUT_WORDS * i;
+    WriteLE32(outpoint + 32, i);
+    ok = Insert(outpoint, data + out[0], height, data + out[1], out[2], true);
+  }
+
+  TxParser::Free(&parsed);
+  return ok;
+}
+
+bool CoinCache::Disconnect(const unsigned char *data, size_t len)
+{
+  TxParser::table_t parsed;
+  unsigned char outpoint[OUTPOINT_SIZE];
+  size_t pos = 0;
+
+  TxParser::Init(&parsed, 1);
+  if (!TxParser::ParseTx(&parsed, 0, outpoint, data, len, &pos)) {
+    TxParser::Free(&parsed);
+    return false;
+  }
+
+  // The spent coins are not restored, lookups fall back to the
+  // transactions for them
+  uint32_t outCount = parsed.words[6];
+  for (uint32_t i = 0; i < outCount; i++) {
+    WriteLE32(outpoint + 32, i);
+    Spend(outpoint, true);
+  }
+
+  TxParser::Free(&parsed);
+  return true;
+}
+
+Handle<Value>
+CoinCache::New(const Arguments& args)
+{
+  if (!args.IsConstructCall()) {
+    return FromConstructorTemplate(s_ct, args);
+  }
+
+  HandleScope scope;
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: budget");
+  }
+  if (!args[0]->IsNumber() || args[0]->NumberValue() < 0) {
+    return VException("Argument 'budget' must be a positive Number");
+  }
+
+  CoinCache* cache = new CoinCache((size_t) args[0]->NumberValue());
+  cache->Wrap(args.Holder());
+
+  return scope.Close(args.This());
+}
+
+Handle<Value>
+CoinCache::Connect(const Arguments& args)
+{
+  HandleScope scope;
+  CoinCache* cache = ObjectWrap::Unwrap<CoinCache>(args.This());
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: txs, height");
+  }
+  if (!args[0]->IsArray()) {
+    return VException("Argument 'txs' must be an Array");
+  }
+  if (!args[1]->IsUint32()) {
+    return VException("Argument 'height' must be a Number");
+  }
+
+  Local<Array> txs = Local<Array>::Cast(args[0]);
+  uint32_t height = args[1]->Uint32Value();
+
+  for (uint32_t i = 0; i < txs->Length(); i++) {
+    Local<Value> tx = txs->Get(i);
+    if (!Buffer::HasInstance(tx)) {
+      return VException("Argument 'txs' must be an Array of Buffers");
+    }
+    if (!cache->Connect((const unsigned char *) Buffer::Data(tx),
+                        Buffer::Length(tx), height)) {
+      return VException("Transaction is invalid or out of memory");
+    }
+  }
+
+  return scope.Close(Undefined());
+}
+
+Handle<Value>
+CoinCache::Disconnect(const Arguments& args)
+{
+  HandleScope scope;
+  CoinCache* cache = ObjectWrap::Unwrap<CoinCache>(args.This());
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: txs");
+  }
+  if (!args[0]->IsArray()) {
+    return VException("Argument 'txs' must be an Array");
+  }
+
+  Local<Array> txs = Local<Array>::Cast(args[0]);
+
+  for (uint32_t i = 0; i < txs->Length(); i++) {
+    Local<Value> tx = txs->Get(i);
+    if (!Buffer::HasInstance(tx)) {
+      return VException("Argument 'txs' must be an Array of Buffers");
+    }
+    if (!cache->Disconnect((const unsigned char *) Buffer::Data(tx),
+                           Buffer::Length(tx))) {
+      return VException("Transaction is invalid");
+    }
+  }
+
+  return scope.Close(Undefined());
+}
+
+Handle<Value>
+CoinCache::GetMany(const Arguments& args)
+{
+  HandleScope scope;
+  CoinCache* cache = ObjectWrap::Unwrap<CoinCache>(args.This());
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: outpoints");
+  }
+  if (!Buffer::HasInstance(args[0])) {
+    return VException("Argument 'outpoints' must be of type Buffer");
+  }
+
+  const unsigned char *outpoints = (const unsigned char *) Buffer::Data(args[0]);
+  size_t len = Buffer::Length(args[0]);
+  if (len % OUTPOINT_SIZE) {
+    return VException("Argument 'outpoints' must be a multiple of 36 bytes long");
+  }
+
+  Local<String> v_sym = String::NewSymbol("v");
+  Local<String> s_sym = String::NewSymbol("s");
+  Local<String> height_sym = String::NewSymbol("height");
+
+  size_t count = len / OUTPOINT_SIZE;
+  Local<Array> result = Array::New(count);
+
+  for (size_t i = 0; i < count; i++) {
+    const unsigned char *outpoint = outpoints + OUTPOINT_SIZE * i;
+    size_t slot = cache->Find(outpoint, cache->Hash(outpoint));
+    entry_t *entry = &cache->table[slot];
+
+    if (entry->record == NULL) {
+      cache->misses++;
+      result->Set(i, Null());
+      continue;
+    }
+    cache->hits++;
+    entry->flags |= FLAG_REFERENCED;
+
+    const unsigned char *record = entry->record;
+    uint32_t scriptLen = ReadLE32(record + OUTPOINT_SIZE + 12);
+
+    Buffer *value_buf = Buffer::New((const char *) record + OUTPOINT_SIZE, 8);
+    Buffer *script_buf = Buffer::New((const char *) record + HEADER_SIZE, scriptLen);
+
+    Local<Object> coin = Object::New();
+    coin->Set(v_sym, value_buf->handle_);
+    coin->Set(s_sym, script_buf->handle_);
+    coin->Set(height_sym, Integer::NewFromUnsigned(ReadLE32(record + OUTPOINT_SIZE + 8)));
+    result->Set(i, coin);
+  }
+
+  return scope.Close(result);
+}
+
+Handle<Value>
+CoinCache::Put(const Arguments& args)
+{
+  HandleScope scope;
+  CoinCache* cache = ObjectWrap::Unwrap<CoinCache>(args.This());
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: outpoint, value");
+  }
+  if (!Buffer::HasInstance(args[0]) || Buffer::Length(args[0]) != OUTPOINT_SIZE) {
+    return VException("Argument 'outpoint' must be Buffer of length 36 bytes");
+  }
+  if (!Buffer::HasInstance(args[1])) {
+    return VException("Argument 'value' must be of type Buffer");
+  }
+
+  // Same layout as the records, without the outpoint
+  const unsigned char *value = (const unsigned char *) Buffer::Data(args[1]);
+  size_t len = Buffer::Length(args[1]);
+  if (len < HEADER_SIZE - OUTPOINT_SIZE ||
+      ReadLE32(value + 12) != len - (HEADER_SIZE - OUTPOINT_SIZE)) {
+    return VException("Argument 'value' is not a valid coin");
+  }
+
+  if (!cache->Insert((const unsigned char *) Buffer::Data(args[0]),
+                     value, ReadLE32(value + 8),
+                     value + 16, len - 16, false)) {
+    return VException("Out of memory");
+  }
+
+  return scope.Close(Undefined());
+}
+
+Handle<Value>
+CoinCache::Flush(const Arguments& args)
+{
+  HandleScope scope;
+  CoinCache* cache = ObjectWrap::Unwrap<CoinCache>(args.This());
+
+  Local<String> type_sym = String::NewSymbol("type");
+  Local<String> key_sym = String::NewSymbol("key");
+  Local<String> value_sym = String::NewSymbol("value");
+  Local<String> put_str = String::New("put");
+  Local<String> del_str = String::New("del");
+
+  Local<Array> batch = Array::New();
+  uint32_t n = 0;
+
+  // Operations are replayed in order, so a coin that is spent and created
+  // again ends up in the database
+  for (size_t i = 0; i < cache->ops.size(); i++) {
+    op_t *op = &cache->ops[i];
+    const unsigned char *record = NULL;
+
+    if (op->put) {
+      size_t slot = cache->Find(op->outpoint, cache->Hash(op->outpoint));
+      entry_t *entry = &cache->table[slot];
+      if (entry->record == NULL || !(entry->flags & FLAG_DIRTY)) {
+        // Spent before it was written
+        continue;
+      }
+      record = entry->record;
+    }
+
+    Buffer *key_buf = Buffer::New(1 + OUTPOINT_SIZE);
+    unsigned char *key = (unsigned char *) Buffer::Data(key_buf);
+    key[0] = KEY_PREFIX;
+    memcpy(key + 1, op->outpoint, OUTPOINT_SIZE);
+
+    Local<Object> item = Object::New();
+    item->Set(type_sym, op->put ? put_str : del_str);
+    item->Set(key_sym, key_buf->handle_);
+    if (record != NULL) {
+      Buffer *value_buf = Buffer::New((const char *) record + OUTPOINT_SIZE,
+                                      RecordSize(record) - OUTPOINT_SIZE);
+      item->Set(value_sym, value_buf->handle_);
+    }
+    batch->Set(n++, item);
+  }
+
+  // Everything is written now, so all coins may be evicted
+  for (size_t i = 0; i < cache->ops.size(); i++) {
+    op_t *op = &cache->ops[i];
+    size_t slot = cache->Find(op->outpoint, cache->Hash(op->outpoint));
+    cache->table[slot].flags &= ~FLAG_DIRTY;
+  }
+  vector<op_t>().swap(cache->ops);
+
+  if (cache->used > cache->budget) {
+    cache->Evict();
+  }
+
+  return scope.Close(batch);
+}
+
+Handle<Value>
+CoinCache::Stats(const Arguments& args)
+{
+  HandleScope scope;
+  CoinCache* cache = ObjectWrap::Unwrap<CoinCache>(args.This());
+
+  Local<Object> stats = Object::New();
+  stats->Set(String::NewSymbol("size"), Number::New(cache->size));
+  stats->Set(String::NewSymbol("capacity"), Number::New(cache->mask + 1));
+  stats->Set(String::NewSymbol("memory"), Number::New(cache->used));
+  stats->Set(String::NewSymbol("slabs"), Number::New(cache->slabBytes));
+  stats->Set(String::NewSymbol("budget"), Number::New(cache->budget));
+  stats->Set(String::NewSymbol("pending"), Number::New(cache->ops.size()));
+  stats->Set(String::NewSymbol("hits"), Number::New(cache->hits));
+  stats->Set(String::NewSymbol("misses"), Number::New(cache->misses));
+  stats->Set(String::NewSymbol("evictions"), Number::New(cache->evictions));
+
+  return scope.Close(stats);
+}
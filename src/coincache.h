@@ -0,0 +1,138 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_COINCACHE_H_
+#define BITCOINJS_SERVER_INCLUDE_COINCACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+using namespace node;
+
+/**
+ * Cache of transaction outputs ("coins") keyed by their 36 byte outpoint.
+ *
+ * Coins live in an open addressing table with linear probing. Each entry
+ * points to a record in a slab arena with power of two size classes:
+ *
+ *   outpoint (36), value (8), height (4, LE), script length (4, LE), script
+ *
+ * Connecting a transaction adds its outputs and drops the coins its inputs
+ * spend. The changes are remembered and handed out by flush() as LevelDB
+ * batch operations on keys 'c' + outpoint, whose values are the records
+ * minus the outpoint. Coins that haven't been flushed stay in memory, all
+ * others are evicted (CLOCK) when the memory budget is exceeded.
+ *
+ * A coin is a plain fact about a transaction output, so a cached coin is
+ * correct even if the output was spent in the meantime. Misses are not
+ * authoritative: coins that were never connected through the cache (e.g.
+ * from before it was enabled, or restored by a reorg) have to be looked up
+ * in their transactions.
+ *
+ * JavaScript API:
+ *
+ *   new CoinCache(budget)       budget in bytes
+ *   cache.connect(txs, height)  txs is an Array of serialized transactions
+ *   cache.disconnect(txs)
+ *   cache.getMany(outpoints)    outpoints is a Buffer of 36 byte outpoints,
+ *                               returns an Array of {v, s, height} or null
+ *   cache.put(outpoint, value)  adds a clean coin from its database value
+ *   cache.flush()               returns an Array of {type, key, value}
+ *   cache.stats()
+ */
+class CoinCache : ObjectWrap
+{
+private:
+
+  enum {
+    OUTPOINT_SIZE = 36,
+    HEADER_SIZE = OUTPOINT_SIZE + 16,
+
+    // Size classes are 64 bytes to 64 kB, larger records use malloc()
+    MIN_CLASS_SHIFT = 6,
+    MAX_CLASS_SHIFT = 16,
+    CLASS_COUNT = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1,
+    SLAB_SIZE = 256 * 1024,
+
+    FLAG_DIRTY = 1,
+    FLAG_REFERENCED = 2
+  };
+
+  struct entry_t {
+    unsigned char *record;
+    uint32_t hash;
+    uint32_t flags;
+  };
+
+  struct op_t {
+    unsigned char outpoint[OUTPOINT_SIZE];
+    bool put;
+  };
+
+  size_t budget;
+  uint32_t salt;
+
+  entry_t *table;
+  size_t mask;
+  size_t size;
+  size_t hand;
+
+  // Free chunks per size class, linked through their first bytes
+  unsigned char *freeLists[CLASS_COUNT];
+  // Unused rest of the newest slab per size class
+  unsigned char *slabPos[CLASS_COUNT];
+  size_t slabLeft[CLASS_COUNT];
+  std::vector<unsigned char *> slabs;
+
+  // Bytes in live records plus the table
+  size_t used;
+  size_t slabBytes;
+
+  // Changes since the last flush(), in order
+  std::vector<op_t> ops;
+
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+
+  CoinCache(size_t budget);
+  ~CoinCache();
+
+  uint32_t Hash(const unsigned char *outpoint);
+  size_t Find(const unsigned char *outpoint, uint32_t hash);
+  void Grow();
+  void Remove(size_t slot);
+  bool Evict();
+
+  static int SizeClass(size_t len);
+  unsigned char *AllocRecord(size_t len);
+  void FreeRecord(unsigned char *record);
+  static size_t RecordSize(const unsigned char *record);
+
+  bool Insert(const unsigned char *outpoint, const unsigned char *value,
+              uint32_t height, const unsigned char *script, size_t scriptLen,
+              bool dirty);
+  bool Spend(const unsigned char *outpoint, bool record);
+
+  bool Connect(const unsigned char *tx, size_t len, uint32_t height);
+  bool Disconnect(const unsigned char *tx, size_t len);
+
+public:
+
+  static Persistent<FunctionTemplate> s_ct;
+
+  static void Init(Handle<Object> target);
+
+  static Handle<Value> New(const Arguments& args);
+  static Handle<Value> Connect(const Arguments& args);
+  static Handle<Value> Disconnect(const Arguments& args);
+  static Handle<Value> GetMany(const Arguments& args);
+  static Handle<Value> Put(const Arguments& args);
+  static Handle<Value> Flush(const Arguments& args);
+  static Handle<Value> Stats(const Arguments& args);
+};
+
+#endif
@@ -1,7 +1,10 @@
 #ifndef BITCOINJS_SERVER_INCLUDE_COMMON_H_
 #define BITCOINJS_SERVER_INCLUDE_COMMON_H_
 
+#include <stdint.h>
+
 #include <v8.h>
+#include <node_buffer.h>
 
 #define REQ_FUN_ARG(I, VAR)                                                            \
   if (args.Length() <= (I) || !args[I]->IsFunction())                                  \
@@ -14,4 +17,49 @@ static v8::Handle<v8::Value> VException(const char *msg) {
     return v8::ThrowException(v8::Exception::Error(v8::String::New(msg)));
 }
 
+/**
+ * Pointer to length bytes at offset into a Buffer, for the functions that
+ * read from or write into a caller's buffer. Returns NULL if the value
+ * isn't a Buffer or the range doesn't fit inside it.
+ */
+static inline unsigned char *
+BufferRange(v8::Handle<v8::Value> buffer, v8::Handle<v8::Value> offset, size_t length)
+{
+  if (!node::Buffer::HasInstance(buffer) || !offset->IsUint32()) {
+    return NULL;
+  }
+
+  size_t start = offset->Uint32Value();
+  size_t bufferLen = node::Buffer::Length(buffer);
+  if (start > bufferLen || length > bufferLen - start) {
+    return NULL;
+  }
+  return (unsigned char *) node::Buffer::Data(buffer) + start;
+}
+
+/**
+ * Little endian fields of the wire format.
+ */
+static inline uint32_t
+ReadLE32(const unsigned char *p)
+{
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline uint64_t
+ReadLE64(const unsigned char *p)
+{
+  return (uint64_t) ReadLE32(p) | ((uint64_t) ReadLE32(p + 4) << 32);
+}
+
+static inline void
+WriteLE32(unsigned char *p, uint32_t v)
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+}
+
 #endif
@@ -0,0 +1,359 @@
+#include <string.h>
+
+#include <openssl/bn.h>
+#include <openssl/crypto.h>
+#include <openssl/ecdsa.h>
+#include <openssl/obj_mac.h>
+
+#include "ecdsa.h"
+#include "pubkeycache.h"
+#include "secp256k1.h"
+#include "sha256.h"
+#include "sigcache.h"
+
+#ifndef USE_SECP256K1
+/**
+ * Append a DER INTEGER holding a 32 byte big endian magnitude.
+ */
+static int
+der_put_magnitude (unsigned char *out, const unsigned char *m)
+{
+  int start = 0;
+  while (start < 31 && m[start] == 0) start++;
+  int pad = (m[start] & 0x80) ? 1 : 0;
+  int len = 32 - start + pad;
+
+  out[0] = 0x02;
+  out[1] = len;
+  out[2] = 0;
+  memcpy(out + 2 + pad, m + start, 32 - start);
+  return 2 + len;
+}
+
+/**
+ * Re-encode a signature as strict DER, at most 72 bytes. OpenSSL refuses
+ * some encodings the JavaScript verifier accepted, see
+ * Secp256k1::ParseSignature().
+ */
+static bool
+sig_normalize (unsigned char *der, int *derLen,
+               const unsigned char *sig, int sigLen)
+{
+  unsigned char r[32], s[32];
+  if (!Secp256k1::ParseSignature(r, s, sig, sigLen)) {
+    return false;
+  }
+
+  int len = der_put_magnitude(der + 2, r);
+  len += der_put_magnitude(der + 2 + len, s);
+  der[0] = 0x30;
+  der[1] = len;
+  *derLen = 2 + len;
+  return true;
+}
+#endif
+
+int Ecdsa::Verify(EC_KEY *ec, const unsigned char *pub, int pubLen,
+                  const unsigned char *digest,
+                  const unsigned char *sig, int sigLen)
+{
+  SigCache::entry_t entry;
+  SigCache::GetEntry(&entry, pub, pubLen, digest, sig, sigLen);
+  if (SigCache::Contains(&entry)) {
+    return 1;
+  }
+
+#ifdef USE_SECP256K1
+  // The engine works on the decoded point, no EC_KEY needed
+  Secp256k1::point_t q;
+  if (!PubKeyCache::GetPoint(&q, pub, pubLen)) {
+    return -1;
+  }
+
+  int result = Secp256k1::Verify(&q, digest, sig, sigLen);
+#else
+  if (ec == NULL || !PubKeyCache::SetPublic(ec, pub, pubLen)) {
+    return -1;
+  }
+
+  unsigned char der[72];
+  int derLen;
+  if (!sig_normalize(der, &derLen, sig, sigLen)) {
+    return -1;
+  }
+
+  int result = ECDSA_verify(0, digest, 32, der, derLen, ec);
+#endif
+
+  if (result == 1) {
+    SigCache::Insert(&entry);
+  }
+  return result;
+}
+
+EC_KEY *Ecdsa::GetThreadKey()
+{
+#ifdef USE_SECP256K1
+  return NULL;
+#else
+  // Pool threads live as long as the process, so the key is never freed
+  static __thread EC_KEY *ec = NULL;
+  if (ec == NULL) {
+    ec = EC_KEY_new_by_curve_name(NID_secp256k1);
+  }
+  return ec;
+#endif
+}
+
+struct Ecdsa::sign_ctx_t {
+  const EC_GROUP *group;
+  EC_KEY *ec;
+  BN_CTX *bn;
+  EC_POINT *point;
+  BIGNUM *order;
+  BIGNUM *halfOrder;
+  BIGNUM *priv;
+  BIGNUM *k;
+  BIGNUM *kinv;
+  BIGNUM *x;
+  BIGNUM *r;
+  BIGNUM *s;
+  BIGNUM *e;
+};
+
+Ecdsa::sign_ctx_t *Ecdsa::NewSignContext()
+{
+  sign_ctx_t *ctx = new sign_ctx_t();
+
+  ctx->ec = EC_KEY_new_by_curve_name(NID_secp256k1);
+  ctx->bn = BN_CTX_new();
+  if (ctx->ec == NULL || ctx->bn == NULL) {
+    FreeSignContext(ctx);
+    return NULL;
+  }
+  ctx->group = EC_KEY_get0_group(ctx->ec);
+  ctx->point = EC_POINT_new(ctx->group);
+
+  BIGNUM **bns[] = { &ctx->order, &ctx->halfOrder, &ctx->priv, &ctx->k,
+                     &ctx->kinv, &ctx->x, &ctx->r, &ctx->s, &ctx->e };
+  for (size_t i = 0; i < sizeof(bns) / sizeof(bns[0]); i++) {
+    *bns[i] = BN_new();
+    if (*bns[i] == NULL) {
+      FreeSignContext(ctx);
+      return NULL;
+    }
+  }
+
+  if (ctx->point == NULL ||
+      !EC_GROUP_get_order(ctx->group, ctx->order, ctx->bn) ||
+      !BN_rshift1(ctx->halfOrder, ctx->order)) {
+    FreeSignContext(ctx);
+    return NULL;
+  }
+
+  BN_set_flags(ctx->priv, BN_FLG_CONSTTIME);
+  BN_set_flags(ctx->k, BN_FLG_CONSTTIME);
+
+  return ctx;
+}
+
+void Ecdsa::FreeSignContext(sign_ctx_t *ctx)
+{
+  if (ctx == NULL) return;
+
+  BIGNUM *bns[] = { ctx->order, ctx->halfOrder, ctx->priv, ctx->k,
+                    ctx->kinv, ctx->x, ctx->r, ctx->s, ctx->e };
+  for (size_t i = 0; i < sizeof(bns) / sizeof(bns[0]); i++) {
+    if (bns[i] != NULL) BN_clear_free(bns[i]);
+  }
+  if (ctx->point != NULL) EC_POINT_free(ctx->point);
+  if (ctx->bn != NULL) BN_CTX_free(ctx->bn);
+  if (ctx->ec != NULL) EC_KEY_free(ctx->ec);
+  delete ctx;
+}
+
+Ecdsa::sign_ctx_t *Ecdsa::GetThreadSignContext()
+{
+  // Pool threads live as long as the process, so the context is never freed
+  static __thread sign_ctx_t *ctx = NULL;
+  if (ctx == NULL) {
+    ctx = NewSignContext();
+  }
+  return ctx;
+}
+
+/**
+ * HMAC-SHA256 with a 32 byte key, written in pieces like a Sha256 stream.
+ */
+static void
+hmac_begin (Sha256::stream_t *inner, const unsigned char *key)
+{
+  unsigned char pad[64];
+  for (int i = 0; i < 64; i++) {
+    pad[i] = (i < 32 ? key[i] : 0) ^ 0x36;
+  }
+  Sha256::Begin(inner);
+  Sha256::Write(inner, pad, 64);
+}
+
+static void
+hmac_finish (Sha256::stream_t *inner, const unsigned char *key, unsigned char *out)
+{
+  unsigned char pad[64 + 32];
+  for (int i = 0; i < 64; i++) {
+    pad[i] = (i < 32 ? key[i] : 0) ^ 0x5c;
+  }
+  Sha256::FinishSingle(inner, pad + 64);
+
+  Sha256::stream_t outer;
+  Sha256::Begin(&outer);
+  Sha256::Write(&outer, pad, sizeof(pad));
+  Sha256::FinishSingle(&outer, out);
+}
+
+/**
+ * HMAC_DRBG state of RFC 6979, section 3.2.
+ */
+struct rfc6979_t {
+  unsigned char k[32];
+  unsigned char v[32];
+};
+
+static void
+rfc6979_init (rfc6979_t *rng, const unsigned char *priv, const unsigned char *hash)
+{
+  Sha256::stream_t h;
+
+  memset(rng->v, 0x01, 32);
+  memset(rng->k, 0x00, 32);
+
+  for (unsigned char round = 0; round < 2; round++) {
+    // K = HMAC_K(V || round || int2octets(x) || bits2octets(h1))
+    hmac_begin(&h, rng->k);
+    Sha256::Write(&h, rng->v, 32);
+    Sha256::Write(&h, &round, 1);
+    Sha256::Write(&h, priv, 32);
+    Sha256::Write(&h, hash, 32);
+    hmac_finish(&h, rng->k, rng->k);
+
+    // V = HMAC_K(V)
+    hmac_begin(&h, rng->k);
+    Sha256::Write(&h, rng->v, 32);
+    hmac_finish(&h, rng->k, rng->v);
+  }
+}
+
+static void
+rfc6979_next (rfc6979_t *rng, unsigned char *out, bool retry)
+{
+  Sha256::stream_t h;
+  static const unsigned char zero = 0;
+
+  if (retry) {
+    // K = HMAC_K(V || 0x00), V = HMAC_K(V)
+    hmac_begin(&h, rng->k);
+    Sha256::Write(&h, rng->v, 32);
+    Sha256::Write(&h, &zero, 1);
+    hmac_finish(&h, rng->k, rng->k);
+
+    hmac_begin(&h, rng->k);
+    Sha256::Write(&h, rng->v, 32);
+    hmac_finish(&h, rng->k, rng->v);
+  }
+
+  hmac_begin(&h, rng->k);
+  Sha256::Write(&h, rng->v, 32);
+  hmac_finish(&h, rng->k, rng->v);
+  memcpy(out, rng->v, 32);
+}
+
+/**
+ * Append a DER INTEGER holding bn, which must fit in 32 bytes.
+ */
+static int
+der_put_integer (unsigned char *out, const BIGNUM *bn)
+{
+  unsigned char buf[33];
+  int len = BN_num_bytes(bn);
+  buf[0] = 0;
+  BN_bn2bin(bn, buf + 1);
+
+  // Keep a zero byte in front of a set high bit
+  int start = (buf[1] & 0x80) ? 0 : 1;
+  len += 1 - start;
+
+  out[0] = 0x02;
+  out[1] = len;
+  memcpy(out + 2, buf + start, len);
+  return 2 + len;
+}
+
+bool Ecdsa::Sign(sign_ctx_t *ctx, const unsigned char *priv,
+                 const unsigned char *digest,
+                 unsigned char *sig, int *sigLen)
+{
+  if (!BN_bin2bn(priv, 32, ctx->priv) ||
+      BN_is_zero(ctx->priv) || BN_cmp(ctx->priv, ctx->order) >= 0 ||
+      !BN_bin2bn(digest, 32, ctx->e)) {
+    BN_clear(ctx->priv);
+    return false;
+  }
+
+  // bits2octets(h1) is the hash reduced modulo the order
+  unsigned char hash[32];
+  memset(hash, 0, sizeof(hash));
+  if (!BN_nnmod(ctx->x, ctx->e, ctx->order, ctx->bn)) {
+    BN_clear(ctx->priv);
+    return false;
+  }
+  BN_bn2bin(ctx->x, hash + 32 - BN_num_bytes(ctx->x));
+
+  rfc6979_t rng;
+  rfc6979_init(&rng, priv, hash);
+
+  unsigned char nonce[32];
+  bool ok = false;
+  for (int attempt = 0; attempt < 16 && !ok; attempt++) {
+    rfc6979_next(&rng, nonce, attempt > 0);
+    if (!BN_bin2bn(nonce, 32, ctx->k)) break;
+    if (BN_is_zero(ctx->k) || BN_cmp(ctx->k, ctx->order) >= 0) continue;
+
+    // r = x(k * G) mod n
+    if (!EC_POINT_mul(ctx->group, ctx->point, ctx->k, NULL, NULL, ctx->bn) ||
+        !EC_POINT_get_affine_coordinates_GFp(ctx->group, ctx->point,
+                                             ctx->x, NULL, ctx->bn) ||
+        !BN_nnmod(ctx->r, ctx->x, ctx->order, ctx->bn)) {
+      break;
+    }
+    if (BN_is_zero(ctx->r)) continue;
+
+    // s = k^-1 * (e + r * priv) mod n
+    if (!BN_mod_inverse(ctx->kinv, ctx->k, ctx->order, ctx->bn) ||
+        !BN_mod_mul(ctx->s, ctx->r, ctx->priv, ctx->order, ctx->bn) ||
+        !BN_mod_add(ctx->s, ctx->s, ctx->e, ctx->order, ctx->bn) ||
+        !BN_mod_mul(ctx->s, ctx->s, ctx->kinv, ctx->order, ctx->bn)) {
+      break;
+    }
+    if (BN_is_zero(ctx->s)) continue;
+
+    ok = true;
+  }
+
+  OPENSSL_cleanse(nonce, sizeof(nonce));
+  OPENSSL_cleanse(&rng, sizeof(rng));
+  BN_clear(ctx->k);
+  BN_clear(ctx->priv);
+  if (!ok) return false;
+
+  // Both s and n - s are valid, always give the lower one
+  if (BN_cmp(ctx->s, ctx->halfOrder) > 0) {
+    BN_sub(ctx->s, ctx->order, ctx->s);
+  }
+
+  int len = der_put_integer(sig + 2, ctx->r);
+  len += der_put_integer(sig + 2 + len, ctx->s);
+  sig[0] = 0x30;
+  sig[1] = len;
+  *sigLen = 2 + len;
+  return true;
+}
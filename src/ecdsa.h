@@ -0,0 +1,55 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_ECDSA_H_
+#define BITCOINJS_SERVER_INCLUDE_ECDSA_H_
+
+#include <openssl/ec.h>
+
+/**
+ * ECDSA on secp256k1 for raw keys, digests and DER signatures.
+ *
+ * Nothing here touches V8, so the functions are safe to call from the
+ * thread pool and can be linked into programs other than the addon.
+ */
+class Ecdsa
+{
+public:
+
+  /**
+   * Verify a signature of a 32 byte digest by a serialized public key,
+   * going through the signature cache. ec is a scratch key for the OpenSSL
+   * code path and may be NULL with USE_SECP256K1. Both backends take the
+   * lax DER of Secp256k1::ParseSignature(). Returns -1, 0 or 1 like
+   * ECDSA_verify().
+   */
+  static int Verify(EC_KEY *ec, const unsigned char *pub, int pubLen,
+                    const unsigned char *digest,
+                    const unsigned char *sig, int sigLen);
+
+  /**
+   * Scratch key for Verify() owned by the calling thread, created on first
+   * use. Only its public point changes between verifications, so the curve
+   * group is set up once per thread. NULL with USE_SECP256K1.
+   */
+  static EC_KEY *GetThreadKey();
+
+  /**
+   * Sign a 32 byte digest with a 32 byte private key, using a deterministic
+   * nonce (RFC 6979) and a low S value. Writes at most 72 bytes of DER to
+   * sig. Returns false if the private key is out of range or OpenSSL
+   * fails. ctx is a scratch context from NewSignContext() or
+   * GetThreadSignContext().
+   */
+  struct sign_ctx_t;
+  static sign_ctx_t *NewSignContext();
+  static void FreeSignContext(sign_ctx_t *ctx);
+
+  /**
+   * Signing context owned by the calling thread, created on first use like
+   * GetThreadKey(). NULL if it could not be set up.
+   */
+  static sign_ctx_t *GetThreadSignContext();
+  static bool Sign(sign_ctx_t *ctx, const unsigned char *priv,
+                   const unsigned char *digest,
+                   unsigned char *sig, int *sigLen);
+};
+
+#endif
@@ -6,16 +6,30 @@
 #include <node_buffer.h>
 #include <node_internals.h>
 
+#include <openssl/bn.h>
 #include <openssl/ecdsa.h>
 #include <openssl/evp.h>
+#include <openssl/obj_mac.h>
 
 #include "common.h"
+#include "ecdsa.h"
 #include "eckey.h"
+#include "pubkeycache.h"
+#include "secp256k1.h"
+#include "sha256.h"
+#include "sigcache.h"
+#include "stats.h"
+#include "workpool.h"
 
 using namespace std;
 using namespace v8;
 using namespace node;
 
+// Jobs smaller than this aren't worth the thread pool round trip
+#define VERIFY_BATCH_MIN_JOB_SIZE 16
+#define SIGN_MIN_JOB_SIZE 8
+#define GENERATE_MIN_JOB_SIZE 8
+
 int static inline EC_KEY_regenerate_key(EC_KEY *eckey, const BIGNUM *priv_key)
 {
   int ok = 0;
@@ -61,34 +75,137 @@ void BitcoinKey::Generate()
 
   hasPublic = true;
   hasPrivate = true;
+  pubLen = 0;
+}
+
+/**
+ * Make sure pub holds the serialized public key. Only call this on the
+ * main thread, the thread pool reads pub.
+ */
+bool BitcoinKey::LoadPublic()
+{
+  if (pubLen > 0) {
+    return true;
+  }
+
+  int size = i2o_ECPublicKey(ec, NULL);
+  if (size <= 0 || size > (int) sizeof(pub)) {
+    return false;
+  }
+  unsigned char *end = pub;
+  if (i2o_ECPublicKey(ec, &end) != size) {
+    return false;
+  }
+  pubLen = size;
+  return true;
 }
 
-int BitcoinKey::VerifySignature(const unsigned char *digest, int digest_len,
-                    const unsigned char *sig, int sig_len)
+/**
+ * Verify with the serialized key, so this shares the signature cache with
+ * BitcoinKey.verify() and verifyBatch(). LoadPublic() must have succeeded.
+ */
+int BitcoinKey::VerifySignature(const unsigned char *digest,
+                                const unsigned char *sig, int sig_len)
 {
-  return ECDSA_verify(0, digest, digest_len, sig, sig_len, ec);
+  return Ecdsa::Verify(Ecdsa::GetThreadKey(), pub, pubLen, digest, sig, sig_len);
 }
 
 void BitcoinKey::EIO_VerifySignature(uv_work_t *req)
 {
   verify_sig_baton_t *b = static_cast<verify_sig_baton_t *>(req->data);
 
+  uint64_t start = Stats::Now();
+  Stats::RecordWait(Stats::OP_VERIFY, start - b->queued);
+
   b->result = b->key->VerifySignature(
-    b->digest, b->digestLen,
+    b->digest,
     b->sig, b->sigLen
   );
+
+  Stats::RecordRun(Stats::OP_VERIFY, Stats::Now() - start);
+  Stats::Count(Stats::OP_VERIFY, Stats::VerifyResult(b->result));
 }
 
-ECDSA_SIG *BitcoinKey::Sign(const unsigned char *digest, int digest_len)
+void BitcoinKey::EIO_VerifyBatch(uv_work_t *req)
 {
-  ECDSA_SIG *sig;
+  verify_batch_job_t *job = static_cast<verify_batch_job_t *>(req->data);
+  verify_batch_baton_t *b = job->baton;
+
+  uint64_t start = Stats::Now();
+  Stats::RecordWait(Stats::OP_VERIFY_BATCH, start - job->queued);
+
+  // Each item only replaces the public point of the thread's key
+  EC_KEY *ec = Ecdsa::GetThreadKey();
 
-  sig = ECDSA_do_sign(digest, digest_len, ec);
-  if (sig == NULL) {
-    // TODO: ERROR
+  for (int i = job->begin; i < job->end; i++) {
+    verify_batch_item_t *item = &b->items[i];
+    const unsigned char *pub = b->data + item->pubOffset;
+    const unsigned char *digest = b->data + item->digestOffset;
+    const unsigned char *sig = b->data + item->sigOffset;
+
+    b->results[i] = Ecdsa::Verify(ec, pub, item->pubLen, digest, sig, item->sigLen);
+    Stats::Count(Stats::OP_VERIFY_BATCH, Stats::VerifyResult(b->results[i]));
+  }
+
+  Stats::RecordRun(Stats::OP_VERIFY_BATCH, Stats::Now() - start);
+}
+
+bool BitcoinKey::GetPrivateBytes(unsigned char *out)
+{
+  const BIGNUM *bn = EC_KEY_get0_private_key(ec);
+  if (!hasPrivate || bn == NULL || BN_num_bytes(bn) > 32) {
+    return false;
+  }
+
+  memset(out, 0, 32);
+  BN_bn2bin(bn, out + 32 - BN_num_bytes(bn));
+  return true;
+}
+
+void BitcoinKey::EIO_Sign(uv_work_t *req)
+{
+  sign_job_t *job = static_cast<sign_job_t *>(req->data);
+  sign_baton_t *b = job->baton;
+
+  uint64_t start = Stats::Now();
+  Stats::RecordWait(Stats::OP_SIGN, start - job->queued);
+
+  Ecdsa::sign_ctx_t *ctx = Ecdsa::GetThreadSignContext();
+
+  for (int i = job->begin; i < job->end; i++) {
+    sign_item_t *item = &b->items[i];
+    if (ctx == NULL || !Ecdsa::Sign(ctx, item->priv, item->digest,
+                                item->sig, &item->sigLen)) {
+      item->sigLen = 0;
+    }
+    OPENSSL_cleanse(item->priv, sizeof(item->priv));
+    Stats::Count(Stats::OP_SIGN, item->sigLen ? Stats::RESULT_GOOD
+                                              : Stats::RESULT_ERROR);
   }
 
-  return sig;
+  Stats::RecordRun(Stats::OP_SIGN, Stats::Now() - start);
+}
+
+void BitcoinKey::EIO_Generate(uv_work_t *req)
+{
+  generate_job_t *job = static_cast<generate_job_t *>(req->data);
+  generate_baton_t *b = job->baton;
+
+  uint64_t start = Stats::Now();
+  Stats::RecordWait(Stats::OP_GENERATE, start - job->queued);
+
+  for (int i = job->begin; i < job->end; i++) {
+    EC_KEY *ec = EC_KEY_new_by_curve_name(NID_secp256k1);
+    if (ec != NULL && !EC_KEY_generate_key(ec)) {
+      EC_KEY_free(ec);
+      ec = NULL;
+    }
+    b->keys[i] = ec;
+    Stats::Count(Stats::OP_GENERATE, ec ? Stats::RESULT_GOOD
+                                        : Stats::RESULT_ERROR);
+  }
+
+  Stats::RecordRun(Stats::OP_GENERATE, Stats::Now() - start);
 }
 
 void BitcoinKey::Init(Handle<Object> target)
@@ -111,11 +228,20 @@ void BitcoinKey::Init(Handle<Object> target)
   NODE_SET_PROTOTYPE_METHOD(s_ct, "verifySignatureSync", VerifySignatureSync);
   NODE_SET_PROTOTYPE_METHOD(s_ct, "regenerateSync", RegenerateSync);
   NODE_SET_PROTOTYPE_METHOD(s_ct, "toDER", ToDER);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "toDERInto", ToDERInto);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "getPublicInto", GetPublicInto);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "getPrivateInto", GetPrivateInto);
   NODE_SET_PROTOTYPE_METHOD(s_ct, "signSync", SignSync);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "signInto", SignInto);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "sign", Sign);
 
   // Static methods
   NODE_SET_METHOD(s_ct->GetFunction(), "generateSync", GenerateSync);
+  NODE_SET_METHOD(s_ct->GetFunction(), "generate", Generate);
   NODE_SET_METHOD(s_ct->GetFunction(), "fromDER", FromDER);
+  NODE_SET_METHOD(s_ct->GetFunction(), "verify", Verify);
+  NODE_SET_METHOD(s_ct->GetFunction(), "verifyBatch", VerifyBatch);
+  NODE_SET_METHOD(s_ct->GetFunction(), "signMany", SignMany);
 
   target->Set(String::NewSymbol("BitcoinKey"),
               s_ct->GetFunction());
@@ -124,7 +250,8 @@ void BitcoinKey::Init(Handle<Object> target)
 BitcoinKey::BitcoinKey() :
   lastError(NULL),
   hasPrivate(false),
-  hasPublic(false)
+  hasPublic(false),
+  pubLen(0)
 {
   ec = EC_KEY_new_by_curve_name(NID_secp256k1);
   if (ec == NULL) {
@@ -193,33 +320,12 @@ BitcoinKey::GetPrivate(Local<String> property, const AccessorInfo& info)
     return scope.Close(Null());
   }
 
-  const BIGNUM *bn = EC_KEY_get0_private_key(key->ec);
-  int priv_size = BN_num_bytes(bn);
-
-  if (bn == NULL) {
-    // TODO: ERROR: "Error from EC_KEY_get0_private_key(pkey)"
-    return scope.Close(Null());
-  }
-
-  if (priv_size > 32) {
+  Buffer *priv_buf = Buffer::New(32);
+  if (!key->GetPrivateBytes((unsigned char *) Buffer::Data(priv_buf))) {
     // TODO: ERROR: "Secret too large (Incorrect curve parameters?)"
     return scope.Close(Null());
   }
 
-  unsigned char *priv = (unsigned char *)malloc(32);
-
-  int n = BN_bn2bin(bn, &priv[32 - priv_size]);
-
-  if (n != priv_size) {
-    // TODO: ERROR: "Error from BN_bn2bin(bn, &priv[32 - priv_size])"
-    return scope.Close(Null());
-  }
-
-  Buffer *priv_buf = Buffer::New(32);
-  memcpy(Buffer::Data(priv_buf), priv, 32);
-
-  free(priv);
-
   return scope.Close(priv_buf->handle_);
 }
 
@@ -253,21 +359,69 @@ BitcoinKey::GetPublic(Local<String> property, const AccessorInfo& info)
     // TODO: ERROR: "Error from i2o_ECPublicKey(key->ec, NULL)"
     return scope.Close(Null());
   }
-  unsigned char *pub_begin, *pub_end;
-  pub_begin = pub_end = (unsigned char *)malloc(pub_size);
+  Buffer *pub_buf = Buffer::New(pub_size);
+  unsigned char *pub_end = (unsigned char *) Buffer::Data(pub_buf);
 
   if (i2o_ECPublicKey(key->ec, &pub_end) != pub_size) {
     // TODO: ERROR: "Error from i2o_ECPublicKey(key->ec, &pub)"
     return scope.Close(Null());
   }
-  Buffer *pub_buf = Buffer::New(pub_size);
-  memcpy(Buffer::Data(pub_buf), pub_begin, pub_size);
-
-  free(pub_begin);
 
   return scope.Close(pub_buf->handle_);
 }
 
+Handle<Value>
+BitcoinKey::GetPublicInto(const Arguments& args)
+{
+  HandleScope scope;
+  BitcoinKey* key = node::ObjectWrap::Unwrap<BitcoinKey>(args.This());
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: out, offset");
+  }
+  if (!key->hasPublic) {
+    return VException("BitcoinKey does not have a public key set");
+  }
+
+  int pub_size = i2o_ECPublicKey(key->ec, NULL);
+  if (!pub_size) {
+    return VException("Error from i2o_ECPublicKey(key->ec, NULL)");
+  }
+  unsigned char *pub_end = BufferRange(args[0], args[1], pub_size);
+  if (pub_end == NULL) {
+    return VException("Argument 'out' must be a Buffer with room for the key at 'offset'");
+  }
+  if (i2o_ECPublicKey(key->ec, &pub_end) != pub_size) {
+    return VException("Error from i2o_ECPublicKey(key->ec, &pub)");
+  }
+
+  return scope.Close(Integer::New(pub_size));
+}
+
+Handle<Value>
+BitcoinKey::GetPrivateInto(const Arguments& args)
+{
+  HandleScope scope;
+  BitcoinKey* key = node::ObjectWrap::Unwrap<BitcoinKey>(args.This());
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: out, offset");
+  }
+  if (!key->hasPrivate) {
+    return VException("BitcoinKey does not have a private key set");
+  }
+
+  unsigned char *out = BufferRange(args[0], args[1], 32);
+  if (out == NULL) {
+    return VException("Argument 'out' must be a Buffer with 32 bytes free at 'offset'");
+  }
+  if (!key->GetPrivateBytes(out)) {
+    return VException("Invalid private key");
+  }
+
+  return scope.Close(Integer::New(32));
+}
+
 void
 BitcoinKey::SetPublic(Local<String> property, Local<Value> value, const AccessorInfo& info)
 {
@@ -275,12 +429,19 @@ BitcoinKey::SetPublic(Local<String> property, Local<Value> value, const Accessor
   Handle<Object> buffer = value->ToObject();
   const unsigned char *data = (const unsigned char*) Buffer::Data(buffer);
 
-  if (!o2i_ECPublicKey(&(key->ec), &data, Buffer::Length(buffer))) {
+  size_t len = Buffer::Length(buffer);
+  if (!PubKeyCache::SetPublic(key->ec, data, len)) {
     // TODO: Error
     return;
   }
 
+  // Keep the key as given, that's what the signature cache is keyed on
   key->hasPublic = true;
+  key->pubLen = 0;
+  if (len <= sizeof(key->pub)) {
+    memcpy(key->pub, data, len);
+    key->pubLen = len;
+  }
 }
 
 Handle<Value>
@@ -299,6 +460,7 @@ BitcoinKey::RegenerateSync(const Arguments& args)
   if (EC_KEY_regenerate_key(key->ec, EC_KEY_get0_private_key(old)) == 1) {
     key->hasPublic = true;
   }
+  key->pubLen = 0;
 
   EC_KEY_free(old);
 
@@ -321,21 +483,45 @@ BitcoinKey::ToDER(const Arguments& args)
     // TODO: ERROR: "Error from i2d_ECPrivateKey(key->ec, NULL)"
     return scope.Close(Null());
   }
-  unsigned char *der_begin, *der_end;
-  der_begin = der_end = (unsigned char *)malloc(der_size);
+  Buffer *der_buf = Buffer::New(der_size);
+  unsigned char *der_end = (unsigned char *) Buffer::Data(der_buf);
 
   if (i2d_ECPrivateKey(key->ec, &der_end) != der_size) {
     // TODO: ERROR: "Error from i2d_ECPrivateKey(key->ec, &der_end)"
     return scope.Close(Null());
   }
-  Buffer *der_buf = Buffer::New(der_size);
-  memcpy(Buffer::Data(der_buf), der_begin, der_size);
-
-  free(der_begin);
 
   return scope.Close(der_buf->handle_);
 }
 
+Handle<Value>
+BitcoinKey::ToDERInto(const Arguments& args)
+{
+  HandleScope scope;
+  BitcoinKey* key = node::ObjectWrap::Unwrap<BitcoinKey>(args.This());
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: out, offset");
+  }
+  if (!key->hasPrivate || !key->hasPublic) {
+    return VException("BitcoinKey needs a private and a public key");
+  }
+
+  int der_size = i2d_ECPrivateKey(key->ec, NULL);
+  if (!der_size) {
+    return VException("Error from i2d_ECPrivateKey(key->ec, NULL)");
+  }
+  unsigned char *der_end = BufferRange(args[0], args[1], der_size);
+  if (der_end == NULL) {
+    return VException("Argument 'out' must be a Buffer with room for the key at 'offset'");
+  }
+  if (i2d_ECPrivateKey(key->ec, &der_end) != der_size) {
+    return VException("Error from i2d_ECPrivateKey(key->ec, &der_end)");
+  }
+
+  return scope.Close(Integer::New(der_size));
+}
+
 Handle<Value>
 BitcoinKey::FromDER(const Arguments& args)
 {
@@ -396,24 +582,27 @@ BitcoinKey::VerifySignature(const Arguments& args)
   if (Buffer::Length(hash_buf) != 32) {
     return VException("Argument 'hash' must be Buffer of length 32 bytes");
   }
+  if (!key->LoadPublic()) {
+    return VException("Error from i2o_ECPublicKey(key->ec, &pub)");
+  }
 
   verify_sig_baton_t *baton = new verify_sig_baton_t();
   baton->key = key;
   baton->digest = (unsigned char *)Buffer::Data(hash_buf);
-  baton->digestLen = Buffer::Length(hash_buf);
   baton->digestBuf = Persistent<Object>::New(hash_buf);
   baton->sig = (unsigned char *)Buffer::Data(sig_buf);
   baton->sigLen = Buffer::Length(sig_buf);
   baton->sigBuf = Persistent<Object>::New(sig_buf);
   baton->result = -1;
   baton->cb = Persistent<Function>::New(cb);
+  baton->queued = Stats::Now();
 
   key->Ref();
 
   uv_work_t *req = new uv_work_t;
   req->data = baton;
 
-  uv_queue_work(uv_default_loop(), req, EIO_VerifySignature, VerifySignatureCallback);
+  WorkPool::Queue(req, EIO_VerifySignature, VerifySignatureCallback);
 
   return scope.Close(Undefined());
 }
@@ -464,6 +653,7 @@ Handle<Value>
 BitcoinKey::VerifySignatureSync(const Arguments& args)
 {
   HandleScope scope;
+  StatsTimer timer(Stats::OP_VERIFY_SYNC);
   BitcoinKey* key = node::ObjectWrap::Unwrap<BitcoinKey>(args.This());
 
   if (args.Length() != 2) {
@@ -491,9 +681,13 @@ BitcoinKey::VerifySignatureSync(const Arguments& args)
   if (hash_len != 32) {
     return VException("Argument 'hash' must be Buffer of length 32 bytes");
   }
+  if (!key->LoadPublic()) {
+    return VException("Error from i2o_ECPublicKey(key->ec, &pub)");
+  }
 
   // Verify signature
-  int result = key->VerifySignature(hash_data, hash_len, sig_data, sig_len);
+  int result = key->VerifySignature(hash_data, sig_data, sig_len);
+  timer.Done(Stats::VerifyResult(result));
 
   if (result == -1) {
     return VException("Error during ECDSA_verify");
@@ -508,10 +702,283 @@ BitcoinKey::VerifySignatureSync(const Arguments& args)
   }
 }
 
+/**
+ * Split a baton into at most one job per thread and queue them.
+ */
+template <typename baton_t, typename job_t>
+static void
+queue_jobs (baton_t *baton, int count, int minJobSize,
+            uv_work_cb work, uv_after_work_cb done)
+{
+  int jobs = (count + minJobSize - 1) / minJobSize;
+  if (jobs > WorkPool::GetThreadCount()) jobs = WorkPool::GetThreadCount();
+  if (jobs < 1) jobs = 1;
+
+  baton->pending = jobs;
+
+  for (int j = 0; j < jobs; j++) {
+    job_t *job = new job_t();
+    job->baton = baton;
+    job->begin = (int)((long long)count * j / jobs);
+    job->end = (int)((long long)count * (j + 1) / jobs);
+    job->queued = Stats::Now();
+
+    uv_work_t *req = new uv_work_t;
+    req->data = job;
+
+    WorkPool::Queue(req, work, done);
+  }
+}
+
+/**
+ * Verify a signature by a serialized public key, without a BitcoinKey
+ * object. Synchronous without a callback. The asynchronous form is a batch
+ * of one that calls back with a Boolean.
+ */
+Handle<Value>
+BitcoinKey::Verify(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 3 && args.Length() != 4) {
+    return VException("Three or four arguments expected: pubkey, hash, sig[, callback]");
+  }
+  if (!Buffer::HasInstance(args[0])) {
+    return VException("Argument 'pubkey' must be of type Buffer");
+  }
+  if (!Buffer::HasInstance(args[1]) || Buffer::Length(args[1]) != 32) {
+    return VException("Argument 'hash' must be Buffer of length 32 bytes");
+  }
+  if (!Buffer::HasInstance(args[2])) {
+    return VException("Argument 'sig' must be of type Buffer");
+  }
+
+  const unsigned char *pub = (const unsigned char *) Buffer::Data(args[0]);
+  size_t pubLen = Buffer::Length(args[0]);
+  size_t sigLen = Buffer::Length(args[2]);
+
+  if (args.Length() == 3) {
+    StatsTimer timer(Stats::OP_VERIFY_SYNC);
+    int result = Ecdsa::Verify(Ecdsa::GetThreadKey(), pub, pubLen,
+                               (const unsigned char *) Buffer::Data(args[1]),
+                               (const unsigned char *) Buffer::Data(args[2]), sigLen);
+    timer.Done(Stats::VerifyResult(result));
+
+    // Undecodable keys and signatures simply don't verify
+    return scope.Close(Boolean::New(result == 1));
+  }
+
+  REQ_FUN_ARG(3, cb);
+
+  verify_batch_baton_t *baton = new verify_batch_baton_t();
+  baton->items = (verify_batch_item_t *)malloc(sizeof(verify_batch_item_t));
+  baton->results = (signed char *)malloc(1);
+  baton->count = 1;
+  baton->single = true;
+
+  baton->data = (unsigned char *)malloc(pubLen + 32 + sigLen);
+  memcpy(baton->data, pub, pubLen);
+  memcpy(baton->data + pubLen, Buffer::Data(args[1]), 32);
+  memcpy(baton->data + pubLen + 32, Buffer::Data(args[2]), sigLen);
+
+  verify_batch_item_t *item = &baton->items[0];
+  item->pubOffset = 0;
+  item->pubLen = pubLen;
+  item->digestOffset = pubLen;
+  item->sigOffset = pubLen + 32;
+  item->sigLen = sigLen;
+
+  baton->cb = Persistent<Function>::New(cb);
+
+  queue_jobs<verify_batch_baton_t, verify_batch_job_t>(
+    baton, 1, VERIFY_BATCH_MIN_JOB_SIZE, EIO_VerifyBatch, VerifyBatchCallback);
+
+  return scope.Close(Undefined());
+}
+
+/**
+ * Report the result of a single verification queued by Verify().
+ */
+void
+BitcoinKey::VerifyCallback(verify_batch_baton_t *baton)
+{
+  HandleScope scope;
+
+  // Like the synchronous form, only valid signatures count as true
+  Local<Value> argv[2];
+  argv[0] = Local<Value>::New(Null());
+  argv[1] = Local<Value>::New(Boolean::New(baton->results[0] == 1));
+
+  TryCatch try_catch;
+
+  baton->cb->Call(Context::GetCurrent()->Global(), 2, argv);
+
+  baton->cb.Dispose();
+
+  free(baton->items);
+  free(baton->results);
+  free(baton->data);
+  delete baton;
+
+  if (try_catch.HasCaught()) {
+    FatalException(try_catch);
+  }
+}
+
+Handle<Value>
+BitcoinKey::VerifyBatch(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: items, callback");
+  }
+  if (!args[0]->IsArray()) {
+    return VException("Argument 'items' must be of type Array");
+  }
+  REQ_FUN_ARG(1, cb);
+
+  Local<Array> items = Local<Array>::Cast(args[0]);
+  int count = items->Length();
+
+  Local<String> pubkey_sym = String::NewSymbol("pubkey");
+  Local<String> hash_sym = String::NewSymbol("hash");
+  Local<String> sig_sym = String::NewSymbol("sig");
+
+  verify_batch_baton_t *baton = new verify_batch_baton_t();
+  baton->items = (verify_batch_item_t *)malloc(sizeof(verify_batch_item_t) * (count + 1));
+  baton->results = (signed char *)malloc(count + 1);
+  baton->count = count;
+  baton->data = NULL;
+
+  // Copy all keys, hashes and signatures into one arena, so the workers
+  // don't depend on any JavaScript objects staying alive.
+  size_t dataLen = 0;
+  size_t dataCap = 0;
+  const char *error = NULL;
+
+  for (int i = 0; i < count; i++) {
+    Local<Value> value = items->Get(i);
+    if (!value->IsObject()) {
+      error = "Batch items must be objects with pubkey, hash and sig";
+      break;
+    }
+    Local<Object> obj = value->ToObject();
+    Local<Value> pub_buf = obj->Get(pubkey_sym);
+    Local<Value> hash_buf = obj->Get(hash_sym);
+    Local<Value> sig_buf = obj->Get(sig_sym);
+
+    if (!Buffer::HasInstance(pub_buf) ||
+        !Buffer::HasInstance(hash_buf) ||
+        !Buffer::HasInstance(sig_buf)) {
+      error = "Batch item properties 'pubkey', 'hash' and 'sig' must be of type Buffer";
+      break;
+    }
+    if (Buffer::Length(hash_buf) != 32) {
+      error = "Batch item 'hash' must be Buffer of length 32 bytes";
+      break;
+    }
+
+    size_t pubLen = Buffer::Length(pub_buf);
+    size_t sigLen = Buffer::Length(sig_buf);
+    size_t needed = dataLen + pubLen + 32 + sigLen;
+    if (needed > dataCap) {
+      dataCap = needed > dataCap * 2 ? needed : dataCap * 2;
+      baton->data = (unsigned char *)realloc(baton->data, dataCap);
+    }
+
+    verify_batch_item_t *item = &baton->items[i];
+    item->pubOffset = dataLen;
+    item->pubLen = pubLen;
+    memcpy(baton->data + dataLen, Buffer::Data(pub_buf), pubLen);
+    dataLen += pubLen;
+
+    item->digestOffset = dataLen;
+    memcpy(baton->data + dataLen, Buffer::Data(hash_buf), 32);
+    dataLen += 32;
+
+    item->sigOffset = dataLen;
+    item->sigLen = sigLen;
+    memcpy(baton->data + dataLen, Buffer::Data(sig_buf), sigLen);
+    dataLen += sigLen;
+  }
+
+  if (error != NULL) {
+    free(baton->items);
+    free(baton->results);
+    free(baton->data);
+    delete baton;
+    return VException(error);
+  }
+
+  baton->single = false;
+  baton->cb = Persistent<Function>::New(cb);
+
+  // Split the batch into jobs for the thread pool
+  queue_jobs<verify_batch_baton_t, verify_batch_job_t>(
+    baton, count, VERIFY_BATCH_MIN_JOB_SIZE, EIO_VerifyBatch, VerifyBatchCallback);
+
+  return scope.Close(Undefined());
+}
+
+void
+BitcoinKey::VerifyBatchCallback(uv_work_t *req, int status)
+{
+  verify_batch_job_t *job = static_cast<verify_batch_job_t *>(req->data);
+  verify_batch_baton_t *baton = job->baton;
+
+  delete job;
+  delete req;
+
+  // Only the last job to finish reports back
+  if (--baton->pending > 0) {
+    return;
+  }
+
+  HandleScope scope;
+
+  if (baton->single) {
+    VerifyCallback(baton);
+    return;
+  }
+
+  // Bit i of the result is set if signature i is valid
+  int bitmapLen = (baton->count + 7) / 8;
+  Buffer *bitmap_buf = Buffer::New(bitmapLen);
+  unsigned char *bitmap = (unsigned char *)Buffer::Data(bitmap_buf);
+  memset(bitmap, 0, bitmapLen);
+  for (int i = 0; i < baton->count; i++) {
+    if (baton->results[i] == 1) {
+      bitmap[i >> 3] |= 1 << (i & 7);
+    }
+  }
+
+  Local<Value> argv[2];
+
+  argv[0] = Local<Value>::New(Null());
+  argv[1] = Local<Value>::New(bitmap_buf->handle_);
+
+  TryCatch try_catch;
+
+  baton->cb->Call(Context::GetCurrent()->Global(), 2, argv);
+
+  baton->cb.Dispose();
+
+  free(baton->items);
+  free(baton->results);
+  free(baton->data);
+  delete baton;
+
+  if (try_catch.HasCaught()) {
+    FatalException(try_catch);
+  }
+}
+
 Handle<Value>
 BitcoinKey::SignSync(const Arguments& args)
 {
   HandleScope scope;
+  StatsTimer timer(Stats::OP_SIGN_SYNC);
   BitcoinKey* key = node::ObjectWrap::Unwrap<BitcoinKey>(args.This());
 
   if (args.Length() != 1) {
@@ -526,37 +993,315 @@ BitcoinKey::SignSync(const Arguments& args)
 
   Handle<Object> hash_buf = args[0]->ToObject();
 
-  const unsigned char *hash_data = (unsigned char *) Buffer::Data(hash_buf);
+  if (Buffer::Length(hash_buf) != 32) {
+    return VException("Argument 'hash' must be Buffer of length 32 bytes");
+  }
 
-  unsigned int hash_len = Buffer::Length(hash_buf);
+  unsigned char priv[32];
+  if (!key->GetPrivateBytes(priv)) {
+    return VException("Invalid private key");
+  }
 
-  if (hash_len != 32) {
+  // Create signature
+  unsigned char sig[72];
+  int sigLen = 0;
+  Ecdsa::sign_ctx_t *ctx = Ecdsa::GetThreadSignContext();
+  bool ok = ctx != NULL &&
+    Ecdsa::Sign(ctx, priv, (const unsigned char *) Buffer::Data(hash_buf), sig, &sigLen);
+  OPENSSL_cleanse(priv, sizeof(priv));
+
+  if (!ok) {
+    return VException("Error signing hash");
+  }
+  timer.Done(Stats::RESULT_GOOD);
+
+  Buffer *der_buf = Buffer::New((const char *) sig, sigLen);
+
+  return scope.Close(der_buf->handle_);
+}
+
+Handle<Value>
+BitcoinKey::SignInto(const Arguments& args)
+{
+  HandleScope scope;
+  StatsTimer timer(Stats::OP_SIGN_SYNC);
+  BitcoinKey* key = node::ObjectWrap::Unwrap<BitcoinKey>(args.This());
+
+  if (args.Length() != 4) {
+    return VException("Four arguments expected: hash, hashOffset, out, outOffset");
+  }
+  const unsigned char *digest = BufferRange(args[0], args[1], 32);
+  if (digest == NULL) {
+    return VException("Argument 'hash' must be a Buffer with 32 bytes at 'hashOffset'");
+  }
+  if (!key->hasPrivate) {
+    return VException("BitcoinKey does not have a private key set");
+  }
+
+  unsigned char priv[32];
+  if (!key->GetPrivateBytes(priv)) {
+    return VException("Invalid private key");
+  }
+
+  unsigned char sig[72];
+  int sigLen = 0;
+  Ecdsa::sign_ctx_t *ctx = Ecdsa::GetThreadSignContext();
+  bool ok = ctx != NULL && Ecdsa::Sign(ctx, priv, digest, sig, &sigLen);
+  OPENSSL_cleanse(priv, sizeof(priv));
+
+  if (!ok) {
+    return VException("Error signing hash");
+  }
+
+  // Signatures are at most 72 bytes, only the actual length has to fit
+  unsigned char *out = BufferRange(args[2], args[3], sigLen);
+  if (out == NULL) {
+    return VException("Argument 'out' must be a Buffer with room for the signature at 'outOffset'");
+  }
+  memcpy(out, sig, sigLen);
+  timer.Done(Stats::RESULT_GOOD);
+
+  return scope.Close(Integer::New(sigLen));
+}
+
+Handle<Value>
+BitcoinKey::Sign(const Arguments& args)
+{
+  HandleScope scope;
+  BitcoinKey* key = node::ObjectWrap::Unwrap<BitcoinKey>(args.This());
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: hash, callback");
+  }
+  if (!Buffer::HasInstance(args[0])) {
+    return VException("Argument 'hash' must be of type Buffer");
+  }
+  REQ_FUN_ARG(1, cb);
+  if (!key->hasPrivate) {
+    return VException("BitcoinKey does not have a private key set");
+  }
+  if (Buffer::Length(args[0]) != 32) {
     return VException("Argument 'hash' must be Buffer of length 32 bytes");
   }
 
-  // Create signature
-  ECDSA_SIG *sig = key->Sign(hash_data, hash_len);
+  sign_baton_t *baton = new sign_baton_t();
+  baton->items = new sign_item_t[1];
+  baton->count = 1;
+  baton->many = false;
 
-  // Export DER
-  int der_size = i2d_ECDSA_SIG(sig, NULL);
-  if (!der_size) {
-    // TODO: ERROR: "Error from i2d_ECPrivateKey(key->ec, NULL)"
-    return scope.Close(Null());
+  if (!key->GetPrivateBytes(baton->items[0].priv)) {
+    delete [] baton->items;
+    delete baton;
+    return VException("Invalid private key");
   }
-  unsigned char *der_begin, *der_end;
-  der_begin = der_end = (unsigned char *)malloc(der_size);
+  memcpy(baton->items[0].digest, Buffer::Data(args[0]), 32);
+  baton->cb = Persistent<Function>::New(cb);
 
-  if (i2d_ECDSA_SIG(sig, &der_end) != der_size) {
-    // TODO: ERROR: "Error from i2d_ECPrivateKey(key->ec, &der_end)"
-    return scope.Close(Null());
+  queue_jobs<sign_baton_t, sign_job_t>(baton, 1, SIGN_MIN_JOB_SIZE,
+                                       EIO_Sign, SignCallback);
+
+  return scope.Close(Undefined());
+}
+
+Handle<Value>
+BitcoinKey::SignMany(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: items, callback");
+  }
+  if (!args[0]->IsArray()) {
+    return VException("Argument 'items' must be of type Array");
+  }
+  REQ_FUN_ARG(1, cb);
+
+  Local<Array> items = Local<Array>::Cast(args[0]);
+  int count = items->Length();
+
+  Local<String> privkey_sym = String::NewSymbol("privkey");
+  Local<String> hash_sym = String::NewSymbol("hash");
+
+  sign_baton_t *baton = new sign_baton_t();
+  baton->items = new sign_item_t[count + 1];
+  baton->count = count;
+  baton->many = true;
+
+  const char *error = NULL;
+  for (int i = 0; i < count; i++) {
+    Local<Value> value = items->Get(i);
+    if (!value->IsObject()) {
+      error = "Batch items must be objects with privkey and hash";
+      break;
+    }
+    Local<Object> obj = value->ToObject();
+    Local<Value> priv_buf = obj->Get(privkey_sym);
+    Local<Value> hash_buf = obj->Get(hash_sym);
+
+    if (!Buffer::HasInstance(priv_buf) || !Buffer::HasInstance(hash_buf)) {
+      error = "Batch item properties 'privkey' and 'hash' must be of type Buffer";
+      break;
+    }
+    if (Buffer::Length(priv_buf) != 32) {
+      error = "Batch item 'privkey' must be Buffer of length 32 bytes";
+      break;
+    }
+    if (Buffer::Length(hash_buf) != 32) {
+      error = "Batch item 'hash' must be Buffer of length 32 bytes";
+      break;
+    }
+
+    memcpy(baton->items[i].priv, Buffer::Data(priv_buf), 32);
+    memcpy(baton->items[i].digest, Buffer::Data(hash_buf), 32);
+  }
+
+  if (error != NULL) {
+    OPENSSL_cleanse(baton->items, sizeof(sign_item_t) * count);
+    delete [] baton->items;
+    delete baton;
+    return VException(error);
   }
-  Buffer *der_buf = Buffer::New(der_size);
-  memcpy(Buffer::Data(der_buf), der_begin, der_size);
 
-  free(der_begin);
-  ECDSA_SIG_free(sig);
+  baton->cb = Persistent<Function>::New(cb);
 
-  return scope.Close(der_buf->handle_);
+  queue_jobs<sign_baton_t, sign_job_t>(baton, count, SIGN_MIN_JOB_SIZE,
+                                       EIO_Sign, SignCallback);
+
+  return scope.Close(Undefined());
+}
+
+void
+BitcoinKey::SignCallback(uv_work_t *req, int status)
+{
+  sign_job_t *job = static_cast<sign_job_t *>(req->data);
+  sign_baton_t *baton = job->baton;
+
+  delete job;
+  delete req;
+
+  // Only the last job to finish reports back
+  if (--baton->pending > 0) {
+    return;
+  }
+
+  HandleScope scope;
+
+  Local<Value> argv[2];
+  argv[0] = Local<Value>::New(Null());
+  argv[1] = Local<Value>::New(Null());
+
+  Local<Array> sigs = Array::New(baton->count);
+  for (int i = 0; i < baton->count; i++) {
+    sign_item_t *item = &baton->items[i];
+    if (item->sigLen == 0) {
+      argv[0] = Exception::Error(String::New(
+        baton->many ? "Invalid private key in batch" : "Error signing hash"));
+      break;
+    }
+    Buffer *sig_buf = Buffer::New((const char *) item->sig, item->sigLen);
+    sigs->Set(i, sig_buf->handle_);
+  }
+
+  if (argv[0]->IsNull()) {
+    argv[1] = baton->many ? Local<Value>(sigs) : sigs->Get(0);
+  }
+
+  TryCatch try_catch;
+
+  baton->cb->Call(Context::GetCurrent()->Global(), 2, argv);
+
+  baton->cb.Dispose();
+
+  delete [] baton->items;
+  delete baton;
+
+  if (try_catch.HasCaught()) {
+    FatalException(try_catch);
+  }
+}
+
+Handle<Value>
+BitcoinKey::Generate(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: count, callback");
+  }
+  if (!args[0]->IsUint32()) {
+    return VException("Argument 'count' must be a Number");
+  }
+  REQ_FUN_ARG(1, cb);
+
+  int count = args[0]->Uint32Value();
+
+  generate_baton_t *baton = new generate_baton_t();
+  baton->keys = new EC_KEY*[count + 1];
+  baton->count = count;
+  baton->cb = Persistent<Function>::New(cb);
+
+  queue_jobs<generate_baton_t, generate_job_t>(baton, count, GENERATE_MIN_JOB_SIZE,
+                                               EIO_Generate, GenerateCallback);
+
+  return scope.Close(Undefined());
+}
+
+void
+BitcoinKey::GenerateCallback(uv_work_t *req, int status)
+{
+  generate_job_t *job = static_cast<generate_job_t *>(req->data);
+  generate_baton_t *baton = job->baton;
+
+  delete job;
+  delete req;
+
+  // Only the last job to finish reports back
+  if (--baton->pending > 0) {
+    return;
+  }
+
+  HandleScope scope;
+
+  Local<Value> argv[2];
+  argv[0] = Local<Value>::New(Null());
+  argv[1] = Local<Value>::New(Null());
+
+  // Hand the generated EC_KEYs over to new BitcoinKey objects
+  Local<Array> keys = Array::New(baton->count);
+  for (int i = 0; i < baton->count; i++) {
+    EC_KEY *ec = baton->keys[i];
+    BitcoinKey *key = ec != NULL && argv[0]->IsNull() ? BitcoinKey::New() : NULL;
+    if (key == NULL) {
+      if (argv[0]->IsNull()) {
+        argv[0] = Exception::Error(String::New("Error from EC_KEY_generate_key"));
+      }
+      if (ec != NULL) EC_KEY_free(ec);
+      continue;
+    }
+
+    EC_KEY_free(key->ec);
+    key->ec = ec;
+    key->hasPrivate = true;
+    key->hasPublic = true;
+    keys->Set(i, key->handle_);
+  }
+
+  if (argv[0]->IsNull()) {
+    argv[1] = keys;
+  }
+
+  TryCatch try_catch;
+
+  baton->cb->Call(Context::GetCurrent()->Global(), 2, argv);
+
+  baton->cb.Dispose();
+
+  delete [] baton->keys;
+  delete baton;
+
+  if (try_catch.HasCaught()) {
+    FatalException(try_catch);
+  }
 }
 
 Persistent<FunctionTemplate> BitcoinKey::s_ct;
@@ -17,6 +17,13 @@ private:
   bool hasPrivate;
   bool hasPublic;
 
+  // Serialized public key, as it was set or as i2o_ECPublicKey() gives
+  // it. pubLen is 0 until LoadPublic() fills it in.
+  unsigned char pub[65];
+  int pubLen;
+
+  bool LoadPublic();
+
   void Generate();
 
   struct verify_sig_baton_t {
@@ -24,7 +31,6 @@ private:
     BitcoinKey *key;
     const unsigned char *digest;
     const unsigned char *sig;
-    int digestLen;
     int sigLen;
     Persistent<Object> digestBuf;
     Persistent<Object> sigBuf;
@@ -33,14 +39,105 @@ private:
     // -1 = error, 0 = bad sig, 1 = good
     int result;
     Persistent<Function> cb;
+
+    // When the job was queued, for the statistics
+    uint64_t queued;
   };
 
-  int VerifySignature(const unsigned char *digest, int digest_len,
+  int VerifySignature(const unsigned char *digest,
                       const unsigned char *sig, int sig_len);
 
   static void EIO_VerifySignature(uv_work_t *req);
 
-  ECDSA_SIG *Sign(const unsigned char *digest, int digest_len);
+  struct verify_batch_item_t {
+    // Offsets into the baton's data arena
+    unsigned int pubOffset;
+    unsigned int digestOffset;
+    unsigned int sigOffset;
+    int pubLen;
+    int sigLen;
+  };
+
+  struct verify_batch_baton_t {
+    // Parameters (copied, so no buffers need to be kept alive)
+    verify_batch_item_t *items;
+    unsigned char *data;
+    int count;
+
+    // Number of jobs still running
+    int pending;
+
+    // Whether to call back with a Boolean (verify) instead of a bitmap
+    bool single;
+
+    // Result per item
+    // -1 = error, 0 = bad sig, 1 = good
+    signed char *results;
+    Persistent<Function> cb;
+  };
+
+  struct verify_batch_job_t {
+    verify_batch_baton_t *baton;
+    int begin;
+    int end;
+    uint64_t queued;
+  };
+
+  static void EIO_VerifyBatch(uv_work_t *req);
+
+  static void VerifyCallback(verify_batch_baton_t *baton);
+
+  struct sign_item_t {
+    unsigned char priv[32];
+    unsigned char digest[32];
+
+    // Result, sigLen is 0 if the private key is invalid
+    unsigned char sig[72];
+    int sigLen;
+  };
+
+  struct sign_baton_t {
+    // Parameters (copied, including the private keys)
+    sign_item_t *items;
+    int count;
+
+    // Whether to call back with an Array (signMany) or a single Buffer
+    bool many;
+
+    // Number of jobs still running
+    int pending;
+    Persistent<Function> cb;
+  };
+
+  struct sign_job_t {
+    sign_baton_t *baton;
+    int begin;
+    int end;
+    uint64_t queued;
+  };
+
+  static void EIO_Sign(uv_work_t *req);
+
+  struct generate_baton_t {
+    // Result, NULL where generation failed
+    EC_KEY **keys;
+    int count;
+
+    // Number of jobs still running
+    int pending;
+    Persistent<Function> cb;
+  };
+
+  struct generate_job_t {
+    generate_baton_t *baton;
+    int begin;
+    int end;
+    uint64_t queued;
+  };
+
+  static void EIO_Generate(uv_work_t *req);
+
+  bool GetPrivateBytes(unsigned char *out);
 
 public:
 
@@ -56,6 +153,11 @@ public:
   static Handle<Value> New(const Arguments& args);
   static Handle<Value> GenerateSync(const Arguments& args);
 
+  static Handle<Value> Generate(const Arguments& args);
+
+  static void
+    GenerateCallback(uv_work_t *req, int status);
+
   static Handle<Value>
     GetPrivate(Local<String> property, const AccessorInfo& info);
 
@@ -68,12 +170,21 @@ public:
   static void
     SetPublic(Local<String> property, Local<Value> value, const AccessorInfo& info);
 
+  static Handle<Value>
+    GetPublicInto(const Arguments& args);
+
+  static Handle<Value>
+    GetPrivateInto(const Arguments& args);
+
   static Handle<Value>
     RegenerateSync(const Arguments& args);
 
   static Handle<Value>
     ToDER(const Arguments& args);
 
+  static Handle<Value>
+    ToDERInto(const Arguments& args);
+
   static Handle<Value>
     FromDER(const Arguments& args);
 
@@ -86,8 +197,29 @@ public:
   static Handle<Value>
     VerifySignatureSync(const Arguments& args);
 
+  static Handle<Value>
+    Verify(const Arguments& args);
+
+  static Handle<Value>
+    VerifyBatch(const Arguments& args);
+
+  static void
+    VerifyBatchCallback(uv_work_t *req, int status);
+
   static Handle<Value>
     SignSync(const Arguments& args);
+
+  static Handle<Value>
+    SignInto(const Arguments& args);
+
+  static Handle<Value>
+    Sign(const Arguments& args);
+
+  static Handle<Value>
+    SignMany(const Arguments& args);
+
+  static void
+    SignCallback(uv_work_t *req, int status);
 };
 
 #endif
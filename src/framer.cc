@@ -0,0 +1,383 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <v8.h>
+
+#include <node.h>
+#include <node_buffer.h>
+
+#include "common.h"
+#include "framer.h"
+#include "sha256.h"
+#include "workpool.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+
+// Magic, command and payload length
+#define HEADER_SIZE 20
+#define CHECKSUM_SIZE 4
+
+// Payloads at least this large have their checksum verified off the loop
+#define ASYNC_CHECKSUM_SIZE 65536
+
+Persistent<FunctionTemplate> Framer::s_ct;
+
+void Framer::Init(Handle<Object> target)
+{
+  HandleScope scope;
+  Local<FunctionTemplate> t = FunctionTemplate::New(New);
+
+  s_ct = Persistent<FunctionTemplate>::New(t);
+  s_ct->InstanceTemplate()->SetInternalFieldCount(1);
+  s_ct->SetClassName(String::NewSymbol("Framer"));
+
+  // Accessors
+  s_ct->InstanceTemplate()->SetAccessor(String::New("checksum"),
+                                        GetChecksum, SetChecksum);
+  s_ct->InstanceTemplate()->SetAccessor(String::New("length"), GetLength);
+
+  // Methods
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "push", Push);
+
+  target->Set(String::NewSymbol("Framer"),
+              s_ct->GetFunction());
+}
+
+Framer::Framer(const unsigned char *magic, Handle<Function> cb) :
+  checksum(false),
+  chunks(NULL),
+  chunkCount(0),
+  chunkCapacity(0),
+  offset(0),
+  length(0),
+  busy(false)
+{
+  memcpy(this->magic, magic, 4);
+  this->cb = Persistent<Function>::New(cb);
+}
+
+Framer::~Framer()
+{
+  for (size_t i = 0; i < chunkCount; i++) {
+    chunks[i].buf.Dispose();
+  }
+  free(chunks);
+  cb.Dispose();
+}
+
+unsigned char Framer::ByteAt(size_t pos)
+{
+  pos += offset;
+  size_t i = 0;
+  while (pos >= chunks[i].len) {
+    pos -= chunks[i].len;
+    i++;
+  }
+  return chunks[i].data[pos];
+}
+
+void Framer::CopyOut(unsigned char *out, size_t pos, size_t len)
+{
+  pos += offset;
+  for (size_t i = 0; len > 0; i++) {
+    if (pos >= chunks[i].len) {
+      pos -= chunks[i].len;
+      continue;
+    }
+    size_t n = chunks[i].len - pos;
+    if (n > len) n = len;
+    memcpy(out, chunks[i].data + pos, n);
+    out += n;
+    len -= n;
+    pos = 0;
+  }
+}
+
+void Framer::Skip(size_t len)
+{
+  length -= len;
+  offset += len;
+
+  size_t done = 0;
+  while (done < chunkCount && offset >= chunks[done].len) {
+    offset -= chunks[done].len;
+    chunks[done].buf.Dispose();
+    done++;
+  }
+  if (done) {
+    memmove(chunks, chunks + done, sizeof(chunk_t) * (chunkCount - done));
+    chunkCount -= done;
+  }
+}
+
+/**
+ * Drop everything in front of the next network magic. Returns false if
+ * there is none yet, keeping the bytes that may be the start of one.
+ */
+bool Framer::FindMagic()
+{
+  size_t base = 0;
+
+  for (size_t i = 0; i < chunkCount; i++) {
+    size_t start = i == 0 ? offset : 0;
+    const unsigned char *p = chunks[i].data + start;
+    const unsigned char *end = chunks[i].data + chunks[i].len;
+
+    while (p < end) {
+      const unsigned char *hit = (const unsigned char *) memchr(p, magic[0], end - p);
+      if (hit == NULL) break;
+
+      size_t pos = base + (hit - (chunks[i].data + start));
+      if (pos + 4 > length) {
+        Skip(pos);
+        return false;
+      }
+      if (ByteAt(pos + 1) == magic[1] &&
+          ByteAt(pos + 2) == magic[2] &&
+          ByteAt(pos + 3) == magic[3]) {
+        Skip(pos);
+        return true;
+      }
+      p = hit + 1;
+    }
+
+    base += chunks[i].len - start;
+  }
+
+  if (length > 3) {
+    Skip(length - 3);
+  }
+  return false;
+}
+
+/**
+ * Payload of len bytes at pos. A slice of the chunk if it lies within one,
+ * a copy otherwise.
+ */
+Local<Object> Framer::Extract(size_t pos, size_t len)
+{
+  // Offset of the payload within chunk i
+  size_t start = pos + offset;
+  size_t i = 0;
+  while (i < chunkCount && start >= chunks[i].len) {
+    start -= chunks[i].len;
+    i++;
+  }
+
+  if (len > 0 && start + len <= chunks[i].len) {
+    Local<Object> buf = Local<Object>::New(chunks[i].buf);
+    Local<Function> slice = Local<Function>::Cast(buf->Get(String::NewSymbol("slice")));
+    Local<Value> argv[2] = {
+      Integer::NewFromUnsigned(start),
+      Integer::NewFromUnsigned(start + len)
+    };
+    return slice->Call(buf, 2, argv)->ToObject();
+  }
+
+  Buffer *copy = Buffer::New(len);
+  CopyOut((unsigned char *) Buffer::Data(copy), pos, len);
+  return Local<Object>::New(copy->handle_);
+}
+
+/**
+ * Hand out all complete messages. Returns false if a callback threw.
+ */
+bool Framer::Process()
+{
+  while (!busy) {
+    if (length < HEADER_SIZE || !FindMagic()) {
+      return true;
+    }
+
+    size_t headerSize = HEADER_SIZE + (checksum ? CHECKSUM_SIZE : 0);
+    if (length < headerSize) {
+      return true;
+    }
+
+    unsigned char header[HEADER_SIZE + CHECKSUM_SIZE];
+    CopyOut(header, 0, headerSize);
+
+    size_t payloadLen = (size_t) header[16] | ((size_t) header[17] << 8) |
+                        ((size_t) header[18] << 16) | ((size_t) header[19] << 24);
+    if (length - headerSize < payloadLen) {
+      return true;
+    }
+
+    // Commands are zero padded
+    int commandLen = 12;
+    while (commandLen > 0 && header[4 + commandLen - 1] == 0) {
+      commandLen--;
+    }
+    Local<String> command = String::New((const char *) header + 4, commandLen);
+    Local<Object> payload = Extract(headerSize, payloadLen);
+    Skip(headerSize + payloadLen);
+
+    if (!checksum) {
+      if (!Emit(true, command, payload)) return false;
+      continue;
+    }
+
+    const unsigned char *data = (const unsigned char *) Buffer::Data(payload);
+
+    if (payloadLen >= ASYNC_CHECKSUM_SIZE) {
+      checksum_baton_t *baton = new checksum_baton_t();
+      baton->framer = this;
+      baton->command = Persistent<String>::New(command);
+      baton->payload = Persistent<Object>::New(payload);
+      baton->data = data;
+      baton->len = payloadLen;
+      memcpy(baton->expected, header + HEADER_SIZE, 4);
+
+      uv_work_t *req = new uv_work_t;
+      req->data = baton;
+
+      busy = true;
+      Ref();
+      WorkPool::Queue(req, EIO_Checksum, ChecksumCallback);
+      return true;
+    }
+
+    unsigned char hash[32];
+    Sha256::Double(hash, data, payloadLen);
+    if (!Emit(memcmp(hash, header + HEADER_SIZE, 4) == 0, command, payload)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Framer::Emit(bool ok, Handle<String> command, Handle<Object> payload)
+{
+  HandleScope scope;
+
+  Local<Value> argv[3];
+  argv[0] = ok ? Local<Value>::New(Null()) :
+                 Exception::Error(String::New("Checksum failed"));
+  argv[1] = Local<Value>::New(command);
+  argv[2] = Local<Value>::New(payload);
+
+  Local<Value> result = cb->Call(handle_, 3, argv);
+  return !result.IsEmpty();
+}
+
+void Framer::EIO_Checksum(uv_work_t *req)
+{
+  checksum_baton_t *b = static_cast<checksum_baton_t *>(req->data);
+
+  unsigned char hash[32];
+  Sha256::Double(hash, b->data, b->len);
+  b->ok = memcmp(hash, b->expected, 4) == 0;
+}
+
+void Framer::ChecksumCallback(uv_work_t *req, int status)
+{
+  HandleScope scope;
+  checksum_baton_t *baton = static_cast<checksum_baton_t *>(req->data);
+  Framer *framer = baton->framer;
+
+  framer->busy = false;
+
+  TryCatch try_catch;
+
+  if (framer->Emit(baton->ok, Local<String>::New(baton->command),
+                   Local<Object>::New(baton->payload))) {
+    // Messages that arrived in the meantime
+    framer->Process();
+  }
+
+  baton->command.Dispose();
+  baton->payload.Dispose();
+  delete baton;
+  delete req;
+
+  framer->Unref();
+
+  if (try_catch.HasCaught()) {
+    FatalException(try_catch);
+  }
+}
+
+Handle<Value>
+Framer::New(const Arguments& args)
+{
+  if (!args.IsConstructCall()) {
+    return FromConstructorTemplate(s_ct, args);
+  }
+
+  HandleScope scope;
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: magic, callback");
+  }
+  if (!Buffer::HasInstance(args[0]) || Buffer::Length(args[0]) != 4) {
+    return VException("Argument 'magic' must be a 4 byte Buffer");
+  }
+  REQ_FUN_ARG(1, cb);
+
+  Framer *framer = new Framer((const unsigned char *) Buffer::Data(args[0]), cb);
+  framer->Wrap(args.Holder());
+
+  return scope.Close(args.This());
+}
+
+Handle<Value>
+Framer::Push(const Arguments& args)
+{
+  HandleScope scope;
+  Framer *framer = node::ObjectWrap::Unwrap<Framer>(args.This());
+
+  if (args.Length() != 1 || !Buffer::HasInstance(args[0])) {
+    return VException("One argument expected: chunk Buffer");
+  }
+
+  size_t len = Buffer::Length(args[0]);
+  if (len == 0) {
+    return scope.Close(Undefined());
+  }
+
+  if (framer->chunkCount == framer->chunkCapacity) {
+    framer->chunkCapacity = framer->chunkCapacity ? 2 * framer->chunkCapacity : 8;
+    framer->chunks = (chunk_t *) realloc(framer->chunks,
+                                         sizeof(chunk_t) * framer->chunkCapacity);
+  }
+
+  chunk_t *chunk = &framer->chunks[framer->chunkCount++];
+  chunk->buf = Persistent<Object>::New(args[0]->ToObject());
+  chunk->data = (const unsigned char *) Buffer::Data(args[0]);
+  chunk->len = len;
+  framer->length += len;
+
+  // An exception from the callback is passed on to the caller
+  framer->Process();
+
+  return scope.Close(Undefined());
+}
+
+Handle<Value>
+Framer::GetChecksum(Local<String> property, const AccessorInfo& info)
+{
+  HandleScope scope;
+  Framer *framer = node::ObjectWrap::Unwrap<Framer>(info.Holder());
+
+  return scope.Close(Boolean::New(framer->checksum));
+}
+
+void
+Framer::SetChecksum(Local<String> property, Local<Value> value, const AccessorInfo& info)
+{
+  Framer *framer = node::ObjectWrap::Unwrap<Framer>(info.Holder());
+
+  framer->checksum = value->BooleanValue();
+}
+
+Handle<Value>
+Framer::GetLength(Local<String> property, const AccessorInfo& info)
+{
+  HandleScope scope;
+  Framer *framer = node::ObjectWrap::Unwrap<Framer>(info.Holder());
+
+  return scope.Close(Number::New((double) framer->length));
+}
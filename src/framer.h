@@ -0,0 +1,102 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_FRAMER_H_
+#define BITCOINJS_SERVER_INCLUDE_FRAMER_H_
+
+#include <stddef.h>
+
+#include <v8.h>
+#include <node.h>
+#include <uv.h>
+
+using namespace v8;
+using namespace node;
+
+/**
+ * Splits the byte stream of a peer connection into P2P messages.
+ *
+ * Socket chunks are kept as they are. The network magic is found with
+ * memchr() and a payload that lies within a single chunk is handed out as
+ * a slice of it, only payloads spanning chunks are copied. Checksums of
+ * large payloads are verified on the work pool. Framing pauses until that
+ * is done, so messages are still delivered in order and a callback can
+ * change how the following messages are framed.
+ *
+ * JavaScript API:
+ *
+ *   new Framer(magic, callback)
+ *   framer.push(chunk)
+ *   framer.checksum     Whether headers carry a checksum (read/write,
+ *                       initially false)
+ *   framer.length       Number of bytes buffered
+ *
+ * The callback receives (err, command, payload) for each message. A
+ * checksum mismatch is reported as an error along with the message.
+ */
+class Framer : ObjectWrap
+{
+private:
+
+  struct chunk_t {
+    Persistent<Object> buf;
+    const unsigned char *data;
+    size_t len;
+  };
+
+  struct checksum_baton_t {
+    Framer *framer;
+    Persistent<String> command;
+    Persistent<Object> payload;
+    const unsigned char *data;
+    size_t len;
+    unsigned char expected[4];
+    bool ok;
+  };
+
+  unsigned char magic[4];
+  Persistent<Function> cb;
+  bool checksum;
+
+  // Buffered chunks, the first one starts at offset
+  chunk_t *chunks;
+  size_t chunkCount;
+  size_t chunkCapacity;
+  size_t offset;
+  size_t length;
+
+  // A checksum is being verified on the work pool
+  bool busy;
+
+  Framer(const unsigned char *magic, Handle<Function> cb);
+  ~Framer();
+
+  unsigned char ByteAt(size_t pos);
+  void CopyOut(unsigned char *out, size_t pos, size_t len);
+  void Skip(size_t len);
+  bool FindMagic();
+  Local<Object> Extract(size_t pos, size_t len);
+
+  bool Process();
+  bool Emit(bool ok, Handle<String> command, Handle<Object> payload);
+
+  static void EIO_Checksum(uv_work_t *req);
+  static void ChecksumCallback(uv_work_t *req, int status);
+
+public:
+
+  static Persistent<FunctionTemplate> s_ct;
+
+  static void Init(Handle<Object> target);
+
+  static Handle<Value> New(const Arguments& args);
+  static Handle<Value> Push(const Arguments& args);
+
+  static Handle<Value>
+    GetChecksum(Local<String> property, const AccessorInfo& info);
+
+  static void
+    SetChecksum(Local<String> property, Local<Value> value, const AccessorInfo& info);
+
+  static Handle<Value>
+    GetLength(Local<String> property, const AccessorInfo& info);
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include <string.h>
+
+#include "common.h"
+#include "headers.h"
+#include "sha256.h"
+#include "uint256.h"
+
+// Headers hashed per call to Sha256::DoubleMany()
+static const size_t BATCH_SIZE = 256;
+
+size_t
+Headers::Validate(const unsigned char *headers, size_t count,
+                  unsigned char *hash, uint64_t *chainWork, error_t *error)
+{
+  unsigned char hashes[32 * BATCH_SIZE];
+  const unsigned char *data[BATCH_SIZE];
+  size_t lens[BATCH_SIZE];
+
+  // Target and work of the bits of the previous header
+  bool haveBits = false;
+  uint32_t lastBits = 0;
+  uint64_t target[4], work[4];
+
+  *error = VALID;
+
+  for (size_t start = 0; start < count; start += BATCH_SIZE) {
+    size_t n = count - start < BATCH_SIZE ? count - start : BATCH_SIZE;
+    for (size_t i = 0; i < n; i++) {
+      data[i] = headers + 80 * (start + i);
+      lens[i] = 80;
+    }
+    Sha256::DoubleMany(hashes, data, lens, n);
+
+    for (size_t i = 0; i < n; i++) {
+      const unsigned char *header = data[i];
+
+      if (memcmp(header + 4, hash, 32) != 0) {
+        *error = BAD_PREV_HASH;
+        return start + i;
+      }
+
+      uint32_t bits = ReadLE32(header + 72);
+      if (!haveBits || bits != lastBits) {
+        if (!UInt256::SetCompact(target, bits) || UInt256::IsZero(target)) {
+          *error = BAD_BITS;
+          return start + i;
+        }
+        UInt256::GetWork(work, target);
+        haveBits = true;
+        lastBits = bits;
+      }
+
+      // The hash is a little endian number
+      uint64_t value[4];
+      for (int j = 0; j < 4; j++) {
+        value[j] = ReadLE64(hashes + 32 * i + 8 * j);
+      }
+      if (UInt256::Compare(value, target) > 0) {
+        *error = BAD_POW;
+        return start + i;
+      }
+
+      UInt256::Add(chainWork, chainWork, work);
+      memcpy(hash, hashes + 32 * i, 32);
+    }
+  }
+
+  return count;
+}
+
+const char *
+Headers::GetErrorMessage(error_t error)
+{
+  switch (error) {
+  case VALID:
+    return NULL;
+  case BAD_PREV_HASH:
+    return "Header does not link to the previous one";
+  case BAD_BITS:
+    return "Invalid difficulty bits";
+  case BAD_POW:
+    return "Difficulty target not met";
+  }
+  return "Unknown error";
+}
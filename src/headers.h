@@ -0,0 +1,49 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_HEADERS_H_
+#define BITCOINJS_SERVER_INCLUDE_HEADERS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Context free validation of a run of block headers, for headers-first
+ * sync.
+ *
+ * Checks that every header links to the one before it and meets the
+ * target of its own difficulty bits, and sums up the work. Whether the
+ * bits follow the retargeting rules and the timestamps are sane is left
+ * to the caller, as both need the chain before the first header.
+ *
+ * Headers are hashed in batches by Sha256::DoubleMany(), and the work of
+ * a target is only recomputed when the bits change, which is once per
+ * retarget interval.
+ */
+class Headers
+{
+public:
+
+  enum error_t {
+    VALID,
+    BAD_PREV_HASH,
+    BAD_BITS,
+    BAD_POW
+  };
+
+  /**
+   * Validate count consecutive 80 byte headers.
+   *
+   * hash holds the hash of the block before the first header on entry and
+   * the hash of the last valid header on return. chainWork is a 256 bit
+   * number as four 64 bit words, least significant first; the work of
+   * every valid header is added to it.
+   *
+   * Returns the number of valid headers. If it is less than count, error
+   * says what is wrong with the header at that index.
+   */
+  static size_t Validate(const unsigned char *headers, size_t count,
+                         unsigned char *hash, uint64_t *chainWork,
+                         error_t *error);
+
+  static const char *GetErrorMessage(error_t error);
+};
+
+#endif
@@ -0,0 +1,1333 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <v8.h>
+
+#include <node.h>
+#include <node_buffer.h>
+
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include <openssl/ripemd.h>
+#include <openssl/sha.h>
+
+#include "common.h"
+#include "ecdsa.h"
+#include "interpreter.h"
+#include "sha256.h"
+#include "workpool.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+
+// Inputs smaller than this aren't worth splitting a transaction for
+#define VERIFY_TX_MIN_JOB_SIZE 4
+
+enum {
+  OP_0 = 0x00,
+  OP_PUSHDATA1 = 0x4c,
+  OP_PUSHDATA2 = 0x4d,
+  OP_PUSHDATA4 = 0x4e,
+  OP_1NEGATE = 0x4f,
+  OP_1 = 0x51,
+  OP_16 = 0x60,
+  OP_NOP = 0x61,
+  OP_IF = 0x63,
+  OP_NOTIF = 0x64,
+  OP_ELSE = 0x67,
+  OP_ENDIF = 0x68,
+  OP_VERIFY = 0x69,
+  OP_RETURN = 0x6a,
+  OP_TOALTSTACK = 0x6b,
+  OP_FROMALTSTACK = 0x6c,
+  OP_2DROP = 0x6d,
+  OP_2DUP = 0x6e,
+  OP_3DUP = 0x6f,
+  OP_2OVER = 0x70,
+  OP_2ROT = 0x71,
+  OP_2SWAP = 0x72,
+  OP_IFDUP = 0x73,
+  OP_DEPTH = 0x74,
+  OP_DROP = 0x75,
+  OP_DUP = 0x76,
+  OP_NIP = 0x77,
+  OP_OVER = 0x78,
+  OP_PICK = 0x79,
+  OP_ROLL = 0x7a,
+  OP_ROT = 0x7b,
+  OP_SWAP = 0x7c,
+  OP_TUCK = 0x7d,
+  OP_CAT = 0x7e,
+  OP_SUBSTR = 0x7f,
+  OP_LEFT = 0x80,
+  OP_RIGHT = 0x81,
+  OP_SIZE = 0x82,
+  OP_INVERT = 0x83,
+  OP_AND = 0x84,
+  OP_OR = 0x85,
+  OP_XOR = 0x86,
+  OP_EQUAL = 0x87,
+  OP_EQUALVERIFY = 0x88,
+  OP_1ADD = 0x8b,
+  OP_1SUB = 0x8c,
+  OP_2MUL = 0x8d,
+  OP_2DIV = 0x8e,
+  OP_NEGATE = 0x8f,
+  OP_ABS = 0x90,
+  OP_NOT = 0x91,
+  OP_0NOTEQUAL = 0x92,
+  OP_ADD = 0x93,
+  OP_SUB = 0x94,
+  OP_MUL = 0x95,
+  OP_DIV = 0x96,
+  OP_MOD = 0x97,
+  OP_LSHIFT = 0x98,
+  OP_RSHIFT = 0x99,
+  OP_BOOLAND = 0x9a,
+  OP_BOOLOR = 0x9b,
+  OP_NUMEQUAL = 0x9c,
+  OP_NUMEQUALVERIFY = 0x9d,
+  OP_NUMNOTEQUAL = 0x9e,
+  OP_LESSTHAN = 0x9f,
+  OP_GREATERTHAN = 0xa0,
+  OP_LESSTHANOREQUAL = 0xa1,
+  OP_GREATERTHANOREQUAL = 0xa2,
+  OP_MIN = 0xa3,
+  OP_MAX = 0xa4,
+  OP_WITHIN = 0xa5,
+  OP_RIPEMD160 = 0xa6,
+  OP_SHA1 = 0xa7,
+  OP_SHA256 = 0xa8,
+  OP_HASH160 = 0xa9,
+  OP_HASH256 = 0xaa,
+  OP_CODESEPARATOR = 0xab,
+  OP_CHECKSIG = 0xac,
+  OP_CHECKSIGVERIFY = 0xad,
+  OP_CHECKMULTISIG = 0xae,
+  OP_CHECKMULTISIGVERIFY = 0xaf,
+  OP_NOP1 = 0xb0,
+  OP_NOP10 = 0xb9
+};
+
+static const char *ERR_UNDERRUN = "ScriptInterpreter.stackTop(): Stack underrun";
+
+static const unsigned char EMPTY[1] = { 0 };
+static const unsigned char TRUE_VALUE[1] = { 1 };
+static const unsigned char FALSE_VALUE[1] = { 0 };
+
+// Encodings of OP_1NEGATE to OP_16, the entry for OP_RESERVED is unused
+static const unsigned char SMALL_INTS[18] = {
+  0x81, 0x00, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16
+};
+
+static bool
+is_disabled (int op)
+{
+  switch (op) {
+  case OP_CAT: case OP_SUBSTR: case OP_LEFT: case OP_RIGHT:
+  case OP_INVERT: case OP_AND: case OP_OR: case OP_XOR:
+  case OP_2MUL: case OP_2DIV: case OP_MUL: case OP_DIV: case OP_MOD:
+  case OP_LSHIFT: case OP_RSHIFT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool
+cast_bool (const Interpreter::item_t *item)
+{
+  for (size_t i = 0; i < item->len; i++) {
+    if (item->data[i] != 0) {
+      // Negative zero is still zero
+      if (i == item->len - 1 && item->data[i] == 0x80) {
+        return false;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Arithmetic operands must be at most four bytes, sign and magnitude,
+ * little endian.
+ */
+static bool
+cast_num (const Interpreter::item_t *item, int64_t *value)
+{
+  if (item->len > 4) return false;
+
+  uint64_t v = 0;
+  for (size_t i = 0; i < item->len; i++) {
+    v |= (uint64_t) item->data[i] << (8 * i);
+  }
+  if (item->len && (item->data[item->len - 1] & 0x80)) {
+    v &= ~((uint64_t) 0x80 << (8 * (item->len - 1)));
+    *value = -(int64_t) v;
+  } else {
+    *value = (int64_t) v;
+  }
+  return true;
+}
+
+static bool
+items_equal (const Interpreter::item_t *a, const Interpreter::item_t *b)
+{
+  return a->len == b->len && !memcmp(a->data, b->data, a->len);
+}
+
+Interpreter::Interpreter() :
+  lastError(NULL),
+  stackSize(0),
+  sighash(NULL),
+  sighashCtx(NULL),
+  altStackSize(0),
+  chunkCount(0),
+  codeLen(0),
+  arenaUsed(0)
+{
+  // Growth per opcode is at most three items before the size check
+  stack = new item_t[MAX_STACK_SIZE + 4];
+  altStack = new item_t[MAX_STACK_SIZE + 4];
+  chunks = new chunk_t[MAX_SCRIPT_SIZE];
+  code = new int[MAX_SCRIPT_SIZE];
+  codeBuf = new unsigned char[MAX_SCRIPT_SIZE];
+  arena = new unsigned char[ARENA_SIZE];
+
+#ifdef USE_SECP256K1
+  ec = NULL;
+#else
+  ec = EC_KEY_new_by_curve_name(NID_secp256k1);
+#endif
+}
+
+Interpreter::~Interpreter()
+{
+  delete [] stack;
+  delete [] altStack;
+  delete [] chunks;
+  delete [] code;
+  delete [] codeBuf;
+  delete [] arena;
+
+  if (ec != NULL)
+    EC_KEY_free(ec);
+}
+
+void Interpreter::SetSigHash(sighash_fn fn, void *ctx)
+{
+  sighash = fn;
+  sighashCtx = ctx;
+}
+
+void Interpreter::Reset()
+{
+  lastError = NULL;
+  stackSize = 0;
+  altStackSize = 0;
+  arenaUsed = 0;
+}
+
+bool Interpreter::Fail(const char *error)
+{
+  lastError = error;
+  return false;
+}
+
+/**
+ * Split a script into chunks like Script.parse(). Pushes become data
+ * chunks, even empty ones, all other opcodes (including OP_0) stay
+ * opcodes.
+ */
+bool Interpreter::Parse(const unsigned char *script, size_t len)
+{
+  chunkCount = 0;
+
+  size_t pos = 0;
+  while (pos < len) {
+    chunk_t *chunk = &chunks[chunkCount++];
+    int op = script[pos++];
+
+    size_t dataLen;
+    if (op > OP_0 && op < OP_PUSHDATA1) {
+      dataLen = op;
+    } else if (op == OP_PUSHDATA1) {
+      if (len - pos < 1) return false;
+      dataLen = script[pos];
+      pos += 1;
+    } else if (op == OP_PUSHDATA2) {
+      if (len - pos < 2) return false;
+      dataLen = script[pos] | (script[pos + 1] << 8);
+      pos += 2;
+    } else if (op == OP_PUSHDATA4) {
+      if (len - pos < 4) return false;
+      dataLen = script[pos] | (script[pos + 1] << 8) |
+                (script[pos + 2] << 16) | ((size_t) script[pos + 3] << 24);
+      pos += 4;
+    } else {
+      chunk->op = op;
+      continue;
+    }
+
+    if (len - pos < dataLen) return false;
+    chunk->op = PUSH;
+    chunk->data = dataLen ? script + pos : EMPTY;
+    chunk->len = dataLen;
+    pos += dataLen;
+  }
+  return true;
+}
+
+unsigned char *Interpreter::Alloc(size_t len)
+{
+  if (ARENA_SIZE - arenaUsed < len) return NULL;
+
+  unsigned char *p = arena + arenaUsed;
+  arenaUsed += len;
+  return p;
+}
+
+bool Interpreter::Push(const unsigned char *data, size_t len)
+{
+  item_t *item = &stack[stackSize++];
+  item->data = len ? data : EMPTY;
+  item->len = len;
+  return true;
+}
+
+/**
+ * Push a number with the shortest encoding, like bigintToBuffer().
+ */
+bool Interpreter::PushNum(int64_t value)
+{
+  if (value == 0) {
+    return Push(EMPTY, 0);
+  }
+
+  unsigned char buf[9];
+  size_t n = 0;
+  uint64_t abs = value < 0 ? -(uint64_t) value : (uint64_t) value;
+  while (abs) {
+    buf[n++] = abs & 0xff;
+    abs >>= 8;
+  }
+  if (buf[n - 1] & 0x80) {
+    buf[n++] = value < 0 ? 0x80 : 0x00;
+  } else if (value < 0) {
+    buf[n - 1] |= 0x80;
+  }
+
+  unsigned char *data = Alloc(n);
+  if (data == NULL) {
+    return Fail("Script arena exhausted");
+  }
+  memcpy(data, buf, n);
+  return Push(data, n);
+}
+
+bool Interpreter::Pop(item_t *item)
+{
+  if (stackSize < 1) {
+    return Fail(ERR_UNDERRUN);
+  }
+  *item = stack[--stackSize];
+  return true;
+}
+
+/**
+ * Start the script code with the chunks since the last OP_CODESEPARATOR.
+ */
+void Interpreter::SetCode(int hashStart)
+{
+  codeLen = 0;
+  for (int i = hashStart; i < chunkCount; i++) {
+    code[codeLen++] = i;
+  }
+}
+
+/**
+ * Script.findAndDelete() for a data chunk (data != NULL) or an opcode.
+ * Like the original it doesn't look at the chunk following a match.
+ */
+void Interpreter::DeleteFromCode(const item_t *data, int op)
+{
+  int l = codeLen;
+  for (int i = 0; i < l; i++) {
+    if (i >= codeLen) break;
+
+    const chunk_t *chunk = &chunks[code[i]];
+    bool match;
+    if (data != NULL) {
+      match = chunk->op == PUSH && chunk->len == data->len &&
+              !memcmp(chunk->data, data->data, data->len);
+    } else {
+      match = chunk->op == op;
+    }
+
+    if (match) {
+      memmove(code + i, code + i + 1, sizeof(int) * (codeLen - i - 1));
+      codeLen--;
+    }
+  }
+}
+
+/**
+ * ScriptInterpreter.checkSig(), including the removal of
+ * OP_CODESEPARATORs from the script code by hashForSignature().
+ */
+bool Interpreter::CheckSig(const item_t *sig, const item_t *pub, uint32_t hashType)
+{
+  if (!sig->len) {
+    return false;
+  }
+
+  uint32_t sigHashType = sig->data[sig->len - 1];
+  if (hashType == 0) {
+    hashType = sigHashType;
+  } else if (hashType != sigHashType) {
+    return false;
+  }
+
+  if (sighash == NULL) {
+    return false;
+  }
+
+  DeleteFromCode(NULL, OP_CODESEPARATOR);
+
+  // Serialize like Script.chunksToBuffer(), with the shortest pushes
+  size_t len = 0;
+  for (int i = 0; i < codeLen; i++) {
+    const chunk_t *chunk = &chunks[code[i]];
+    if (chunk->op != PUSH) {
+      codeBuf[len++] = chunk->op;
+      continue;
+    }
+    if (chunk->len < OP_PUSHDATA1) {
+      codeBuf[len++] = chunk->len;
+    } else if (chunk->len <= 0xff) {
+      codeBuf[len++] = OP_PUSHDATA1;
+      codeBuf[len++] = chunk->len;
+    } else {
+      codeBuf[len++] = OP_PUSHDATA2;
+      codeBuf[len++] = chunk->len & 0xff;
+      codeBuf[len++] = chunk->len >> 8;
+    }
+    memcpy(codeBuf + len, chunk->data, chunk->len);
+    len += chunk->len;
+  }
+
+  unsigned char digest[32];
+  if (!sighash(sighashCtx, digest, codeBuf, len, hashType)) {
+    return false;
+  }
+
+  return Ecdsa::Verify(ec, pub->data, pub->len, digest,
+                               sig->data, sig->len - 1) == 1;
+}
+
+bool Interpreter::Eval(const unsigned char *script, size_t len, uint32_t hashType)
+{
+  if (len > MAX_SCRIPT_SIZE) {
+    return Fail("Oversized script (> 10k bytes)");
+  }
+  if (!Parse(script, len)) {
+    return Fail("Script data is truncated");
+  }
+
+  // Each script starts with an empty alt stack
+  altStackSize = 0;
+
+  // Branch conditions of the enclosing IFs, and how many are false
+  bool execStack[MAX_EXEC_DEPTH];
+  int execDepth = 0;
+  int execFalse = 0;
+
+  int hashStart = 0;
+  int opCount = 0;
+
+  for (int pc = 0; pc < chunkCount;) {
+    const chunk_t *chunk = &chunks[pc++];
+    int op = chunk->op;
+    bool exec = execFalse == 0;
+
+    if (op == PUSH && chunk->len > MAX_PUSH_SIZE) {
+      return Fail("Max push value size exceeded (>520)");
+    }
+    if (op > OP_16 && ++opCount > MAX_OPS) {
+      return Fail("Opcode limit exceeded (>200)");
+    }
+    if (is_disabled(op)) {
+      return Fail("Encountered a disabled opcode");
+    }
+
+    if (op == PUSH) {
+      if (exec) {
+        Push(chunk->data, chunk->len);
+      }
+    } else if (exec || (OP_IF <= op && op <= OP_ENDIF)) {
+      item_t a, b;
+      int64_t n1, n2, n3;
+
+      switch (op) {
+      case OP_0:
+        Push(EMPTY, 0);
+        break;
+
+      case OP_1NEGATE:
+      case OP_1: case OP_1 + 1: case OP_1 + 2: case OP_1 + 3:
+      case OP_1 + 4: case OP_1 + 5: case OP_1 + 6: case OP_1 + 7:
+      case OP_1 + 8: case OP_1 + 9: case OP_1 + 10: case OP_1 + 11:
+      case OP_1 + 12: case OP_1 + 13: case OP_1 + 14: case OP_16:
+        Push(SMALL_INTS + (op - OP_1NEGATE), 1);
+        break;
+
+      case OP_NOP:
+        break;
+
+      case OP_IF:
+      case OP_NOTIF: {
+        // <expression> if [statements] [else [statements]] endif
+        bool value = false;
+        if (exec) {
+          if (!Pop(&a)) return false;
+          value = cast_bool(&a);
+          if (op == OP_NOTIF) {
+            value = !value;
+          }
+        }
+        execStack[execDepth++] = value;
+        if (!value) execFalse++;
+        break;
+      }
+
+      case OP_ELSE:
+        if (execDepth < 1) {
+          return Fail("Unmatched OP_ELSE");
+        }
+        execFalse += execStack[execDepth - 1] ? 1 : -1;
+        execStack[execDepth - 1] = !execStack[execDepth - 1];
+        break;
+
+      case OP_ENDIF:
+        if (execDepth < 1) {
+          return Fail("Unmatched OP_ENDIF");
+        }
+        if (!execStack[--execDepth]) execFalse--;
+        break;
+
+      case OP_VERIFY:
+        if (stackSize < 1) return Fail(ERR_UNDERRUN);
+        if (!cast_bool(&stack[stackSize - 1])) {
+          return Fail("OP_VERIFY negative");
+        }
+        stackSize--;
+        break;
+
+      case OP_RETURN:
+        return Fail("OP_RETURN");
+
+      case OP_TOALTSTACK:
+        if (!Pop(&a)) return false;
+        altStack[altStackSize++] = a;
+        break;
+
+      case OP_FROMALTSTACK:
+        if (altStackSize < 1) {
+          return Fail("OP_FROMALTSTACK with alt stack empty");
+        }
+        stack[stackSize++] = altStack[--altStackSize];
+        break;
+
+      case OP_2DROP:
+        // (x1 x2 -- )
+        if (stackSize < 2) return Fail(ERR_UNDERRUN);
+        stackSize -= 2;
+        break;
+
+      case OP_2DUP:
+        // (x1 x2 -- x1 x2 x1 x2)
+        if (stackSize < 2) return Fail(ERR_UNDERRUN);
+        stack[stackSize] = stack[stackSize - 2];
+        stack[stackSize + 1] = stack[stackSize - 1];
+        stackSize += 2;
+        break;
+
+      case OP_3DUP:
+        // (x1 x2 x3 -- x1 x2 x3 x1 x2 x3)
+        if (stackSize < 3) return Fail(ERR_UNDERRUN);
+        stack[stackSize] = stack[stackSize - 3];
+        stack[stackSize + 1] = stack[stackSize - 2];
+        stack[stackSize + 2] = stack[stackSize - 1];
+        stackSize += 3;
+        break;
+
+      case OP_2OVER:
+        // (x1 x2 x3 x4 -- x1 x2 x3 x4 x1 x2)
+        if (stackSize < 4) return Fail(ERR_UNDERRUN);
+        stack[stackSize] = stack[stackSize - 4];
+        stack[stackSize + 1] = stack[stackSize - 3];
+        stackSize += 2;
+        break;
+
+      case OP_2ROT:
+        // (x1 x2 x3 x4 x5 x6 -- x3 x4 x5 x6 x1 x2)
+        if (stackSize < 6) return Fail(ERR_UNDERRUN);
+        a = stack[stackSize - 6];
+        b = stack[stackSize - 5];
+        memmove(stack + stackSize - 6, stack + stackSize - 4, 4 * sizeof(item_t));
+        stack[stackSize - 2] = a;
+        stack[stackSize - 1] = b;
+        break;
+
+      case OP_2SWAP:
+        // (x1 x2 x3 x4 -- x3 x4 x1 x2)
+        if (stackSize < 4) return Fail(ERR_UNDERRUN);
+        a = stack[stackSize - 4];
+        b = stack[stackSize - 3];
+        stack[stackSize - 4] = stack[stackSize - 2];
+        stack[stackSize - 3] = stack[stackSize - 1];
+        stack[stackSize - 2] = a;
+        stack[stackSize - 1] = b;
+        break;
+
+      case OP_IFDUP:
+        // (x - 0 | x x)
+        if (stackSize < 1) return Fail(ERR_UNDERRUN);
+        if (cast_bool(&stack[stackSize - 1])) {
+          stack[stackSize] = stack[stackSize - 1];
+          stackSize++;
+        }
+        break;
+
+      case OP_DEPTH:
+        // -- stacksize
+        if (!PushNum(stackSize)) return false;
+        break;
+
+      case OP_DROP:
+        // (x -- )
+        if (!Pop(&a)) return false;
+        break;
+
+      case OP_DUP:
+        // (x -- x x)
+        if (stackSize < 1) return Fail(ERR_UNDERRUN);
+        stack[stackSize] = stack[stackSize - 1];
+        stackSize++;
+        break;
+
+      case OP_NIP:
+        // (x1 x2 -- x2)
+        if (stackSize < 2) {
+          return Fail("OP_NIP insufficient stack size");
+        }
+        stack[stackSize - 2] = stack[stackSize - 1];
+        stackSize--;
+        break;
+
+      case OP_OVER:
+        // (x1 x2 -- x1 x2 x1)
+        if (stackSize < 2) return Fail(ERR_UNDERRUN);
+        stack[stackSize] = stack[stackSize - 2];
+        stackSize++;
+        break;
+
+      case OP_PICK:
+      case OP_ROLL:
+        // (xn ... x2 x1 x0 n - xn ... x2 x1 x0 xn)
+        // (xn ... x2 x1 x0 n - ... x2 x1 x0 xn)
+        if (!Pop(&a)) return false;
+        if (!cast_num(&a, &n1)) {
+          return Fail("Bigint cast overflow (> 4 bytes)");
+        }
+        if (n1 < 0 || n1 >= stackSize) {
+          return Fail("OP_PICK/OP_ROLL insufficient stack size");
+        }
+        b = stack[stackSize - n1 - 1];
+        if (op == OP_ROLL) {
+          memmove(stack + stackSize - n1 - 1, stack + stackSize - n1,
+                  n1 * sizeof(item_t));
+          stackSize--;
+        }
+        stack[stackSize++] = b;
+        break;
+
+      case OP_ROT:
+        // (x1 x2 x3 -- x2 x3 x1)
+        if (stackSize < 3) return Fail(ERR_UNDERRUN);
+        a = stack[stackSize - 3];
+        stack[stackSize - 3] = stack[stackSize - 2];
+        stack[stackSize - 2] = stack[stackSize - 1];
+        stack[stackSize - 1] = a;
+        break;
+
+      case OP_SWAP:
+        // (x1 x2 -- x2 x1)
+        if (stackSize < 2) return Fail(ERR_UNDERRUN);
+        a = stack[stackSize - 2];
+        stack[stackSize - 2] = stack[stackSize - 1];
+        stack[stackSize - 1] = a;
+        break;
+
+      case OP_TUCK:
+        // (x1 x2 -- x2 x1 x2)
+        if (stackSize < 2) {
+          return Fail("OP_TUCK insufficient stack size");
+        }
+        a = stack[stackSize - 1];
+        stack[stackSize] = a;
+        stack[stackSize - 1] = stack[stackSize - 2];
+        stack[stackSize - 2] = a;
+        stackSize++;
+        break;
+
+      case OP_SIZE:
+        // (in -- in size)
+        if (stackSize < 1) return Fail(ERR_UNDERRUN);
+        if (!PushNum(stack[stackSize - 1].len)) return false;
+        break;
+
+      case OP_EQUAL:
+      case OP_EQUALVERIFY: {
+        // (x1 x2 - bool)
+        if (stackSize < 2) return Fail(ERR_UNDERRUN);
+        bool value = items_equal(&stack[stackSize - 2], &stack[stackSize - 1]);
+        stackSize -= 2;
+        if (op == OP_EQUALVERIFY) {
+          if (!value) {
+            return Fail("OP_EQUALVERIFY negative");
+          }
+        } else {
+          Push(value ? TRUE_VALUE : FALSE_VALUE, 1);
+        }
+        break;
+      }
+
+      case OP_1ADD:
+      case OP_1SUB:
+      case OP_NEGATE:
+      case OP_ABS:
+      case OP_NOT:
+      case OP_0NOTEQUAL:
+        // (in -- out)
+        if (!Pop(&a)) return false;
+        if (!cast_num(&a, &n1)) {
+          return Fail("Bigint cast overflow (> 4 bytes)");
+        }
+        switch (op) {
+        case OP_1ADD:      n1 += 1; break;
+        case OP_1SUB:      n1 -= 1; break;
+        case OP_NEGATE:    n1 = -n1; break;
+        case OP_ABS:       if (n1 < 0) n1 = -n1; break;
+        case OP_NOT:       n1 = n1 == 0; break;
+        case OP_0NOTEQUAL: n1 = n1 != 0; break;
+        }
+        if (!PushNum(n1)) return false;
+        break;
+
+      case OP_ADD:
+      case OP_SUB:
+      case OP_BOOLAND:
+      case OP_BOOLOR:
+      case OP_NUMEQUAL:
+      case OP_NUMEQUALVERIFY:
+      case OP_NUMNOTEQUAL:
+      case OP_LESSTHAN:
+      case OP_GREATERTHAN:
+      case OP_LESSTHANOREQUAL:
+      case OP_GREATERTHANOREQUAL:
+      case OP_MIN:
+      case OP_MAX:
+        // (x1 x2 -- out)
+        if (stackSize < 2) return Fail(ERR_UNDERRUN);
+        if (!cast_num(&stack[stackSize - 2], &n1) ||
+            !cast_num(&stack[stackSize - 1], &n2)) {
+          return Fail("Bigint cast overflow (> 4 bytes)");
+        }
+        switch (op) {
+        case OP_ADD:                n3 = n1 + n2; break;
+        case OP_SUB:                n3 = n1 - n2; break;
+        case OP_BOOLAND:            n3 = n1 != 0 && n2 != 0; break;
+        case OP_BOOLOR:             n3 = n1 != 0 || n2 != 0; break;
+        case OP_NUMEQUAL:
+        case OP_NUMEQUALVERIFY:     n3 = n1 == n2; break;
+        case OP_NUMNOTEQUAL:        n3 = n1 != n2; break;
+        case OP_LESSTHAN:           n3 = n1 < n2; break;
+        case OP_GREATERTHAN:        n3 = n1 > n2; break;
+        case OP_LESSTHANOREQUAL:    n3 = n1 <= n2; break;
+        case OP_GREATERTHANOREQUAL: n3 = n1 >= n2; break;
+        case OP_MIN:                n3 = n1 < n2 ? n1 : n2; break;
+        default:                    n3 = n1 > n2 ? n1 : n2; break;
+        }
+        stackSize -= 2;
+        if (!PushNum(n3)) return false;
+
+        if (op == OP_NUMEQUALVERIFY) {
+          if (!n3) {
+            return Fail("OP_NUMEQUALVERIFY negative");
+          }
+          stackSize--;
+        }
+        break;
+
+      case OP_WITHIN:
+        // (x min max -- out)
+        if (stackSize < 3) return Fail(ERR_UNDERRUN);
+        if (!cast_num(&stack[stackSize - 3], &n1) ||
+            !cast_num(&stack[stackSize - 2], &n2) ||
+            !cast_num(&stack[stackSize - 1], &n3)) {
+          return Fail("Bigint cast overflow (> 4 bytes)");
+        }
+        stackSize -= 3;
+        if (!PushNum(n1 >= n2 && n1 < n3)) return false;
+        break;
+
+      case OP_RIPEMD160:
+      case OP_SHA1:
+      case OP_SHA256:
+      case OP_HASH160:
+      case OP_HASH256: {
+        // (in -- hash)
+        if (!Pop(&a)) return false;
+        size_t hashLen = (op == OP_SHA256 || op == OP_HASH256) ? 32 : 20;
+        unsigned char *hash = Alloc(hashLen);
+        if (hash == NULL) {
+          return Fail("Script arena exhausted");
+        }
+        unsigned char digest[32];
+        switch (op) {
+        case OP_RIPEMD160:
+          RIPEMD160(a.data, a.len, hash);
+          break;
+        case OP_SHA1:
+          SHA1(a.data, a.len, hash);
+          break;
+        case OP_SHA256:
+          Sha256::Single(hash, a.data, a.len);
+          break;
+        case OP_HASH160:
+          Sha256::Single(digest, a.data, a.len);
+          RIPEMD160(digest, 32, hash);
+          break;
+        case OP_HASH256:
+          Sha256::Double(hash, a.data, a.len);
+          break;
+        }
+        Push(hash, hashLen);
+        break;
+      }
+
+      case OP_CODESEPARATOR:
+        // Hash starts after the code separator
+        hashStart = pc;
+        break;
+
+      case OP_CHECKSIG:
+      case OP_CHECKSIGVERIFY: {
+        // (sig pubkey -- bool)
+        if (stackSize < 2) return Fail(ERR_UNDERRUN);
+        a = stack[stackSize - 2];
+        b = stack[stackSize - 1];
+
+        // A signature can't sign itself
+        SetCode(hashStart);
+        DeleteFromCode(&a, 0);
+
+        bool success = CheckSig(&a, &b, hashType);
+
+        stackSize -= 2;
+        Push(success ? TRUE_VALUE : FALSE_VALUE, 1);
+        if (op == OP_CHECKSIGVERIFY) {
+          if (!success) {
+            return Fail("OP_CHECKSIGVERIFY negative");
+          }
+          stackSize--;
+        }
+        break;
+      }
+
+      case OP_CHECKMULTISIG:
+      case OP_CHECKMULTISIGVERIFY: {
+        // ([sig ...] num_of_signatures [pubkey ...] num_of_pubkeys -- bool)
+        item_t keys[MAX_MULTISIG_KEYS];
+        item_t sigs[MAX_MULTISIG_KEYS];
+
+        if (!Pop(&a)) return false;
+        if (!cast_num(&a, &n1)) {
+          return Fail("Bigint cast overflow (> 4 bytes)");
+        }
+        if (n1 < 0 || n1 > MAX_MULTISIG_KEYS) {
+          return Fail("OP_CHECKMULTISIG keysCount out of bounds");
+        }
+        int keysCount = n1;
+        opCount += keysCount;
+        if (opCount > MAX_OPS) {
+          return Fail("Opcode limit exceeded (>200)");
+        }
+        for (int i = 0; i < keysCount; i++) {
+          if (!Pop(&keys[i])) return false;
+        }
+
+        if (!Pop(&a)) return false;
+        if (!cast_num(&a, &n2)) {
+          return Fail("Bigint cast overflow (> 4 bytes)");
+        }
+        if (n2 < 0 || n2 > keysCount) {
+          return Fail("OP_CHECKMULTISIG sigsCount out of bounds");
+        }
+        int sigsCount = n2;
+        for (int i = 0; i < sigsCount; i++) {
+          if (!Pop(&sigs[i])) return false;
+        }
+
+        // The original client pops an extra element off the stack, which
+        // can't be fixed without a chain split
+        if (!Pop(&a)) return false;
+
+        // Drop the signatures, since a signature can't sign itself
+        SetCode(hashStart);
+        for (int i = 0; i < sigsCount; i++) {
+          DeleteFromCode(&sigs[i], 0);
+        }
+
+        bool success = true;
+        int isig = 0, ikey = 0;
+        while (success && sigsCount > 0) {
+          if (CheckSig(&sigs[isig], &keys[ikey], hashType)) {
+            isig++;
+            sigsCount--;
+          } else {
+            ikey++;
+            keysCount--;
+
+            // If there are more signatures than keys left, then too many
+            // signatures have failed
+            if (sigsCount > keysCount) {
+              success = false;
+            }
+          }
+        }
+
+        Push(success ? TRUE_VALUE : FALSE_VALUE, 1);
+        if (op == OP_CHECKMULTISIGVERIFY) {
+          if (!success) {
+            return Fail("OP_CHECKMULTISIGVERIFY negative");
+          }
+          stackSize--;
+        }
+        break;
+      }
+
+      default:
+        if (op >= OP_NOP1 && op <= OP_NOP10) {
+          break;
+        }
+        return Fail("Unknown opcode encountered");
+      }
+    }
+
+    // Size limits
+    if (stackSize + altStackSize > MAX_STACK_SIZE) {
+      return Fail("Maximum stack size exceeded");
+    }
+  }
+
+  // Execution stack must be empty at the end of the script
+  if (execDepth) {
+    return Fail("Execution stack ended non-empty");
+  }
+
+  return true;
+}
+
+bool Interpreter::Verify(const unsigned char *scriptSig, size_t scriptSigLen,
+                         const unsigned char *scriptPubKey, size_t scriptPubKeyLen,
+                         uint32_t hashType, bool *result)
+{
+  Reset();
+
+  if (!Eval(scriptSig, scriptSigLen, hashType) ||
+      !Eval(scriptPubKey, scriptPubKeyLen, hashType)) {
+    return false;
+  }
+
+  if (stackSize == 0) {
+    return Fail("Empty stack after script evaluation");
+  }
+
+  *result = cast_bool(&stack[stackSize - 1]);
+  return true;
+}
+
+/**
+ * Signature hashes for one input of a parsed transaction. Multisig checks
+ * hash the same script code for every key, so the last digest is kept.
+ */
+struct tx_sighash_t {
+  const SigHash::tx_t *tx;
+  size_t inIndex;
+
+  bool cached;
+  uint32_t hashType;
+  size_t scriptLen;
+  unsigned char script[Interpreter::MAX_SCRIPT_SIZE];
+  unsigned char digest[32];
+};
+
+static void
+tx_sighash_init (tx_sighash_t *ctx, const SigHash::tx_t *tx, size_t inIndex)
+{
+  ctx->tx = tx;
+  ctx->inIndex = inIndex;
+  ctx->cached = false;
+}
+
+static bool
+tx_sighash (void *arg, unsigned char *out,
+            const unsigned char *scriptCode, size_t len, uint32_t hashType)
+{
+  tx_sighash_t *ctx = static_cast<tx_sighash_t *>(arg);
+
+  if (ctx->inIndex >= ctx->tx->inCount) {
+    return false;
+  }
+
+  if (ctx->cached && ctx->hashType == hashType && ctx->scriptLen == len &&
+      !memcmp(ctx->script, scriptCode, len)) {
+    memcpy(out, ctx->digest, 32);
+    return true;
+  }
+
+  if (!SigHash::Hash(out, ctx->tx, ctx->inIndex, scriptCode, len, hashType)) {
+    return false;
+  }
+
+  ctx->cached = true;
+  ctx->hashType = hashType;
+  ctx->scriptLen = len;
+  memcpy(ctx->script, scriptCode, len);
+  memcpy(ctx->digest, out, 32);
+  return true;
+}
+
+void Interpreter::Init(Handle<Object> target)
+{
+  HandleScope scope;
+
+  target->Set(String::New("verify_script"), FunctionTemplate::New(VerifyScript)->GetFunction());
+  target->Set(String::New("verify_transaction"), FunctionTemplate::New(VerifyTransaction)->GetFunction());
+}
+
+void Interpreter::EIO_VerifyScript(uv_work_t *req)
+{
+  verify_script_baton_t *b = static_cast<verify_script_baton_t *>(req->data);
+
+  tx_sighash_t *ctx = new tx_sighash_t;
+  tx_sighash_init(ctx, &b->parsed, b->inIndex);
+
+  Interpreter *interp = new Interpreter();
+  interp->SetSigHash(tx_sighash, ctx);
+
+  if (interp->Verify(b->scriptSig, b->scriptSigLen,
+                     b->scriptPubKey, b->scriptPubKeyLen,
+                     b->hashType, &b->result)) {
+    // Copy the final stack, the arena goes away with the interpreter
+    size_t dataLen = 0;
+    for (int i = 0; i < interp->stackSize; i++) {
+      dataLen += interp->stack[i].len;
+    }
+    b->stackSize = interp->stackSize;
+    b->stack = new item_t[b->stackSize + 1];
+    b->stackData = new unsigned char[dataLen + 1];
+
+    size_t pos = 0;
+    for (int i = 0; i < interp->stackSize; i++) {
+      memcpy(b->stackData + pos, interp->stack[i].data, interp->stack[i].len);
+      b->stack[i].data = b->stackData + pos;
+      b->stack[i].len = interp->stack[i].len;
+      pos += interp->stack[i].len;
+    }
+  } else {
+    b->error = interp->lastError;
+  }
+
+  delete interp;
+  delete ctx;
+}
+
+void Interpreter::VerifyScriptCallback(uv_work_t *req, int status)
+{
+  HandleScope scope;
+  verify_script_baton_t *baton = static_cast<verify_script_baton_t *>(req->data);
+
+  Local<Value> argv[3];
+
+  if (baton->error) {
+    argv[0] = Exception::Error(String::New(baton->error));
+    argv[1] = Local<Value>::New(Null());
+    argv[2] = Local<Value>::New(Null());
+  } else {
+    Local<Array> stack = Array::New(baton->stackSize);
+    for (int i = 0; i < baton->stackSize; i++) {
+      Buffer *item_buf = Buffer::New((const char *) baton->stack[i].data,
+                                     baton->stack[i].len);
+      stack->Set(i, item_buf->handle_);
+    }
+
+    argv[0] = Local<Value>::New(Null());
+    argv[1] = Local<Value>::New(Boolean::New(baton->result));
+    argv[2] = stack;
+  }
+
+  TryCatch try_catch;
+
+  baton->cb->Call(Context::GetCurrent()->Global(), 3, argv);
+
+  baton->cb.Dispose();
+  SigHash::Free(&baton->parsed);
+  delete [] baton->tx;
+  delete [] baton->scriptSig;
+  delete [] baton->scriptPubKey;
+  delete [] baton->stack;
+  delete [] baton->stackData;
+  delete baton;
+  delete req;
+
+  if (try_catch.HasCaught()) {
+    FatalException(try_catch);
+  }
+}
+
+static unsigned char *
+copy_buffer (Handle<Value> buf, size_t *len)
+{
+  *len = Buffer::Length(buf);
+  unsigned char *copy = new unsigned char[*len + 1];
+  memcpy(copy, Buffer::Data(buf), *len);
+  return copy;
+}
+
+Handle<Value> Interpreter::VerifyScript(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 6) {
+    return VException("Six arguments expected: tx, inIndex, scriptSig, scriptPubKey, hashType, callback");
+  }
+  if (!Buffer::HasInstance(args[0])) {
+    return VException("Argument 'tx' must be of type Buffer");
+  }
+  if (!args[1]->IsUint32()) {
+    return VException("Argument 'inIndex' must be a Number");
+  }
+  if (!Buffer::HasInstance(args[2])) {
+    return VException("Argument 'scriptSig' must be of type Buffer");
+  }
+  if (!Buffer::HasInstance(args[3])) {
+    return VException("Argument 'scriptPubKey' must be of type Buffer");
+  }
+  if (!args[4]->IsUint32()) {
+    return VException("Argument 'hashType' must be a Number");
+  }
+  REQ_FUN_ARG(5, cb);
+
+  verify_script_baton_t *baton = new verify_script_baton_t();
+  baton->tx = copy_buffer(args[0], &baton->txLen);
+  if (!SigHash::Parse(&baton->parsed, baton->tx, baton->txLen)) {
+    delete [] baton->tx;
+    delete baton;
+    return VException("Argument 'tx' is not a valid transaction");
+  }
+
+  // An index out of range makes all signatures invalid, as in
+  // Transaction.hashForSignature()
+  baton->inIndex = args[1]->Uint32Value();
+  baton->scriptSig = copy_buffer(args[2], &baton->scriptSigLen);
+  baton->scriptPubKey = copy_buffer(args[3], &baton->scriptPubKeyLen);
+  baton->hashType = args[4]->Uint32Value();
+  baton->error = NULL;
+  baton->result = false;
+  baton->stack = NULL;
+  baton->stackSize = 0;
+  baton->stackData = NULL;
+  baton->cb = Persistent<Function>::New(cb);
+
+  uv_work_t *req = new uv_work_t;
+  req->data = baton;
+
+  WorkPool::Queue(req, EIO_VerifyScript, VerifyScriptCallback);
+
+  return scope.Close(Undefined());
+}
+
+void Interpreter::EIO_VerifyTransaction(uv_work_t *req)
+{
+  verify_tx_job_t *job = static_cast<verify_tx_job_t *>(req->data);
+  verify_tx_baton_t *b = job->baton;
+
+  tx_sighash_t *ctx = new tx_sighash_t;
+  Interpreter *interp = new Interpreter();
+  interp->SetSigHash(tx_sighash, ctx);
+
+  const uint32_t *words = b->table.words;
+  size_t firstIn = words[5];
+
+  for (size_t i = job->begin; i < job->end; i++) {
+    const uint32_t *in = words + firstIn + TxParser::IN_WORDS * i;
+    tx_sighash_init(ctx, &b->parsed, i);
+
+    const unsigned char *scriptPubKey = b->scripts + b->scriptOffsets[i];
+    size_t scriptPubKeyLen = b->scriptOffsets[i + 1] - b->scriptOffsets[i];
+
+    b->errors[i] = NULL;
+    if (!interp->Verify(b->tx + in[1], in[2], scriptPubKey, scriptPubKeyLen,
+                        0, &b->results[i])) {
+      b->errors[i] = interp->lastError;
+      b->results[i] = false;
+    }
+  }
+
+  delete interp;
+  delete ctx;
+}
+
+void Interpreter::VerifyTransactionCallback(uv_work_t *req, int status)
+{
+  verify_tx_job_t *job = static_cast<verify_tx_job_t *>(req->data);
+  verify_tx_baton_t *baton = job->baton;
+
+  delete job;
+  delete req;
+
+  // Only the last job to finish reports back
+  if (--baton->pending > 0) {
+    return;
+  }
+
+  HandleScope scope;
+
+  Local<Array> results = Array::New(baton->inCount);
+  for (size_t i = 0; i < baton->inCount; i++) {
+    if (baton->errors[i]) {
+      results->Set(i, Exception::Error(String::New(baton->errors[i])));
+    } else {
+      results->Set(i, Boolean::New(baton->results[i]));
+    }
+  }
+
+  Local<Value> argv[2];
+  argv[0] = Local<Value>::New(Null());
+  argv[1] = results;
+
+  TryCatch try_catch;
+
+  baton->cb->Call(Context::GetCurrent()->Global(), 2, argv);
+
+  baton->cb.Dispose();
+  SigHash::Free(&baton->parsed);
+  TxParser::Free(&baton->table);
+  delete [] baton->tx;
+  delete [] baton->scripts;
+  delete [] baton->scriptOffsets;
+  delete [] baton->errors;
+  delete [] baton->results;
+  delete baton;
+
+  if (try_catch.HasCaught()) {
+    FatalException(try_catch);
+  }
+}
+
+Handle<Value> Interpreter::VerifyTransaction(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 3) {
+    return VException("Three arguments expected: tx, scriptPubKeys, callback");
+  }
+  if (!Buffer::HasInstance(args[0])) {
+    return VException("Argument 'tx' must be of type Buffer");
+  }
+  if (!args[1]->IsArray()) {
+    return VException("Argument 'scriptPubKeys' must be an Array");
+  }
+  REQ_FUN_ARG(2, cb);
+
+  verify_tx_baton_t *baton = new verify_tx_baton_t();
+  baton->tx = copy_buffer(args[0], &baton->txLen);
+
+  unsigned char hash[32];
+  size_t pos = 0;
+  TxParser::Init(&baton->table, 1);
+  if (!TxParser::ParseTx(&baton->table, 0, hash, baton->tx, baton->txLen, &pos) ||
+      !SigHash::Parse(&baton->parsed, baton->tx, baton->txLen)) {
+    TxParser::Free(&baton->table);
+    delete [] baton->tx;
+    delete baton;
+    return VException("Argument 'tx' is not a valid transaction");
+  }
+  baton->inCount = baton->parsed.inCount;
+
+  Local<Array> scripts = Local<Array>::Cast(args[1]);
+  const char *error = NULL;
+  if (scripts->Length() != baton->inCount) {
+    error = "Argument 'scriptPubKeys' must have one entry per input";
+  }
+
+  // Copy the scripts into one block
+  size_t total = 0;
+  for (size_t i = 0; !error && i < baton->inCount; i++) {
+    Local<Value> script = scripts->Get(i);
+    if (!Buffer::HasInstance(script)) {
+      error = "Argument 'scriptPubKeys' must be an Array of Buffers";
+    } else {
+      total += Buffer::Length(script);
+    }
+  }
+  if (error) {
+    SigHash::Free(&baton->parsed);
+    TxParser::Free(&baton->table);
+    delete [] baton->tx;
+    delete baton;
+    return VException(error);
+  }
+
+  baton->scripts = new unsigned char[total + 1];
+  baton->scriptOffsets = new size_t[baton->inCount + 1];
+  size_t offset = 0;
+  for (size_t i = 0; i < baton->inCount; i++) {
+    Local<Value> script = scripts->Get(i);
+    size_t len = Buffer::Length(script);
+    memcpy(baton->scripts + offset, Buffer::Data(script), len);
+    baton->scriptOffsets[i] = offset;
+    offset += len;
+  }
+  baton->scriptOffsets[baton->inCount] = offset;
+
+  baton->errors = new const char *[baton->inCount + 1];
+  baton->results = new bool[baton->inCount + 1];
+  baton->cb = Persistent<Function>::New(cb);
+
+  // Split the inputs into jobs for the thread pool
+  int jobs = (baton->inCount + VERIFY_TX_MIN_JOB_SIZE - 1) / VERIFY_TX_MIN_JOB_SIZE;
+  if (jobs > WorkPool::GetThreadCount()) jobs = WorkPool::GetThreadCount();
+  if (jobs < 1) jobs = 1;
+
+  baton->pending = jobs;
+
+  for (int j = 0; j < jobs; j++) {
+    verify_tx_job_t *job = new verify_tx_job_t();
+    job->baton = baton;
+    job->begin = baton->inCount * j / jobs;
+    job->end = baton->inCount * (j + 1) / jobs;
+
+    uv_work_t *req = new uv_work_t;
+    req->data = job;
+
+    WorkPool::Queue(req, EIO_VerifyTransaction, VerifyTransactionCallback);
+  }
+
+  return scope.Close(Undefined());
+}
@@ -0,0 +1,199 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_INTERPRETER_H_
+#define BITCOINJS_SERVER_INCLUDE_INTERPRETER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <v8.h>
+#include <uv.h>
+
+#include <openssl/ec.h>
+
+#include "sighash.h"
+#include "txparser.h"
+
+using namespace v8;
+
+/**
+ * Native port of lib/scriptinterpreter.js.
+ *
+ * It runs the same opcode set with the same limits and gives the same
+ * results, down to the quirks of the JavaScript version (OP_EQUAL pushes
+ * 0x00 for false, findAndDelete() skips the element after a match, ...),
+ * so either can be used to validate the chain. Disabled opcodes are always
+ * disabled.
+ *
+ * Stack items point into the scripts or into a fixed size arena that holds
+ * the results of hash and arithmetic opcodes. The opcode limit bounds what
+ * a script can allocate, so Reset() only has to rewind the arena between
+ * inputs. Signature hashes come from a hook, see SetSigHash().
+ *
+ * An Interpreter is not thread safe, but any number of them can run in
+ * parallel on the work pool.
+ *
+ * JavaScript API:
+ *
+ *   verify_script(tx, inIndex, scriptSig, scriptPubKey, hashType, callback)
+ *   verify_transaction(tx, scriptPubKeys, callback)
+ *
+ * verify_script() calls back with (err, valid, stack), stack being the
+ * final stack as an Array of Buffers. verify_transaction() verifies every
+ * input against its scriptPubKey with hash type 0 and calls back with
+ * (err, results), where each result is a Boolean or the Error the input's
+ * scripts raised.
+ */
+class Interpreter
+{
+public:
+
+  enum {
+    MAX_SCRIPT_SIZE = 10000,
+    MAX_PUSH_SIZE = 520,
+    MAX_STACK_SIZE = 1000,
+    MAX_OPS = 201,
+    MAX_EXEC_DEPTH = MAX_OPS,
+    MAX_MULTISIG_KEYS = 20,
+    // Every counted opcode allocates at most one 32 byte hash, for both
+    // scripts of an input
+    ARENA_SIZE = 2 * MAX_OPS * 32
+  };
+
+  struct item_t {
+    const unsigned char *data;
+    size_t len;
+  };
+
+  /**
+   * Compute the hash for signing with the given script code. Returns false
+   * if the transaction can't be signed that way, which makes the signature
+   * invalid.
+   */
+  typedef bool (*sighash_fn)(void *ctx, unsigned char *out,
+                             const unsigned char *scriptCode, size_t len,
+                             uint32_t hashType);
+
+  Interpreter();
+  ~Interpreter();
+
+  void SetSigHash(sighash_fn fn, void *ctx);
+
+  /**
+   * Evaluate scriptSig and then scriptPubKey on the same stack, like
+   * ScriptInterpreter.verify(). Returns false with lastError set if the
+   * scripts fail, otherwise *result is the truth value of the top item.
+   */
+  bool Verify(const unsigned char *scriptSig, size_t scriptSigLen,
+              const unsigned char *scriptPubKey, size_t scriptPubKeyLen,
+              uint32_t hashType, bool *result);
+
+  const char *lastError;
+
+  // Main stack after Verify()
+  item_t *stack;
+  int stackSize;
+
+  static void Init(Handle<Object> target);
+
+private:
+
+  enum {
+    PUSH = -1
+  };
+
+  struct chunk_t {
+    int op;
+    const unsigned char *data;
+    size_t len;
+  };
+
+  sighash_fn sighash;
+  void *sighashCtx;
+
+  item_t *altStack;
+  int altStackSize;
+
+  chunk_t *chunks;
+  int chunkCount;
+
+  // Script code for signature checks, as indexes into chunks
+  int *code;
+  int codeLen;
+  unsigned char *codeBuf;
+
+  unsigned char *arena;
+  size_t arenaUsed;
+
+  // Scratch key for the OpenSSL verification path
+  EC_KEY *ec;
+
+  void Reset();
+  bool Fail(const char *error);
+  bool Parse(const unsigned char *script, size_t len);
+  bool Eval(const unsigned char *script, size_t len, uint32_t hashType);
+
+  bool Push(const unsigned char *data, size_t len);
+  bool PushNum(int64_t value);
+  bool Pop(item_t *item);
+  unsigned char *Alloc(size_t len);
+
+  void SetCode(int hashStart);
+  void DeleteFromCode(const item_t *data, int op);
+  bool CheckSig(const item_t *sig, const item_t *pub, uint32_t hashType);
+
+  struct verify_script_baton_t {
+    unsigned char *tx;
+    size_t txLen;
+    SigHash::tx_t parsed;
+    size_t inIndex;
+    unsigned char *scriptSig;
+    size_t scriptSigLen;
+    unsigned char *scriptPubKey;
+    size_t scriptPubKeyLen;
+    uint32_t hashType;
+
+    // Results
+    const char *error;
+    bool result;
+    // Final stack, items point into stackData
+    item_t *stack;
+    int stackSize;
+    unsigned char *stackData;
+
+    Persistent<Function> cb;
+  };
+
+  struct verify_tx_baton_t {
+    unsigned char *tx;
+    size_t txLen;
+    SigHash::tx_t parsed;
+    TxParser::table_t table;
+
+    // All scriptPubKeys, one after the other
+    unsigned char *scripts;
+    size_t *scriptOffsets;
+
+    size_t inCount;
+    // Per input: NULL or the error, and the result
+    const char **errors;
+    bool *results;
+
+    int pending;
+    Persistent<Function> cb;
+  };
+
+  struct verify_tx_job_t {
+    verify_tx_baton_t *baton;
+    size_t begin;
+    size_t end;
+  };
+
+  static void EIO_VerifyScript(uv_work_t *req);
+  static void VerifyScriptCallback(uv_work_t *req, int status);
+  static void EIO_VerifyTransaction(uv_work_t *req);
+  static void VerifyTransactionCallback(uv_work_t *req, int status);
+
+  static Handle<Value> VerifyScript(const Arguments& args);
+  static Handle<Value> VerifyTransaction(const Arguments& args);
+};
+
+#endif
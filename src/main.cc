@@ -1,4 +1,3 @@
-#include <cctype>
 #include <cstdlib>
 #include <cstring>
 #include <stdio.h>
@@ -9,7 +8,6 @@
 #include <node_version.h>
 #include <node_buffer.h>
 
-#include <openssl/bn.h>
 #include <openssl/buffer.h>
 #include <openssl/ecdsa.h>
 #include <openssl/evp.h>
@@ -18,245 +16,452 @@
 #include <openssl/ripemd.h>
 
 #include "common.h"
+#include "base58.h"
+#include "coincache.h"
 #include "eckey.h"
+#include "framer.h"
+#include "headers.h"
+#include "interpreter.h"
+#include "mempool.h"
+#include "merkle.h"
+#include "noncescanner.h"
+#include "pubkeycache.h"
+#include "secp256k1.h"
+#include "sha256.h"
+#include "sighash.h"
+#include "sighashtx.h"
+#include "sigcache.h"
+#include "standardinput.h"
+#include "stats.h"
+#include "txparser.h"
+#include "uint256.h"
+#include "workpool.h"
+#include "worktemplate.h"
 
 using namespace std;
 using namespace v8;
 using namespace node;
 
+// Number of decoded public keys to keep around by default
+#define PUBKEY_CACHE_DEFAULT_SIZE 8192
+
+// Number of verified signatures to remember by default (32 bytes each)
+#define SIG_CACHE_DEFAULT_SIZE 65536
+
+static void
+hash160 (unsigned char *out, const unsigned char *data, size_t len)
+{
+  unsigned char hash[32];
+  Sha256::Single(hash, data, len);
+  RIPEMD160(hash, 32, out);
+}
+
+/**
+ * Version byte, hash160 and the first four bytes of the double SHA-256
+ * of both.
+ */
+static void
+hash160_to_address256 (unsigned char *out, const unsigned char *hash, unsigned char version)
+{
+  unsigned char digest[32];
+  out[0] = version;
+  memcpy(out + 1, hash, RIPEMD160_DIGEST_LENGTH);
+  Sha256::Double(digest, out, 1 + RIPEMD160_DIGEST_LENGTH);
+  memcpy(out + 1 + RIPEMD160_DIGEST_LENGTH, digest, 4);
+}
+
 static Handle<Value>
 pubkey_to_address256 (const Arguments& args)
 {
   HandleScope scope;
+  StatsTimer timer(Stats::OP_ADDRESS);
   
-  if (args.Length() != 1) {
-    return VException("One argument expected: pubkey Buffer");
+  if (args.Length() < 1 || args.Length() > 2) {
+    return VException("One or two arguments expected: pubkey Buffer, version Number");
   }
   if (!Buffer::HasInstance(args[0])) {
-    return VException("One argument expected: pubkey Buffer");
+    return VException("Argument 'pubkey' must be of type Buffer");
   }
-  v8::Handle<v8::Object> pub_buf = args[0]->ToObject();
-  
-  unsigned char *pub_data = (unsigned char *) Buffer::Data(pub_buf);
-  
-  // sha256(pubkey)
-  unsigned char hash1[SHA256_DIGEST_LENGTH];
-  SHA256_CTX c;
-  SHA256_Init(&c);
-  SHA256_Update(&c, pub_data, Buffer::Length(pub_buf));
-  SHA256_Final(hash1, &c);
-  
-  // ripemd160(sha256(pubkey))
-  unsigned char hash2[RIPEMD160_DIGEST_LENGTH];
-  RIPEMD160_CTX c2;
-  RIPEMD160_Init(&c2);
-  RIPEMD160_Update(&c2, hash1, SHA256_DIGEST_LENGTH);
-  RIPEMD160_Final(hash2, &c2);
-  
-  // x = '\x00' + ripemd160(sha256(pubkey))
-  // LATER: make the version an optional argument
-  unsigned char address256[1 + RIPEMD160_DIGEST_LENGTH + 4];
-  address256[0] = 0;
-  memcpy(address256 + 1, hash2, RIPEMD160_DIGEST_LENGTH);
-  
-  // sha256(x)
-  unsigned char hash3[SHA256_DIGEST_LENGTH];
-  SHA256_CTX c3;
-  SHA256_Init(&c3);
-  SHA256_Update(&c3, address256, 1 + RIPEMD160_DIGEST_LENGTH);
-  SHA256_Final(hash3, &c3);
-  
-  // address256 = (x + sha256(x)[:4])
-  memcpy(
-    address256 + (1 + RIPEMD160_DIGEST_LENGTH),
-    hash3,
-    4);
-  
+  if (args.Length() > 1 && !args[1]->IsUint32()) {
+    return VException("Argument 'version' must be a Number");
+  }
+  unsigned char version = args.Length() > 1 ? args[1]->Uint32Value() & 0xff : 0;
+
+  unsigned char hash[RIPEMD160_DIGEST_LENGTH];
+  hash160(hash, (const unsigned char *) Buffer::Data(args[0]), Buffer::Length(args[0]));
+
   Buffer *address256_buf = Buffer::New(1 + RIPEMD160_DIGEST_LENGTH + 4);
-  memcpy(Buffer::Data(address256_buf), address256, 1 + RIPEMD160_DIGEST_LENGTH + 4);
+  hash160_to_address256((unsigned char *) Buffer::Data(address256_buf), hash, version);
+  timer.Done(Stats::RESULT_GOOD);
   return scope.Close(address256_buf->handle_);
 }
 
+/**
+ * Like pubkey_to_address256, but reads the key from a range of a Buffer
+ * and writes the 25 bytes into out at outOffset. Returns the number of
+ * bytes written.
+ */
+static Handle<Value>
+pubkey_to_address256_into (const Arguments& args)
+{
+  HandleScope scope;
+  StatsTimer timer(Stats::OP_ADDRESS);
 
-static const char* BASE58_ALPHABET = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+  if (args.Length() != 6) {
+    return VException("Six arguments expected: pubkey, offset, length, version, out, outOffset");
+  }
+  if (!args[2]->IsUint32()) {
+    return VException("Argument 'length' must be a Number");
+  }
+  const unsigned char *pubkey = BufferRange(args[0], args[1], args[2]->Uint32Value());
+  if (pubkey == NULL) {
+    return VException("Arguments 'pubkey', 'offset' and 'length' must be a range of a Buffer");
+  }
+  if (!args[3]->IsUint32()) {
+    return VException("Argument 'version' must be a Number");
+  }
+  unsigned char *out = BufferRange(args[4], args[5], 1 + RIPEMD160_DIGEST_LENGTH + 4);
+  if (out == NULL) {
+    return VException("Argument 'out' must be a Buffer with 25 bytes free at 'outOffset'");
+  }
 
+  unsigned char hash[RIPEMD160_DIGEST_LENGTH];
+  hash160(hash, pubkey, args[2]->Uint32Value());
+  hash160_to_address256(out, hash, args[3]->Uint32Value() & 0xff);
+  timer.Done(Stats::RESULT_GOOD);
+  return scope.Close(Integer::New(1 + RIPEMD160_DIGEST_LENGTH + 4));
+}
 
+/**
+ * hash160 of many public keys. Takes the keys concatenated in one Buffer
+ * and an Array with the offset of each key, every key ending where the
+ * next one starts. Returns the 20 byte hashes concatenated.
+ */
 static Handle<Value>
-base58_encode (const Arguments& args)
+hash160_many (const Arguments& args)
 {
   HandleScope scope;
-  
-  if (args.Length() != 1) {
-    return VException("One argument expected: a Buffer");
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: pubkeys Buffer, offsets Array");
   }
   if (!Buffer::HasInstance(args[0])) {
-    return VException("One argument expected: a Buffer");
+    return VException("Argument 'pubkeys' must be of type Buffer");
   }
-  v8::Handle<v8::Object> buf = args[0]->ToObject();
-  
-  unsigned char *buf_data = (unsigned char *) Buffer::Data(buf);
-  int buf_length = Buffer::Length(buf);
-  
-  BN_CTX *ctx = BN_CTX_new();
-  
-  BIGNUM *bn = BN_bin2bn(buf_data, buf_length, NULL);
-  
-  BIGNUM *bn58 = BN_new();
-  BN_set_word(bn58, 58);
-  
-  BIGNUM *bn0 = BN_new();
-  BN_set_word(bn0, 0);
-  
-  BIGNUM *dv = BN_new();
-  BIGNUM *rem = BN_new();
-  
-  // TODO: compute safe length
-  char *str = new char[100];
-  unsigned int c;
-  int i, j, j2;
-  
-  i = 0;
-  while (BN_cmp(bn, bn0) > 0) {
-    if (!BN_div(dv, rem, bn, bn58, ctx)) {
-      return VException("BN_div failed");
-    }
-    if (bn != dv) {
-      BN_free(bn);
-      bn = dv;
-    }
-    c = BN_get_word(rem);
-    str[i] = BASE58_ALPHABET[c];
-    i++;
+  if (!args[1]->IsArray()) {
+    return VException("Argument 'offsets' must be an Array");
   }
-  
-  // Leading zeros
-  for (j = 0; j < buf_length; j++) {
-    if (buf_data[j] != 0) {
-      break;
+
+  const unsigned char *data = (const unsigned char *) Buffer::Data(args[0]);
+  size_t len = Buffer::Length(args[0]);
+  Local<Array> offsets = Local<Array>::Cast(args[1]);
+  size_t count = offsets->Length();
+
+  const unsigned char **keys = new const unsigned char *[count];
+  size_t *lens = new size_t[count];
+
+  size_t prev = len;
+  for (size_t i = count; i-- > 0;) {
+    Local<Value> offset = offsets->Get(i);
+    if (!offset->IsUint32() || offset->Uint32Value() > prev) {
+      delete [] keys;
+      delete [] lens;
+      return VException("Argument 'offsets' must be ascending offsets into 'pubkeys'");
     }
-    str[i] = BASE58_ALPHABET[0];
-    i++;
+    keys[i] = data + offset->Uint32Value();
+    lens[i] = prev - offset->Uint32Value();
+    prev = offset->Uint32Value();
   }
-  
-  // Terminator
-  str[i] = 0;
-  
-  // Reverse string
-  int numSwaps = (i / 2);
-  char tmp;
-  for (j = 0; j < numSwaps; j++) {
-    j2 = i - 1 - j;
-    tmp = str[j];
-    str[j] = str[j2];
-    str[j2] = tmp;
+
+  // Compressed and uncompressed keys come in runs of equal length, which
+  // the multi-buffer kernels hash side by side
+  unsigned char *digests = new unsigned char[32 * count];
+  Sha256::SingleMany(digests, keys, lens, count);
+
+  Buffer *hashes_buf = Buffer::New(RIPEMD160_DIGEST_LENGTH * count);
+  unsigned char *hashes = (unsigned char *) Buffer::Data(hashes_buf);
+  for (size_t i = 0; i < count; i++) {
+    RIPEMD160(digests + 32 * i, 32, hashes + RIPEMD160_DIGEST_LENGTH * i);
   }
-  
-  BN_free(bn);
-  BN_free(bn58);
-  BN_free(bn0);
-  BN_free(rem);
-  BN_CTX_free(ctx);
-  
-  Local<String> ret = String::New(str);
-  delete [] str;
-  return scope.Close(ret);
+
+  delete [] keys;
+  delete [] lens;
+  delete [] digests;
+
+  return scope.Close(hashes_buf->handle_);
+}
+
+/**
+ * Base58Check addresses for concatenated 20 byte hashes. Returns an Array
+ * of Strings.
+ */
+static Handle<Value>
+address_many (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: hashes Buffer, version Number");
+  }
+  if (!Buffer::HasInstance(args[0])) {
+    return VException("Argument 'hashes' must be of type Buffer");
+  }
+  if (!args[1]->IsUint32() || args[1]->Uint32Value() > 0xff) {
+    return VException("Argument 'version' must be a Number from 0 to 255");
+  }
+
+  const unsigned char *hashes = (const unsigned char *) Buffer::Data(args[0]);
+  size_t len = Buffer::Length(args[0]);
+  if (len % RIPEMD160_DIGEST_LENGTH) {
+    return VException("Length of 'hashes' must be a multiple of 20");
+  }
+  size_t count = len / RIPEMD160_DIGEST_LENGTH;
+  unsigned char version = args[1]->Uint32Value();
+
+  // All payloads have the same length, so their checksums are computed
+  // side by side
+  const size_t payloadLen = 1 + RIPEMD160_DIGEST_LENGTH;
+  unsigned char *payloads = new unsigned char[payloadLen * count];
+  const unsigned char **ptrs = new const unsigned char *[count];
+  size_t *lens = new size_t[count];
+  for (size_t i = 0; i < count; i++) {
+    payloads[payloadLen * i] = version;
+    memcpy(payloads + payloadLen * i + 1, hashes + RIPEMD160_DIGEST_LENGTH * i,
+           RIPEMD160_DIGEST_LENGTH);
+    ptrs[i] = payloads + payloadLen * i;
+    lens[i] = payloadLen;
+  }
+
+  unsigned char *digests = new unsigned char[32 * count];
+  Sha256::DoubleMany(digests, ptrs, lens, count);
+
+  Local<Array> addresses = Array::New(count);
+  for (size_t i = 0; i < count; i++) {
+    unsigned char address256[payloadLen + 4];
+    memcpy(address256, ptrs[i], payloadLen);
+    memcpy(address256 + payloadLen, digests + 32 * i, 4);
+
+    char str[64];
+    size_t strLen = Base58::Encode(str, address256, sizeof(address256));
+    addresses->Set(i, String::New(str, strLen));
+  }
+
+  delete [] payloads;
+  delete [] ptrs;
+  delete [] lens;
+  delete [] digests;
+
+  return scope.Close(addresses);
+}
+
+
+/**
+ * Base58 encode a Buffer, with a checksum if check is set. Returns an
+ * empty handle after raising an exception if arg is not a Buffer.
+ */
+static Local<Value>
+base58_encode_value (Handle<Value> arg, bool check)
+{
+  StatsTimer timer(check ? Stats::OP_BASE58CHECK_ENCODE : Stats::OP_BASE58_ENCODE);
+  if (!Buffer::HasInstance(arg)) {
+    VException("Argument must be of type Buffer");
+    return Local<Value>();
+  }
+
+  const unsigned char *data = (const unsigned char *) Buffer::Data(arg);
+  size_t len = Buffer::Length(arg);
+
+  char stackStr[128];
+  size_t size = Base58::EncodedSize(len + (check ? 4 : 0));
+  char *str = size <= sizeof(stackStr) ? stackStr : new char[size];
+
+  size_t strLen = check ? Base58::EncodeCheck(str, data, len)
+                        : Base58::Encode(str, data, len);
+  Local<String> result = String::New(str, strLen);
+
+  if (str != stackStr) {
+    delete [] str;
+  }
+  timer.Done(Stats::RESULT_GOOD);
+  return result;
+}
+
+/**
+ * Base58 decode a String, verifying and removing the checksum if check is
+ * set. Invalid strings raise an exception, or return null with check.
+ */
+static Local<Value>
+base58_decode_value (Handle<Value> arg, bool check)
+{
+  StatsTimer timer(check ? Stats::OP_BASE58CHECK_DECODE : Stats::OP_BASE58_DECODE);
+  if (!arg->IsString()) {
+    VException("Argument must be a String");
+    return Local<Value>();
+  }
+
+  String::Utf8Value str(arg);
+
+  unsigned char stackData[128];
+  size_t size = str.length();
+  unsigned char *data = size <= sizeof(stackData) ? stackData : new unsigned char[size];
+
+  size_t len;
+  bool ok = check ? Base58::DecodeCheck(data, &len, *str, str.length())
+                  : Base58::Decode(data, &len, *str, str.length());
+
+  Local<Value> result;
+  if (ok) {
+    Buffer *buf = Buffer::New(len);
+    memcpy(Buffer::Data(buf), data, len);
+    result = Local<Value>::New(buf->handle_);
+    timer.Done(Stats::RESULT_GOOD);
+  } else if (check) {
+    // Bad checksum
+    result = Local<Value>::New(Null());
+    timer.Done(Stats::RESULT_BAD);
+  } else {
+    VException("Invalid base58 string");
+  }
+
+  if (data != stackData) {
+    delete [] data;
+  }
+  return result;
 }
 
+typedef Local<Value> (*base58_fn_t)(Handle<Value> arg, bool check);
 
 static Handle<Value>
-base58_decode (const Arguments& args)
+base58_one (const Arguments& args, base58_fn_t fn, bool check)
 {
   HandleScope scope;
-  
+
   if (args.Length() != 1) {
-    return VException("One argument expected: a String");
+    return VException("One argument expected");
   }
-  if (!args[0]->IsString()) {
-    return VException("One argument expected: a String");
+
+  Local<Value> result = fn(args[0], check);
+  if (result.IsEmpty()) {
+    return scope.Close(Undefined());
   }
-  
-  BN_CTX *ctx = BN_CTX_new();
-  
-  BIGNUM *bn58 = BN_new();
-  BN_set_word(bn58, 58);
-  
-  BIGNUM *bn = BN_new();
-  BN_set_word(bn, 0);
+  return scope.Close(result);
+}
 
-  BIGNUM *bnChar = BN_new();
+/**
+ * Apply fn to every element of an Array, for encoding or decoding many
+ * values with a single call into the module.
+ */
+static Handle<Value>
+base58_many (const Arguments& args, base58_fn_t fn, bool check)
+{
+  HandleScope scope;
 
-  String::Utf8Value str(args[0]->ToString());
-  char *psz = *str;
-  
-  while (isspace(*psz))
-    psz++;
-  
-  // Convert big endian string to bignum
-  for (const char* p = psz; *p; p++) {
-    const char* p1 = strchr(BASE58_ALPHABET, *p);
-    if (p1 == NULL) {
-      while (isspace(*p))
-        p++;
-      if (*p != '\0')
-        return VException("Error");
-      break;
+  if (args.Length() != 1 || !args[0]->IsArray()) {
+    return VException("One argument expected: an Array");
+  }
+
+  Local<Array> values = Local<Array>::Cast(args[0]);
+  uint32_t count = values->Length();
+  Local<Array> results = Array::New(count);
+
+  for (uint32_t i = 0; i < count; i++) {
+    Local<Value> result = fn(values->Get(i), check);
+    if (result.IsEmpty()) {
+      return scope.Close(Undefined());
     }
-    BN_set_word(bnChar, p1 - BASE58_ALPHABET);
-    if (!BN_mul(bn, bn, bn58, ctx))
-      return VException("BN_mul failed");
-    if (!BN_add(bn, bn, bnChar))
-      return VException("BN_add failed");
+    results->Set(i, result);
   }
 
-  // Get bignum as little endian data
-  unsigned int tmpLen = BN_num_bytes(bn);
-  unsigned char *tmp = (unsigned char *)malloc(tmpLen);
-  BN_bn2bin(bn, tmp);
+  return scope.Close(results);
+}
 
-  // Trim off sign byte if present
-  if (tmpLen >= 2 && tmp[tmpLen-1] == 0 && tmp[tmpLen-2] >= 0x80)
-    tmpLen--;
-  
-  // Restore leading zeros
-  int nLeadingZeros = 0;
-  for (const char* p = psz; *p == BASE58_ALPHABET[0]; p++)
-    nLeadingZeros++;
+static Handle<Value>
+base58_encode (const Arguments& args)
+{
+  return base58_one(args, base58_encode_value, false);
+}
+
+static Handle<Value>
+base58_decode (const Arguments& args)
+{
+  return base58_one(args, base58_decode_value, false);
+}
 
-  // Allocate buffer and zero it
-  Buffer *buf = Buffer::New(nLeadingZeros + tmpLen);
-  char* data = Buffer::Data(buf);
-  memset(data, 0, nLeadingZeros + tmpLen);
-  memcpy(data+nLeadingZeros, tmp, tmpLen);
+static Handle<Value>
+base58check_encode (const Arguments& args)
+{
+  return base58_one(args, base58_encode_value, true);
+}
+
+static Handle<Value>
+base58check_decode (const Arguments& args)
+{
+  return base58_one(args, base58_decode_value, true);
+}
+
+static Handle<Value>
+base58_encode_many (const Arguments& args)
+{
+  return base58_many(args, base58_encode_value, false);
+}
+
+static Handle<Value>
+base58_decode_many (const Arguments& args)
+{
+  return base58_many(args, base58_decode_value, false);
+}
 
-  BN_free(bn58);
-  BN_free(bn);
-  BN_free(bnChar);
-  BN_CTX_free(ctx);
-  free(tmp);
+static Handle<Value>
+base58check_encode_many (const Arguments& args)
+{
+  return base58_many(args, base58_encode_value, true);
+}
 
-  return scope.Close(buf->handle_);
+static Handle<Value>
+base58check_decode_many (const Arguments& args)
+{
+  return base58_many(args, base58_decode_value, true);
 }
 
 
-int static FormatHashBlocks(void* pbuffer, unsigned int len)
+/**
+ * SHA-256 state after the first 64 byte block of data, padded as the
+ * last block if data is shorter.
+ */
+static void
+midstate (unsigned char *out, const unsigned char *data, size_t len)
 {
-  unsigned char* pdata = (unsigned char*)pbuffer;
-  unsigned int blocks = 1 + ((len + 8) / 64);
-  unsigned char* pend = pdata + 64 * blocks;
-  memset(pdata + len, 0, 64 * blocks - len);
-  pdata[len] = 0x80;
-  unsigned int bits = len * 8;
-  pend[-1] = (bits >> 0) & 0xff;
-  pend[-2] = (bits >> 8) & 0xff;
-  pend[-3] = (bits >> 16) & 0xff;
-  pend[-4] = (bits >> 24) & 0xff;
-  return blocks;
+  unsigned char block[64];
+
+  if (len >= sizeof(block)) {
+    memcpy(block, data, sizeof(block));
+  } else {
+    memcpy(block, data, len);
+    memset(block + len, 0, sizeof(block) - len);
+    block[len] = 0x80;
+
+    // The length only goes into this block if it fits after the 0x80
+    if (len < 56) {
+      unsigned int bits = len * 8;
+      block[63] = (bits >> 0) & 0xff;
+      block[62] = (bits >> 8) & 0xff;
+      block[61] = (bits >> 16) & 0xff;
+      block[60] = (bits >> 24) & 0xff;
+    }
+  }
+
+  // Note that we don't run SHA256_Final and return the middle state instead
+  SHA256_CTX c;
+  SHA256_Init(&c);
+  SHA256_Transform(&c, block);
+  memcpy(out, &c.h, SHA256_DIGEST_LENGTH);
 }
 
 static Handle<Value>
 sha256_midstate (const Arguments& args)
 {
   HandleScope scope;
+  StatsTimer timer(Stats::OP_SHA256_MIDSTATE);
 
   if (args.Length() != 1) {
     return VException("One argument expected: data Buffer");
@@ -264,31 +469,716 @@ sha256_midstate (const Arguments& args)
   if (!Buffer::HasInstance(args[0])) {
     return VException("One argument expected: data Buffer");
   }
-  v8::Handle<v8::Object> blk_buf = args[0]->ToObject();
 
-  // Reserve 64 extra bytes of memory for padding
-  unsigned int blk_len = Buffer::Length(blk_buf);
-  unsigned char *blk_data = (unsigned char *) malloc(blk_len + 64);
+  Buffer *midstate_buf = Buffer::New(SHA256_DIGEST_LENGTH);
+  midstate((unsigned char *) Buffer::Data(midstate_buf),
+           (const unsigned char *) Buffer::Data(args[0]), Buffer::Length(args[0]));
 
-  // Get block header
-  memcpy(blk_data, Buffer::Data(blk_buf), blk_len);
+  timer.Done(Stats::RESULT_GOOD);
+  return scope.Close(midstate_buf->handle_);
+}
 
-  // Add SHA256 padding
-  FormatHashBlocks(blk_data, blk_len);
+/**
+ * Like sha256_midstate, but reads from a range of a Buffer and writes the
+ * 32 bytes into out at outOffset. Returns the number of bytes written.
+ */
+static Handle<Value>
+sha256_midstate_into (const Arguments& args)
+{
+  HandleScope scope;
+  StatsTimer timer(Stats::OP_SHA256_MIDSTATE);
 
-  // Execute first half of first hash on block data
-  SHA256_CTX c;
-  SHA256_Init(&c);
-  SHA256_Transform(&c, blk_data);
+  if (args.Length() != 5) {
+    return VException("Five arguments expected: data, offset, length, out, outOffset");
+  }
+  if (!args[2]->IsUint32()) {
+    return VException("Argument 'length' must be a Number");
+  }
+  const unsigned char *data = BufferRange(args[0], args[1], args[2]->Uint32Value());
+  if (data == NULL) {
+    return VException("Arguments 'data', 'offset' and 'length' must be a range of a Buffer");
+  }
+  unsigned char *out = BufferRange(args[3], args[4], SHA256_DIGEST_LENGTH);
+  if (out == NULL) {
+    return VException("Argument 'out' must be a Buffer with 32 bytes free at 'outOffset'");
+  }
 
-  // Note that we don't run SHA256_Final and return the middle state instead
+  midstate(out, data, args[2]->Uint32Value());
 
-  Buffer *midstate_buf = Buffer::New(SHA256_DIGEST_LENGTH);
-  memcpy(Buffer::Data(midstate_buf), &c.h, SHA256_DIGEST_LENGTH);
+  timer.Done(Stats::RESULT_GOOD);
+  return scope.Close(Integer::New(SHA256_DIGEST_LENGTH));
+}
 
-  free(blk_data);
 
-  return scope.Close(midstate_buf->handle_);
+static Handle<Value>
+sha256d (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 1 || !Buffer::HasInstance(args[0])) {
+    return VException("One argument expected: data Buffer");
+  }
+
+  Buffer *hash_buf = Buffer::New(SHA256_DIGEST_LENGTH);
+  Sha256::Double((unsigned char *) Buffer::Data(hash_buf),
+                 (const unsigned char *) Buffer::Data(args[0]),
+                 Buffer::Length(args[0]));
+
+  return scope.Close(hash_buf->handle_);
+}
+
+
+/**
+ * sha256d_many(buffers) or sha256d_many(data, stride)
+ *
+ * Double hashes an Array of Buffers, or a single Buffer split into chunks
+ * of stride bytes. Returns one Buffer with the 32 byte hashes back to back.
+ */
+static Handle<Value>
+sha256d_many (const Arguments& args)
+{
+  HandleScope scope;
+
+  size_t count;
+  const unsigned char **data;
+  size_t *lens;
+
+  if (args.Length() == 1 && args[0]->IsArray()) {
+    Local<Array> buffers = Local<Array>::Cast(args[0]);
+    count = buffers->Length();
+    data = (const unsigned char **) malloc(sizeof(unsigned char *) * (count + 1));
+    lens = (size_t *) malloc(sizeof(size_t) * (count + 1));
+
+    for (size_t i = 0; i < count; i++) {
+      Local<Value> buffer = buffers->Get(i);
+      if (!Buffer::HasInstance(buffer)) {
+        free(data);
+        free(lens);
+        return VException("Array must only contain Buffers");
+      }
+      data[i] = (const unsigned char *) Buffer::Data(buffer);
+      lens[i] = Buffer::Length(buffer);
+    }
+  } else if (args.Length() == 2 && Buffer::HasInstance(args[0])) {
+    if (!args[1]->IsUint32() || args[1]->Uint32Value() == 0) {
+      return VException("Argument 'stride' must be a positive Number");
+    }
+    size_t stride = args[1]->Uint32Value();
+    size_t len = Buffer::Length(args[0]);
+    if (len % stride) {
+      return VException("Data length must be a multiple of 'stride'");
+    }
+
+    const unsigned char *base = (const unsigned char *) Buffer::Data(args[0]);
+    count = len / stride;
+    data = (const unsigned char **) malloc(sizeof(unsigned char *) * (count + 1));
+    lens = (size_t *) malloc(sizeof(size_t) * (count + 1));
+
+    for (size_t i = 0; i < count; i++) {
+      data[i] = base + i * stride;
+      lens[i] = stride;
+    }
+  } else {
+    return VException("Expected an Array of Buffers or a Buffer and a stride");
+  }
+
+  Buffer *hash_buf = Buffer::New(count * SHA256_DIGEST_LENGTH);
+  Sha256::DoubleMany((unsigned char *) Buffer::Data(hash_buf), data, lens, count);
+
+  free(data);
+  free(lens);
+
+  return scope.Close(hash_buf->handle_);
+}
+
+
+static Handle<Value>
+sha256_implementation (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() > 0) {
+    String::AsciiValue name(args[0]);
+    if (!Sha256::SetImplementation(*name)) {
+      return VException("SHA-256 implementation not supported on this CPU");
+    }
+  }
+
+  return scope.Close(String::New(Sha256::GetImplementation()));
+}
+
+
+/**
+ * Build the merkle tree over a Buffer of concatenated 32 byte hashes.
+ *
+ * Returns NULL after throwing if the argument is invalid. An empty list of
+ * hashes gives a tree consisting of a single null hash, like
+ * Block.getMerkleTree() does.
+ */
+static unsigned char *
+build_merkle_tree (Handle<Value> arg, size_t *count, size_t *treeSize)
+{
+  if (!Buffer::HasInstance(arg)) {
+    VException("Argument 'hashes' must be of type Buffer");
+    return NULL;
+  }
+  size_t len = Buffer::Length(arg);
+  if (len % 32) {
+    VException("Length of 'hashes' must be a multiple of 32");
+    return NULL;
+  }
+
+  *count = len / 32;
+  if (*count == 0) {
+    *treeSize = 1;
+    return (unsigned char *) calloc(1, 32);
+  }
+
+  *treeSize = Merkle::TreeSize(*count);
+  unsigned char *tree = (unsigned char *) malloc(32 * *treeSize);
+  Merkle::BuildTree(tree, (const unsigned char *) Buffer::Data(arg), *count);
+  return tree;
+}
+
+static Handle<Value>
+merkle_root (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: hashes Buffer");
+  }
+
+  size_t count, treeSize;
+  unsigned char *tree = build_merkle_tree(args[0], &count, &treeSize);
+  if (tree == NULL) {
+    return scope.Close(Undefined());
+  }
+
+  Buffer *root_buf = Buffer::New(32);
+  memcpy(Buffer::Data(root_buf), tree + 32 * (treeSize - 1), 32);
+  free(tree);
+
+  return scope.Close(root_buf->handle_);
+}
+
+static Handle<Value>
+merkle_tree (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: hashes Buffer");
+  }
+
+  size_t count, treeSize;
+  unsigned char *tree = build_merkle_tree(args[0], &count, &treeSize);
+  if (tree == NULL) {
+    return scope.Close(Undefined());
+  }
+
+  Buffer *tree_buf = Buffer::New(32 * treeSize);
+  memcpy(Buffer::Data(tree_buf), tree, 32 * treeSize);
+  free(tree);
+
+  return scope.Close(tree_buf->handle_);
+}
+
+static Handle<Value>
+merkle_branch (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: hashes Buffer, index Number");
+  }
+  if (!args[1]->IsUint32()) {
+    return VException("Argument 'index' must be a Number");
+  }
+
+  size_t count, treeSize;
+  unsigned char *tree = build_merkle_tree(args[0], &count, &treeSize);
+  if (tree == NULL) {
+    return scope.Close(Undefined());
+  }
+
+  size_t index = args[1]->Uint32Value();
+  if (index >= count) {
+    free(tree);
+    return VException("Argument 'index' out of range");
+  }
+
+  Buffer *branch_buf = Buffer::New(32 * Merkle::BranchSize(count));
+  Merkle::GetBranch((unsigned char *) Buffer::Data(branch_buf), tree, count, index);
+  free(tree);
+
+  return scope.Close(branch_buf->handle_);
+}
+
+
+static Handle<Value>
+validate_headers (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 3) {
+    return VException("Three arguments expected: headers, prevHash, prevChainWork");
+  }
+  if (!Buffer::HasInstance(args[0]) || Buffer::Length(args[0]) % 80 != 0) {
+    return VException("Argument 'headers' must be a Buffer of 80 byte headers");
+  }
+  if (!Buffer::HasInstance(args[1]) || Buffer::Length(args[1]) != 32) {
+    return VException("Argument 'prevHash' must be a 32 byte Buffer");
+  }
+  if (!Buffer::HasInstance(args[2]) || Buffer::Length(args[2]) > 32) {
+    return VException("Argument 'prevChainWork' must be a Buffer of at most 32 bytes");
+  }
+
+  size_t count = Buffer::Length(args[0]) / 80;
+  unsigned char hash[32];
+  memcpy(hash, Buffer::Data(args[1]), 32);
+
+  // Chain work is stored big endian, like bignum's toBuffer()
+  uint64_t chainWork[4] = { 0, 0, 0, 0 };
+  const unsigned char *work = (const unsigned char *) Buffer::Data(args[2]);
+  size_t workLen = Buffer::Length(args[2]);
+  for (size_t i = 0; i < workLen; i++) {
+    chainWork[i / 8] |= (uint64_t) work[workLen - 1 - i] << (8 * (i % 8));
+  }
+
+  Headers::error_t error;
+  size_t valid = Headers::Validate((const unsigned char *) Buffer::Data(args[0]),
+                                   count, hash, chainWork, &error);
+
+  unsigned char workBytes[32];
+  for (size_t i = 0; i < 32; i++) {
+    workBytes[31 - i] = chainWork[i / 8] >> (8 * (i % 8));
+  }
+  size_t skip = 0;
+  while (skip < 32 && workBytes[skip] == 0) {
+    skip++;
+  }
+
+  Buffer *hash_buf = Buffer::New(32);
+  memcpy(Buffer::Data(hash_buf), hash, 32);
+  Buffer *work_buf = Buffer::New(32 - skip);
+  memcpy(Buffer::Data(work_buf), workBytes + skip, 32 - skip);
+
+  Local<Object> result = Object::New();
+  result->Set(String::NewSymbol("failed"),
+              Integer::New(valid < count ? (int32_t) valid : -1));
+  if (valid < count) {
+    result->Set(String::NewSymbol("error"),
+                String::New(Headers::GetErrorMessage(error)));
+  } else {
+    result->Set(String::NewSymbol("error"), Null());
+  }
+  result->Set(String::NewSymbol("hash"), hash_buf->handle_);
+  result->Set(String::NewSymbol("chainWork"), work_buf->handle_);
+
+  return scope.Close(result);
+}
+
+static Handle<Value>
+sighash (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 4) {
+    return VException("Four arguments expected: tx, inIndex, script, hashType");
+  }
+  if (!Buffer::HasInstance(args[0])) {
+    return VException("Argument 'tx' must be of type Buffer");
+  }
+  if (!args[1]->IsUint32()) {
+    return VException("Argument 'inIndex' must be a Number");
+  }
+  if (!Buffer::HasInstance(args[2])) {
+    return VException("Argument 'script' must be of type Buffer");
+  }
+  if (!args[3]->IsUint32()) {
+    return VException("Argument 'hashType' must be a Number");
+  }
+
+  SigHash::tx_t tx;
+  if (!SigHash::Parse(&tx, (const unsigned char *) Buffer::Data(args[0]),
+                      Buffer::Length(args[0]))) {
+    return VException("Argument 'tx' is not a valid transaction");
+  }
+
+  size_t inIndex = args[1]->Uint32Value();
+  if (inIndex >= tx.inCount) {
+    SigHash::Free(&tx);
+    return VException("Argument 'inIndex' out of range");
+  }
+
+  Buffer *hash_buf = Buffer::New(32);
+  bool ok = SigHash::Hash((unsigned char *) Buffer::Data(hash_buf), &tx, inIndex,
+                          (const unsigned char *) Buffer::Data(args[2]),
+                          Buffer::Length(args[2]), args[3]->Uint32Value());
+  SigHash::Free(&tx);
+
+  if (!ok) {
+    return VException("SIGHASH_SINGLE without a matching output");
+  }
+  return scope.Close(hash_buf->handle_);
+}
+
+/**
+ * Signature hashes for all inputs at once. Takes an Array with the script
+ * code for each input and either one hash type for all of them or an
+ * Array of hash types. Returns the concatenated 32 byte hashes.
+ */
+static Handle<Value>
+sighash_many (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 3) {
+    return VException("Three arguments expected: tx, scripts, hashTypes");
+  }
+  if (!Buffer::HasInstance(args[0])) {
+    return VException("Argument 'tx' must be of type Buffer");
+  }
+  if (!args[1]->IsArray()) {
+    return VException("Argument 'scripts' must be an Array");
+  }
+  if (!args[2]->IsArray() && !args[2]->IsUint32()) {
+    return VException("Argument 'hashTypes' must be an Array or a Number");
+  }
+
+  SigHash::tx_t tx;
+  if (!SigHash::Parse(&tx, (const unsigned char *) Buffer::Data(args[0]),
+                      Buffer::Length(args[0]))) {
+    return VException("Argument 'tx' is not a valid transaction");
+  }
+
+  Local<Array> scripts = Local<Array>::Cast(args[1]);
+  if (scripts->Length() != tx.inCount) {
+    SigHash::Free(&tx);
+    return VException("Argument 'scripts' must have one entry per input");
+  }
+  Local<Array> hashTypes;
+  if (args[2]->IsArray()) {
+    hashTypes = Local<Array>::Cast(args[2]);
+    if (hashTypes->Length() != tx.inCount) {
+      SigHash::Free(&tx);
+      return VException("Argument 'hashTypes' must have one entry per input");
+    }
+  }
+
+  const unsigned char **data = new const unsigned char *[tx.inCount];
+  size_t *lens = new size_t[tx.inCount];
+  uint32_t *types = new uint32_t[tx.inCount];
+  const char *error = NULL;
+
+  for (size_t i = 0; i < tx.inCount; i++) {
+    Local<Value> script = scripts->Get(i);
+    if (!Buffer::HasInstance(script)) {
+      error = "Entries of 'scripts' must be of type Buffer";
+      break;
+    }
+    data[i] = (const unsigned char *) Buffer::Data(script);
+    lens[i] = Buffer::Length(script);
+
+    Local<Value> type = hashTypes.IsEmpty() ? args[2] : hashTypes->Get(i);
+    if (!type->IsUint32()) {
+      error = "Entries of 'hashTypes' must be Numbers";
+      break;
+    }
+    types[i] = type->Uint32Value();
+  }
+
+  Buffer *hashes_buf = NULL;
+  if (error == NULL) {
+    hashes_buf = Buffer::New(32 * tx.inCount);
+    if (!SigHash::HashAll((unsigned char *) Buffer::Data(hashes_buf), &tx,
+                          data, lens, types)) {
+      error = "SIGHASH_SINGLE without a matching output";
+    }
+  }
+
+  delete [] data;
+  delete [] lens;
+  delete [] types;
+  SigHash::Free(&tx);
+
+  if (error != NULL) {
+    return VException(error);
+  }
+  return scope.Close(hashes_buf->handle_);
+}
+
+
+/**
+ * Parse count transactions starting at pos into {count, end, table,
+ * hashes}. Returns an empty handle after raising an exception if any of
+ * them is malformed.
+ */
+static Handle<Object>
+parse_txs (const unsigned char *data, size_t len, size_t pos, size_t count)
+{
+  TxParser::table_t table;
+  TxParser::Init(&table, count);
+
+  Buffer *hashes_buf = Buffer::New(32 * count);
+  unsigned char *hashes = (unsigned char *) Buffer::Data(hashes_buf);
+
+  for (size_t i = 0; i < count; i++) {
+    if (!TxParser::ParseTx(&table, i, hashes + 32 * i, data, len, &pos)) {
+      TxParser::Free(&table);
+      VException("Transaction data is malformed or truncated");
+      return Handle<Object>();
+    }
+  }
+
+  Buffer *table_buf = Buffer::New(4 * table.size);
+  unsigned char *out = (unsigned char *) Buffer::Data(table_buf);
+  for (size_t i = 0; i < table.size; i++) {
+    uint32_t word = table.words[i];
+    out[4 * i] = word & 0xff;
+    out[4 * i + 1] = (word >> 8) & 0xff;
+    out[4 * i + 2] = (word >> 16) & 0xff;
+    out[4 * i + 3] = (word >> 24) & 0xff;
+  }
+  TxParser::Free(&table);
+
+  Local<Object> result = Object::New();
+  result->Set(String::NewSymbol("count"), Integer::NewFromUnsigned(count));
+  result->Set(String::NewSymbol("end"), Integer::NewFromUnsigned(pos));
+  result->Set(String::NewSymbol("table"), table_buf->handle_);
+  result->Set(String::NewSymbol("hashes"), hashes_buf->handle_);
+  return result;
+}
+
+static Handle<Value>
+parse_tx (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() < 1 || !Buffer::HasInstance(args[0])) {
+    return VException("Argument 'data' must be of type Buffer");
+  }
+  if (args.Length() > 1 && !args[1]->IsUint32()) {
+    return VException("Argument 'offset' must be a Number");
+  }
+
+  size_t len = Buffer::Length(args[0]);
+  size_t offset = args.Length() > 1 ? args[1]->Uint32Value() : 0;
+  if (offset > len) {
+    return VException("Argument 'offset' out of range");
+  }
+
+  Handle<Object> result = parse_txs((const unsigned char *) Buffer::Data(args[0]),
+                                    len, offset, 1);
+  if (result.IsEmpty()) {
+    return scope.Close(Undefined());
+  }
+  return scope.Close(result);
+}
+
+static Handle<Value>
+parse_block (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 1 || !Buffer::HasInstance(args[0])) {
+    return VException("One argument expected: data Buffer");
+  }
+
+  const unsigned char *data = (const unsigned char *) Buffer::Data(args[0]);
+  size_t len = Buffer::Length(args[0]);
+  size_t pos = 80;
+  uint32_t count;
+
+  // The smallest possible transaction is 60 bytes
+  if (len < pos || !TxParser::ReadVarInt(data, len, &pos, &count) ||
+      count > (len - pos) / 60) {
+    return VException("Block data is malformed or truncated");
+  }
+
+  Handle<Object> result = parse_txs(data, len, pos, count);
+  if (result.IsEmpty()) {
+    return scope.Close(Undefined());
+  }
+  return scope.Close(result);
+}
+
+
+static Handle<Value>
+pubkey_cache_stats (const Arguments& args)
+{
+  HandleScope scope;
+
+  PubKeyCache::stats_t stats;
+  PubKeyCache::GetStats(&stats);
+
+  Local<Object> result = Object::New();
+  result->Set(String::NewSymbol("hits"), Number::New((double) stats.hits));
+  result->Set(String::NewSymbol("misses"), Number::New((double) stats.misses));
+  result->Set(String::NewSymbol("size"), Integer::NewFromUnsigned(stats.size));
+  result->Set(String::NewSymbol("capacity"), Integer::NewFromUnsigned(stats.capacity));
+  return scope.Close(result);
+}
+
+
+static Handle<Value>
+pubkey_cache_resize (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 1 || !args[0]->IsUint32()) {
+    return VException("One argument expected: capacity Number");
+  }
+  unsigned int capacity = args[0]->Uint32Value();
+  if (capacity > (1 << 24)) {
+    return VException("Argument 'capacity' must not exceed 16777216");
+  }
+
+  PubKeyCache::Resize(capacity);
+  return scope.Close(Undefined());
+}
+
+
+static Handle<Value>
+sig_cache_stats (const Arguments& args)
+{
+  HandleScope scope;
+
+  SigCache::stats_t stats;
+  SigCache::GetStats(&stats);
+
+  Local<Object> result = Object::New();
+  result->Set(String::NewSymbol("hits"), Number::New((double) stats.hits));
+  result->Set(String::NewSymbol("misses"), Number::New((double) stats.misses));
+  result->Set(String::NewSymbol("evictions"), Number::New((double) stats.evictions));
+  result->Set(String::NewSymbol("size"), Integer::NewFromUnsigned(stats.size));
+  result->Set(String::NewSymbol("capacity"), Integer::NewFromUnsigned(stats.capacity));
+  return scope.Close(result);
+}
+
+
+static Handle<Value>
+sig_cache_resize (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 1 || !args[0]->IsUint32()) {
+    return VException("One argument expected: capacity Number");
+  }
+  unsigned int capacity = args[0]->Uint32Value();
+  if (capacity > (1 << 26)) {
+    return VException("Argument 'capacity' must not exceed 67108864");
+  }
+
+  SigCache::Resize(capacity);
+  return scope.Close(Undefined());
+}
+
+
+static Handle<Value>
+verify_pool_threads (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() > 0) {
+    if (!args[0]->IsUint32()) {
+      return VException("Argument 'threads' must be a Number");
+    }
+    if (WorkPool::SetThreadCount(args[0]->Uint32Value()) != 0) {
+      return VException("Verification pool has already been started");
+    }
+  }
+
+  return scope.Close(Integer::New(WorkPool::GetThreadCount()));
+}
+
+
+static Local<Object>
+histogram_to_object (const Stats::histogram_t *hist)
+{
+  Local<Array> buckets = Array::New(Stats::BUCKETS);
+  for (int i = 0; i < Stats::BUCKETS; i++) {
+    buckets->Set(i, Number::New((double) hist->buckets[i]));
+  }
+
+  Local<Object> result = Object::New();
+  result->Set(String::NewSymbol("count"), Number::New((double) hist->count));
+  result->Set(String::NewSymbol("sumNs"), Number::New((double) hist->sum));
+  result->Set(String::NewSymbol("buckets"), buckets);
+  return result;
+}
+
+/**
+ * Counters and latency histograms of every operation, see src/stats.h.
+ */
+static Handle<Value>
+stats (const Arguments& args)
+{
+  HandleScope scope;
+
+  Stats::op_stats_t ops[Stats::OP_COUNT];
+  Stats::Get(ops);
+
+  Local<Object> opsObj = Object::New();
+  for (int op = 0; op < Stats::OP_COUNT; op++) {
+    Local<Object> opObj = Object::New();
+    opObj->Set(String::NewSymbol("good"),
+               Number::New((double) ops[op].results[Stats::RESULT_GOOD]));
+    opObj->Set(String::NewSymbol("bad"),
+               Number::New((double) ops[op].results[Stats::RESULT_BAD]));
+    opObj->Set(String::NewSymbol("error"),
+               Number::New((double) ops[op].results[Stats::RESULT_ERROR]));
+    opObj->Set(String::NewSymbol("wait"), histogram_to_object(&ops[op].wait));
+    opObj->Set(String::NewSymbol("run"), histogram_to_object(&ops[op].run));
+    opsObj->Set(String::NewSymbol(Stats::GetName((Stats::op_t) op)), opObj);
+  }
+
+  Local<Object> result = Object::New();
+  result->Set(String::NewSymbol("enabled"), Boolean::New(Stats::IsEnabled()));
+  result->Set(String::NewSymbol("ops"), opsObj);
+  return scope.Close(result);
+}
+
+
+static Handle<Value>
+reset_stats (const Arguments& args)
+{
+  HandleScope scope;
+  Stats::Reset();
+  return scope.Close(Undefined());
+}
+
+
+static Handle<Value>
+secp256k1_verify (const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 3) {
+    return VException("Three arguments expected: pubkey, hash, sig");
+  }
+  if (!Buffer::HasInstance(args[0])) {
+    return VException("Argument 'pubkey' must be of type Buffer");
+  }
+  if (!Buffer::HasInstance(args[1])) {
+    return VException("Argument 'hash' must be of type Buffer");
+  }
+  if (!Buffer::HasInstance(args[2])) {
+    return VException("Argument 'sig' must be of type Buffer");
+  }
+
+  if (Buffer::Length(args[1]) != 32) {
+    return VException("Argument 'hash' must be 32 bytes");
+  }
+
+  int result = Secp256k1::Verify(
+    (const unsigned char *) Buffer::Data(args[0]), Buffer::Length(args[0]),
+    (const unsigned char *) Buffer::Data(args[1]),
+    (const unsigned char *) Buffer::Data(args[2]), Buffer::Length(args[2]));
+
+  // Undecodable keys and signatures simply don't verify
+  return scope.Close(Boolean::New(result == 1));
 }
 
 
@@ -296,11 +1186,59 @@ extern "C" void
 init (Handle<Object> target)
 {
   HandleScope scope;
+  PubKeyCache::Init(PUBKEY_CACHE_DEFAULT_SIZE);
+  SigCache::Init(SIG_CACHE_DEFAULT_SIZE);
+  WorkPool::Init();
+  Secp256k1::Init();
+  Sha256::Init();
   BitcoinKey::Init(target);
+  CoinCache::Init(target);
+  Framer::Init(target);
+  Interpreter::Init(target);
+  MemPool::Init(target);
+  NonceScanner::Init(target);
+  SigHashTx::Init(target);
+  StandardInput::Init(target);
+  UInt256::Init(target);
+  WorkTemplate::Init(target);
   target->Set(String::New("pubkey_to_address256"), FunctionTemplate::New(pubkey_to_address256)->GetFunction());
+  target->Set(String::New("pubkey_to_address256_into"), FunctionTemplate::New(pubkey_to_address256_into)->GetFunction());
+  target->Set(String::New("hash160_many"), FunctionTemplate::New(hash160_many)->GetFunction());
+  target->Set(String::New("address_many"), FunctionTemplate::New(address_many)->GetFunction());
   target->Set(String::New("base58_encode"), FunctionTemplate::New(base58_encode)->GetFunction());
   target->Set(String::New("base58_decode"), FunctionTemplate::New(base58_decode)->GetFunction());
+  target->Set(String::New("base58check_encode"), FunctionTemplate::New(base58check_encode)->GetFunction());
+  target->Set(String::New("base58check_decode"), FunctionTemplate::New(base58check_decode)->GetFunction());
+  target->Set(String::New("base58_encode_many"), FunctionTemplate::New(base58_encode_many)->GetFunction());
+  target->Set(String::New("base58_decode_many"), FunctionTemplate::New(base58_decode_many)->GetFunction());
+  target->Set(String::New("base58check_encode_many"), FunctionTemplate::New(base58check_encode_many)->GetFunction());
+  target->Set(String::New("base58check_decode_many"), FunctionTemplate::New(base58check_decode_many)->GetFunction());
   target->Set(String::New("sha256_midstate"), FunctionTemplate::New(sha256_midstate)->GetFunction());
+  target->Set(String::New("sha256_midstate_into"), FunctionTemplate::New(sha256_midstate_into)->GetFunction());
+  target->Set(String::New("sha256d"), FunctionTemplate::New(sha256d)->GetFunction());
+  target->Set(String::New("sha256d_many"), FunctionTemplate::New(sha256d_many)->GetFunction());
+  target->Set(String::New("sha256_implementation"), FunctionTemplate::New(sha256_implementation)->GetFunction());
+  target->Set(String::New("merkle_root"), FunctionTemplate::New(merkle_root)->GetFunction());
+  target->Set(String::New("merkle_tree"), FunctionTemplate::New(merkle_tree)->GetFunction());
+  target->Set(String::New("merkle_branch"), FunctionTemplate::New(merkle_branch)->GetFunction());
+  target->Set(String::New("validate_headers"), FunctionTemplate::New(validate_headers)->GetFunction());
+  target->Set(String::New("sighash"), FunctionTemplate::New(sighash)->GetFunction());
+  target->Set(String::New("sighash_many"), FunctionTemplate::New(sighash_many)->GetFunction());
+  target->Set(String::New("parse_tx"), FunctionTemplate::New(parse_tx)->GetFunction());
+  target->Set(String::New("parse_block"), FunctionTemplate::New(parse_block)->GetFunction());
+  target->Set(String::New("pubkey_cache_stats"), FunctionTemplate::New(pubkey_cache_stats)->GetFunction());
+  target->Set(String::New("pubkey_cache_resize"), FunctionTemplate::New(pubkey_cache_resize)->GetFunction());
+  target->Set(String::New("sig_cache_stats"), FunctionTemplate::New(sig_cache_stats)->GetFunction());
+  target->Set(String::New("sig_cache_resize"), FunctionTemplate::New(sig_cache_resize)->GetFunction());
+  target->Set(String::New("verify_pool_threads"), FunctionTemplate::New(verify_pool_threads)->GetFunction());
+  target->Set(String::New("secp256k1_verify"), FunctionTemplate::New(secp256k1_verify)->GetFunction());
+  target->Set(String::New("stats"), FunctionTemplate::New(stats)->GetFunction());
+  target->Set(String::New("reset_stats"), FunctionTemplate::New(reset_stats)->GetFunction());
+#ifdef USE_SECP256K1
+  target->Set(String::New("ecdsa_backend"), String::New("secp256k1"));
+#else
+  target->Set(String::New("ecdsa_backend"), String::New("openssl"));
+#endif
 }
 
 NODE_MODULE(native, init)
@@ -0,0 +1,548 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <v8.h>
+
+#include <node.h>
+#include <node_buffer.h>
+
+#include <openssl/rand.h>
+
+#include "common.h"
+#include "mempool.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+
+#define INITIAL_CAPACITY 64
+
+MemPool::Index::Index(size_t keySize, uint32_t salt) :
+  mask(INITIAL_CAPACITY - 1),
+  size(0),
+  keySize(keySize),
+  salt(salt)
+{
+  table = (slot_t *) calloc(INITIAL_CAPACITY, sizeof(slot_t));
+}
+
+MemPool::Index::~Index()
+{
+  free(table);
+}
+
+uint32_t MemPool::Index::Hash(const unsigned char *key) const
+{
+  // FNV-1a
+  uint32_t hash = 2166136261u ^ salt;
+  for (size_t i = 0; i < keySize; i++) {
+    hash ^= key[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Slot of the entry for key, or the empty slot where it would go.
+ */
+size_t MemPool::Index::Find(const unsigned char *key, uint32_t hash) const
+{
+  size_t slot = hash & mask;
+  while (table[slot].key != NULL) {
+    if (table[slot].hash == hash &&
+        memcmp(table[slot].key, key, keySize) == 0) {
+      break;
+    }
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+MemPool::entry_t *MemPool::Index::Get(const unsigned char *key) const
+{
+  return table[Find(key, Hash(key))].entry;
+}
+
+/**
+ * Add a key that isn't in the table yet. The key must stay valid until it
+ * is removed again.
+ */
+void MemPool::Index::Insert(const unsigned char *key, entry_t *entry)
+{
+  if ((size + 1) * 4 > (mask + 1) * 3) {
+    Grow();
+  }
+
+  uint32_t hash = Hash(key);
+  size_t slot = Find(key, hash);
+  table[slot].key = key;
+  table[slot].entry = entry;
+  table[slot].hash = hash;
+  size++;
+}
+
+/**
+ * Clear slot and close the gap by moving later entries of the probe
+ * sequence back (no tombstones).
+ */
+void MemPool::Index::Remove(size_t slot)
+{
+  size--;
+
+  size_t i = slot;
+  size_t j = slot;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (table[j].key == NULL) break;
+
+    // The entry at j may move to i unless its home slot lies in (i, j]
+    size_t home = table[j].hash & mask;
+    bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+    if (!stays) {
+      table[i] = table[j];
+      i = j;
+    }
+  }
+  table[i].key = NULL;
+  table[i].entry = NULL;
+}
+
+void MemPool::Index::Grow()
+{
+  slot_t *old = table;
+  size_t oldCapacity = mask + 1;
+
+  table = (slot_t *) calloc(oldCapacity * 2, sizeof(slot_t));
+  mask = oldCapacity * 2 - 1;
+
+  for (size_t i = 0; i < oldCapacity; i++) {
+    if (old[i].key == NULL) continue;
+
+    size_t slot = old[i].hash & mask;
+    while (table[slot].key != NULL) {
+      slot = (slot + 1) & mask;
+    }
+    table[slot] = old[i];
+  }
+
+  free(old);
+}
+
+Persistent<FunctionTemplate> MemPool::s_ct;
+
+void MemPool::Init(Handle<Object> target)
+{
+  HandleScope scope;
+  Local<FunctionTemplate> t = FunctionTemplate::New(New);
+
+  s_ct = Persistent<FunctionTemplate>::New(t);
+  s_ct->InstanceTemplate()->SetInternalFieldCount(1);
+  s_ct->SetClassName(String::NewSymbol("MemPool"));
+
+  // Methods
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "put", Put);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "get", Get);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "has", Has);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "remove", Remove);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "getMany", GetMany);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "hasMany", HasMany);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "getSpenders", GetSpenders);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "getAll", GetAll);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "trim", Trim);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "count", Count);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "stats", Stats);
+
+  target->Set(String::NewSymbol("MemPool"),
+              s_ct->GetFunction());
+}
+
+MemPool::MemPool(size_t maxBytes, uint32_t salt) :
+  maxBytes(maxBytes),
+  txs(HASH_SIZE, salt),
+  spends(OUTPOINT_SIZE, salt),
+  oldest(NULL),
+  newest(NULL),
+  entryBytes(0),
+  evictions(0)
+{
+}
+
+MemPool::~MemPool()
+{
+  while (oldest != NULL) {
+    Free(oldest);
+  }
+}
+
+size_t MemPool::MemoryUsage() const
+{
+  return entryBytes +
+    (txs.mask + 1 + spends.mask + 1) * sizeof(Index::slot_t);
+}
+
+/**
+ * Register entry as the spender of outpoints. Outpoints that already have
+ * a spender keep it.
+ */
+void MemPool::AddSpends(entry_t *entry, const unsigned char *outpoints, size_t count)
+{
+  if (count == 0) return;
+
+  entry->outpoints = (unsigned char *) malloc(count * OUTPOINT_SIZE);
+  memcpy(entry->outpoints, outpoints, count * OUTPOINT_SIZE);
+  entry->outpointCount = count;
+  entryBytes += count * OUTPOINT_SIZE;
+
+  for (size_t i = 0; i < count; i++) {
+    const unsigned char *outpoint = entry->outpoints + OUTPOINT_SIZE * i;
+    if (spends.Get(outpoint) == NULL) {
+      spends.Insert(outpoint, entry);
+    }
+  }
+}
+
+void MemPool::RemoveSpends(entry_t *entry)
+{
+  for (uint32_t i = 0; i < entry->outpointCount; i++) {
+    const unsigned char *outpoint = entry->outpoints + OUTPOINT_SIZE * i;
+    size_t slot = spends.Find(outpoint, spends.Hash(outpoint));
+    if (spends.table[slot].entry == entry) {
+      spends.Remove(slot);
+    }
+  }
+
+  entryBytes -= entry->outpointCount * OUTPOINT_SIZE;
+  free(entry->outpoints);
+  entry->outpoints = NULL;
+  entry->outpointCount = 0;
+}
+
+void MemPool::Free(entry_t *entry)
+{
+  RemoveSpends(entry);
+  txs.Remove(txs.Find(entry->hash, txs.Hash(entry->hash)));
+
+  if (entry->prev) entry->prev->next = entry->next;
+  else oldest = entry->next;
+  if (entry->next) entry->next->prev = entry->prev;
+  else newest = entry->prev;
+
+  entryBytes -= sizeof(entry_t) + entry->size;
+  entry->value.Dispose();
+  delete entry;
+}
+
+static bool
+is_hash (Handle<Value> value)
+{
+  return Buffer::HasInstance(value) && Buffer::Length(value) == 32;
+}
+
+Handle<Value>
+MemPool::New(const Arguments& args)
+{
+  if (!args.IsConstructCall()) {
+    return FromConstructorTemplate(s_ct, args);
+  }
+
+  HandleScope scope;
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: maxBytes");
+  }
+  if (!args[0]->IsNumber() || args[0]->NumberValue() < 0) {
+    return VException("Argument 'maxBytes' must be a positive Number");
+  }
+
+  // Hashes are chosen by whoever creates the transactions, so the table
+  // layout must not be predictable
+  uint32_t salt;
+  if (!RAND_bytes((unsigned char *)&salt, sizeof(salt))) {
+    return VException("Unable to seed memory pool");
+  }
+
+  MemPool* pool = new MemPool((size_t) args[0]->NumberValue(), salt);
+  pool->Wrap(args.Holder());
+
+  return scope.Close(args.This());
+}
+
+Handle<Value>
+MemPool::Put(const Arguments& args)
+{
+  HandleScope scope;
+  MemPool* pool = ObjectWrap::Unwrap<MemPool>(args.This());
+
+  if (args.Length() != 2 && args.Length() != 4) {
+    return VException("Two or four arguments expected: hash, value[, size, outpoints]");
+  }
+  if (!is_hash(args[0])) {
+    return VException("Argument 'hash' must be Buffer of length 32 bytes");
+  }
+
+  size_t size = 0;
+  const unsigned char *outpoints = NULL;
+  size_t outpointCount = 0;
+  if (args.Length() == 4) {
+    if (!args[2]->IsUint32()) {
+      return VException("Argument 'size' must be a Number");
+    }
+    if (!Buffer::HasInstance(args[3]) ||
+        Buffer::Length(args[3]) % OUTPOINT_SIZE) {
+      return VException("Argument 'outpoints' must be Buffer of 36 byte outpoints");
+    }
+    size = args[2]->Uint32Value();
+    outpoints = (const unsigned char *) Buffer::Data(args[3]);
+    outpointCount = Buffer::Length(args[3]) / OUTPOINT_SIZE;
+  }
+
+  const unsigned char *hash = (const unsigned char *) Buffer::Data(args[0]);
+  entry_t *entry = pool->txs.Get(hash);
+  bool isNew = entry == NULL;
+
+  if (isNew) {
+    entry = new entry_t;
+    memcpy(entry->hash, hash, HASH_SIZE);
+    entry->size = 0;
+    entry->outpoints = NULL;
+    entry->outpointCount = 0;
+
+    entry->prev = pool->newest;
+    entry->next = NULL;
+    if (pool->newest) pool->newest->next = entry;
+    else pool->oldest = entry;
+    pool->newest = entry;
+
+    pool->txs.Insert(entry->hash, entry);
+    pool->entryBytes += sizeof(entry_t);
+  } else {
+    // Replacing keeps the age of the entry
+    entry->value.Dispose();
+    pool->RemoveSpends(entry);
+  }
+
+  entry->value = Persistent<Value>::New(args[1]);
+  pool->entryBytes += size - entry->size;
+  entry->size = size;
+  pool->AddSpends(entry, outpoints, outpointCount);
+
+  return scope.Close(Boolean::New(isNew));
+}
+
+Handle<Value>
+MemPool::Get(const Arguments& args)
+{
+  HandleScope scope;
+  MemPool* pool = ObjectWrap::Unwrap<MemPool>(args.This());
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: hash");
+  }
+  if (!is_hash(args[0])) {
+    return VException("Argument 'hash' must be Buffer of length 32 bytes");
+  }
+
+  entry_t *entry = pool->txs.Get((const unsigned char *) Buffer::Data(args[0]));
+  if (entry == NULL) {
+    return scope.Close(Undefined());
+  }
+  return scope.Close(entry->value);
+}
+
+Handle<Value>
+MemPool::Has(const Arguments& args)
+{
+  HandleScope scope;
+  MemPool* pool = ObjectWrap::Unwrap<MemPool>(args.This());
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: hash");
+  }
+  if (!is_hash(args[0])) {
+    return VException("Argument 'hash' must be Buffer of length 32 bytes");
+  }
+
+  entry_t *entry = pool->txs.Get((const unsigned char *) Buffer::Data(args[0]));
+  return scope.Close(Boolean::New(entry != NULL));
+}
+
+Handle<Value>
+MemPool::Remove(const Arguments& args)
+{
+  HandleScope scope;
+  MemPool* pool = ObjectWrap::Unwrap<MemPool>(args.This());
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: hash");
+  }
+  if (!is_hash(args[0])) {
+    return VException("Argument 'hash' must be Buffer of length 32 bytes");
+  }
+
+  entry_t *entry = pool->txs.Get((const unsigned char *) Buffer::Data(args[0]));
+  if (entry == NULL) {
+    return scope.Close(Undefined());
+  }
+
+  Local<Value> value = Local<Value>::New(entry->value);
+  pool->Free(entry);
+  return scope.Close(value);
+}
+
+Handle<Value>
+MemPool::GetMany(const Arguments& args)
+{
+  HandleScope scope;
+  MemPool* pool = ObjectWrap::Unwrap<MemPool>(args.This());
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: hashes");
+  }
+  if (!args[0]->IsArray()) {
+    return VException("Argument 'hashes' must be an Array");
+  }
+
+  Local<Array> hashes = Local<Array>::Cast(args[0]);
+  uint32_t count = hashes->Length();
+  Local<Array> result = Array::New(count);
+
+  for (uint32_t i = 0; i < count; i++) {
+    Local<Value> hash = hashes->Get(i);
+    if (!is_hash(hash)) {
+      return VException("Argument 'hashes' must be an Array of 32 byte Buffers");
+    }
+
+    entry_t *entry = pool->txs.Get((const unsigned char *) Buffer::Data(hash));
+    if (entry == NULL) {
+      result->Set(i, Undefined());
+    } else {
+      result->Set(i, entry->value);
+    }
+  }
+
+  return scope.Close(result);
+}
+
+Handle<Value>
+MemPool::HasMany(const Arguments& args)
+{
+  HandleScope scope;
+  MemPool* pool = ObjectWrap::Unwrap<MemPool>(args.This());
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: hashes");
+  }
+  if (!args[0]->IsArray()) {
+    return VException("Argument 'hashes' must be an Array");
+  }
+
+  Local<Array> hashes = Local<Array>::Cast(args[0]);
+  uint32_t count = hashes->Length();
+  Local<Array> result = Array::New(count);
+
+  for (uint32_t i = 0; i < count; i++) {
+    Local<Value> hash = hashes->Get(i);
+    if (!is_hash(hash)) {
+      return VException("Argument 'hashes' must be an Array of 32 byte Buffers");
+    }
+
+    entry_t *entry = pool->txs.Get((const unsigned char *) Buffer::Data(hash));
+    result->Set(i, Boolean::New(entry != NULL));
+  }
+
+  return scope.Close(result);
+}
+
+Handle<Value>
+MemPool::GetSpenders(const Arguments& args)
+{
+  HandleScope scope;
+  MemPool* pool = ObjectWrap::Unwrap<MemPool>(args.This());
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: outpoints");
+  }
+  if (!Buffer::HasInstance(args[0]) ||
+      Buffer::Length(args[0]) % OUTPOINT_SIZE) {
+    return VException("Argument 'outpoints' must be Buffer of 36 byte outpoints");
+  }
+
+  const unsigned char *outpoints = (const unsigned char *) Buffer::Data(args[0]);
+  size_t count = Buffer::Length(args[0]) / OUTPOINT_SIZE;
+  Local<Array> result = Array::New(count);
+
+  for (size_t i = 0; i < count; i++) {
+    entry_t *entry = pool->spends.Get(outpoints + OUTPOINT_SIZE * i);
+    if (entry == NULL) {
+      result->Set(i, Null());
+    } else {
+      Buffer *hash_buf = Buffer::New((const char *) entry->hash, HASH_SIZE);
+      result->Set(i, hash_buf->handle_);
+    }
+  }
+
+  return scope.Close(result);
+}
+
+Handle<Value>
+MemPool::GetAll(const Arguments& args)
+{
+  HandleScope scope;
+  MemPool* pool = ObjectWrap::Unwrap<MemPool>(args.This());
+
+  Local<Array> result = Array::New(pool->txs.size);
+  uint32_t i = 0;
+  for (entry_t *entry = pool->oldest; entry != NULL; entry = entry->next) {
+    result->Set(i++, entry->value);
+  }
+
+  return scope.Close(result);
+}
+
+Handle<Value>
+MemPool::Trim(const Arguments& args)
+{
+  HandleScope scope;
+  MemPool* pool = ObjectWrap::Unwrap<MemPool>(args.This());
+
+  Local<Array> evicted = Array::New();
+  uint32_t n = 0;
+
+  entry_t *entry = pool->oldest;
+  while (entry != NULL && pool->MemoryUsage() > pool->maxBytes) {
+    entry_t *next = entry->next;
+    if (entry->size > 0) {
+      evicted->Set(n++, Local<Value>::New(entry->value));
+      pool->Free(entry);
+      pool->evictions++;
+    }
+    entry = next;
+  }
+
+  return scope.Close(evicted);
+}
+
+Handle<Value>
+MemPool::Count(const Arguments& args)
+{
+  HandleScope scope;
+  MemPool* pool = ObjectWrap::Unwrap<MemPool>(args.This());
+
+  return scope.Close(Number::New(pool->txs.size));
+}
+
+Handle<Value>
+MemPool::Stats(const Arguments& args)
+{
+  HandleScope scope;
+  MemPool* pool = ObjectWrap::Unwrap<MemPool>(args.This());
+
+  Local<Object> stats = Object::New();
+  stats->Set(String::NewSymbol("count"), Number::New(pool->txs.size));
+  stats->Set(String::NewSymbol("spends"), Number::New(pool->spends.size));
+  stats->Set(String::NewSymbol("memory"), Number::New(pool->MemoryUsage()));
+  stats->Set(String::NewSymbol("maxBytes"), Number::New(pool->maxBytes));
+  stats->Set(String::NewSymbol("evictions"), Number::New(pool->evictions));
+
+  return scope.Close(stats);
+}
@@ -0,0 +1,138 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_MEMPOOL_H_
+#define BITCOINJS_SERVER_INCLUDE_MEMPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+using namespace node;
+
+/**
+ * Memory pool of transactions keyed by their 32 byte binary hash.
+ *
+ * Each entry holds an arbitrary JavaScript value (the Transaction, or
+ * whatever the caller keeps while it is being verified), the size of its
+ * serialized form and the outpoints it spends. A second table maps every
+ * spent outpoint to the first pooled transaction spending it, so conflicts
+ * are found without scanning the pool.
+ *
+ * Memory use is the serialized sizes plus the native entries and tables.
+ * Once it exceeds the cap, trim() evicts the oldest transactions. Entries
+ * without a size (still being verified) are never evicted.
+ *
+ * JavaScript API:
+ *
+ *   new MemPool(maxBytes)
+ *   pool.put(hash, value[, size, outpoints])  -> Boolean, whether it is new
+ *   pool.get(hash)                            -> value or undefined
+ *   pool.has(hash)                            -> Boolean
+ *   pool.remove(hash)                         -> removed value or undefined
+ *   pool.getMany(hashes)                      -> Array of values
+ *   pool.hasMany(hashes)                      -> Array of Booleans
+ *   pool.getSpenders(outpoints)               -> Array of hashes or null
+ *   pool.getAll()                             -> Array of values, oldest first
+ *   pool.trim()                               -> Array of evicted values
+ *   pool.count()
+ *   pool.stats()
+ *
+ * outpoints are Buffers of concatenated 36 byte outpoints, hashes are
+ * Arrays of 32 byte Buffers.
+ */
+class MemPool : ObjectWrap
+{
+private:
+
+  enum {
+    HASH_SIZE = 32,
+    OUTPOINT_SIZE = 36
+  };
+
+  struct entry_t {
+    unsigned char hash[HASH_SIZE];
+    Persistent<Value> value;
+    size_t size;
+
+    // Spent outpoints, OUTPOINT_SIZE bytes each
+    unsigned char *outpoints;
+    uint32_t outpointCount;
+
+    // Insertion order
+    entry_t *prev;
+    entry_t *next;
+  };
+
+  /**
+   * Open addressing table from keys stored elsewhere to entries.
+   */
+  class Index
+  {
+  public:
+    struct slot_t {
+      const unsigned char *key;
+      entry_t *entry;
+      uint32_t hash;
+    };
+
+    slot_t *table;
+    size_t mask;
+    size_t size;
+    size_t keySize;
+    uint32_t salt;
+
+    Index(size_t keySize, uint32_t salt);
+    ~Index();
+
+    uint32_t Hash(const unsigned char *key) const;
+    size_t Find(const unsigned char *key, uint32_t hash) const;
+    entry_t *Get(const unsigned char *key) const;
+    void Insert(const unsigned char *key, entry_t *entry);
+    void Remove(size_t slot);
+    void Grow();
+  };
+
+  size_t maxBytes;
+
+  Index txs;
+  Index spends;
+
+  entry_t *oldest;
+  entry_t *newest;
+
+  // Serialized sizes plus entries and outpoint copies
+  size_t entryBytes;
+
+  uint64_t evictions;
+
+  MemPool(size_t maxBytes, uint32_t salt);
+  ~MemPool();
+
+  size_t MemoryUsage() const;
+
+  void AddSpends(entry_t *entry, const unsigned char *outpoints, size_t count);
+  void RemoveSpends(entry_t *entry);
+  void Free(entry_t *entry);
+
+public:
+
+  static Persistent<FunctionTemplate> s_ct;
+
+  static void Init(Handle<Object> target);
+
+  static Handle<Value> New(const Arguments& args);
+  static Handle<Value> Put(const Arguments& args);
+  static Handle<Value> Get(const Arguments& args);
+  static Handle<Value> Has(const Arguments& args);
+  static Handle<Value> Remove(const Arguments& args);
+  static Handle<Value> GetMany(const Arguments& args);
+  static Handle<Value> HasMany(const Arguments& args);
+  static Handle<Value> GetSpenders(const Arguments& args);
+  static Handle<Value> GetAll(const Arguments& args);
+  static Handle<Value> Trim(const Arguments& args);
+  static Handle<Value> Count(const Arguments& args);
+  static Handle<Value> Stats(const Arguments& args);
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include <string.h>
+
+#include "merkle.h"
+#include "sha256.h"
+
+size_t Merkle::TreeSize(size_t count)
+{
+  size_t total = 1;
+  for (size_t size = count; size > 1; size = (size + 1) / 2) {
+    total += size;
+  }
+  return total;
+}
+
+size_t Merkle::BranchSize(size_t count)
+{
+  size_t depth = 0;
+  for (size_t size = count; size > 1; size = (size + 1) / 2) {
+    depth++;
+  }
+  return depth;
+}
+
+void Merkle::BuildTree(unsigned char *tree, const unsigned char *leaves, size_t count)
+{
+  memcpy(tree, leaves, 32 * count);
+
+  unsigned char *level = tree;
+  for (size_t size = count; size > 1; size = (size + 1) / 2) {
+    unsigned char *next = level + 32 * size;
+
+    // Pairs of siblings are already adjacent in memory
+    Sha256::Double64(next, level, size / 2);
+
+    if (size & 1) {
+      unsigned char pair[64];
+      memcpy(pair, level + 32 * (size - 1), 32);
+      memcpy(pair + 32, level + 32 * (size - 1), 32);
+      Sha256::Double(next + 32 * (size / 2), pair, 64);
+    }
+
+    level = next;
+  }
+}
+
+void Merkle::GetBranch(unsigned char *branch, const unsigned char *tree,
+                       size_t count, size_t index)
+{
+  const unsigned char *level = tree;
+  for (size_t size = count; size > 1; size = (size + 1) / 2) {
+    size_t sibling = index ^ 1;
+    if (sibling > size - 1) {
+      sibling = size - 1;
+    }
+    memcpy(branch, level + 32 * sibling, 32);
+
+    branch += 32;
+    level += 32 * size;
+    index >>= 1;
+  }
+}
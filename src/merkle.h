@@ -0,0 +1,40 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_MERKLE_H_
+#define BITCOINJS_SERVER_INCLUDE_MERKLE_H_
+
+#include <stddef.h>
+
+/**
+ * Merkle trees over 32 byte hashes.
+ *
+ * The layout is the same as CBlock::BuildMerkleTree(): all leaves, then
+ * each level above them, ending with the root. A level with an odd number
+ * of nodes pairs its last node with itself.
+ */
+class Merkle
+{
+public:
+
+  /**
+   * Number of hashes in the tree over count leaves (count > 0).
+   */
+  static size_t TreeSize(size_t count);
+
+  /**
+   * Number of hashes in a branch for a tree over count leaves.
+   */
+  static size_t BranchSize(size_t count);
+
+  /**
+   * Build the whole tree. tree must have room for TreeSize(count) hashes.
+   */
+  static void BuildTree(unsigned char *tree, const unsigned char *leaves, size_t count);
+
+  /**
+   * Extract the branch for the leaf at index from a tree built by
+   * BuildTree(). branch must have room for BranchSize(count) hashes.
+   */
+  static void GetBranch(unsigned char *branch, const unsigned char *tree,
+                        size_t count, size_t index);
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include <string.h>
+
+#include <v8.h>
+
+#include <node.h>
+#include <node_buffer.h>
+
+#include "common.h"
+#include "noncescanner.h"
+#include "sha256.h"
+#include "workpool.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+
+// Offset of the nonce in the header, and in the second block of the header
+#define NONCE_POS 76
+#define TAIL_NONCE_POS (NONCE_POS - 64)
+
+// Nonces hashed between checks for cancellation
+#define SCAN_BATCH_SIZE 4096
+
+NonceScanner::job_t *NonceScanner::jobs = NULL;
+int NonceScanner::nextId = 1;
+
+static inline void WriteBE32(unsigned char *p, uint32_t x)
+{
+  p[0] = x >> 24;
+  p[1] = x >> 16;
+  p[2] = x >> 8;
+  p[3] = x;
+}
+
+static inline uint32_t ReadBE32(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+void NonceScanner::Init(Handle<Object> target)
+{
+  HandleScope scope;
+
+  target->Set(String::New("scan_nonce"), FunctionTemplate::New(Scan)->GetFunction());
+  target->Set(String::New("scan_nonce_cancel"), FunctionTemplate::New(Cancel)->GetFunction());
+  target->Set(String::New("scan_nonce_stats"), FunctionTemplate::New(Stats)->GetFunction());
+}
+
+NonceScanner::job_t *NonceScanner::Find(int id)
+{
+  for (job_t *job = jobs; job; job = job->next) {
+    if (job->id == id) return job;
+  }
+  return NULL;
+}
+
+void NonceScanner::Run(void *arg)
+{
+  thread_t *self = static_cast<thread_t *>(arg);
+  job_t *job = self->job;
+
+  unsigned char block[64];
+  memcpy(block, job->tail, 64);
+
+  // Second hash of the 32 byte digest, padding is always the same
+  unsigned char digest[64];
+  memset(digest, 0, 64);
+  digest[32] = 0x80;
+  digest[62] = 0x01;
+
+  // Hashes are compared as big endian numbers, i.e. byte reversed, so the
+  // top word of the target decides most candidates
+  uint32_t targetTop = ReadBE32(job->target);
+
+  uint64_t n = self->begin;
+  while (n < self->end && !job->stop) {
+    uint64_t batchEnd = n + SCAN_BATCH_SIZE;
+    if (batchEnd > self->end) batchEnd = self->end;
+    uint64_t batchStart = n;
+
+    for (; n < batchEnd; n++) {
+      uint32_t nonce = (uint32_t) n;
+      block[TAIL_NONCE_POS] = nonce & 0xff;
+      block[TAIL_NONCE_POS + 1] = (nonce >> 8) & 0xff;
+      block[TAIL_NONCE_POS + 2] = (nonce >> 16) & 0xff;
+      block[TAIL_NONCE_POS + 3] = (nonce >> 24) & 0xff;
+
+      uint32_t state[8];
+      memcpy(state, job->midstate, sizeof(state));
+      Sha256::Transform(state, block, 1);
+      for (int i = 0; i < 8; i++) {
+        WriteBE32(digest + 4 * i, state[i]);
+      }
+      Sha256::Initialize(state);
+      Sha256::Transform(state, digest, 1);
+
+      // The first four bytes of the reversed hash are the last word,
+      // byte swapped
+      uint32_t top = __builtin_bswap32(state[7]);
+      if (top > targetTop) continue;
+
+      unsigned char hash[32];
+      for (int i = 0; i < 8; i++) {
+        uint32_t word = state[7 - i];
+        hash[4 * i] = word & 0xff;
+        hash[4 * i + 1] = (word >> 8) & 0xff;
+        hash[4 * i + 2] = (word >> 16) & 0xff;
+        hash[4 * i + 3] = (word >> 24) & 0xff;
+      }
+
+      if (memcmp(hash, job->target, 32) < 0) {
+        uv_mutex_lock(&job->mutex);
+        if (!job->found) {
+          job->found = true;
+          job->nonce = nonce;
+        }
+        job->stop = 1;
+        uv_mutex_unlock(&job->mutex);
+
+        n++;
+        break;
+      }
+    }
+
+    __sync_fetch_and_add(&job->hashes, n - batchStart);
+  }
+
+  // The last thread out reports back to the loop
+  if (__sync_sub_and_fetch(&job->running, 1) == 0) {
+    job->endTime = uv_hrtime();
+    uv_async_send(&job->async);
+  }
+}
+
+Local<Object> NonceScanner::GetStats(job_t *job)
+{
+  uint64_t end = job->running ? uv_hrtime() : job->endTime;
+  double seconds = (end - job->startTime) / 1e9;
+  double hashes = (double) job->hashes;
+
+  Local<Object> stats = Object::New();
+  stats->Set(String::NewSymbol("hashes"), Number::New(hashes));
+  stats->Set(String::NewSymbol("seconds"), Number::New(seconds));
+  stats->Set(String::NewSymbol("hashrate"), Number::New(seconds > 0 ? hashes / seconds : 0));
+  return stats;
+}
+
+void NonceScanner::OnDone(uv_async_t *handle, int status)
+{
+  HandleScope scope;
+  job_t *job = static_cast<job_t *>(handle->data);
+
+  for (int i = 0; i < job->threadCount; i++) {
+    uv_thread_join(&job->threads[i].thread);
+  }
+
+  // Unlink from the list of scans in progress
+  job_t **link = &jobs;
+  while (*link != job) link = &(*link)->next;
+  *link = job->next;
+
+  Local<Value> argv[3];
+
+  if (job->found) {
+    argv[0] = Local<Value>::New(Null());
+    argv[1] = Local<Value>::New(Integer::NewFromUnsigned(job->nonce));
+  } else {
+    argv[0] = Exception::Error(String::New(job->cancelled ?
+                                           "Nonce scan cancelled" :
+                                           "Nonce space exhausted"));
+    argv[1] = Local<Value>::New(Null());
+  }
+  argv[2] = GetStats(job);
+
+  TryCatch try_catch;
+
+  job->cb->Call(Context::GetCurrent()->Global(), 3, argv);
+
+  job->cb.Dispose();
+  uv_close((uv_handle_t *) &job->async, OnClose);
+
+  if (try_catch.HasCaught()) {
+    FatalException(try_catch);
+  }
+}
+
+void NonceScanner::OnClose(uv_handle_t *handle)
+{
+  job_t *job = static_cast<job_t *>(handle->data);
+
+  uv_mutex_destroy(&job->mutex);
+  delete [] job->threads;
+  delete job;
+}
+
+Handle<Value> NonceScanner::Scan(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 4) {
+    return VException("Four arguments expected: header, target, threads, callback");
+  }
+  if (!Buffer::HasInstance(args[0]) || Buffer::Length(args[0]) != 80) {
+    return VException("Argument 'header' must be an 80 byte Buffer");
+  }
+  if (!Buffer::HasInstance(args[1]) || Buffer::Length(args[1]) != 32) {
+    return VException("Argument 'target' must be a 32 byte Buffer");
+  }
+  if (!args[2]->IsUint32() && !args[2]->IsUndefined() && !args[2]->IsNull()) {
+    return VException("Argument 'threads' must be a Number");
+  }
+  REQ_FUN_ARG(3, cb);
+
+  int threadCount = args[2]->IsUint32() ? args[2]->Uint32Value() : 0;
+  if (threadCount <= 0) {
+    threadCount = WorkPool::GetThreadCount();
+  }
+  if (threadCount > 256) {
+    return VException("Argument 'threads' must not exceed 256");
+  }
+
+  const unsigned char *header = (const unsigned char *) Buffer::Data(args[0]);
+
+  job_t *job = new job_t;
+  job->id = nextId++;
+
+  Sha256::Initialize(job->midstate);
+  Sha256::Transform(job->midstate, header, 1);
+
+  // Second block: the last 16 header bytes plus padding for 80 bytes
+  memset(job->tail, 0, 64);
+  memcpy(job->tail, header + 64, 16);
+  job->tail[16] = 0x80;
+  job->tail[62] = 0x02;
+  job->tail[63] = 0x80;
+
+  memcpy(job->target, Buffer::Data(args[1]), 32);
+
+  job->stop = 0;
+  job->running = threadCount;
+  job->hashes = 0;
+  uv_mutex_init(&job->mutex);
+  job->found = false;
+  job->cancelled = false;
+  job->nonce = 0;
+  job->startTime = uv_hrtime();
+  job->endTime = 0;
+  job->cb = Persistent<Function>::New(cb);
+
+  uv_async_init(uv_default_loop(), &job->async, OnDone);
+  job->async.data = job;
+
+  job->next = jobs;
+  jobs = job;
+
+  // Split the nonce space into one range per thread
+  const uint64_t space = (uint64_t) 1 << 32;
+  job->threadCount = threadCount;
+  job->threads = new thread_t[threadCount];
+  for (int i = 0; i < threadCount; i++) {
+    job->threads[i].job = job;
+    job->threads[i].begin = space * i / threadCount;
+    job->threads[i].end = space * (i + 1) / threadCount;
+  }
+  for (int i = 0; i < threadCount; i++) {
+    uv_thread_create(&job->threads[i].thread, Run, &job->threads[i]);
+  }
+
+  return scope.Close(Integer::New(job->id));
+}
+
+Handle<Value> NonceScanner::Cancel(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 1 || !args[0]->IsInt32()) {
+    return VException("One argument expected: id Number");
+  }
+
+  job_t *job = Find(args[0]->Int32Value());
+  if (job == NULL) {
+    return scope.Close(False());
+  }
+
+  uv_mutex_lock(&job->mutex);
+  if (!job->found) {
+    job->cancelled = true;
+  }
+  job->stop = 1;
+  uv_mutex_unlock(&job->mutex);
+
+  return scope.Close(True());
+}
+
+Handle<Value> NonceScanner::Stats(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 1 || !args[0]->IsInt32()) {
+    return VException("One argument expected: id Number");
+  }
+
+  job_t *job = Find(args[0]->Int32Value());
+  if (job == NULL) {
+    return scope.Close(Null());
+  }
+
+  return scope.Close(GetStats(job));
+}
@@ -0,0 +1,90 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_NONCESCANNER_H_
+#define BITCOINJS_SERVER_INCLUDE_NONCESCANNER_H_
+
+#include <stdint.h>
+
+#include <v8.h>
+#include <uv.h>
+
+using namespace v8;
+
+/**
+ * Multi-threaded search for a block header nonce.
+ *
+ * The first 64 bytes of the header don't depend on the nonce, so their
+ * SHA-256 midstate is computed once and every candidate costs two
+ * compression function calls. The nonce space is split into one range per
+ * thread. Scans run on their own threads, not the verification pool, and
+ * report back to the event loop through a uv_async_t.
+ *
+ * JavaScript API:
+ *
+ *   scan_nonce(header, target, threads, callback) -> id
+ *   scan_nonce_cancel(id) -> Boolean
+ *   scan_nonce_stats(id) -> {hashes, seconds, hashrate}
+ *
+ * The callback receives (err, nonce, stats). Cancelled scans and scans
+ * that exhaust the nonce space report an error.
+ */
+class NonceScanner
+{
+private:
+
+  struct job_t;
+
+  struct thread_t {
+    job_t *job;
+    uv_thread_t thread;
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  struct job_t {
+    int id;
+
+    uint32_t midstate[8];
+    unsigned char tail[64];
+    unsigned char target[32];
+
+    int threadCount;
+    thread_t *threads;
+
+    // Set once a nonce has been found or the scan was cancelled
+    volatile int stop;
+    volatile int running;
+    volatile uint64_t hashes;
+
+    uv_mutex_t mutex;
+    bool found;
+    bool cancelled;
+    uint32_t nonce;
+
+    uint64_t startTime;
+    uint64_t endTime;
+
+    uv_async_t async;
+    Persistent<Function> cb;
+
+    job_t *next;
+  };
+
+  // Scans in progress (loop thread only)
+  static job_t *jobs;
+  static int nextId;
+
+  static job_t *Find(int id);
+  static void Run(void *arg);
+  static void OnDone(uv_async_t *handle, int status);
+  static void OnClose(uv_handle_t *handle);
+  static Local<Object> GetStats(job_t *job);
+
+  static Handle<Value> Scan(const Arguments& args);
+  static Handle<Value> Cancel(const Arguments& args);
+  static Handle<Value> Stats(const Arguments& args);
+
+public:
+
+  static void Init(Handle<Object> target);
+};
+
+#endif
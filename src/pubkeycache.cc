@@ -0,0 +1,261 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/rand.h>
+
+#include "pubkeycache.h"
+
+uv_mutex_t PubKeyCache::mutex;
+uint32_t PubKeyCache::salt = 0;
+
+PubKeyCache::entry_t **PubKeyCache::buckets = NULL;
+unsigned int PubKeyCache::bucketMask = 0;
+
+PubKeyCache::entry_t *PubKeyCache::lruHead = NULL;
+PubKeyCache::entry_t *PubKeyCache::lruTail = NULL;
+
+unsigned int PubKeyCache::size = 0;
+unsigned int PubKeyCache::capacity = 0;
+
+uint64_t PubKeyCache::hits = 0;
+uint64_t PubKeyCache::misses = 0;
+
+void PubKeyCache::Init(unsigned int capacity)
+{
+  uv_mutex_init(&mutex);
+
+  // Salt the hash, so nobody can flood a single bucket with crafted keys
+  if (!RAND_bytes((unsigned char *)&salt, sizeof(salt))) {
+    salt = (uint32_t)(uintptr_t)&salt;
+  }
+
+  Resize(capacity);
+}
+
+uint32_t PubKeyCache::Hash(const unsigned char *pub, int len)
+{
+  // FNV-1a
+  uint32_t hash = 2166136261u ^ salt;
+  for (int i = 0; i < len; i++) {
+    hash ^= pub[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+PubKeyCache::entry_t *PubKeyCache::Find(uint32_t hash, const unsigned char *pub, int len)
+{
+  if (buckets == NULL) return NULL;
+
+  for (entry_t *entry = buckets[hash & bucketMask]; entry; entry = entry->chain) {
+    if (entry->hash == hash && entry->pubLen == len &&
+        memcmp(entry->pub, pub, len) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+void PubKeyCache::Unlink(entry_t *entry)
+{
+  if (entry->lruPrev) entry->lruPrev->lruNext = entry->lruNext;
+  else lruHead = entry->lruNext;
+  if (entry->lruNext) entry->lruNext->lruPrev = entry->lruPrev;
+  else lruTail = entry->lruPrev;
+  entry->lruPrev = entry->lruNext = NULL;
+}
+
+void PubKeyCache::Touch(entry_t *entry)
+{
+  if (entry == lruHead) return;
+
+  Unlink(entry);
+  entry->lruNext = lruHead;
+  if (lruHead) lruHead->lruPrev = entry;
+  lruHead = entry;
+  if (lruTail == NULL) lruTail = entry;
+}
+
+void PubKeyCache::Evict()
+{
+  entry_t *entry = lruTail;
+  if (entry == NULL) return;
+
+  Unlink(entry);
+
+  entry_t **link = &buckets[entry->hash & bucketMask];
+  while (*link != entry) link = &(*link)->chain;
+  *link = entry->chain;
+
+  if (entry->point) EC_POINT_free(entry->point);
+  free(entry);
+  size--;
+}
+
+void PubKeyCache::Rehash(unsigned int bucketCount)
+{
+  free(buckets);
+  buckets = (entry_t **)calloc(bucketCount, sizeof(entry_t *));
+  bucketMask = bucketCount - 1;
+
+  for (entry_t *entry = lruHead; entry; entry = entry->lruNext) {
+    entry_t **bucket = &buckets[entry->hash & bucketMask];
+    entry->chain = *bucket;
+    *bucket = entry;
+  }
+}
+
+PubKeyCache::entry_t *PubKeyCache::Insert(uint32_t hash, const unsigned char *pub, int len)
+{
+  if (capacity == 0) return NULL;
+
+  // Another thread may have inserted the same key in the meantime
+  entry_t *entry = Find(hash, pub, len);
+  if (entry != NULL) return entry;
+
+  while (size >= capacity) {
+    Evict();
+  }
+
+  entry = (entry_t *)malloc(sizeof(entry_t));
+  entry->hash = hash;
+  entry->pubLen = len;
+  memcpy(entry->pub, pub, len);
+  entry->point = NULL;
+  entry->hasQ = false;
+
+  entry_t **bucket = &buckets[hash & bucketMask];
+  entry->chain = *bucket;
+  *bucket = entry;
+
+  entry->lruPrev = NULL;
+  entry->lruNext = lruHead;
+  if (lruHead) lruHead->lruPrev = entry;
+  lruHead = entry;
+  if (lruTail == NULL) lruTail = entry;
+
+  size++;
+
+  return entry;
+}
+
+int PubKeyCache::SetPublic(EC_KEY *ec, const unsigned char *pub, int len)
+{
+  if (len <= 0 || len > (int)sizeof(((entry_t *)0)->pub)) {
+    // Can't be a valid key, let OpenSSL produce the error
+    return o2i_ECPublicKey(&ec, &pub, len) != NULL;
+  }
+
+  uint32_t hash = Hash(pub, len);
+  const EC_GROUP *group = EC_KEY_get0_group(ec);
+
+  uv_mutex_lock(&mutex);
+  entry_t *entry = Find(hash, pub, len);
+  if (entry != NULL && entry->point != NULL) {
+    int ok = EC_KEY_set_public_key(ec, entry->point);
+    EC_KEY_set_conv_form(ec, entry->form);
+    Touch(entry);
+    hits++;
+    uv_mutex_unlock(&mutex);
+    return ok;
+  }
+  misses++;
+  uv_mutex_unlock(&mutex);
+
+  // Decode outside the lock
+  const unsigned char *data = pub;
+  if (!o2i_ECPublicKey(&ec, &data, len)) {
+    return 0;
+  }
+
+  if (capacity == 0) {
+    return 1;
+  }
+
+  EC_POINT *point = EC_POINT_dup(EC_KEY_get0_public_key(ec), group);
+  if (point == NULL) {
+    return 1;
+  }
+
+  uv_mutex_lock(&mutex);
+  entry = Insert(hash, pub, len);
+  if (entry != NULL && entry->point == NULL) {
+    entry->form = EC_KEY_get_conv_form(ec);
+    entry->point = point;
+    point = NULL;
+  }
+  uv_mutex_unlock(&mutex);
+
+  if (point != NULL) EC_POINT_free(point);
+
+  return 1;
+}
+
+int PubKeyCache::GetPoint(Secp256k1::point_t *q, const unsigned char *pub, int len)
+{
+  if (len <= 0 || len > (int)sizeof(((entry_t *)0)->pub)) {
+    return 0;
+  }
+
+  uint32_t hash = Hash(pub, len);
+
+  uv_mutex_lock(&mutex);
+  entry_t *entry = Find(hash, pub, len);
+  if (entry != NULL && entry->hasQ) {
+    *q = entry->q;
+    Touch(entry);
+    hits++;
+    uv_mutex_unlock(&mutex);
+    return 1;
+  }
+  misses++;
+  uv_mutex_unlock(&mutex);
+
+  // Decode outside the lock
+  if (!Secp256k1::ParsePublic(q, pub, len)) {
+    return 0;
+  }
+
+  if (capacity == 0) {
+    return 1;
+  }
+
+  uv_mutex_lock(&mutex);
+  entry = Insert(hash, pub, len);
+  if (entry != NULL && !entry->hasQ) {
+    entry->q = *q;
+    entry->hasQ = true;
+  }
+  uv_mutex_unlock(&mutex);
+
+  return 1;
+}
+
+void PubKeyCache::Resize(unsigned int newCapacity)
+{
+  uv_mutex_lock(&mutex);
+
+  capacity = newCapacity;
+  while (size > capacity) {
+    Evict();
+  }
+
+  // Keep the load factor at or below one
+  unsigned int bucketCount = 16;
+  while (bucketCount < capacity) bucketCount <<= 1;
+  Rehash(bucketCount);
+
+  uv_mutex_unlock(&mutex);
+}
+
+void PubKeyCache::GetStats(stats_t *stats)
+{
+  uv_mutex_lock(&mutex);
+  stats->hits = hits;
+  stats->misses = misses;
+  stats->size = size;
+  stats->capacity = capacity;
+  uv_mutex_unlock(&mutex);
+}
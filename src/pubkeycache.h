@@ -0,0 +1,96 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_PUBKEYCACHE_H_
+#define BITCOINJS_SERVER_INCLUDE_PUBKEYCACHE_H_
+
+#include <stdint.h>
+
+#include <uv.h>
+
+#include <openssl/ec.h>
+
+#include "secp256k1.h"
+
+/**
+ * Cache of decoded public keys.
+ *
+ * Decoding a serialized public key is expensive, especially for compressed
+ * keys which require a modular square root. This cache maps the serialized
+ * key to the decoded EC_POINT and the decoded Secp256k1 point, so keys that
+ * are used over and over again only get decoded once. Each form is filled
+ * in the first time it is asked for.
+ *
+ * The cache is bounded and evicts the least recently used key. It is safe to
+ * use from the thread pool. Points are copied into the caller's EC_KEY while
+ * holding the lock, so entries are never shared outside of the cache.
+ */
+class PubKeyCache
+{
+private:
+
+  struct entry_t {
+    entry_t *chain;
+    entry_t *lruPrev;
+    entry_t *lruNext;
+    uint32_t hash;
+    int pubLen;
+    unsigned char pub[65];
+    point_conversion_form_t form;
+    EC_POINT *point;
+    bool hasQ;
+    Secp256k1::point_t q;
+  };
+
+  static uv_mutex_t mutex;
+  static uint32_t salt;
+
+  static entry_t **buckets;
+  static unsigned int bucketMask;
+
+  // Most recently used entry is at the head
+  static entry_t *lruHead;
+  static entry_t *lruTail;
+
+  static unsigned int size;
+  static unsigned int capacity;
+
+  static uint64_t hits;
+  static uint64_t misses;
+
+  static uint32_t Hash(const unsigned char *pub, int len);
+  static entry_t *Find(uint32_t hash, const unsigned char *pub, int len);
+  static void Touch(entry_t *entry);
+  static void Unlink(entry_t *entry);
+  static entry_t *Insert(uint32_t hash, const unsigned char *pub, int len);
+  static void Evict();
+  static void Rehash(unsigned int bucketCount);
+
+public:
+
+  struct stats_t {
+    uint64_t hits;
+    uint64_t misses;
+    unsigned int size;
+    unsigned int capacity;
+  };
+
+  static void Init(unsigned int capacity);
+
+  /**
+   * Set the public key of ec from its serialized form.
+   *
+   * Returns 1 on success and 0 if the key could not be decoded.
+   */
+  static int SetPublic(EC_KEY *ec, const unsigned char *pub, int len);
+
+  /**
+   * Decode a serialized public key for Secp256k1::Verify().
+   *
+   * Returns 1 on success and 0 if the key could not be decoded.
+   */
+  static int GetPoint(Secp256k1::point_t *q, const unsigned char *pub, int len);
+
+  static void Resize(unsigned int capacity);
+
+  static void GetStats(stats_t *stats);
+};
+
+#endif
@@ -0,0 +1,1261 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "secp256k1.h"
+
+typedef unsigned __int128 uint128_t;
+
+/*
+ * Field arithmetic modulo p = 2^256 - 2^32 - 977
+ *
+ * Elements are stored in five 52 bit limbs. The "magnitude" of an element
+ * bounds how far its limbs may exceed 52 (48 for the top limb) bits: each
+ * limb is at most 2 * magnitude * (2^52 - 1). Products and squares accept
+ * inputs up to magnitude 8 and return magnitude 1.
+ */
+
+typedef struct {
+  uint64_t n[5];
+} fe_t;
+
+#define M52 0xFFFFFFFFFFFFFULL
+#define M48 0xFFFFFFFFFFFFULL
+
+static const fe_t FE_BETA = {{
+  0x96C28719501EEULL, 0x7512F58995C13ULL, 0xC3434E99CF049ULL,
+  0x07106E64479EAULL, 0x07AE96A2B657CULL
+}};
+
+// The group order n, and p - n, as field elements
+static const fe_t FE_N = {{
+  0x25E8CD0364141ULL, 0xE6AF48A03BBFDULL, 0xFFFFFFEBAAEDCULL,
+  0xFFFFFFFFFFFFFULL, 0x0FFFFFFFFFFFFULL
+}};
+static const fe_t FE_P_MINUS_N = {{
+  0xDA1722FC9BAEEULL, 0x1950B75FC4402ULL, 0x0000001455123ULL, 0, 0
+}};
+
+static const unsigned char P_MINUS_2[32] = {
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFE, 0xFF, 0xFF, 0xFC, 0x2D
+};
+
+static const unsigned char P_PLUS_1_DIV_4[32] = {
+  0x3F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xBF, 0xFF, 0xFF, 0x0C
+};
+
+static inline void fe_set_int(fe_t *r, int a)
+{
+  r->n[0] = a;
+  r->n[1] = r->n[2] = r->n[3] = r->n[4] = 0;
+}
+
+static inline uint64_t read_be64(const unsigned char *p)
+{
+  return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) |
+         ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+         ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+         ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+}
+
+/**
+ * Load a big endian number. Returns 0 if it is not below p.
+ */
+static int fe_set_b32(fe_t *r, const unsigned char *a)
+{
+  uint64_t w3 = read_be64(a);
+  uint64_t w2 = read_be64(a + 8);
+  uint64_t w1 = read_be64(a + 16);
+  uint64_t w0 = read_be64(a + 24);
+
+  r->n[0] = w0 & M52;
+  r->n[1] = (w0 >> 52) | ((w1 & 0xFFFFFFFFFFULL) << 12);
+  r->n[2] = (w1 >> 40) | ((w2 & 0xFFFFFFFULL) << 24);
+  r->n[3] = (w2 >> 28) | ((w3 & 0xFFFFULL) << 36);
+  r->n[4] = w3 >> 16;
+
+  return !(r->n[4] == M48 && (r->n[3] & r->n[2] & r->n[1]) == M52 &&
+           r->n[0] >= 0xFFFFEFFFFFC2FULL);
+}
+
+static void fe_normalize_weak(fe_t *r)
+{
+  uint64_t t0 = r->n[0], t1 = r->n[1], t2 = r->n[2], t3 = r->n[3], t4 = r->n[4];
+
+  // Fold everything above 2^256 back in, 2^256 = 0x1000003D1 (mod p)
+  uint64_t x = t4 >> 48;
+  t4 &= M48;
+
+  t0 += x * 0x1000003D1ULL;
+  t1 += t0 >> 52; t0 &= M52;
+  t2 += t1 >> 52; t1 &= M52;
+  t3 += t2 >> 52; t2 &= M52;
+  t4 += t3 >> 52; t3 &= M52;
+
+  r->n[0] = t0; r->n[1] = t1; r->n[2] = t2; r->n[3] = t3; r->n[4] = t4;
+}
+
+static void fe_normalize(fe_t *r)
+{
+  uint64_t t0 = r->n[0], t1 = r->n[1], t2 = r->n[2], t3 = r->n[3], t4 = r->n[4];
+
+  uint64_t x = t4 >> 48;
+  t4 &= M48;
+
+  t0 += x * 0x1000003D1ULL;
+  t1 += t0 >> 52; t0 &= M52;
+  t2 += t1 >> 52; t1 &= M52;
+  t3 += t2 >> 52; t2 &= M52;
+  t4 += t3 >> 52; t3 &= M52;
+
+  // At most one more subtraction of p is needed
+  x = (t4 >> 48) | ((t4 == M48) & ((t3 & t2 & t1) == M52) &
+                    (t0 >= 0xFFFFEFFFFFC2FULL));
+
+  t0 += x * 0x1000003D1ULL;
+  t1 += t0 >> 52; t0 &= M52;
+  t2 += t1 >> 52; t1 &= M52;
+  t3 += t2 >> 52; t2 &= M52;
+  t4 += t3 >> 52; t3 &= M52;
+  t4 &= M48;
+
+  r->n[0] = t0; r->n[1] = t1; r->n[2] = t2; r->n[3] = t3; r->n[4] = t4;
+}
+
+static inline int fe_is_zero(const fe_t *a)
+{
+  fe_t t = *a;
+  fe_normalize(&t);
+  return (t.n[0] | t.n[1] | t.n[2] | t.n[3] | t.n[4]) == 0;
+}
+
+static inline int fe_is_odd(const fe_t *a)
+{
+  fe_t t = *a;
+  fe_normalize(&t);
+  return t.n[0] & 1;
+}
+
+static inline int fe_equal(const fe_t *a, const fe_t *b)
+{
+  fe_t t = *a, u = *b;
+  fe_normalize(&t);
+  fe_normalize(&u);
+  return ((t.n[0] ^ u.n[0]) | (t.n[1] ^ u.n[1]) | (t.n[2] ^ u.n[2]) |
+          (t.n[3] ^ u.n[3]) | (t.n[4] ^ u.n[4])) == 0;
+}
+
+/**
+ * Compare two normalized elements.
+ */
+static inline int fe_cmp(const fe_t *a, const fe_t *b)
+{
+  for (int i = 4; i >= 0; i--) {
+    if (a->n[i] > b->n[i]) return 1;
+    if (a->n[i] < b->n[i]) return -1;
+  }
+  return 0;
+}
+
+static inline void fe_add(fe_t *r, const fe_t *a)
+{
+  r->n[0] += a->n[0];
+  r->n[1] += a->n[1];
+  r->n[2] += a->n[2];
+  r->n[3] += a->n[3];
+  r->n[4] += a->n[4];
+}
+
+static inline void fe_mul_int(fe_t *r, int a)
+{
+  r->n[0] *= a;
+  r->n[1] *= a;
+  r->n[2] *= a;
+  r->n[3] *= a;
+  r->n[4] *= a;
+}
+
+/**
+ * r = -a, where a has at most magnitude m. The result has magnitude m + 1.
+ */
+static inline void fe_negate(fe_t *r, const fe_t *a, int m)
+{
+  r->n[0] = 0xFFFFEFFFFFC2FULL * 2 * (m + 1) - a->n[0];
+  r->n[1] = 0xFFFFFFFFFFFFFULL * 2 * (m + 1) - a->n[1];
+  r->n[2] = 0xFFFFFFFFFFFFFULL * 2 * (m + 1) - a->n[2];
+  r->n[3] = 0xFFFFFFFFFFFFFULL * 2 * (m + 1) - a->n[3];
+  r->n[4] = 0x0FFFFFFFFFFFFULL * 2 * (m + 1) - a->n[4];
+}
+
+/**
+ * Reduce a product given as nine 128 bit column sums.
+ */
+static inline void fe_reduce(fe_t *r, uint128_t *c)
+{
+  uint64_t d[10];
+  uint128_t acc = 0;
+
+  // Carry the columns into ten 52 bit limbs
+  for (int k = 0; k < 9; k++) {
+    acc += c[k];
+    d[k] = (uint64_t)acc & M52;
+    acc >>= 52;
+  }
+  d[9] = (uint64_t)acc;
+
+  // Fold the upper five limbs, 2^260 = 0x1000003D10 (mod p)
+  uint64_t t[5];
+  acc = 0;
+  for (int k = 0; k < 5; k++) {
+    acc += (uint128_t)d[k] + (uint128_t)d[k + 5] * 0x1000003D10ULL;
+    t[k] = (uint64_t)acc & M52;
+    acc >>= 52;
+  }
+
+  // Whatever is left above 2^256 gets folded into the bottom limb
+  uint128_t top = (acc << 4) | (t[4] >> 48);
+  t[4] &= M48;
+
+  acc = (uint128_t)t[0] + top * 0x1000003D1ULL;
+  r->n[0] = (uint64_t)acc & M52; acc >>= 52;
+  acc += t[1];
+  r->n[1] = (uint64_t)acc & M52; acc >>= 52;
+  acc += t[2];
+  r->n[2] = (uint64_t)acc & M52; acc >>= 52;
+  acc += t[3];
+  r->n[3] = (uint64_t)acc & M52; acc >>= 52;
+  r->n[4] = t[4] + (uint64_t)acc;
+}
+
+static void fe_mul(fe_t *r, const fe_t *a, const fe_t *b)
+{
+  uint128_t c[9];
+  const uint64_t *x = a->n, *y = b->n;
+
+  c[0] = (uint128_t)x[0] * y[0];
+  c[1] = (uint128_t)x[0] * y[1] + (uint128_t)x[1] * y[0];
+  c[2] = (uint128_t)x[0] * y[2] + (uint128_t)x[1] * y[1] + (uint128_t)x[2] * y[0];
+  c[3] = (uint128_t)x[0] * y[3] + (uint128_t)x[1] * y[2] + (uint128_t)x[2] * y[1] +
+         (uint128_t)x[3] * y[0];
+  c[4] = (uint128_t)x[0] * y[4] + (uint128_t)x[1] * y[3] + (uint128_t)x[2] * y[2] +
+         (uint128_t)x[3] * y[1] + (uint128_t)x[4] * y[0];
+  c[5] = (uint128_t)x[1] * y[4] + (uint128_t)x[2] * y[3] + (uint128_t)x[3] * y[2] +
+         (uint128_t)x[4] * y[1];
+  c[6] = (uint128_t)x[2] * y[4] + (uint128_t)x[3] * y[3] + (uint128_t)x[4] * y[2];
+  c[7] = (uint128_t)x[3] * y[4] + (uint128_t)x[4] * y[3];
+  c[8] = (uint128_t)x[4] * y[4];
+
+  fe_reduce(r, c);
+}
+
+static void fe_sqr(fe_t *r, const fe_t *a)
+{
+  uint128_t c[9];
+  const uint64_t *x = a->n;
+  uint64_t x0_2 = x[0] * 2, x1_2 = x[1] * 2, x2_2 = x[2] * 2, x3_2 = x[3] * 2;
+
+  c[0] = (uint128_t)x[0] * x[0];
+  c[1] = (uint128_t)x0_2 * x[1];
+  c[2] = (uint128_t)x0_2 * x[2] + (uint128_t)x[1] * x[1];
+  c[3] = (uint128_t)x0_2 * x[3] + (uint128_t)x1_2 * x[2];
+  c[4] = (uint128_t)x0_2 * x[4] + (uint128_t)x1_2 * x[3] + (uint128_t)x[2] * x[2];
+  c[5] = (uint128_t)x1_2 * x[4] + (uint128_t)x2_2 * x[3];
+  c[6] = (uint128_t)x2_2 * x[4] + (uint128_t)x[3] * x[3];
+  c[7] = (uint128_t)x3_2 * x[4];
+  c[8] = (uint128_t)x[4] * x[4];
+
+  fe_reduce(r, c);
+}
+
+/**
+ * r = a^e for a fixed big endian exponent, using a 4 bit window.
+ */
+static void fe_pow(fe_t *r, const fe_t *a, const unsigned char *e)
+{
+  fe_t table[16];
+  fe_set_int(&table[0], 1);
+  table[1] = *a;
+  for (int i = 2; i < 16; i++) {
+    fe_mul(&table[i], &table[i - 1], a);
+  }
+
+  fe_t t;
+  fe_set_int(&t, 1);
+  for (int i = 0; i < 64; i++) {
+    int nibble = (e[i >> 1] >> ((i & 1) ? 0 : 4)) & 0xF;
+    if (i > 0) {
+      fe_sqr(&t, &t);
+      fe_sqr(&t, &t);
+      fe_sqr(&t, &t);
+      fe_sqr(&t, &t);
+    }
+    if (nibble) {
+      fe_mul(&t, &t, &table[nibble]);
+    }
+  }
+  *r = t;
+}
+
+static inline void fe_inv(fe_t *r, const fe_t *a)
+{
+  fe_pow(r, a, P_MINUS_2);
+}
+
+/**
+ * r = sqrt(a), returns 0 if a is not a square.
+ */
+static int fe_sqrt(fe_t *r, const fe_t *a)
+{
+  fe_t t, check;
+  fe_pow(&t, a, P_PLUS_1_DIV_4);
+  fe_sqr(&check, &t);
+  if (!fe_equal(&check, a)) {
+    return 0;
+  }
+  *r = t;
+  return 1;
+}
+
+
+/*
+ * Scalar arithmetic modulo the group order n
+ */
+
+typedef struct {
+  uint64_t d[4];
+} scalar_t;
+
+static const uint64_t N[4] = {
+  0xBFD25E8CD0364141ULL, 0xBAAEDCE6AF48A03BULL,
+  0xFFFFFFFFFFFFFFFEULL, 0xFFFFFFFFFFFFFFFFULL
+};
+
+// 2^256 - n
+static const uint64_t NC[3] = {
+  0x402DA1732FC9BEBFULL, 0x4551231950B75FC4ULL, 1
+};
+
+// floor(n / 2)
+static const uint64_t NH[4] = {
+  0xDFE92F46681B20A0ULL, 0x5D576E7357A4501DULL,
+  0xFFFFFFFFFFFFFFFFULL, 0x7FFFFFFFFFFFFFFFULL
+};
+
+static const unsigned char N_MINUS_2[32] = {
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+  0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B,
+  0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x3F
+};
+
+// Constants for splitting a scalar with the endomorphism lambda
+static const scalar_t MINUS_LAMBDA = {{
+  0xE0CFC810B51283CFULL, 0xA880B9FC8EC739C2ULL,
+  0x5AD9E3FD77ED9BA4ULL, 0xAC9C52B33FA3CF1FULL
+}};
+static const scalar_t MINUS_B1 = {{
+  0x6F547FA90ABFE4C3ULL, 0xE4437ED6010E8828ULL, 0, 0
+}};
+static const scalar_t MINUS_B2 = {{
+  0xD765CDA83DB1562CULL, 0x8A280AC50774346DULL,
+  0xFFFFFFFFFFFFFFFEULL, 0xFFFFFFFFFFFFFFFFULL
+}};
+static const scalar_t G1 = {{
+  0xE893209A45DBB031ULL, 0x3DAA8A1471E8CA7FULL,
+  0xE86C90E49284EB15ULL, 0x3086D221A7D46BCDULL
+}};
+static const scalar_t G2 = {{
+  0x1571B4AE8AC47F71ULL, 0x221208AC9DF506C6ULL,
+  0x6F547FA90ABFE4C4ULL, 0xE4437ED6010E8828ULL
+}};
+
+static inline int scalar_cmp(const uint64_t *a, const uint64_t *b)
+{
+  for (int i = 3; i >= 0; i--) {
+    if (a[i] > b[i]) return 1;
+    if (a[i] < b[i]) return -1;
+  }
+  return 0;
+}
+
+static inline int scalar_is_zero(const scalar_t *a)
+{
+  return (a->d[0] | a->d[1] | a->d[2] | a->d[3]) == 0;
+}
+
+static inline int scalar_is_high(const scalar_t *a)
+{
+  return scalar_cmp(a->d, NH) > 0;
+}
+
+/**
+ * Subtract n once, i.e. add 2^256 - n and drop the carry.
+ */
+static inline void scalar_sub_n(scalar_t *r)
+{
+  uint128_t t = (uint128_t)r->d[0] + NC[0];
+  r->d[0] = (uint64_t)t; t >>= 64;
+  t += (uint128_t)r->d[1] + NC[1];
+  r->d[1] = (uint64_t)t; t >>= 64;
+  t += (uint128_t)r->d[2] + NC[2];
+  r->d[2] = (uint64_t)t; t >>= 64;
+  t += r->d[3];
+  r->d[3] = (uint64_t)t;
+}
+
+/**
+ * Load a big endian number, reducing it modulo n. Returns 1 if the number
+ * was not below n.
+ */
+static int scalar_set_b32(scalar_t *r, const unsigned char *b)
+{
+  r->d[3] = read_be64(b);
+  r->d[2] = read_be64(b + 8);
+  r->d[1] = read_be64(b + 16);
+  r->d[0] = read_be64(b + 24);
+
+  if (scalar_cmp(r->d, N) >= 0) {
+    scalar_sub_n(r);
+    return 1;
+  }
+  return 0;
+}
+
+static void scalar_add(scalar_t *r, const scalar_t *a, const scalar_t *b)
+{
+  uint128_t t = (uint128_t)a->d[0] + b->d[0];
+  r->d[0] = (uint64_t)t; t >>= 64;
+  t += (uint128_t)a->d[1] + b->d[1];
+  r->d[1] = (uint64_t)t; t >>= 64;
+  t += (uint128_t)a->d[2] + b->d[2];
+  r->d[2] = (uint64_t)t; t >>= 64;
+  t += (uint128_t)a->d[3] + b->d[3];
+  r->d[3] = (uint64_t)t; t >>= 64;
+
+  if (t || scalar_cmp(r->d, N) >= 0) {
+    scalar_sub_n(r);
+  }
+}
+
+static void scalar_negate(scalar_t *r, const scalar_t *a)
+{
+  if (scalar_is_zero(a)) {
+    *r = *a;
+    return;
+  }
+
+  // n - a
+  uint128_t t = (uint128_t)(~a->d[0]) + N[0] + 1;
+  r->d[0] = (uint64_t)t; t >>= 64;
+  t += (uint128_t)(~a->d[1]) + N[1];
+  r->d[1] = (uint64_t)t; t >>= 64;
+  t += (uint128_t)(~a->d[2]) + N[2];
+  r->d[2] = (uint64_t)t; t >>= 64;
+  t += (uint128_t)(~a->d[3]) + N[3];
+  r->d[3] = (uint64_t)t;
+}
+
+static void mul_512(uint64_t *l, const scalar_t *a, const scalar_t *b)
+{
+  memset(l, 0, sizeof(uint64_t) * 8);
+  for (int i = 0; i < 4; i++) {
+    uint128_t carry = 0;
+    for (int j = 0; j < 4; j++) {
+      carry += (uint128_t)a->d[i] * b->d[j] + l[i + j];
+      l[i + j] = (uint64_t)carry;
+      carry >>= 64;
+    }
+    l[i + 4] = (uint64_t)carry;
+  }
+}
+
+/**
+ * out = low + high * (2^256 - n), where low has four limbs.
+ */
+static void scalar_fold(uint64_t *out, int outLen,
+                        const uint64_t *low, const uint64_t *high, int highLen)
+{
+  uint128_t acc = 0;
+  for (int k = 0; k < outLen; k++) {
+    uint128_t hi = 0;
+    if (k < 4) acc += low[k];
+    for (int i = 0; i < highLen; i++) {
+      int j = k - i;
+      if (j < 0 || j > 2) continue;
+      uint128_t p = (uint128_t)high[i] * NC[j];
+      acc += (uint64_t)p;
+      hi += p >> 64;
+    }
+    out[k] = (uint64_t)acc;
+    acc = (acc >> 64) + hi;
+  }
+}
+
+static void scalar_reduce_512(scalar_t *r, const uint64_t *l)
+{
+  uint64_t m[7], p[5], q[5];
+
+  // 512 -> 386 bits
+  scalar_fold(m, 7, l, l + 4, 4);
+  // 386 -> 260 bits
+  scalar_fold(p, 5, m, m + 4, 3);
+  // 260 -> 257 bits
+  scalar_fold(q, 5, p, p + 4, 1);
+
+  r->d[0] = q[0];
+  r->d[1] = q[1];
+  r->d[2] = q[2];
+  r->d[3] = q[3];
+
+  if (q[4] || scalar_cmp(r->d, N) >= 0) {
+    scalar_sub_n(r);
+  }
+}
+
+static void scalar_mul(scalar_t *r, const scalar_t *a, const scalar_t *b)
+{
+  uint64_t l[8];
+  mul_512(l, a, b);
+  scalar_reduce_512(r, l);
+}
+
+static void scalar_inverse(scalar_t *r, const scalar_t *a)
+{
+  scalar_t table[16];
+  memset(&table[0], 0, sizeof(scalar_t));
+  table[0].d[0] = 1;
+  table[1] = *a;
+  for (int i = 2; i < 16; i++) {
+    scalar_mul(&table[i], &table[i - 1], a);
+  }
+
+  scalar_t t = table[0];
+  for (int i = 0; i < 64; i++) {
+    int nibble = (N_MINUS_2[i >> 1] >> ((i & 1) ? 0 : 4)) & 0xF;
+    if (i > 0) {
+      scalar_mul(&t, &t, &t);
+      scalar_mul(&t, &t, &t);
+      scalar_mul(&t, &t, &t);
+      scalar_mul(&t, &t, &t);
+    }
+    if (nibble) {
+      scalar_mul(&t, &t, &table[nibble]);
+    }
+  }
+  *r = t;
+}
+
+/**
+ * r = round(a * b / 2^384)
+ */
+static void scalar_mul_shift_384(scalar_t *r, const scalar_t *a, const scalar_t *b)
+{
+  uint64_t l[8];
+  mul_512(l, a, b);
+
+  uint64_t round = l[5] >> 63;
+  uint128_t t = (uint128_t)l[6] + round;
+  r->d[0] = (uint64_t)t; t >>= 64;
+  t += l[7];
+  r->d[1] = (uint64_t)t;
+  r->d[2] = 0;
+  r->d[3] = 0;
+}
+
+/**
+ * Split a into r1 + r2 * lambda, where r1 and r2 (or their negations) are
+ * below 2^128.
+ */
+static void scalar_split_lambda(scalar_t *r1, scalar_t *r2, const scalar_t *a)
+{
+  scalar_t c1, c2;
+  scalar_mul_shift_384(&c1, a, &G1);
+  scalar_mul_shift_384(&c2, a, &G2);
+  scalar_mul(&c1, &c1, &MINUS_B1);
+  scalar_mul(&c2, &c2, &MINUS_B2);
+  scalar_add(r2, &c1, &c2);
+  scalar_mul(r1, r2, &MINUS_LAMBDA);
+  scalar_add(r1, r1, a);
+}
+
+static inline unsigned int scalar_get_bits(const scalar_t *a, int offset, int count)
+{
+  int limb = offset >> 6;
+  int shift = offset & 63;
+  uint64_t v = a->d[limb] >> shift;
+  if (shift + count > 64 && limb < 3) {
+    v |= a->d[limb + 1] << (64 - shift);
+  }
+  return (unsigned int)(v & ((1ULL << count) - 1));
+}
+
+
+/*
+ * Group operations on y^2 = x^3 + 7
+ */
+
+typedef struct {
+  fe_t x;
+  fe_t y;
+} ge_t;
+
+typedef struct {
+  fe_t x;
+  fe_t y;
+  fe_t z;
+  int infinity;
+} gej_t;
+
+static inline void gej_set_ge(gej_t *r, const ge_t *a)
+{
+  r->x = a->x;
+  r->y = a->y;
+  fe_set_int(&r->z, 1);
+  r->infinity = 0;
+}
+
+static void gej_double(gej_t *r, const gej_t *a)
+{
+  if (a->infinity) {
+    r->infinity = 1;
+    return;
+  }
+
+  fe_t m, s, y2, y4, t;
+
+  // Z3 = 2*Y*Z
+  fe_mul(&r->z, &a->z, &a->y);
+  fe_mul_int(&r->z, 2);
+  fe_normalize_weak(&r->z);
+
+  // M = 3*X^2
+  fe_sqr(&m, &a->x);
+  fe_mul_int(&m, 3);
+
+  // S = 4*X*Y^2
+  fe_sqr(&y2, &a->y);
+  fe_mul(&s, &a->x, &y2);
+  fe_mul_int(&s, 4);
+
+  // 8*Y^4
+  fe_sqr(&y4, &y2);
+  fe_mul_int(&y4, 8);
+
+  // X3 = M^2 - 2*S
+  fe_sqr(&r->x, &m);
+  fe_negate(&t, &s, 4);
+  fe_mul_int(&t, 2);
+  fe_add(&r->x, &t);
+  fe_normalize_weak(&r->x);
+
+  // Y3 = M*(S - X3) - 8*Y^4
+  fe_negate(&t, &r->x, 1);
+  fe_add(&t, &s);
+  fe_mul(&r->y, &m, &t);
+  fe_negate(&t, &y4, 8);
+  fe_add(&r->y, &t);
+  fe_normalize_weak(&r->y);
+
+  r->infinity = 0;
+}
+
+/**
+ * Finish an addition once H = U2 - U1 and R = S2 - S1 are known.
+ */
+static inline void gej_add_finish(gej_t *r, const fe_t *u1, const fe_t *s1,
+                                  fe_t *h, fe_t *rr)
+{
+  fe_t hh, hhh, v, t;
+
+  fe_sqr(&hh, h);
+  fe_mul(&hhh, h, &hh);
+  fe_mul(&v, u1, &hh);
+
+  // X3 = R^2 - H^3 - 2*V
+  fe_sqr(&r->x, rr);
+  fe_negate(&t, &hhh, 1);
+  fe_add(&r->x, &t);
+  fe_negate(&t, &v, 1);
+  fe_mul_int(&t, 2);
+  fe_add(&r->x, &t);
+  fe_normalize_weak(&r->x);
+
+  // Y3 = R*(V - X3) - S1*H^3
+  fe_negate(&t, &r->x, 1);
+  fe_add(&t, &v);
+  fe_mul(&r->y, rr, &t);
+  fe_mul(&t, s1, &hhh);
+  fe_negate(&t, &t, 1);
+  fe_add(&r->y, &t);
+  fe_normalize_weak(&r->y);
+
+  r->infinity = 0;
+}
+
+/**
+ * r = a + b, with b in affine coordinates.
+ */
+static void gej_add_ge(gej_t *r, const gej_t *a, const ge_t *b)
+{
+  if (a->infinity) {
+    gej_set_ge(r, b);
+    return;
+  }
+
+  fe_t z1z1, u2, s2, h, rr, t;
+
+  fe_sqr(&z1z1, &a->z);
+  fe_mul(&u2, &b->x, &z1z1);
+  fe_mul(&s2, &b->y, &z1z1);
+  fe_mul(&s2, &s2, &a->z);
+
+  // H = U2 - X1, R = S2 - Y1
+  fe_negate(&h, &a->x, 1);
+  fe_add(&h, &u2);
+  fe_negate(&rr, &a->y, 1);
+  fe_add(&rr, &s2);
+
+  if (fe_is_zero(&h)) {
+    if (fe_is_zero(&rr)) {
+      gej_double(r, a);
+    } else {
+      r->infinity = 1;
+    }
+    return;
+  }
+
+  // Z3 = Z1*H
+  fe_mul(&t, &a->z, &h);
+
+  fe_t x1 = a->x, y1 = a->y;
+  gej_add_finish(r, &x1, &y1, &h, &rr);
+  r->z = t;
+}
+
+/**
+ * r = a + b, both in Jacobian coordinates.
+ */
+static void gej_add(gej_t *r, const gej_t *a, const gej_t *b)
+{
+  if (a->infinity) {
+    *r = *b;
+    return;
+  }
+  if (b->infinity) {
+    *r = *a;
+    return;
+  }
+
+  fe_t z1z1, z2z2, u1, u2, s1, s2, h, rr, t;
+
+  fe_sqr(&z1z1, &a->z);
+  fe_sqr(&z2z2, &b->z);
+  fe_mul(&u1, &a->x, &z2z2);
+  fe_mul(&u2, &b->x, &z1z1);
+  fe_mul(&s1, &a->y, &z2z2);
+  fe_mul(&s1, &s1, &b->z);
+  fe_mul(&s2, &b->y, &z1z1);
+  fe_mul(&s2, &s2, &a->z);
+
+  fe_negate(&h, &u1, 1);
+  fe_add(&h, &u2);
+  fe_negate(&rr, &s1, 1);
+  fe_add(&rr, &s2);
+
+  if (fe_is_zero(&h)) {
+    if (fe_is_zero(&rr)) {
+      gej_double(r, a);
+    } else {
+      r->infinity = 1;
+    }
+    return;
+  }
+
+  // Z3 = Z1*Z2*H
+  fe_mul(&t, &a->z, &b->z);
+  fe_mul(&t, &t, &h);
+
+  gej_add_finish(r, &u1, &s1, &h, &rr);
+  r->z = t;
+}
+
+static inline void ge_neg(ge_t *r, const ge_t *a)
+{
+  r->x = a->x;
+  fe_negate(&r->y, &a->y, 1);
+  fe_normalize_weak(&r->y);
+}
+
+static inline void gej_neg(gej_t *r, const gej_t *a)
+{
+  *r = *a;
+  fe_negate(&r->y, &a->y, 1);
+  fe_normalize_weak(&r->y);
+}
+
+/**
+ * Apply the endomorphism, lambda * (x, y) = (beta * x, y).
+ */
+static inline void gej_mul_lambda(gej_t *r, const gej_t *a)
+{
+  *r = *a;
+  fe_mul(&r->x, &a->x, &FE_BETA);
+}
+
+/**
+ * Check that (x, y) is on the curve.
+ */
+static int ge_is_valid(const ge_t *a)
+{
+  fe_t y2, x3;
+  fe_sqr(&y2, &a->y);
+  fe_sqr(&x3, &a->x);
+  fe_mul(&x3, &x3, &a->x);
+  fe_t seven;
+  fe_set_int(&seven, 7);
+  fe_add(&x3, &seven);
+  return fe_equal(&y2, &x3);
+}
+
+static int ge_set_xo(ge_t *r, const fe_t *x, int odd)
+{
+  fe_t x3, seven;
+  fe_sqr(&x3, x);
+  fe_mul(&x3, &x3, x);
+  fe_set_int(&seven, 7);
+  fe_add(&x3, &seven);
+
+  r->x = *x;
+  if (!fe_sqrt(&r->y, &x3)) {
+    return 0;
+  }
+  fe_normalize(&r->y);
+  if (fe_is_odd(&r->y) != odd) {
+    fe_negate(&r->y, &r->y, 1);
+    fe_normalize(&r->y);
+  }
+  return 1;
+}
+
+static int pubkey_parse(ge_t *r, const unsigned char *pub, int len)
+{
+  fe_t x;
+
+  if (len == 33 && (pub[0] == 0x02 || pub[0] == 0x03)) {
+    if (!fe_set_b32(&x, pub + 1)) return 0;
+    return ge_set_xo(r, &x, pub[0] == 0x03);
+  }
+
+  if (len == 65 && (pub[0] == 0x04 || pub[0] == 0x06 || pub[0] == 0x07)) {
+    if (!fe_set_b32(&r->x, pub + 1) || !fe_set_b32(&r->y, pub + 33)) {
+      return 0;
+    }
+    // Hybrid keys encode the parity of y in the prefix as well
+    if (pub[0] != 0x04 && fe_is_odd(&r->y) != (pub[0] == 0x07)) {
+      return 0;
+    }
+    return ge_is_valid(r);
+  }
+
+  return 0;
+}
+
+
+/*
+ * Multi-scalar multiplication
+ */
+
+// Window size for the variable point Q, 8 precomputed points
+#define WINDOW_A 5
+
+// Window size for the generator, 2^(WINDOW_G - 2) precomputed points
+#define WINDOW_G 12
+
+#define TABLE_SIZE(w) (1 << ((w) - 2))
+
+// Enough digits for a 128 bit scalar plus the final carry
+#define WNAF_BITS 130
+
+// Odd multiples of G and lambda*G in affine coordinates
+static ge_t *pre_g = NULL;
+static ge_t *pre_g_lam = NULL;
+
+/**
+ * Convert a scalar to width-w NAF form.
+ *
+ * Every nonzero digit is odd and below 2^(w-1) in absolute value, and
+ * nonzero digits are at least w positions apart. The scalar must be below
+ * 2^128 (after a possible negation, which is applied to the digits).
+ * Returns the number of digits used.
+ */
+static int ecmult_wnaf(int *wnaf, const scalar_t *a, int w)
+{
+  scalar_t s = *a;
+  int sign = 1;
+  if (scalar_is_high(&s)) {
+    scalar_negate(&s, &s);
+    sign = -1;
+  }
+
+  memset(wnaf, 0, sizeof(int) * WNAF_BITS);
+
+  int bit = 0;
+  int last = -1;
+  unsigned int carry = 0;
+
+  while (bit < WNAF_BITS) {
+    if (scalar_get_bits(&s, bit, 1) == carry) {
+      bit++;
+      continue;
+    }
+
+    int now = w;
+    if (now > WNAF_BITS - bit) {
+      now = WNAF_BITS - bit;
+    }
+
+    int word = (int)scalar_get_bits(&s, bit, now) + carry;
+    carry = (word >> (w - 1)) & 1;
+    word -= carry << w;
+
+    wnaf[bit] = sign * word;
+    last = bit;
+    bit += now;
+  }
+
+  return last + 1;
+}
+
+static inline void table_get_ge(ge_t *r, const ge_t *table, int n)
+{
+  if (n > 0) {
+    *r = table[(n - 1) / 2];
+  } else {
+    ge_neg(r, &table[(-n - 1) / 2]);
+  }
+}
+
+static inline void table_get_gej(gej_t *r, const gej_t *table, int n)
+{
+  if (n > 0) {
+    *r = table[(n - 1) / 2];
+  } else {
+    gej_neg(r, &table[(-n - 1) / 2]);
+  }
+}
+
+/**
+ * r = na * a + ng * G
+ */
+static void ecmult(gej_t *r, const gej_t *a, const scalar_t *na, const scalar_t *ng)
+{
+  scalar_t na_1, na_lam, ng_1, ng_lam;
+  int wnaf_na_1[WNAF_BITS], wnaf_na_lam[WNAF_BITS];
+  int wnaf_ng_1[WNAF_BITS], wnaf_ng_lam[WNAF_BITS];
+
+  scalar_split_lambda(&na_1, &na_lam, na);
+  scalar_split_lambda(&ng_1, &ng_lam, ng);
+
+  int bits = 0, len;
+  len = ecmult_wnaf(wnaf_na_1, &na_1, WINDOW_A);
+  if (len > bits) bits = len;
+  len = ecmult_wnaf(wnaf_na_lam, &na_lam, WINDOW_A);
+  if (len > bits) bits = len;
+  len = ecmult_wnaf(wnaf_ng_1, &ng_1, WINDOW_G);
+  if (len > bits) bits = len;
+  len = ecmult_wnaf(wnaf_ng_lam, &ng_lam, WINDOW_G);
+  if (len > bits) bits = len;
+
+  // Odd multiples of a: a, 3a, 5a, ...
+  gej_t pre_a[TABLE_SIZE(WINDOW_A)];
+  gej_t pre_a_lam[TABLE_SIZE(WINDOW_A)];
+  gej_t a2;
+  pre_a[0] = *a;
+  gej_double(&a2, a);
+  for (int i = 1; i < TABLE_SIZE(WINDOW_A); i++) {
+    gej_add(&pre_a[i], &pre_a[i - 1], &a2);
+  }
+  for (int i = 0; i < TABLE_SIZE(WINDOW_A); i++) {
+    gej_mul_lambda(&pre_a_lam[i], &pre_a[i]);
+  }
+
+  r->infinity = 1;
+
+  gej_t tj;
+  ge_t t;
+  for (int i = bits - 1; i >= 0; i--) {
+    int n;
+    gej_double(r, r);
+
+    if ((n = wnaf_na_1[i])) {
+      table_get_gej(&tj, pre_a, n);
+      gej_add(r, r, &tj);
+    }
+    if ((n = wnaf_na_lam[i])) {
+      table_get_gej(&tj, pre_a_lam, n);
+      gej_add(r, r, &tj);
+    }
+    if ((n = wnaf_ng_1[i])) {
+      table_get_ge(&t, pre_g, n);
+      gej_add_ge(r, r, &t);
+    }
+    if ((n = wnaf_ng_lam[i])) {
+      table_get_ge(&t, pre_g_lam, n);
+      gej_add_ge(r, r, &t);
+    }
+  }
+}
+
+
+/*
+ * Signatures
+ */
+
+/**
+ * Read a DER length, short or long form. Long form lengths may have
+ * leading zero bytes. Returns 0 if the length is missing, indefinite or
+ * runs past end.
+ */
+static int der_read_length(size_t *len, const unsigned char **p, const unsigned char *end)
+{
+  if (*p == end) return 0;
+  unsigned char b = *(*p)++;
+  if (!(b & 0x80)) {
+    *len = b;
+  } else {
+    size_t n = b & 0x7f;
+    if (n == 0 || (size_t)(end - *p) < n) return 0;
+    *len = 0;
+    while (n-- > 0) {
+      // Nothing we could be given is 16 MB long
+      if (*len >> 24) return 0;
+      *len = (*len << 8) | *(*p)++;
+    }
+  }
+  return *len <= (size_t)(end - *p);
+}
+
+/**
+ * Read one INTEGER as a 32 byte big endian unsigned magnitude. A value
+ * that doesn't fit comes back as zero, which never verifies.
+ */
+static int der_read_integer(unsigned char *out, const unsigned char **p,
+                            const unsigned char *end)
+{
+  size_t len;
+  if (*p == end || *(*p)++ != 0x02) return 0;
+  if (!der_read_length(&len, p, end)) return 0;
+
+  const unsigned char *data = *p;
+  *p += len;
+
+  while (len > 0 && data[0] == 0) {
+    data++;
+    len--;
+  }
+
+  memset(out, 0, 32);
+  if (len <= 32) {
+    memcpy(out + 32 - len, data, len);
+  }
+  return 1;
+}
+
+bool Secp256k1::ParseSignature(unsigned char *r, unsigned char *s,
+                               const unsigned char *sig, int sigLen)
+{
+  const unsigned char *p = sig;
+  const unsigned char *end = sig + sigLen;
+  size_t len;
+
+  if (sigLen < 1 || *p++ != 0x30) return false;
+  if (!der_read_length(&len, &p, end)) return false;
+
+  // Bytes after the sequence are ignored, like OpenSSL used to, but the
+  // sequence itself must hold exactly two integers
+  end = p + len;
+  return der_read_integer(r, &p, end) && der_read_integer(s, &p, end) &&
+         p == end;
+}
+
+/**
+ * Parse a signature, see Secp256k1::ParseSignature().
+ *
+ * Returns 1 if r and s are valid, 0 if the encoding is fine but the values
+ * are out of range and -1 if the encoding is invalid.
+ */
+static int sig_parse_der(scalar_t *r, scalar_t *s, const unsigned char *sig, int len)
+{
+  unsigned char rb[32], sb[32];
+  if (!Secp256k1::ParseSignature(rb, sb, sig, len)) return -1;
+
+  if (scalar_set_b32(r, rb) || scalar_set_b32(s, sb) ||
+      scalar_is_zero(r) || scalar_is_zero(s)) {
+    return 0;
+  }
+  return 1;
+}
+
+static int ecdsa_verify(const scalar_t *sigr, const scalar_t *sigs,
+                        const ge_t *pubkey, const scalar_t *message)
+{
+  scalar_t sn, u1, u2;
+  scalar_inverse(&sn, sigs);
+  scalar_mul(&u1, &sn, message);
+  scalar_mul(&u2, &sn, sigr);
+
+  gej_t pubkeyj, pr;
+  gej_set_ge(&pubkeyj, pubkey);
+  ecmult(&pr, &pubkeyj, &u2, &u1);
+  if (pr.infinity) {
+    return 0;
+  }
+
+  // Compare in Jacobian coordinates: x(R) = X/Z^2 = r (mod n)
+  unsigned char c[32];
+  fe_t xr, z2, t;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 8; j++) {
+      c[i * 8 + j] = (unsigned char)(sigr->d[3 - i] >> (56 - 8 * j));
+    }
+  }
+  fe_set_b32(&xr, c);
+
+  fe_sqr(&z2, &pr.z);
+  fe_mul(&t, &xr, &z2);
+  if (fe_equal(&t, &pr.x)) {
+    return 1;
+  }
+
+  // x(R) may also be r + n, if that is still below p
+  fe_normalize(&xr);
+  if (fe_cmp(&xr, &FE_P_MINUS_N) >= 0) {
+    return 0;
+  }
+  fe_add(&xr, &FE_N);
+  fe_mul(&t, &xr, &z2);
+  return fe_equal(&t, &pr.x);
+}
+
+
+static const unsigned char GX[32] = {
+  0x79, 0xBE, 0x66, 0x7E, 0xF9, 0xDC, 0xBB, 0xAC,
+  0x55, 0xA0, 0x62, 0x95, 0xCE, 0x87, 0x0B, 0x07,
+  0x02, 0x9B, 0xFC, 0xDB, 0x2D, 0xCE, 0x28, 0xD9,
+  0x59, 0xF2, 0x81, 0x5B, 0x16, 0xF8, 0x17, 0x98
+};
+
+static const unsigned char GY[32] = {
+  0x48, 0x3A, 0xDA, 0x77, 0x26, 0xA3, 0xC4, 0x65,
+  0x5D, 0xA4, 0xFB, 0xFC, 0x0E, 0x11, 0x08, 0xA8,
+  0xFD, 0x17, 0xB4, 0x48, 0xA6, 0x85, 0x54, 0x19,
+  0x9C, 0x47, 0xD0, 0x8F, 0xFB, 0x10, 0xD4, 0xB8
+};
+
+void Secp256k1::Init()
+{
+  if (pre_g != NULL) return;
+
+  const int size = TABLE_SIZE(WINDOW_G);
+
+  ge_t g;
+  fe_set_b32(&g.x, GX);
+  fe_set_b32(&g.y, GY);
+
+  // Odd multiples of G in Jacobian coordinates
+  gej_t *prej = (gej_t *) malloc(sizeof(gej_t) * size);
+  gej_t g2;
+  gej_set_ge(&prej[0], &g);
+  gej_double(&g2, &prej[0]);
+  for (int i = 1; i < size; i++) {
+    gej_add(&prej[i], &prej[i - 1], &g2);
+  }
+
+  // Convert to affine with a single inversion (Montgomery's trick)
+  fe_t *acc = (fe_t *) malloc(sizeof(fe_t) * size);
+  acc[0] = prej[0].z;
+  for (int i = 1; i < size; i++) {
+    fe_mul(&acc[i], &acc[i - 1], &prej[i].z);
+  }
+  fe_t inv;
+  fe_inv(&inv, &acc[size - 1]);
+
+  ge_t *table = (ge_t *) malloc(sizeof(ge_t) * size);
+  ge_t *table_lam = (ge_t *) malloc(sizeof(ge_t) * size);
+  for (int i = size - 1; i >= 0; i--) {
+    fe_t zi, zi2, zi3;
+    if (i > 0) {
+      fe_mul(&zi, &inv, &acc[i - 1]);
+      fe_mul(&inv, &inv, &prej[i].z);
+    } else {
+      zi = inv;
+    }
+    fe_sqr(&zi2, &zi);
+    fe_mul(&zi3, &zi2, &zi);
+    fe_mul(&table[i].x, &prej[i].x, &zi2);
+    fe_mul(&table[i].y, &prej[i].y, &zi3);
+    fe_normalize(&table[i].x);
+    fe_normalize(&table[i].y);
+
+    fe_mul(&table_lam[i].x, &table[i].x, &FE_BETA);
+    fe_normalize(&table_lam[i].x);
+    table_lam[i].y = table[i].y;
+  }
+
+  free(acc);
+  free(prej);
+
+  pre_g_lam = table_lam;
+  pre_g = table;
+}
+
+// point_t is a ge_t as far as the outside world is concerned
+typedef char point_size_check[sizeof(Secp256k1::point_t) == sizeof(ge_t) ? 1 : -1];
+
+bool Secp256k1::ParsePublic(point_t *q, const unsigned char *pub, int pubLen)
+{
+  ge_t r;
+  if (!pubkey_parse(&r, pub, pubLen)) {
+    return false;
+  }
+  memcpy(q, &r, sizeof(r));
+  return true;
+}
+
+int Secp256k1::Verify(const point_t *q,
+                      const unsigned char *digest,
+                      const unsigned char *sig, int sigLen)
+{
+  ge_t p;
+  scalar_t r, s, m;
+
+  memcpy(&p, q, sizeof(p));
+
+  int ret = sig_parse_der(&r, &s, sig, sigLen);
+  if (ret != 1) {
+    return ret;
+  }
+
+  scalar_set_b32(&m, digest);
+
+  return ecdsa_verify(&r, &s, &p, &m);
+}
+
+int Secp256k1::Verify(const unsigned char *pub, int pubLen,
+                      const unsigned char *digest,
+                      const unsigned char *sig, int sigLen)
+{
+  point_t q;
+
+  if (!ParsePublic(&q, pub, pubLen)) {
+    return -1;
+  }
+
+  return Verify(&q, digest, sig, sigLen);
+}
@@ -0,0 +1,67 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_SECP256K1_H_
+#define BITCOINJS_SERVER_INCLUDE_SECP256K1_H_
+
+#include <stdint.h>
+
+/**
+ * Specialized ECDSA verification for the secp256k1 curve.
+ *
+ * Field elements use 5x52 bit limbs and scalars 4x64 bit limbs. Both
+ * scalars of u1*G + u2*Q are split with the GLV endomorphism and the four
+ * half-length products are evaluated in a single interleaved wNAF loop
+ * (Shamir's trick). Odd multiples of G are precomputed once by Init().
+ *
+ * This code is not constant time and must only be used on public data.
+ */
+class Secp256k1
+{
+public:
+
+  static void Init();
+
+  /**
+   * A decoded public key. Plain data, so it can be copied around and
+   * cached, see PubKeyCache::GetPoint().
+   */
+  struct point_t {
+    uint64_t d[10];
+  };
+
+  /**
+   * Decode a compressed, uncompressed or hybrid public key. Returns false
+   * if it is not a point on the curve.
+   */
+  static bool ParsePublic(point_t *q, const unsigned char *pub, int pubLen);
+
+  /**
+   * Decode a DER signature into 32 byte big endian r and s. This is as lax
+   * as the JavaScript fallback in lib/binding.js: long form lengths, padded
+   * integers and trailing bytes are accepted, and r and s are read as
+   * unsigned magnitudes, so a missing sign byte doesn't matter. A value
+   * longer than 32 bytes decodes as zero. Returns false if the structure
+   * can't be read.
+   */
+  static bool ParseSignature(unsigned char *r, unsigned char *s,
+                             const unsigned char *sig, int sigLen);
+
+  /**
+   * Verify a DER encoded signature of a 32 byte digest by a decoded public
+   * key. Returns 1, 0 or -1 like the function below.
+   */
+  static int Verify(const point_t *q,
+                    const unsigned char *digest,
+                    const unsigned char *sig, int sigLen);
+
+  /**
+   * Verify a DER encoded signature of a 32 byte digest.
+   *
+   * The public key may be compressed, uncompressed or hybrid. Returns 1 for
+   * a valid signature, 0 for an invalid one and -1 if the key or signature
+   * can't be decoded, just like ECDSA_verify().
+   */
+  static int Verify(const unsigned char *pub, int pubLen,
+                    const unsigned char *digest,
+                    const unsigned char *sig, int sigLen);
+};
+
+#endif
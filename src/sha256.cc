@@ -0,0 +1,694 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sha256.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+static const uint32_t K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t IV[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static inline uint32_t ReadBE32(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void WriteBE32(unsigned char *p, uint32_t x)
+{
+  p[0] = x >> 24;
+  p[1] = x >> 16;
+  p[2] = x >> 8;
+  p[3] = x;
+}
+
+/**
+ * Transform a state with count consecutive 64 byte blocks.
+ */
+typedef void (*transform_t)(uint32_t *state, const unsigned char *blocks, size_t count);
+
+/**
+ * Transform several states (8 words each, one after the other) with one
+ * block per state.
+ */
+typedef void (*transform_lanes_t)(uint32_t *states, const unsigned char **blocks);
+
+
+/*
+ * Portable C
+ */
+
+static inline uint32_t Ror(uint32_t x, int n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+static void TransformPortable(uint32_t *s, const unsigned char *blocks, size_t count)
+{
+  uint32_t w[64];
+
+  for (; count > 0; count--, blocks += 64) {
+    for (int i = 0; i < 16; i++) {
+      w[i] = ReadBE32(blocks + 4 * i);
+    }
+    for (int i = 16; i < 64; i++) {
+      uint32_t s0 = Ror(w[i - 15], 7) ^ Ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t s1 = Ror(w[i - 2], 17) ^ Ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = s[0], b = s[1], c = s[2], d = s[3];
+    uint32_t e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (int i = 0; i < 64; i++) {
+      uint32_t t1 = h + (Ror(e, 6) ^ Ror(e, 11) ^ Ror(e, 25)) +
+                    (g ^ (e & (f ^ g))) + K[i] + w[i];
+      uint32_t t2 = (Ror(a, 2) ^ Ror(a, 13) ^ Ror(a, 22)) +
+                    ((a & b) | (c & (a | b)));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+
+    s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+    s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+  }
+}
+
+
+#ifdef SHA256_X86
+
+/*
+ * Multi-buffer kernels, one message per 32 bit lane
+ *
+ * The round macros below are written in terms of ADD, XOR, ... which each
+ * kernel defines for its own vector type.
+ */
+
+#define ROR(x, n) OR(SHR(x, n), SHL(x, 32 - (n)))
+#define BSIG0(x) XOR(XOR(ROR(x, 2), ROR(x, 13)), ROR(x, 22))
+#define BSIG1(x) XOR(XOR(ROR(x, 6), ROR(x, 11)), ROR(x, 25))
+#define SSIG0(x) XOR(XOR(ROR(x, 7), ROR(x, 18)), SHR(x, 3))
+#define SSIG1(x) XOR(XOR(ROR(x, 17), ROR(x, 19)), SHR(x, 10))
+#define CH(e, f, g) XOR(g, AND(e, XOR(f, g)))
+#define MAJ(a, b, c) OR(AND(a, b), AND(c, OR(a, b)))
+
+#define VROUND(a, b, c, d, e, f, g, h, i) do {                              \
+    if ((i) >= 16) {                                                        \
+      W[(i) & 15] = ADD(ADD(SSIG1(W[((i) - 2) & 15]), W[((i) - 7) & 15]),  \
+                        ADD(SSIG0(W[((i) - 15) & 15]), W[(i) & 15]));       \
+    }                                                                       \
+    T1 = ADD(ADD(h, BSIG1(e)), ADD(ADD(CH(e, f, g), SET1(K[i])),            \
+                                   W[(i) & 15]));                           \
+    T2 = ADD(BSIG0(a), MAJ(a, b, c));                                       \
+    d = ADD(d, T1);                                                         \
+    h = ADD(T1, T2);                                                        \
+  } while (0)
+
+#define VROUNDS(i) do {                      \
+    VROUND(a, b, c, d, e, f, g, h, (i));     \
+    VROUND(h, a, b, c, d, e, f, g, (i) + 1); \
+    VROUND(g, h, a, b, c, d, e, f, (i) + 2); \
+    VROUND(f, g, h, a, b, c, d, e, (i) + 3); \
+    VROUND(e, f, g, h, a, b, c, d, (i) + 4); \
+    VROUND(d, e, f, g, h, a, b, c, (i) + 5); \
+    VROUND(c, d, e, f, g, h, a, b, (i) + 6); \
+    VROUND(b, c, d, e, f, g, h, a, (i) + 7); \
+  } while (0)
+
+#define ADD(a, b) _mm_add_epi32(a, b)
+#define XOR(a, b) _mm_xor_si128(a, b)
+#define OR(a, b) _mm_or_si128(a, b)
+#define AND(a, b) _mm_and_si128(a, b)
+#define SHR(x, n) _mm_srli_epi32(x, n)
+#define SHL(x, n) _mm_slli_epi32(x, n)
+#define SET1(x) _mm_set1_epi32((int) (x))
+
+__attribute__((target("sse4.1")))
+static void Transform4Way(uint32_t *states, const unsigned char **blocks)
+{
+  __m128i W[16], T1, T2;
+
+  for (int i = 0; i < 16; i++) {
+    W[i] = _mm_set_epi32((int) ReadBE32(blocks[3] + 4 * i),
+                         (int) ReadBE32(blocks[2] + 4 * i),
+                         (int) ReadBE32(blocks[1] + 4 * i),
+                         (int) ReadBE32(blocks[0] + 4 * i));
+  }
+
+  __m128i a = _mm_set_epi32(states[24], states[16], states[8], states[0]);
+  __m128i b = _mm_set_epi32(states[25], states[17], states[9], states[1]);
+  __m128i c = _mm_set_epi32(states[26], states[18], states[10], states[2]);
+  __m128i d = _mm_set_epi32(states[27], states[19], states[11], states[3]);
+  __m128i e = _mm_set_epi32(states[28], states[20], states[12], states[4]);
+  __m128i f = _mm_set_epi32(states[29], states[21], states[13], states[5]);
+  __m128i g = _mm_set_epi32(states[30], states[22], states[14], states[6]);
+  __m128i h = _mm_set_epi32(states[31], states[23], states[15], states[7]);
+
+  for (int i = 0; i < 64; i += 8) {
+    VROUNDS(i);
+  }
+
+  uint32_t out[8][4];
+  _mm_storeu_si128((__m128i *) out[0], a);
+  _mm_storeu_si128((__m128i *) out[1], b);
+  _mm_storeu_si128((__m128i *) out[2], c);
+  _mm_storeu_si128((__m128i *) out[3], d);
+  _mm_storeu_si128((__m128i *) out[4], e);
+  _mm_storeu_si128((__m128i *) out[5], f);
+  _mm_storeu_si128((__m128i *) out[6], g);
+  _mm_storeu_si128((__m128i *) out[7], h);
+
+  for (int lane = 0; lane < 4; lane++) {
+    for (int i = 0; i < 8; i++) {
+      states[lane * 8 + i] += out[i][lane];
+    }
+  }
+}
+
+#undef ADD
+#undef XOR
+#undef OR
+#undef AND
+#undef SHR
+#undef SHL
+#undef SET1
+
+#define ADD(a, b) _mm256_add_epi32(a, b)
+#define XOR(a, b) _mm256_xor_si256(a, b)
+#define OR(a, b) _mm256_or_si256(a, b)
+#define AND(a, b) _mm256_and_si256(a, b)
+#define SHR(x, n) _mm256_srli_epi32(x, n)
+#define SHL(x, n) _mm256_slli_epi32(x, n)
+#define SET1(x) _mm256_set1_epi32((int) (x))
+
+__attribute__((target("avx2")))
+static void Transform8Way(uint32_t *states, const unsigned char **blocks)
+{
+  __m256i W[16], T1, T2;
+  __m256i v[8];
+
+  for (int i = 0; i < 16; i++) {
+    W[i] = _mm256_set_epi32((int) ReadBE32(blocks[7] + 4 * i),
+                            (int) ReadBE32(blocks[6] + 4 * i),
+                            (int) ReadBE32(blocks[5] + 4 * i),
+                            (int) ReadBE32(blocks[4] + 4 * i),
+                            (int) ReadBE32(blocks[3] + 4 * i),
+                            (int) ReadBE32(blocks[2] + 4 * i),
+                            (int) ReadBE32(blocks[1] + 4 * i),
+                            (int) ReadBE32(blocks[0] + 4 * i));
+  }
+
+  for (int i = 0; i < 8; i++) {
+    v[i] = _mm256_set_epi32(states[56 + i], states[48 + i], states[40 + i],
+                            states[32 + i], states[24 + i], states[16 + i],
+                            states[8 + i], states[i]);
+  }
+
+  __m256i a = v[0], b = v[1], c = v[2], d = v[3];
+  __m256i e = v[4], f = v[5], g = v[6], h = v[7];
+
+  for (int i = 0; i < 64; i += 8) {
+    VROUNDS(i);
+  }
+
+  uint32_t out[8][8];
+  _mm256_storeu_si256((__m256i *) out[0], a);
+  _mm256_storeu_si256((__m256i *) out[1], b);
+  _mm256_storeu_si256((__m256i *) out[2], c);
+  _mm256_storeu_si256((__m256i *) out[3], d);
+  _mm256_storeu_si256((__m256i *) out[4], e);
+  _mm256_storeu_si256((__m256i *) out[5], f);
+  _mm256_storeu_si256((__m256i *) out[6], g);
+  _mm256_storeu_si256((__m256i *) out[7], h);
+
+  for (int lane = 0; lane < 8; lane++) {
+    for (int i = 0; i < 8; i++) {
+      states[lane * 8 + i] += out[i][lane];
+    }
+  }
+}
+
+#undef ADD
+#undef XOR
+#undef OR
+#undef AND
+#undef SHR
+#undef SHL
+#undef SET1
+
+
+/*
+ * SHA extensions
+ *
+ * Each group of four rounds also advances the message schedule: msg1 and
+ * msg2 compute the next four words from the previous sixteen.
+ */
+
+#define SHANI_ROUNDS(i, W0, W1, W2, W3) do {                                \
+    msg = _mm_add_epi32(W0, _mm_loadu_si128((const __m128i *) &K[4 * (i)])); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);                    \
+    if ((i) >= 3 && (i) <= 14) {                                            \
+      tmp = _mm_alignr_epi8(W0, W3, 4);                                     \
+      W1 = _mm_add_epi32(W1, tmp);                                          \
+      W1 = _mm_sha256msg2_epu32(W1, W0);                                    \
+    }                                                                       \
+    msg = _mm_shuffle_epi32(msg, 0x0E);                                     \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);                    \
+    if ((i) >= 1 && (i) <= 12) {                                            \
+      W3 = _mm_sha256msg1_epu32(W3, W0);                                    \
+    }                                                                       \
+  } while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void TransformShaNi(uint32_t *s, const unsigned char *blocks, size_t count)
+{
+  const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  __m128i state0, state1, msg, tmp;
+  __m128i msg0, msg1, msg2, msg3;
+  __m128i abefSave, cdghSave;
+
+  // The instructions want the state as ABEF and CDGH
+  tmp = _mm_loadu_si128((const __m128i *) &s[0]);
+  state1 = _mm_loadu_si128((const __m128i *) &s[4]);
+  tmp = _mm_shuffle_epi32(tmp, 0xB1);
+  state1 = _mm_shuffle_epi32(state1, 0x1B);
+  state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+  for (; count > 0; count--, blocks += 64) {
+    abefSave = state0;
+    cdghSave = state1;
+
+    msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + 0)), mask);
+    msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + 16)), mask);
+    msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + 32)), mask);
+    msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + 48)), mask);
+
+    SHANI_ROUNDS(0, msg0, msg1, msg2, msg3);
+    SHANI_ROUNDS(1, msg1, msg2, msg3, msg0);
+    SHANI_ROUNDS(2, msg2, msg3, msg0, msg1);
+    SHANI_ROUNDS(3, msg3, msg0, msg1, msg2);
+    SHANI_ROUNDS(4, msg0, msg1, msg2, msg3);
+    SHANI_ROUNDS(5, msg1, msg2, msg3, msg0);
+    SHANI_ROUNDS(6, msg2, msg3, msg0, msg1);
+    SHANI_ROUNDS(7, msg3, msg0, msg1, msg2);
+    SHANI_ROUNDS(8, msg0, msg1, msg2, msg3);
+    SHANI_ROUNDS(9, msg1, msg2, msg3, msg0);
+    SHANI_ROUNDS(10, msg2, msg3, msg0, msg1);
+    SHANI_ROUNDS(11, msg3, msg0, msg1, msg2);
+    SHANI_ROUNDS(12, msg0, msg1, msg2, msg3);
+    SHANI_ROUNDS(13, msg1, msg2, msg3, msg0);
+    SHANI_ROUNDS(14, msg2, msg3, msg0, msg1);
+    SHANI_ROUNDS(15, msg3, msg0, msg1, msg2);
+
+    state0 = _mm_add_epi32(state0, abefSave);
+    state1 = _mm_add_epi32(state1, cdghSave);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1B);
+  state1 = _mm_shuffle_epi32(state1, 0xB1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+  _mm_storeu_si128((__m128i *) &s[0], state0);
+  _mm_storeu_si128((__m128i *) &s[4], state1);
+}
+
+#endif /* SHA256_X86 */
+
+
+/*
+ * Dispatch
+ */
+
+struct impl_t {
+  const char *name;
+  transform_t transform;
+
+  // Multi-buffer kernel, if any, and a narrower one for shorter runs
+  transform_lanes_t transformLanes;
+  int lanes;
+  const impl_t *narrow;
+};
+
+static const impl_t implPortable = { "portable", TransformPortable, NULL, 1, NULL };
+
+#ifdef SHA256_X86
+static const impl_t implSse41 = { "sse41", TransformPortable, Transform4Way, 4, NULL };
+static const impl_t implAvx2 = { "avx2", TransformPortable, Transform8Way, 8, &implSse41 };
+static const impl_t implShaNi = { "shani", TransformShaNi, NULL, 1, NULL };
+
+static bool hasSse41 = false;
+static bool hasAvx2 = false;
+static bool hasShaNi = false;
+#endif
+
+static const impl_t *impl = &implPortable;
+
+void Sha256::Init()
+{
+#ifdef SHA256_X86
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return;
+  }
+
+  bool ssse3 = ecx & (1 << 9);
+  bool sse41 = ecx & (1 << 19);
+  bool osxsave = ecx & (1 << 27);
+  bool avx = ecx & (1 << 28);
+  bool avx2 = false, sha = false;
+
+  if (__get_cpuid_max(0, NULL) >= 7) {
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    avx2 = ebx & (1 << 5);
+    sha = ebx & (1 << 29);
+  }
+
+  // AVX registers are only usable if the OS saves them on context switches
+  bool ymm = false;
+  if (osxsave) {
+    uint32_t lo, hi;
+    __asm__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+    ymm = (lo & 6) == 6;
+  }
+
+  hasSse41 = sse41;
+  hasAvx2 = avx && avx2 && ymm;
+  hasShaNi = sha && ssse3 && sse41;
+
+  if (hasShaNi) {
+    impl = &implShaNi;
+  } else if (hasAvx2) {
+    impl = &implAvx2;
+  } else if (hasSse41) {
+    impl = &implSse41;
+  }
+#endif
+}
+
+const char *Sha256::GetImplementation()
+{
+  return impl->name;
+}
+
+bool Sha256::SetImplementation(const char *name)
+{
+  const impl_t *next = NULL;
+
+  if (strcmp(name, "portable") == 0) {
+    next = &implPortable;
+  }
+#ifdef SHA256_X86
+  else if (strcmp(name, "sse41") == 0 && hasSse41) {
+    next = &implSse41;
+  } else if (strcmp(name, "avx2") == 0 && hasAvx2) {
+    next = &implAvx2;
+  } else if (strcmp(name, "shani") == 0 && hasShaNi) {
+    next = &implShaNi;
+  }
+#endif
+
+  if (next == NULL) {
+    return false;
+  }
+  impl = next;
+  return true;
+}
+
+void Sha256::Initialize(uint32_t *state)
+{
+  memcpy(state, IV, sizeof(IV));
+}
+
+void Sha256::Transform(uint32_t *state, const unsigned char *blocks, size_t count)
+{
+  impl->transform(state, blocks, count);
+}
+
+/**
+ * Pad the last partial block of a message of len bytes. Returns the number
+ * of blocks written to tail, which must have room for 128 bytes.
+ */
+static int FormatTail(unsigned char *tail, const unsigned char *rest, size_t len)
+{
+  size_t restLen = len % 64;
+  int blocks = restLen + 9 > 64 ? 2 : 1;
+
+  memcpy(tail, rest, restLen);
+  memset(tail + restLen, 0, 64 * blocks - restLen);
+  tail[restLen] = 0x80;
+
+  uint64_t bits = (uint64_t) len * 8;
+  unsigned char *end = tail + 64 * blocks;
+  WriteBE32(end - 8, (uint32_t) (bits >> 32));
+  WriteBE32(end - 4, (uint32_t) bits);
+
+  return blocks;
+}
+
+/**
+ * Build the single block for hashing a 32 byte digest.
+ */
+static void FormatDigest(unsigned char *block, const uint32_t *state)
+{
+  for (int i = 0; i < 8; i++) {
+    WriteBE32(block + 4 * i, state[i]);
+  }
+  memset(block + 32, 0, 32);
+  block[32] = 0x80;
+  block[62] = 0x01;  // 256 bits
+}
+
+void Sha256::Single(unsigned char *out, const unsigned char *data, size_t len)
+{
+  uint32_t state[8];
+  unsigned char tail[128];
+
+  memcpy(state, IV, sizeof(state));
+  impl->transform(state, data, len / 64);
+  int blocks = FormatTail(tail, data + len - len % 64, len);
+  impl->transform(state, tail, blocks);
+
+  for (int i = 0; i < 8; i++) {
+    WriteBE32(out + 4 * i, state[i]);
+  }
+}
+
+void Sha256::Double(unsigned char *out, const unsigned char *data, size_t len)
+{
+  uint32_t state[8];
+  unsigned char tail[128];
+
+  memcpy(state, IV, sizeof(state));
+  impl->transform(state, data, len / 64);
+  int blocks = FormatTail(tail, data + len - len % 64, len);
+  impl->transform(state, tail, blocks);
+
+  FormatDigest(tail, state);
+  memcpy(state, IV, sizeof(state));
+  impl->transform(state, tail, 1);
+
+  for (int i = 0; i < 8; i++) {
+    WriteBE32(out + 4 * i, state[i]);
+  }
+}
+
+/**
+ * Hash exactly lanes messages of the same length side by side, twice if
+ * twice is set.
+ */
+static void HashLanes(const impl_t *kernel, unsigned char *out,
+                      const unsigned char * const *data, size_t len, bool twice)
+{
+  const int lanes = kernel->lanes;
+  uint32_t states[8 * 8];
+  unsigned char tails[8][128];
+  const unsigned char *blocks[8];
+
+  for (int l = 0; l < lanes; l++) {
+    memcpy(states + 8 * l, IV, sizeof(IV));
+  }
+
+  size_t full = len / 64;
+  for (size_t j = 0; j < full; j++) {
+    for (int l = 0; l < lanes; l++) {
+      blocks[l] = data[l] + 64 * j;
+    }
+    kernel->transformLanes(states, blocks);
+  }
+
+  int tailBlocks = 0;
+  for (int l = 0; l < lanes; l++) {
+    tailBlocks = FormatTail(tails[l], data[l] + 64 * full, len);
+  }
+  for (int j = 0; j < tailBlocks; j++) {
+    for (int l = 0; l < lanes; l++) {
+      blocks[l] = tails[l] + 64 * j;
+    }
+    kernel->transformLanes(states, blocks);
+  }
+
+  if (twice) {
+    for (int l = 0; l < lanes; l++) {
+      FormatDigest(tails[l], states + 8 * l);
+      memcpy(states + 8 * l, IV, sizeof(IV));
+      blocks[l] = tails[l];
+    }
+    kernel->transformLanes(states, blocks);
+  }
+
+  for (int l = 0; l < lanes; l++) {
+    for (int i = 0; i < 8; i++) {
+      WriteBE32(out + 32 * l + 4 * i, states[8 * l + i]);
+    }
+  }
+}
+
+/**
+ * Hash count messages, handing runs of equally long ones to the widest
+ * multi-buffer kernel that fits.
+ */
+static void HashMany(unsigned char *out, const unsigned char * const *data,
+                     const size_t *lens, size_t count, bool twice)
+{
+  size_t i = 0;
+
+  while (i < count) {
+    // Length of the run of equally long messages starting here
+    size_t run = 1;
+    while (i + run < count && run < 8 && lens[i + run] == lens[i]) {
+      run++;
+    }
+
+    const impl_t *kernel = impl;
+    while (kernel != NULL && (kernel->transformLanes == NULL ||
+                              (size_t) kernel->lanes > run)) {
+      kernel = kernel->narrow;
+    }
+
+    if (kernel != NULL) {
+      HashLanes(kernel, out + 32 * i, data + i, lens[i], twice);
+      i += kernel->lanes;
+    } else if (twice) {
+      Sha256::Double(out + 32 * i, data[i], lens[i]);
+      i++;
+    } else {
+      Sha256::Single(out + 32 * i, data[i], lens[i]);
+      i++;
+    }
+  }
+}
+
+void Sha256::SingleMany(unsigned char *out, const unsigned char * const *data,
+                        const size_t *lens, size_t count)
+{
+  HashMany(out, data, lens, count, false);
+}
+
+void Sha256::DoubleMany(unsigned char *out, const unsigned char * const *data,
+                        const size_t *lens, size_t count)
+{
+  HashMany(out, data, lens, count, true);
+}
+
+void Sha256::Double64(unsigned char *out, const unsigned char *data, size_t count)
+{
+  const unsigned char *ptrs[8];
+  size_t lens[8];
+
+  while (count > 0) {
+    size_t n = count < 8 ? count : 8;
+    for (size_t i = 0; i < n; i++) {
+      ptrs[i] = data + 64 * i;
+      lens[i] = 64;
+    }
+    DoubleMany(out, ptrs, lens, n);
+
+    out += 32 * n;
+    data += 64 * n;
+    count -= n;
+  }
+}
+
+void Sha256::Begin(stream_t *stream)
+{
+  memcpy(stream->state, IV, sizeof(IV));
+  stream->total = 0;
+}
+
+void Sha256::Write(stream_t *stream, const unsigned char *data, size_t len)
+{
+  size_t used = stream->total % 64;
+  stream->total += len;
+
+  if (used) {
+    size_t fill = 64 - used;
+    if (len < fill) {
+      memcpy(stream->buf + used, data, len);
+      return;
+    }
+    memcpy(stream->buf + used, data, fill);
+    impl->transform(stream->state, stream->buf, 1);
+    data += fill;
+    len -= fill;
+  }
+
+  impl->transform(stream->state, data, len / 64);
+  memcpy(stream->buf, data + len - len % 64, len % 64);
+}
+
+void Sha256::FinishSingle(const stream_t *stream, unsigned char *out)
+{
+  uint32_t state[8];
+  unsigned char tail[128];
+
+  memcpy(state, stream->state, sizeof(state));
+  int blocks = FormatTail(tail, stream->buf, stream->total);
+  impl->transform(state, tail, blocks);
+
+  for (int i = 0; i < 8; i++) {
+    WriteBE32(out + 4 * i, state[i]);
+  }
+}
+
+void Sha256::FinishDouble(const stream_t *stream, unsigned char *out)
+{
+  uint32_t state[8];
+  unsigned char tail[128];
+
+  memcpy(state, stream->state, sizeof(state));
+  int blocks = FormatTail(tail, stream->buf, stream->total);
+  impl->transform(state, tail, blocks);
+
+  FormatDigest(tail, state);
+  memcpy(state, IV, sizeof(state));
+  impl->transform(state, tail, 1);
+
+  for (int i = 0; i < 8; i++) {
+    WriteBE32(out + 4 * i, state[i]);
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_SHA256_H_
+#define BITCOINJS_SERVER_INCLUDE_SHA256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Double SHA-256 with CPU specific kernels.
+ *
+ * Init() picks the fastest implementation the CPU supports: the SHA
+ * extensions, 8-way AVX2, 4-way SSE4.1 or portable C. The multi-buffer
+ * kernels hash several messages of the same length side by side, so they
+ * only pay off in DoubleMany() and SingleMany().
+ */
+class Sha256
+{
+public:
+
+  static void Init();
+
+  /**
+   * Name of the active implementation ("shani", "avx2", "sse41" or
+   * "portable").
+   */
+  static const char *GetImplementation();
+
+  /**
+   * Switch to another implementation. Returns false if the CPU doesn't
+   * support it.
+   */
+  static bool SetImplementation(const char *name);
+
+  /**
+   * Set state to the SHA-256 initial hash value.
+   */
+  static void Initialize(uint32_t *state);
+
+  /**
+   * Run the compression function on count consecutive 64 byte blocks.
+   */
+  static void Transform(uint32_t *state, const unsigned char *blocks, size_t count);
+
+  /**
+   * out = SHA256(data), out must have room for 32 bytes.
+   */
+  static void Single(unsigned char *out, const unsigned char *data, size_t len);
+
+  /**
+   * out = SHA256(SHA256(data)), out must have room for 32 bytes.
+   */
+  static void Double(unsigned char *out, const unsigned char *data, size_t len);
+
+  /**
+   * Double hash count messages, writing 32 bytes per message to out.
+   *
+   * Runs of consecutive messages with the same length are handed to the
+   * multi-buffer kernel together.
+   */
+  static void DoubleMany(unsigned char *out, const unsigned char * const *data,
+                         const size_t *lens, size_t count);
+
+  /**
+   * Single hash count messages, batched like DoubleMany().
+   */
+  static void SingleMany(unsigned char *out, const unsigned char * const *data,
+                         const size_t *lens, size_t count);
+
+  /**
+   * Double hash count consecutive 64 byte messages, e.g. the pairs on one
+   * level of a merkle tree. out may not overlap data.
+   */
+  static void Double64(unsigned char *out, const unsigned char *data, size_t count);
+
+  /**
+   * Incremental hash of a message written in pieces. A stream is a
+   * plain struct, so copying one forks the hash of a common prefix.
+   */
+  struct stream_t {
+    uint32_t state[8];
+    unsigned char buf[64];
+    uint64_t total;
+  };
+
+  static void Begin(stream_t *stream);
+  static void Write(stream_t *stream, const unsigned char *data, size_t len);
+
+  /**
+   * out = SHA256(everything written). The stream is left as is.
+   */
+  static void FinishSingle(const stream_t *stream, unsigned char *out);
+
+  /**
+   * out = SHA256(SHA256(everything written)). The stream is left as is.
+   */
+  static void FinishDouble(const stream_t *stream, unsigned char *out);
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+#include "sigcache.h"
+
+uv_rwlock_t SigCache::lock;
+unsigned char SigCache::salt[32];
+
+SigCache::set_t *SigCache::sets = NULL;
+unsigned int SigCache::setMask = 0;
+
+unsigned int SigCache::size = 0;
+unsigned int SigCache::capacity = 0;
+
+volatile uint64_t SigCache::hits = 0;
+volatile uint64_t SigCache::misses = 0;
+uint64_t SigCache::evictions = 0;
+
+void SigCache::Init(unsigned int capacity)
+{
+  uv_rwlock_init(&lock);
+
+  // Without a secret salt, anyone could craft signatures that collide in
+  // a single set and keep evicting each other
+  if (!RAND_bytes(salt, sizeof(salt))) {
+    RAND_pseudo_bytes(salt, sizeof(salt));
+  }
+
+  Resize(capacity);
+}
+
+bool SigCache::IsEmpty(const entry_t *entry)
+{
+  for (unsigned int i = 0; i < sizeof(entry->hash); i++) {
+    if (entry->hash[i]) return false;
+  }
+  return true;
+}
+
+void SigCache::GetEntry(entry_t *entry,
+                        const unsigned char *pub, int pubLen,
+                        const unsigned char *digest,
+                        const unsigned char *sig, int sigLen)
+{
+  // The lengths are hashed as well, so the fields can't shift into each other
+  uint32_t lengths[2] = { (uint32_t) pubLen, (uint32_t) sigLen };
+
+  SHA256_CTX c;
+  SHA256_Init(&c);
+  SHA256_Update(&c, salt, sizeof(salt));
+  SHA256_Update(&c, lengths, sizeof(lengths));
+  SHA256_Update(&c, pub, pubLen);
+  SHA256_Update(&c, digest, 32);
+  SHA256_Update(&c, sig, sigLen);
+  SHA256_Final(entry->hash, &c);
+}
+
+bool SigCache::Contains(const entry_t *entry)
+{
+  bool found = false;
+
+  uv_rwlock_rdlock(&lock);
+  if (sets != NULL) {
+    uint32_t index;
+    memcpy(&index, entry->hash, sizeof(index));
+
+    set_t *set = &sets[index & setMask];
+    for (int i = 0; i < WAYS; i++) {
+      if (memcmp(set->entries[i].hash, entry->hash, sizeof(entry->hash)) == 0) {
+        found = true;
+        break;
+      }
+    }
+  }
+  uv_rwlock_rdunlock(&lock);
+
+  if (found) {
+    __sync_fetch_and_add(&hits, 1);
+  } else {
+    __sync_fetch_and_add(&misses, 1);
+  }
+  return found;
+}
+
+void SigCache::Insert(const entry_t *entry)
+{
+  uv_rwlock_wrlock(&lock);
+  if (sets == NULL) {
+    uv_rwlock_wrunlock(&lock);
+    return;
+  }
+
+  uint32_t index;
+  memcpy(&index, entry->hash, sizeof(index));
+  set_t *set = &sets[index & setMask];
+
+  int slot = -1;
+  for (int i = 0; i < WAYS; i++) {
+    if (memcmp(set->entries[i].hash, entry->hash, sizeof(entry->hash)) == 0) {
+      // Another thread got here first
+      uv_rwlock_wrunlock(&lock);
+      return;
+    }
+    if (slot < 0 && IsEmpty(&set->entries[i])) {
+      slot = i;
+    }
+  }
+
+  if (slot < 0) {
+    // The hash is salted, so its bits are as good as random
+    slot = entry->hash[4] % WAYS;
+    evictions++;
+  } else {
+    size++;
+  }
+  memcpy(&set->entries[slot], entry, sizeof(entry_t));
+
+  uv_rwlock_wrunlock(&lock);
+}
+
+void SigCache::Resize(unsigned int newCapacity)
+{
+  unsigned int setCount = 0;
+  if (newCapacity >= WAYS) {
+    setCount = 1;
+    while (setCount * 2 <= newCapacity / WAYS) setCount <<= 1;
+  }
+
+  set_t *newSets = NULL;
+  if (setCount) {
+    newSets = (set_t *) calloc(setCount, sizeof(set_t));
+    if (newSets == NULL) setCount = 0;
+  }
+
+  uv_rwlock_wrlock(&lock);
+  free(sets);
+  sets = newSets;
+  setMask = setCount ? setCount - 1 : 0;
+  capacity = setCount * WAYS;
+  size = 0;
+  uv_rwlock_wrunlock(&lock);
+}
+
+void SigCache::GetStats(stats_t *stats)
+{
+  uv_rwlock_rdlock(&lock);
+  stats->hits = hits;
+  stats->misses = misses;
+  stats->evictions = evictions;
+  stats->size = size;
+  stats->capacity = capacity;
+  uv_rwlock_rdunlock(&lock);
+}
@@ -0,0 +1,87 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_SIGCACHE_H_
+#define BITCOINJS_SERVER_INCLUDE_SIGCACHE_H_
+
+#include <stdint.h>
+
+#include <uv.h>
+
+/**
+ * Cache of signatures that have been verified successfully.
+ *
+ * Transactions are verified once when they enter the memory pool and again
+ * when they are included in a block. This cache remembers valid
+ * (pubkey, hash, sig) triples, so the second check costs only a lookup.
+ *
+ * Entries are the salted SHA-256 of the triple. They live in a fixed size,
+ * four-way set associative table, so memory use never grows beyond the
+ * configured capacity. A full set evicts one of its entries at random.
+ * Lookups take a shared lock and are safe to use from the thread pool.
+ */
+class SigCache
+{
+public:
+
+  struct entry_t {
+    unsigned char hash[32];
+  };
+
+  struct stats_t {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    unsigned int size;
+    unsigned int capacity;
+  };
+
+private:
+
+  // Entries per set
+  static const int WAYS = 4;
+
+  struct set_t {
+    entry_t entries[WAYS];
+  };
+
+  static uv_rwlock_t lock;
+  static unsigned char salt[32];
+
+  static set_t *sets;
+  static unsigned int setMask;
+
+  static unsigned int size;
+  static unsigned int capacity;
+
+  static volatile uint64_t hits;
+  static volatile uint64_t misses;
+  static uint64_t evictions;
+
+  static bool IsEmpty(const entry_t *entry);
+
+public:
+
+  static void Init(unsigned int capacity);
+
+  /**
+   * Compute the cache entry for a signature.
+   */
+  static void GetEntry(entry_t *entry,
+                       const unsigned char *pub, int pubLen,
+                       const unsigned char *digest,
+                       const unsigned char *sig, int sigLen);
+
+  static bool Contains(const entry_t *entry);
+
+  static void Insert(const entry_t *entry);
+
+  /**
+   * Change the number of entries, clearing the cache.
+   *
+   * The capacity is rounded down to a power of two. A capacity of zero
+   * disables the cache.
+   */
+  static void Resize(unsigned int capacity);
+
+  static void GetStats(stats_t *stats);
+};
+
+#endif
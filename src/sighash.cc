@@ -0,0 +1,225 @@
+#include <string.h>
+
+#include "common.h"
+#include "sighash.h"
+#include "sha256.h"
+#include "txparser.h"
+
+// Outpoint, zero script length and sequence
+#define BLANK_IN_SIZE 41
+#define OUTPOINT_SIZE 36
+
+// Value of -1 and an empty script
+static const unsigned char BLANK_OUT[9] = {
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00
+};
+
+static void WriteVarInt(Sha256::stream_t *stream, uint64_t value)
+{
+  unsigned char buf[9];
+  size_t len;
+
+  if (value < 0xfd) {
+    buf[0] = value;
+    len = 1;
+  } else {
+    int size = value <= 0xffff ? 2 : value <= 0xffffffff ? 4 : 8;
+    buf[0] = size == 2 ? 0xfd : size == 4 ? 0xfe : 0xff;
+    for (int i = 0; i < size; i++) {
+      buf[1 + i] = (value >> (8 * i)) & 0xff;
+    }
+    len = 1 + size;
+  }
+
+  Sha256::Write(stream, buf, len);
+}
+
+bool SigHash::Parse(tx_t *tx, const unsigned char *data, size_t len)
+{
+  TxParser::table_t table;
+  size_t pos = 0;
+
+  tx->inCount = 0;
+  tx->blankIns = NULL;
+  tx->blankInsNoSeq = NULL;
+  tx->outCount = 0;
+  tx->outStarts = NULL;
+
+  // The transaction hash isn't needed, only where the fields are
+  TxParser::Init(&table, 1);
+  if (!TxParser::ParseTx(&table, 0, NULL, data, len, &pos) || pos != len) {
+    TxParser::Free(&table);
+    return false;
+  }
+
+  const uint32_t *record = table.words;
+  tx->version = data;
+  tx->lockTime = data + len - 4;
+
+  tx->inCount = record[4];
+  tx->blankIns = new unsigned char[BLANK_IN_SIZE * tx->inCount];
+  tx->blankInsNoSeq = new unsigned char[BLANK_IN_SIZE * tx->inCount];
+
+  // The outputs start right after the last input's sequence
+  size_t outsPos = 4;
+  if (tx->inCount == 0) {
+    uint32_t count;
+    TxParser::ReadVarInt(data, len, &outsPos, &count);
+  }
+
+  for (size_t i = 0; i < tx->inCount; i++) {
+    const uint32_t *in = table.words + record[5] + TxParser::IN_WORDS * i;
+    unsigned char *blank = tx->blankIns + BLANK_IN_SIZE * i;
+    unsigned char *blankNoSeq = tx->blankInsNoSeq + BLANK_IN_SIZE * i;
+
+    memcpy(blank, data + in[0], OUTPOINT_SIZE);
+    blank[OUTPOINT_SIZE] = 0;
+    WriteLE32(blank + OUTPOINT_SIZE + 1, in[3]);
+
+    memcpy(blankNoSeq, blank, OUTPOINT_SIZE + 1);
+    memset(blankNoSeq + OUTPOINT_SIZE + 1, 0, 4);
+
+    outsPos = in[1] + in[2] + 4;
+  }
+
+  tx->outs = data + outsPos;
+  tx->outsLen = tx->lockTime - tx->outs;
+  tx->outCount = record[6];
+  tx->outStarts = new const unsigned char *[tx->outCount + 1];
+  for (size_t i = 0; i < tx->outCount; i++) {
+    const uint32_t *out = table.words + record[7] + TxParser::OUT_WORDS * i;
+    tx->outStarts[i] = data + out[0];
+  }
+  tx->outStarts[tx->outCount] = tx->lockTime;
+
+  TxParser::Free(&table);
+  return true;
+}
+
+void SigHash::Free(tx_t *tx)
+{
+  delete [] tx->blankIns;
+  delete [] tx->blankInsNoSeq;
+  delete [] tx->outStarts;
+  tx->blankIns = NULL;
+  tx->blankInsNoSeq = NULL;
+  tx->outStarts = NULL;
+}
+
+/**
+ * Everything from the input being signed onwards. stream must already
+ * contain the version, input count and the blanked inputs before it.
+ */
+static bool Finish(unsigned char *out, Sha256::stream_t *stream,
+                   const SigHash::tx_t *tx, size_t inIndex,
+                   const unsigned char *script, size_t scriptLen,
+                   uint32_t hashType)
+{
+  int mode = hashType & 0x1f;
+  bool anyoneCanPay = (hashType & SigHash::SIGHASH_ANYONECANPAY) != 0;
+  bool keepSequences = mode != SigHash::SIGHASH_NONE && mode != SigHash::SIGHASH_SINGLE;
+
+  if (mode == SigHash::SIGHASH_SINGLE && inIndex >= tx->outCount) {
+    return false;
+  }
+
+  // The input being signed keeps its own sequence in every mode
+  const unsigned char *current = tx->blankIns + BLANK_IN_SIZE * inIndex;
+  Sha256::Write(stream, current, OUTPOINT_SIZE);
+  WriteVarInt(stream, scriptLen);
+  Sha256::Write(stream, script, scriptLen);
+  Sha256::Write(stream, current + OUTPOINT_SIZE + 1, 4);
+
+  if (!anyoneCanPay) {
+    const unsigned char *blank = keepSequences ? tx->blankIns : tx->blankInsNoSeq;
+    Sha256::Write(stream, blank + BLANK_IN_SIZE * (inIndex + 1),
+                  BLANK_IN_SIZE * (tx->inCount - inIndex - 1));
+  }
+
+  if (mode == SigHash::SIGHASH_NONE) {
+    WriteVarInt(stream, 0);
+  } else if (mode == SigHash::SIGHASH_SINGLE) {
+    WriteVarInt(stream, inIndex + 1);
+    for (size_t i = 0; i < inIndex; i++) {
+      Sha256::Write(stream, BLANK_OUT, sizeof(BLANK_OUT));
+    }
+    Sha256::Write(stream, tx->outStarts[inIndex],
+                  tx->outStarts[inIndex + 1] - tx->outStarts[inIndex]);
+  } else {
+    Sha256::Write(stream, tx->outs, tx->outsLen);
+  }
+
+  Sha256::Write(stream, tx->lockTime, 4);
+
+  unsigned char type[4];
+  WriteLE32(type, hashType);
+  Sha256::Write(stream, type, 4);
+
+  Sha256::FinishDouble(stream, out);
+  return true;
+}
+
+bool SigHash::Hash(unsigned char *out, const tx_t *tx, size_t inIndex,
+                   const unsigned char *script, size_t scriptLen,
+                   uint32_t hashType)
+{
+  int mode = hashType & 0x1f;
+  Sha256::stream_t stream;
+
+  Sha256::Begin(&stream);
+  Sha256::Write(&stream, tx->version, 4);
+
+  if (hashType & SIGHASH_ANYONECANPAY) {
+    WriteVarInt(&stream, 1);
+  } else {
+    bool keepSequences = mode != SIGHASH_NONE && mode != SIGHASH_SINGLE;
+    WriteVarInt(&stream, tx->inCount);
+    Sha256::Write(&stream, keepSequences ? tx->blankIns : tx->blankInsNoSeq,
+                  BLANK_IN_SIZE * inIndex);
+  }
+
+  return Finish(out, &stream, tx, inIndex, script, scriptLen, hashType);
+}
+
+bool SigHash::HashAll(unsigned char *out, const tx_t *tx,
+                      const unsigned char * const *scripts,
+                      const size_t *scriptLens, const uint32_t *hashTypes)
+{
+  // Hash of the blanked inputs in front of the current one, kept for both
+  // kinds of blanking and only brought up to date when needed
+  Sha256::stream_t prefix, prefixNoSeq;
+  size_t prefixPos = 0, prefixNoSeqPos = 0;
+
+  Sha256::Begin(&prefix);
+  Sha256::Write(&prefix, tx->version, 4);
+  WriteVarInt(&prefix, tx->inCount);
+  prefixNoSeq = prefix;
+
+  for (size_t i = 0; i < tx->inCount; i++) {
+    uint32_t hashType = hashTypes[i];
+    int mode = hashType & 0x1f;
+    Sha256::stream_t stream;
+
+    if (hashType & SIGHASH_ANYONECANPAY) {
+      Sha256::Begin(&stream);
+      Sha256::Write(&stream, tx->version, 4);
+      WriteVarInt(&stream, 1);
+    } else if (mode != SIGHASH_NONE && mode != SIGHASH_SINGLE) {
+      Sha256::Write(&prefix, tx->blankIns + BLANK_IN_SIZE * prefixPos,
+                    BLANK_IN_SIZE * (i - prefixPos));
+      prefixPos = i;
+      stream = prefix;
+    } else {
+      Sha256::Write(&prefixNoSeq, tx->blankInsNoSeq + BLANK_IN_SIZE * prefixNoSeqPos,
+                    BLANK_IN_SIZE * (i - prefixNoSeqPos));
+      prefixNoSeqPos = i;
+      stream = prefixNoSeq;
+    }
+
+    if (!Finish(out + 32 * i, &stream, tx, i, scripts[i], scriptLens[i], hashType)) {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,73 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_SIGHASH_H_
+#define BITCOINJS_SERVER_INCLUDE_SIGHASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Signature hashes (SignatureHash() in the reference client) computed
+ * straight from a serialized transaction.
+ *
+ * Parse() locates the fields with TxParser and prepares everything that
+ * doesn't depend on the input being signed: the inputs with blanked
+ * scripts (with and without their sequence numbers) and the location of
+ * the outputs.
+ * Each digest is then streamed from those pieces without building the
+ * modified transaction. HashAll() also carries the hash of the blanked
+ * inputs in front of the current one over from one input to the next.
+ */
+class SigHash
+{
+public:
+
+  enum {
+    SIGHASH_ALL = 1,
+    SIGHASH_NONE = 2,
+    SIGHASH_SINGLE = 3,
+    SIGHASH_ANYONECANPAY = 0x80
+  };
+
+  struct tx_t {
+    const unsigned char *version;
+    const unsigned char *lockTime;
+
+    size_t inCount;
+    // Per input: outpoint, empty script and sequence, 41 bytes each
+    unsigned char *blankIns;
+    // The same with all sequences set to zero
+    unsigned char *blankInsNoSeq;
+
+    size_t outCount;
+    // Output count and all outputs as serialized
+    const unsigned char *outs;
+    size_t outsLen;
+    // Start of each output, plus the end of the last one
+    const unsigned char **outStarts;
+  };
+
+  /**
+   * Parse a serialized transaction. tx points into data, which must stay
+   * around until Free(). Returns false if the transaction is malformed.
+   */
+  static bool Parse(tx_t *tx, const unsigned char *data, size_t len);
+  static void Free(tx_t *tx);
+
+  /**
+   * Hash for signing input inIndex with the given script code (with
+   * OP_CODESEPARATORs already removed). Returns false for SIGHASH_SINGLE
+   * without a matching output.
+   */
+  static bool Hash(unsigned char *out, const tx_t *tx, size_t inIndex,
+                   const unsigned char *script, size_t scriptLen,
+                   uint32_t hashType);
+
+  /**
+   * Hashes for all inputs, 32 bytes per input. Returns false if any of
+   * them fails as in Hash().
+   */
+  static bool HashAll(unsigned char *out, const tx_t *tx,
+                      const unsigned char * const *scripts,
+                      const size_t *scriptLens, const uint32_t *hashTypes);
+};
+
+#endif
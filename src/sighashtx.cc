@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <v8.h>
+
+#include <node.h>
+#include <node_buffer.h>
+
+#include "common.h"
+#include "sighashtx.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+
+Persistent<FunctionTemplate> SigHashTx::s_ct;
+
+void SigHashTx::Init(Handle<Object> target)
+{
+  HandleScope scope;
+  Local<FunctionTemplate> t = FunctionTemplate::New(New);
+
+  s_ct = Persistent<FunctionTemplate>::New(t);
+  s_ct->InstanceTemplate()->SetInternalFieldCount(1);
+  s_ct->SetClassName(String::NewSymbol("SigHashTx"));
+
+  // Methods
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "hash", Hash);
+
+  target->Set(String::NewSymbol("SigHashTx"),
+              s_ct->GetFunction());
+}
+
+SigHashTx::SigHashTx() :
+  data(NULL)
+{
+  tx.blankIns = NULL;
+  tx.blankInsNoSeq = NULL;
+  tx.outStarts = NULL;
+}
+
+SigHashTx::~SigHashTx()
+{
+  SigHash::Free(&tx);
+  free(data);
+}
+
+Handle<Value>
+SigHashTx::New(const Arguments& args)
+{
+  if (!args.IsConstructCall()) {
+    return FromConstructorTemplate(s_ct, args);
+  }
+
+  HandleScope scope;
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: tx");
+  }
+  if (!Buffer::HasInstance(args[0])) {
+    return VException("Argument 'tx' must be of type Buffer");
+  }
+
+  size_t len = Buffer::Length(args[0]);
+  unsigned char *data = (unsigned char *) malloc(len + 1);
+  memcpy(data, Buffer::Data(args[0]), len);
+
+  SigHashTx *parsed = new SigHashTx();
+  parsed->data = data;
+  if (!SigHash::Parse(&parsed->tx, data, len)) {
+    delete parsed;
+    return VException("Argument 'tx' is not a valid transaction");
+  }
+
+  parsed->Wrap(args.Holder());
+  return scope.Close(args.This());
+}
+
+Handle<Value>
+SigHashTx::Hash(const Arguments& args)
+{
+  HandleScope scope;
+  SigHashTx *parsed = ObjectWrap::Unwrap<SigHashTx>(args.This());
+
+  if (args.Length() != 3) {
+    return VException("Three arguments expected: inIndex, script, hashType");
+  }
+  if (!args[0]->IsUint32()) {
+    return VException("Argument 'inIndex' must be a Number");
+  }
+  if (!Buffer::HasInstance(args[1])) {
+    return VException("Argument 'script' must be of type Buffer");
+  }
+  if (!args[2]->IsUint32()) {
+    return VException("Argument 'hashType' must be a Number");
+  }
+
+  size_t inIndex = args[0]->Uint32Value();
+  if (inIndex >= parsed->tx.inCount) {
+    return VException("Argument 'inIndex' out of range");
+  }
+
+  Buffer *hash_buf = Buffer::New(32);
+  if (!SigHash::Hash((unsigned char *) Buffer::Data(hash_buf), &parsed->tx, inIndex,
+                     (const unsigned char *) Buffer::Data(args[1]),
+                     Buffer::Length(args[1]), args[2]->Uint32Value())) {
+    return VException("SIGHASH_SINGLE without a matching output");
+  }
+  return scope.Close(hash_buf->handle_);
+}
@@ -0,0 +1,47 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_SIGHASHTX_H_
+#define BITCOINJS_SERVER_INCLUDE_SIGHASHTX_H_
+
+#include <stddef.h>
+
+#include <v8.h>
+#include <node.h>
+
+#include "sighash.h"
+
+using namespace v8;
+using namespace node;
+
+/**
+ * A transaction parsed once for SigHash, so the script interpreter can ask
+ * for the hash of one input after another without walking the whole
+ * transaction each time.
+ *
+ * JavaScript API:
+ *
+ *   new SigHashTx(tx)                         -> tx is the serialized Buffer
+ *   sigHashTx.hash(inIndex, script, hashType) -> 32 byte Buffer
+ *
+ * hash() takes the same arguments as sighash() minus the transaction. The
+ * transaction is copied, so later changes to the Buffer have no effect.
+ */
+class SigHashTx : ObjectWrap
+{
+private:
+
+  unsigned char *data;
+  SigHash::tx_t tx;
+
+  SigHashTx();
+  ~SigHashTx();
+
+public:
+
+  static Persistent<FunctionTemplate> s_ct;
+
+  static void Init(Handle<Object> target);
+
+  static Handle<Value> New(const Arguments& args);
+  static Handle<Value> Hash(const Arguments& args);
+};
+
+#endif
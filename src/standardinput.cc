@@ -0,0 +1,229 @@
+#include <string.h>
+
+#include <v8.h>
+
+#include <node.h>
+#include <node_buffer.h>
+
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include <openssl/ripemd.h>
+
+#include "common.h"
+#include "ecdsa.h"
+#include "sha256.h"
+#include "sighash.h"
+#include "standardinput.h"
+#include "workpool.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+
+#define OP_DUP 0x76
+#define OP_HASH160 0xa9
+#define OP_EQUALVERIFY 0x88
+#define OP_CHECKSIG 0xac
+
+// Length of the pubkey hash push in a pay-to-pubkey-hash script
+#define HASH_POS 3
+
+/**
+ * Read a direct push (opcodes 1 to 75) at *pos. Longer pushes never occur
+ * in the standard templates.
+ */
+static bool
+read_push (const unsigned char *script, size_t len, size_t *pos,
+           const unsigned char **data, size_t *dataLen)
+{
+  if (*pos >= len) return false;
+
+  size_t n = script[*pos];
+  if (n < 1 || n > 75 || len - *pos - 1 < n) return false;
+
+  *data = script + *pos + 1;
+  *dataLen = n;
+  *pos += 1 + n;
+  return true;
+}
+
+static bool
+is_pubkey_length (size_t len)
+{
+  return len == 33 || len == 65;
+}
+
+bool StandardInput::Match(input_t *input,
+                          const unsigned char *scriptSig, size_t scriptSigLen,
+                          const unsigned char *scriptPubKey, size_t scriptPubKeyLen)
+{
+  size_t pos = 0;
+  if (!read_push(scriptSig, scriptSigLen, &pos, &input->sig, &input->sigLen)) {
+    return false;
+  }
+
+  if (scriptPubKeyLen == 25 &&
+      scriptPubKey[0] == OP_DUP &&
+      scriptPubKey[1] == OP_HASH160 &&
+      scriptPubKey[2] == RIPEMD160_DIGEST_LENGTH &&
+      scriptPubKey[23] == OP_EQUALVERIFY &&
+      scriptPubKey[24] == OP_CHECKSIG) {
+    // Pay to pubkey hash: <sig> <pubkey>
+    if (!read_push(scriptSig, scriptSigLen, &pos, &input->pub, &input->pubLen) ||
+        pos != scriptSigLen || !is_pubkey_length(input->pubLen)) {
+      return false;
+    }
+
+    // The interpreter would delete the signature from the script code
+    if (input->sigLen == RIPEMD160_DIGEST_LENGTH &&
+        !memcmp(input->sig, scriptPubKey + HASH_POS, RIPEMD160_DIGEST_LENGTH)) {
+      return false;
+    }
+    return true;
+  }
+
+  // Pay to pubkey: <sig>
+  size_t pubPos = 0;
+  if (pos != scriptSigLen ||
+      !read_push(scriptPubKey, scriptPubKeyLen, &pubPos, &input->pub, &input->pubLen) ||
+      !is_pubkey_length(input->pubLen) ||
+      pubPos + 1 != scriptPubKeyLen || scriptPubKey[pubPos] != OP_CHECKSIG) {
+    return false;
+  }
+
+  if (input->sigLen == input->pubLen &&
+      !memcmp(input->sig, input->pub, input->pubLen)) {
+    return false;
+  }
+  return true;
+}
+
+void StandardInput::Init(Handle<Object> target)
+{
+  HandleScope scope;
+
+  target->Set(String::New("verify_standard_input"), FunctionTemplate::New(Verify)->GetFunction());
+}
+
+void StandardInput::EIO_Verify(uv_work_t *req)
+{
+  verify_baton_t *b = static_cast<verify_baton_t *>(req->data);
+
+  if (b->pubLen == 0) {
+    b->result = 0;
+    return;
+  }
+
+  b->result = Ecdsa::Verify(Ecdsa::GetThreadKey(), b->pub, b->pubLen,
+                            b->digest, b->sig, b->sigLen);
+}
+
+void StandardInput::VerifyCallback(uv_work_t *req, int status)
+{
+  HandleScope scope;
+  verify_baton_t *baton = static_cast<verify_baton_t *>(req->data);
+
+  // Errors decoding the key or signature make the signature invalid, as
+  // in the interpreter
+  Local<Value> argv[2];
+  argv[0] = Local<Value>::New(Null());
+  argv[1] = Local<Value>::New(Boolean::New(baton->result == 1));
+
+  TryCatch try_catch;
+
+  baton->cb->Call(Context::GetCurrent()->Global(), 2, argv);
+
+  baton->cb.Dispose();
+  delete baton;
+  delete req;
+
+  if (try_catch.HasCaught()) {
+    FatalException(try_catch);
+  }
+}
+
+Handle<Value> StandardInput::Verify(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 5) {
+    return VException("Five arguments expected: tx, inIndex, scriptSig, scriptPubKey, callback");
+  }
+  if (!Buffer::HasInstance(args[0])) {
+    return VException("Argument 'tx' must be of type Buffer");
+  }
+  if (!args[1]->IsUint32()) {
+    return VException("Argument 'inIndex' must be a Number");
+  }
+  if (!Buffer::HasInstance(args[2])) {
+    return VException("Argument 'scriptSig' must be of type Buffer");
+  }
+  if (!Buffer::HasInstance(args[3])) {
+    return VException("Argument 'scriptPubKey' must be of type Buffer");
+  }
+  REQ_FUN_ARG(4, cb);
+
+  const unsigned char *scriptPubKey = (const unsigned char *) Buffer::Data(args[3]);
+  size_t scriptPubKeyLen = Buffer::Length(args[3]);
+
+  input_t input;
+  if (!Match(&input,
+             (const unsigned char *) Buffer::Data(args[2]), Buffer::Length(args[2]),
+             scriptPubKey, scriptPubKeyLen)) {
+    return scope.Close(False());
+  }
+
+  // A pubkey that doesn't match the hash fails EQUALVERIFY, which the
+  // interpreter reports as an error rather than an invalid signature
+  if (scriptPubKeyLen == 25) {
+    unsigned char digest[32];
+    unsigned char hash[RIPEMD160_DIGEST_LENGTH];
+    Sha256::Single(digest, input.pub, input.pubLen);
+    RIPEMD160(digest, 32, hash);
+    if (memcmp(hash, scriptPubKey + HASH_POS, RIPEMD160_DIGEST_LENGTH)) {
+      return scope.Close(False());
+    }
+  }
+
+  SigHash::tx_t tx;
+  if (!SigHash::Parse(&tx, (const unsigned char *) Buffer::Data(args[0]),
+                      Buffer::Length(args[0]))) {
+    return VException("Argument 'tx' is not a valid transaction");
+  }
+
+  size_t inIndex = args[1]->Uint32Value();
+  if (inIndex >= tx.inCount) {
+    SigHash::Free(&tx);
+    return VException("Argument 'inIndex' out of range");
+  }
+
+  verify_baton_t *baton = new verify_baton_t();
+  memcpy(baton->pub, input.pub, input.pubLen);
+  baton->pubLen = input.pubLen;
+  memcpy(baton->sig, input.sig, input.sigLen - 1);
+  baton->sigLen = input.sigLen - 1;
+  baton->result = 0;
+
+  // The last byte of the signature is the hash type. The script code is
+  // the whole scriptPubKey, the templates have no OP_CODESEPARATOR.
+  uint32_t hashType = input.sig[input.sigLen - 1];
+  bool ok = SigHash::Hash(baton->digest, &tx, inIndex,
+                          scriptPubKey, scriptPubKeyLen, hashType);
+  SigHash::Free(&tx);
+
+  // SIGHASH_SINGLE without a matching output can't be signed. Clearing
+  // the key marks the signature invalid, the callback still runs
+  // asynchronously.
+  if (!ok) {
+    baton->pubLen = 0;
+  }
+
+  baton->cb = Persistent<Function>::New(cb);
+
+  uv_work_t *req = new uv_work_t;
+  req->data = baton;
+
+  WorkPool::Queue(req, EIO_Verify, VerifyCallback);
+
+  return scope.Close(True());
+}
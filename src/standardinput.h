@@ -0,0 +1,71 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_STANDARDINPUT_H_
+#define BITCOINJS_SERVER_INCLUDE_STANDARDINPUT_H_
+
+#include <stddef.h>
+
+#include <v8.h>
+#include <uv.h>
+
+using namespace v8;
+
+/**
+ * Verification of standard inputs without the script interpreter.
+ *
+ * Pay-to-pubkey-hash and pay-to-pubkey spends are recognized by their
+ * templates. The pubkey hash is compared and the signature hash computed
+ * on the loop thread, only the ECDSA check goes to the thread pool.
+ * Anything else, including a pubkey that doesn't match its hash, is left
+ * to the interpreter, so the results and errors are exactly the ones it
+ * would give.
+ *
+ * JavaScript API:
+ *
+ *   verify_standard_input(tx, inIndex, scriptSig, scriptPubKey, callback)
+ *     -> Boolean
+ *
+ * Returns false, without calling back, if the scripts are not standard.
+ * Otherwise the callback receives (err, valid).
+ */
+class StandardInput
+{
+public:
+
+  struct input_t {
+    const unsigned char *pub;
+    size_t pubLen;
+    // Signature including the hash type byte
+    const unsigned char *sig;
+    size_t sigLen;
+  };
+
+  /**
+   * Match a scriptSig/scriptPubKey pair against the standard templates.
+   * The pointers in input point into the scripts.
+   */
+  static bool Match(input_t *input,
+                    const unsigned char *scriptSig, size_t scriptSigLen,
+                    const unsigned char *scriptPubKey, size_t scriptPubKeyLen);
+
+  static void Init(Handle<Object> target);
+
+private:
+
+  struct verify_baton_t {
+    unsigned char pub[65];
+    int pubLen;
+    unsigned char digest[32];
+    unsigned char sig[80];
+    int sigLen;
+
+    // -1 = error, 0 = bad sig, 1 = good
+    int result;
+    Persistent<Function> cb;
+  };
+
+  static void EIO_Verify(uv_work_t *req);
+  static void VerifyCallback(uv_work_t *req, int status);
+
+  static Handle<Value> Verify(const Arguments& args);
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include <string.h>
+
+#include "stats.h"
+
+Stats::shard_t Stats::shards[SHARDS];
+volatile int Stats::nextShard = 0;
+__thread int Stats::shardIndex = -1;
+
+static const char *names[Stats::OP_COUNT] = {
+  "verifySignature",
+  "verifySignatureSync",
+  "verifyBatch",
+  "sign",
+  "signSync",
+  "generate",
+  "base58_encode",
+  "base58_decode",
+  "base58check_encode",
+  "base58check_decode",
+  "sha256_midstate",
+  "pubkey_to_address256"
+};
+
+const char *Stats::GetName(op_t op)
+{
+  return names[op];
+}
+
+static void
+add_histogram (Stats::histogram_t *sum, const Stats::histogram_t *hist)
+{
+  sum->count += hist->count;
+  sum->sum += hist->sum;
+  for (int i = 0; i < Stats::BUCKETS; i++) {
+    sum->buckets[i] += hist->buckets[i];
+  }
+}
+
+void Stats::Get(op_stats_t *stats)
+{
+  memset(stats, 0, sizeof(op_stats_t) * OP_COUNT);
+
+  for (int s = 0; s < SHARDS; s++) {
+    for (int op = 0; op < OP_COUNT; op++) {
+      const op_stats_t *shard = &shards[s].ops[op];
+      for (int r = 0; r < RESULT_COUNT; r++) {
+        stats[op].results[r] += shard->results[r];
+      }
+      add_histogram(&stats[op].wait, &shard->wait);
+      add_histogram(&stats[op].run, &shard->run);
+    }
+  }
+}
+
+void Stats::Reset()
+{
+  // Updates racing with this may survive it, which is fine for statistics
+  memset(shards, 0, sizeof(shards));
+}
+
+bool Stats::IsEnabled()
+{
+#ifndef DISABLE_STATS
+  return true;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,175 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_STATS_H_
+#define BITCOINJS_SERVER_INCLUDE_STATS_H_
+
+#include <stdint.h>
+
+#include <uv.h>
+
+/**
+ * Counters and latency histograms for the addon's operations.
+ *
+ * Every operation counts its results (good, bad or error) and records how
+ * long it ran. Operations that go through the work pool also record how
+ * long they waited in the queue. For batched operations the histograms
+ * are per job and the results per item.
+ *
+ * Histograms have log2 buckets: bucket i counts durations from 2^i up to
+ * 2^(i+1) nanoseconds, the last bucket everything above.
+ *
+ * Threads update their own shard of the counters, so the workers don't
+ * fight over cache lines. Reading sums the shards and may miss updates
+ * that happen at the same time.
+ *
+ * Building with DISABLE_STATS turns all recording into no-ops.
+ */
+class Stats
+{
+public:
+
+  enum op_t {
+    OP_VERIFY,
+    OP_VERIFY_SYNC,
+    OP_VERIFY_BATCH,
+    OP_SIGN,
+    OP_SIGN_SYNC,
+    OP_GENERATE,
+    OP_BASE58_ENCODE,
+    OP_BASE58_DECODE,
+    OP_BASE58CHECK_ENCODE,
+    OP_BASE58CHECK_DECODE,
+    OP_SHA256_MIDSTATE,
+    OP_ADDRESS,
+    OP_COUNT
+  };
+
+  enum result_t {
+    RESULT_GOOD,
+    RESULT_BAD,
+    RESULT_ERROR,
+    RESULT_COUNT
+  };
+
+  static const int BUCKETS = 32;
+
+  struct histogram_t {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t buckets[BUCKETS];
+  };
+
+  struct op_stats_t {
+    uint64_t results[RESULT_COUNT];
+    histogram_t wait;
+    histogram_t run;
+  };
+
+  static const char *GetName(op_t op);
+
+  /**
+   * Sum of all shards, for every operation.
+   */
+  static void Get(op_stats_t *stats);
+
+  static void Reset();
+
+  static bool IsEnabled();
+
+#ifndef DISABLE_STATS
+
+  static uint64_t Now() { return uv_hrtime(); }
+
+  static void Count(op_t op, result_t result, uint64_t n = 1)
+  {
+    __sync_fetch_and_add(&GetShard()->ops[op].results[result], n);
+  }
+
+  static void RecordWait(op_t op, uint64_t ns)
+  {
+    Record(&GetShard()->ops[op].wait, ns);
+  }
+
+  static void RecordRun(op_t op, uint64_t ns)
+  {
+    Record(&GetShard()->ops[op].run, ns);
+  }
+
+#else
+
+  static uint64_t Now() { return 0; }
+  static void Count(op_t op, result_t result, uint64_t n = 1) {}
+  static void RecordWait(op_t op, uint64_t ns) {}
+  static void RecordRun(op_t op, uint64_t ns) {}
+
+#endif
+
+  /**
+   * Result of a signature verification, -1 = error, 0 = bad, 1 = good.
+   */
+  static result_t VerifyResult(int result)
+  {
+    return result == 1 ? RESULT_GOOD :
+           result == 0 ? RESULT_BAD : RESULT_ERROR;
+  }
+
+private:
+
+  static const int SHARDS = 16;
+
+  struct shard_t {
+    op_stats_t ops[OP_COUNT];
+  } __attribute__((aligned(64)));
+
+  static shard_t shards[SHARDS];
+  static volatile int nextShard;
+  static __thread int shardIndex;
+
+  static shard_t *GetShard()
+  {
+    if (shardIndex < 0) {
+      shardIndex = __sync_fetch_and_add(&nextShard, 1) % SHARDS;
+    }
+    return &shards[shardIndex];
+  }
+
+  static void Record(histogram_t *hist, uint64_t ns)
+  {
+    int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+    if (bucket >= BUCKETS) bucket = BUCKETS - 1;
+
+    __sync_fetch_and_add(&hist->count, 1);
+    __sync_fetch_and_add(&hist->sum, ns);
+    __sync_fetch_and_add(&hist->buckets[bucket], 1);
+  }
+};
+
+/**
+ * Times a synchronous operation from construction to Done(). Returning
+ * without calling Done(), e.g. after raising an exception, counts as an
+ * error.
+ */
+class StatsTimer
+{
+private:
+
+  Stats::op_t op;
+  uint64_t start;
+  bool done;
+
+public:
+
+  StatsTimer(Stats::op_t op) : op(op), start(Stats::Now()), done(false) {}
+
+  ~StatsTimer()
+  {
+    if (!done) Done(Stats::RESULT_ERROR);
+  }
+
+  void Done(Stats::result_t result)
+  {
+    Stats::RecordRun(op, Stats::Now() - start);
+    Stats::Count(op, result);
+    done = true;
+  }
+};
+
+#endif
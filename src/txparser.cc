@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "txparser.h"
+#include "sha256.h"
+
+/**
+ * Append words to the table, returning the position of the first one.
+ */
+static size_t Append(TxParser::table_t *table, size_t words)
+{
+  if (table->size + words > table->capacity) {
+    size_t capacity = table->capacity * 2;
+    if (capacity < table->size + words) {
+      capacity = table->size + words;
+    }
+    table->words = (uint32_t *) realloc(table->words, 4 * capacity);
+    table->capacity = capacity;
+  }
+
+  size_t start = table->size;
+  table->size += words;
+  return start;
+}
+
+void TxParser::Init(table_t *table, size_t count)
+{
+  // Leave room for a few inputs and outputs per transaction up front
+  table->capacity = (TX_WORDS + 4 * IN_WORDS + 4 * OUT_WORDS) * (count ? count : 1);
+  table->words = (uint32_t *) malloc(4 * table->capacity);
+  table->size = TX_WORDS * count;
+}
+
+void TxParser::Free(table_t *table)
+{
+  free(table->words);
+  table->words = NULL;
+}
+
+bool TxParser::ReadVarInt(const unsigned char *data, size_t len, size_t *pos,
+                          uint32_t *value)
+{
+  if (*pos >= len) return false;
+
+  unsigned char first = data[(*pos)++];
+  int size = first == 0xff ? 8 : first == 0xfe ? 4 : first == 0xfd ? 2 : 0;
+  if (size == 0) {
+    *value = first;
+    return true;
+  }
+  if (len - *pos < (size_t) size) return false;
+
+  uint64_t result = 0;
+  for (int i = 0; i < size; i++) {
+    result |= (uint64_t) data[*pos + i] << (8 * i);
+  }
+  *pos += size;
+
+  if (result > 0xffffffff) return false;
+  *value = (uint32_t) result;
+  return true;
+}
+
+bool TxParser::ParseTx(table_t *table, size_t index, unsigned char *hash,
+                       const unsigned char *data, size_t len, size_t *pos)
+{
+  size_t p = *pos;
+  uint32_t count, scriptLen;
+
+  uint32_t *tx = table->words + TX_WORDS * index;
+  tx[0] = p;
+
+  if (len - p < 4) return false;
+  tx[2] = ReadLE32(data + p);
+  p += 4;
+
+  // Every input takes at least 41 bytes, every output 9
+  if (!ReadVarInt(data, len, &p, &count) || count > (len - p) / 41) return false;
+  size_t ins = Append(table, IN_WORDS * count);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t *in = table->words + ins + IN_WORDS * i;
+
+    if (len - p < 36) return false;
+    in[0] = p;
+    p += 36;
+
+    if (!ReadVarInt(data, len, &p, &scriptLen) || scriptLen > len - p) return false;
+    in[1] = p;
+    in[2] = scriptLen;
+    p += scriptLen;
+
+    if (len - p < 4) return false;
+    in[3] = ReadLE32(data + p);
+    p += 4;
+  }
+
+  // Appending may have moved the table
+  tx = table->words + TX_WORDS * index;
+  tx[4] = count;
+  tx[5] = ins;
+
+  if (!ReadVarInt(data, len, &p, &count) || count > (len - p) / 9) return false;
+  size_t outs = Append(table, OUT_WORDS * count);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t *out = table->words + outs + OUT_WORDS * i;
+
+    if (len - p < 8) return false;
+    out[0] = p;
+    p += 8;
+
+    if (!ReadVarInt(data, len, &p, &scriptLen) || scriptLen > len - p) return false;
+    out[1] = p;
+    out[2] = scriptLen;
+    p += scriptLen;
+  }
+
+  tx = table->words + TX_WORDS * index;
+  tx[6] = count;
+  tx[7] = outs;
+
+  if (len - p < 4) return false;
+  tx[3] = ReadLE32(data + p);
+  p += 4;
+
+  tx[1] = p - *pos;
+  if (hash != NULL) {
+    Sha256::Double(hash, data + *pos, p - *pos);
+  }
+
+  *pos = p;
+  return true;
+}
@@ -0,0 +1,60 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_TXPARSER_H_
+#define BITCOINJS_SERVER_INCLUDE_TXPARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Single pass parser for serialized transactions and blocks.
+ *
+ * Instead of decoding fields, the parser records where they are in an
+ * offset table of 32 bit words and hashes each transaction on the way.
+ * The table starts with one record per transaction:
+ *
+ *   offset, length, version, lock_time,
+ *   input count, first input record, output count, first output record
+ *
+ * followed by the input records (outpoint offset, script offset, script
+ * length, sequence) and output records (value offset, script offset,
+ * script length) they point to. Offsets are relative to the start of the
+ * parsed buffer, record positions count words from the start of the table.
+ */
+class TxParser
+{
+public:
+
+  enum {
+    TX_WORDS = 8,
+    IN_WORDS = 4,
+    OUT_WORDS = 3
+  };
+
+  struct table_t {
+    uint32_t *words;
+    size_t size;
+    size_t capacity;
+  };
+
+  /**
+   * Start a table for count transactions.
+   */
+  static void Init(table_t *table, size_t count);
+  static void Free(table_t *table);
+
+  /**
+   * Parse the transaction at *pos as transaction number index of the
+   * table, write its hash to hash (unless it is NULL) and advance *pos
+   * past it. Returns false if the transaction is malformed or truncated.
+   */
+  static bool ParseTx(table_t *table, size_t index, unsigned char *hash,
+                      const unsigned char *data, size_t len, size_t *pos);
+
+  /**
+   * Read a variable length integer at *pos. Returns false if it doesn't
+   * fit in the buffer or in 32 bits.
+   */
+  static bool ReadVarInt(const unsigned char *data, size_t len, size_t *pos,
+                         uint32_t *value);
+};
+
+#endif
@@ -0,0 +1,589 @@
+#include <string.h>
+
+#include <v8.h>
+
+#include <node.h>
+#include <node_buffer.h>
+
+#include "common.h"
+#include "uint256.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+
+// Largest integer a double holds exactly
+#define MAX_SAFE_NUMBER 9007199254740992.0
+
+Persistent<FunctionTemplate> UInt256::s_ct;
+
+static inline unsigned int
+get_byte (const uint64_t *a, int i)
+{
+  return (a[i / 8] >> (8 * (i % 8))) & 0xff;
+}
+
+/**
+ * Number of significant bits.
+ */
+static int
+bit_length (const uint64_t *a)
+{
+  for (int i = 3; i >= 0; i--) {
+    if (a[i] != 0) {
+      int bits = 64 * i;
+      for (uint64_t word = a[i]; word != 0; word >>= 1) {
+        bits++;
+      }
+      return bits;
+    }
+  }
+  return 0;
+}
+
+void UInt256::SetZero(uint64_t *r)
+{
+  r[0] = r[1] = r[2] = r[3] = 0;
+}
+
+bool UInt256::IsZero(const uint64_t *a)
+{
+  return (a[0] | a[1] | a[2] | a[3]) == 0;
+}
+
+int UInt256::Compare(const uint64_t *a, const uint64_t *b)
+{
+  for (int i = 3; i >= 0; i--) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+void UInt256::Add(uint64_t *r, const uint64_t *a, const uint64_t *b)
+{
+  uint64_t carry = 0;
+  for (int i = 0; i < 4; i++) {
+    uint64_t sum = a[i] + carry;
+    carry = sum < carry;
+    uint64_t word = sum + b[i];
+    carry += word < sum;
+    r[i] = word;
+  }
+}
+
+bool UInt256::Sub(uint64_t *r, const uint64_t *a, const uint64_t *b)
+{
+  uint64_t borrow = 0;
+  for (int i = 0; i < 4; i++) {
+    uint64_t diff = a[i] - b[i];
+    uint64_t nextBorrow = (a[i] < b[i]) || (diff < borrow);
+    r[i] = diff - borrow;
+    borrow = nextBorrow;
+  }
+  return borrow == 0;
+}
+
+void UInt256::Mul(uint64_t *r, const uint64_t *a, const uint64_t *b)
+{
+  // Schoolbook on 32 bit limbs, so every partial product fits 64 bits
+  uint32_t x[8], y[8], z[8];
+  for (int i = 0; i < 8; i++) {
+    x[i] = a[i / 2] >> (32 * (i % 2));
+    y[i] = b[i / 2] >> (32 * (i % 2));
+    z[i] = 0;
+  }
+
+  for (int i = 0; i < 8; i++) {
+    uint64_t carry = 0;
+    for (int j = 0; i + j < 8; j++) {
+      uint64_t t = (uint64_t) x[i] * y[j] + z[i + j] + carry;
+      z[i + j] = (uint32_t) t;
+      carry = t >> 32;
+    }
+  }
+
+  for (int i = 0; i < 4; i++) {
+    r[i] = (uint64_t) z[2 * i] | ((uint64_t) z[2 * i + 1] << 32);
+  }
+}
+
+void UInt256::Divide(uint64_t *q, uint64_t *rem,
+                     const uint64_t *a, const uint64_t *b)
+{
+  uint64_t quot[4], r[4];
+  SetZero(quot);
+  SetZero(r);
+
+  // Shift and subtract, the remainder may carry into bit 256
+  for (int bit = bit_length(a) - 1; bit >= 0; bit--) {
+    uint64_t carry = r[3] >> 63;
+    for (int i = 3; i > 0; i--) {
+      r[i] = (r[i] << 1) | (r[i - 1] >> 63);
+    }
+    r[0] = (r[0] << 1) | ((a[bit / 64] >> (bit % 64)) & 1);
+
+    if (carry || Compare(r, b) >= 0) {
+      Sub(r, r, b);
+      quot[bit / 64] |= (uint64_t) 1 << (bit % 64);
+    }
+  }
+
+  if (q != NULL) {
+    memcpy(q, quot, sizeof(quot));
+  }
+  if (rem != NULL) {
+    memcpy(rem, r, sizeof(r));
+  }
+}
+
+bool UInt256::SetCompact(uint64_t *r, uint32_t bits)
+{
+  unsigned int size = bits >> 24;
+  uint32_t word = bits & 0x007fffff;
+
+  SetZero(r);
+  if (word == 0) {
+    return true;
+  }
+  if (bits & 0x00800000) {
+    return false;
+  }
+
+  if (size <= 3) {
+    r[0] = word >> (8 * (3 - size));
+    return true;
+  }
+
+  unsigned int wordBits = 0;
+  while (word >> wordBits) {
+    wordBits++;
+  }
+  unsigned int shift = 8 * (size - 3);
+  if (shift + wordBits > 256) {
+    return false;
+  }
+
+  r[shift / 64] = (uint64_t) word << (shift % 64);
+  if (shift % 64 != 0 && shift / 64 < 3) {
+    r[shift / 64 + 1] = (uint64_t) word >> (64 - shift % 64);
+  }
+  return true;
+}
+
+uint32_t UInt256::GetCompact(const uint64_t *a)
+{
+  int size = (bit_length(a) + 7) / 8;
+
+  uint32_t compact = 0;
+  for (int k = 0; k < 3; k++) {
+    if (size - 1 - k >= 0) {
+      compact |= get_byte(a, size - 1 - k) << (16 - 8 * k);
+    }
+  }
+
+  // The top bit of the mantissa is the sign
+  if (compact & 0x00800000) {
+    compact >>= 8;
+    size++;
+  }
+  return compact | ((uint32_t) size << 24);
+}
+
+void UInt256::GetWork(uint64_t *work, const uint64_t *target)
+{
+  static const uint64_t one[4] = { 1, 0, 0, 0 };
+
+  // 2^256 doesn't fit, but ~target / (target + 1) + 1 is the same
+  uint64_t num[4], div[4];
+  for (int i = 0; i < 4; i++) {
+    num[i] = ~target[i];
+  }
+  Add(div, target, one);
+  if (IsZero(div)) {
+    // A target of 2^256 - 1 is met by every hash
+    memcpy(work, one, sizeof(one));
+    return;
+  }
+
+  Divide(work, NULL, num, div);
+  Add(work, work, one);
+}
+
+void UInt256::Init(Handle<Object> target)
+{
+  HandleScope scope;
+  Local<FunctionTemplate> t = FunctionTemplate::New(New);
+
+  s_ct = Persistent<FunctionTemplate>::New(t);
+  s_ct->InstanceTemplate()->SetInternalFieldCount(1);
+  s_ct->SetClassName(String::NewSymbol("UInt256"));
+
+  // Methods
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "add", AddMethod);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "sub", SubMethod);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "mul", MulMethod);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "div", DivMethod);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "cmp", CmpMethod);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "getWork", GetWorkMethod);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "toCompact", ToCompact);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "toNumber", ToNumber);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "toString", ToString);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "toBuffer", ToBuffer);
+
+  // Static methods
+  NODE_SET_METHOD(s_ct->GetFunction(), "fromBuffer", FromBuffer);
+  NODE_SET_METHOD(s_ct->GetFunction(), "fromCompact", FromCompact);
+  NODE_SET_METHOD(s_ct->GetFunction(), "sumValues", SumValues);
+
+  target->Set(String::NewSymbol("UInt256"),
+              s_ct->GetFunction());
+}
+
+Handle<Value>
+UInt256::NewInstance(const uint64_t *value)
+{
+  HandleScope scope;
+
+  Local<Object> obj = s_ct->GetFunction()->NewInstance(0, NULL);
+  if (obj.IsEmpty()) {
+    return scope.Close(obj);
+  }
+
+  UInt256* num = ObjectWrap::Unwrap<UInt256>(obj);
+  memcpy(num->d, value, sizeof(num->d));
+  return scope.Close(obj);
+}
+
+/**
+ * Read a UInt256 or a non-negative integer Number.
+ */
+bool
+UInt256::GetValue(Handle<Value> arg, uint64_t *value)
+{
+  if (s_ct->HasInstance(arg)) {
+    UInt256* num = ObjectWrap::Unwrap<UInt256>(arg->ToObject());
+    memcpy(value, num->d, sizeof(num->d));
+    return true;
+  }
+
+  if (!arg->IsNumber()) {
+    return false;
+  }
+  double n = arg->NumberValue();
+  if (!(n >= 0) || n > MAX_SAFE_NUMBER || n != (double) (uint64_t) n) {
+    return false;
+  }
+  SetZero(value);
+  value[0] = (uint64_t) n;
+  return true;
+}
+
+Handle<Value>
+UInt256::New(const Arguments& args)
+{
+  if (!args.IsConstructCall()) {
+    return FromConstructorTemplate(s_ct, args);
+  }
+
+  HandleScope scope;
+
+  UInt256* num = new UInt256();
+  SetZero(num->d);
+  if (args.Length() > 0 && !args[0]->IsUndefined() &&
+      !GetValue(args[0], num->d)) {
+    delete num;
+    return VException("Argument must be a UInt256 or a non-negative integer");
+  }
+
+  num->Wrap(args.Holder());
+  return scope.Close(args.This());
+}
+
+static bool
+is_little_endian (const Arguments& args, int index)
+{
+  if (args.Length() <= index || !args[index]->IsObject()) {
+    return false;
+  }
+  Local<Value> endian = args[index]->ToObject()->Get(String::NewSymbol("endian"));
+  if (!endian->IsString()) {
+    return false;
+  }
+  String::AsciiValue name(endian);
+  return strcmp(*name, "little") == 0;
+}
+
+Handle<Value>
+UInt256::FromBuffer(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() < 1 || !Buffer::HasInstance(args[0]) ||
+      Buffer::Length(args[0]) > 32) {
+    return VException("Argument must be a Buffer of at most 32 bytes");
+  }
+
+  const unsigned char *data = (const unsigned char *) Buffer::Data(args[0]);
+  size_t len = Buffer::Length(args[0]);
+  bool little = is_little_endian(args, 1);
+
+  uint64_t value[4];
+  SetZero(value);
+  for (size_t i = 0; i < len; i++) {
+    unsigned int byte = little ? data[i] : data[len - 1 - i];
+    value[i / 8] |= (uint64_t) byte << (8 * (i % 8));
+  }
+
+  return scope.Close(NewInstance(value));
+}
+
+Handle<Value>
+UInt256::FromCompact(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 1 || !args[0]->IsUint32()) {
+    return VException("One argument expected: bits Number");
+  }
+
+  uint64_t value[4];
+  if (!SetCompact(value, args[0]->Uint32Value())) {
+    return VException("Invalid difficulty bits");
+  }
+
+  return scope.Close(NewInstance(value));
+}
+
+Handle<Value>
+UInt256::SumValues(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: values Buffer or Array");
+  }
+
+  uint64_t total[4], value[4];
+  SetZero(total);
+  SetZero(value);
+
+  if (Buffer::HasInstance(args[0])) {
+    // Concatenated 8 byte fields
+    const unsigned char *data = (const unsigned char *) Buffer::Data(args[0]);
+    size_t len = Buffer::Length(args[0]);
+    if (len % 8 != 0) {
+      return VException("Values Buffer must consist of 8 byte fields");
+    }
+    for (size_t i = 0; i < len; i += 8) {
+      value[0] = 0;
+      for (int j = 7; j >= 0; j--) {
+        value[0] = (value[0] << 8) | data[i + j];
+      }
+      Add(total, total, value);
+    }
+  } else if (args[0]->IsArray()) {
+    Local<Array> values = Local<Array>::Cast(args[0]);
+    for (uint32_t i = 0; i < values->Length(); i++) {
+      Local<Value> field = values->Get(i);
+      if (!Buffer::HasInstance(field) || Buffer::Length(field) != 8) {
+        return VException("Values must be 8 byte Buffers");
+      }
+      const unsigned char *data = (const unsigned char *) Buffer::Data(field);
+      value[0] = 0;
+      for (int j = 7; j >= 0; j--) {
+        value[0] = (value[0] << 8) | data[j];
+      }
+      Add(total, total, value);
+    }
+  } else {
+    return VException("Argument 'values' must be a Buffer or an Array");
+  }
+
+  return scope.Close(NewInstance(total));
+}
+
+Handle<Value>
+UInt256::AddMethod(const Arguments& args)
+{
+  HandleScope scope;
+  UInt256* num = ObjectWrap::Unwrap<UInt256>(args.This());
+
+  uint64_t other[4];
+  if (args.Length() != 1 || !GetValue(args[0], other)) {
+    return VException("Argument must be a UInt256 or a non-negative integer");
+  }
+
+  uint64_t result[4];
+  Add(result, num->d, other);
+  return scope.Close(NewInstance(result));
+}
+
+Handle<Value>
+UInt256::SubMethod(const Arguments& args)
+{
+  HandleScope scope;
+  UInt256* num = ObjectWrap::Unwrap<UInt256>(args.This());
+
+  uint64_t other[4];
+  if (args.Length() != 1 || !GetValue(args[0], other)) {
+    return VException("Argument must be a UInt256 or a non-negative integer");
+  }
+
+  uint64_t result[4];
+  if (!Sub(result, num->d, other)) {
+    return VException("Result of subtraction is negative");
+  }
+  return scope.Close(NewInstance(result));
+}
+
+Handle<Value>
+UInt256::MulMethod(const Arguments& args)
+{
+  HandleScope scope;
+  UInt256* num = ObjectWrap::Unwrap<UInt256>(args.This());
+
+  uint64_t other[4];
+  if (args.Length() != 1 || !GetValue(args[0], other)) {
+    return VException("Argument must be a UInt256 or a non-negative integer");
+  }
+
+  uint64_t result[4];
+  Mul(result, num->d, other);
+  return scope.Close(NewInstance(result));
+}
+
+Handle<Value>
+UInt256::DivMethod(const Arguments& args)
+{
+  HandleScope scope;
+  UInt256* num = ObjectWrap::Unwrap<UInt256>(args.This());
+
+  uint64_t other[4];
+  if (args.Length() != 1 || !GetValue(args[0], other)) {
+    return VException("Argument must be a UInt256 or a non-negative integer");
+  }
+  if (IsZero(other)) {
+    return VException("Division by zero");
+  }
+
+  uint64_t result[4];
+  Divide(result, NULL, num->d, other);
+  return scope.Close(NewInstance(result));
+}
+
+Handle<Value>
+UInt256::CmpMethod(const Arguments& args)
+{
+  HandleScope scope;
+  UInt256* num = ObjectWrap::Unwrap<UInt256>(args.This());
+
+  uint64_t other[4];
+  if (args.Length() != 1 || !GetValue(args[0], other)) {
+    return VException("Argument must be a UInt256 or a non-negative integer");
+  }
+
+  return scope.Close(Integer::New(Compare(num->d, other)));
+}
+
+Handle<Value>
+UInt256::GetWorkMethod(const Arguments& args)
+{
+  HandleScope scope;
+  UInt256* num = ObjectWrap::Unwrap<UInt256>(args.This());
+
+  uint64_t work[4];
+  GetWork(work, num->d);
+  return scope.Close(NewInstance(work));
+}
+
+Handle<Value>
+UInt256::ToCompact(const Arguments& args)
+{
+  HandleScope scope;
+  UInt256* num = ObjectWrap::Unwrap<UInt256>(args.This());
+
+  return scope.Close(Integer::NewFromUnsigned(GetCompact(num->d)));
+}
+
+Handle<Value>
+UInt256::ToNumber(const Arguments& args)
+{
+  HandleScope scope;
+  UInt256* num = ObjectWrap::Unwrap<UInt256>(args.This());
+
+  double n = 0;
+  for (int i = 3; i >= 0; i--) {
+    n = n * 18446744073709551616.0 + (double) num->d[i];
+  }
+  return scope.Close(Number::New(n));
+}
+
+Handle<Value>
+UInt256::ToString(const Arguments& args)
+{
+  HandleScope scope;
+  UInt256* num = ObjectWrap::Unwrap<UInt256>(args.This());
+
+  uint32_t base = 10;
+  if (args.Length() > 0 && !args[0]->IsUndefined()) {
+    if (!args[0]->IsUint32() ||
+        (args[0]->Uint32Value() != 10 && args[0]->Uint32Value() != 16)) {
+      return VException("Argument 'base' must be 10 or 16");
+    }
+    base = args[0]->Uint32Value();
+  }
+
+  // 78 decimal digits at most, written from the end
+  char out[80];
+  int pos = sizeof(out);
+
+  // Divide by the base on 32 bit limbs, the remainder always fits
+  uint32_t limbs[8];
+  for (int i = 0; i < 8; i++) {
+    limbs[i] = num->d[i / 2] >> (32 * (i % 2));
+  }
+  bool zero;
+  do {
+    uint64_t rem = 0;
+    zero = true;
+    for (int i = 7; i >= 0; i--) {
+      uint64_t cur = (rem << 32) | limbs[i];
+      limbs[i] = (uint32_t) (cur / base);
+      rem = cur % base;
+      zero = zero && limbs[i] == 0;
+    }
+    out[--pos] = "0123456789abcdef"[rem];
+  } while (!zero);
+
+  return scope.Close(String::New(out + pos, sizeof(out) - pos));
+}
+
+Handle<Value>
+UInt256::ToBuffer(const Arguments& args)
+{
+  HandleScope scope;
+  UInt256* num = ObjectWrap::Unwrap<UInt256>(args.This());
+
+  if (is_little_endian(args, 0)) {
+    Buffer *buf = Buffer::New(32);
+    unsigned char *data = (unsigned char *) Buffer::Data(buf);
+    for (int i = 0; i < 32; i++) {
+      data[i] = get_byte(num->d, i);
+    }
+    return scope.Close(buf->handle_);
+  }
+
+  // Like bignum, zero is a single byte
+  int len = (bit_length(num->d) + 7) / 8;
+  if (len == 0) {
+    len = 1;
+  }
+  Buffer *buf = Buffer::New(len);
+  unsigned char *data = (unsigned char *) Buffer::Data(buf);
+  for (int i = 0; i < len; i++) {
+    data[len - 1 - i] = get_byte(num->d, i);
+  }
+  return scope.Close(buf->handle_);
+}
@@ -0,0 +1,113 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_UINT256_H_
+#define BITCOINJS_SERVER_INCLUDE_UINT256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+using namespace node;
+
+/**
+ * Fixed width 256 bit unsigned integers for chain work, difficulty
+ * targets and output values.
+ *
+ * The static functions work on numbers stored as four 64 bit words,
+ * least significant first, and are shared with the native code that
+ * needs them, e.g. Headers. Results wrap around modulo 2^256.
+ *
+ * JavaScript API, a subset of bignum's so the two can be swapped:
+ *
+ *   new UInt256([value])            -> value is a Number or a UInt256
+ *   UInt256.fromBuffer(buf[, opts]) -> big endian, or little endian with
+ *                                      {endian: 'little'}
+ *   UInt256.fromCompact(bits)       -> expanded difficulty target
+ *   UInt256.sumValues(values)       -> total of 8 byte output values
+ *   x.add(y), x.sub(y), x.mul(y), x.div(y) -> new UInt256
+ *   x.cmp(y)                        -> -1, 0 or 1
+ *   x.getWork()                     -> 2^256 / (x + 1), the work of target x
+ *   x.toCompact()                   -> compact difficulty bits
+ *   x.toNumber(), x.toString([base])
+ *   x.toBuffer([opts])              -> big endian without leading zeros
+ *                                      like bignum, or 32 bytes little
+ *                                      endian with {endian: 'little'}
+ *
+ * y may be a UInt256 or a non-negative integer Number.
+ */
+class UInt256 : ObjectWrap
+{
+private:
+
+  uint64_t d[4];
+
+  static Handle<Value> NewInstance(const uint64_t *value);
+  static bool GetValue(Handle<Value> arg, uint64_t *value);
+
+public:
+
+  static void SetZero(uint64_t *r);
+
+  static bool IsZero(const uint64_t *a);
+
+  static int Compare(const uint64_t *a, const uint64_t *b);
+
+  /**
+   * r = a + b. r may be a or b.
+   */
+  static void Add(uint64_t *r, const uint64_t *a, const uint64_t *b);
+
+  /**
+   * r = a - b. r may be a or b. Returns false if b > a.
+   */
+  static bool Sub(uint64_t *r, const uint64_t *a, const uint64_t *b);
+
+  /**
+   * r = a * b. r may be a or b.
+   */
+  static void Mul(uint64_t *r, const uint64_t *a, const uint64_t *b);
+
+  /**
+   * q = a / b and rem = a % b, b must not be zero. Either output may be
+   * NULL, neither may be a or b.
+   */
+  static void Divide(uint64_t *q, uint64_t *rem,
+                     const uint64_t *a, const uint64_t *b);
+
+  /**
+   * Expand compact difficulty bits with the rules of
+   * CBigNum::SetCompact(). Returns false for a negative or overflowing
+   * target.
+   */
+  static bool SetCompact(uint64_t *r, uint32_t bits);
+
+  static uint32_t GetCompact(const uint64_t *a);
+
+  /**
+   * work = 2^256 / (target + 1), the expected number of hashes needed to
+   * meet target.
+   */
+  static void GetWork(uint64_t *work, const uint64_t *target);
+
+  static Persistent<FunctionTemplate> s_ct;
+
+  static void Init(Handle<Object> target);
+
+  static Handle<Value> New(const Arguments& args);
+  static Handle<Value> FromBuffer(const Arguments& args);
+  static Handle<Value> FromCompact(const Arguments& args);
+  static Handle<Value> SumValues(const Arguments& args);
+  static Handle<Value> AddMethod(const Arguments& args);
+  static Handle<Value> SubMethod(const Arguments& args);
+  static Handle<Value> MulMethod(const Arguments& args);
+  static Handle<Value> DivMethod(const Arguments& args);
+  static Handle<Value> CmpMethod(const Arguments& args);
+  static Handle<Value> GetWorkMethod(const Arguments& args);
+  static Handle<Value> ToCompact(const Arguments& args);
+  static Handle<Value> ToNumber(const Arguments& args);
+  static Handle<Value> ToString(const Arguments& args);
+  static Handle<Value> ToBuffer(const Arguments& args);
+};
+
+#endif
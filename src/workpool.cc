@@ -0,0 +1,221 @@
+#include <stdlib.h>
+
+#include "workpool.h"
+
+WorkPool::worker_t *WorkPool::workers = NULL;
+int WorkPool::threadCount = 0;
+bool WorkPool::started = false;
+
+volatile int WorkPool::queued = 0;
+unsigned int WorkPool::nextWorker = 0;
+
+uv_mutex_t WorkPool::sleepMutex;
+uv_cond_t WorkPool::sleepCond;
+
+WorkPool::job_t * volatile WorkPool::completed = NULL;
+uv_async_t WorkPool::async;
+
+int WorkPool::outstanding = 0;
+
+void WorkPool::Init()
+{
+  uv_mutex_init(&sleepMutex);
+  uv_cond_init(&sleepCond);
+
+  uv_async_init(uv_default_loop(), &async, OnComplete);
+
+  // Only keep the loop alive while there is work in flight
+  uv_unref((uv_handle_t *) &async);
+
+  SetThreadCount(0);
+}
+
+int WorkPool::GetThreadCount()
+{
+  return threadCount;
+}
+
+int WorkPool::SetThreadCount(int count)
+{
+  if (started) {
+    return -1;
+  }
+
+  if (count <= 0) {
+    uv_cpu_info_t *cpus;
+    int cpuCount = 0;
+    uv_err_t err = uv_cpu_info(&cpus, &cpuCount);
+    if (err.code == UV_OK) {
+      uv_free_cpu_info(cpus, cpuCount);
+    }
+    count = cpuCount > 0 ? cpuCount : 4;
+  }
+
+  threadCount = count;
+  return 0;
+}
+
+void WorkPool::Start()
+{
+  workers = (worker_t *) calloc(threadCount, sizeof(worker_t));
+
+  for (int i = 0; i < threadCount; i++) {
+    worker_t *worker = &workers[i];
+    uv_mutex_init(&worker->mutex);
+    worker->capacity = 64;
+    worker->jobs = (job_t **) malloc(sizeof(job_t *) * worker->capacity);
+    worker->index = i;
+  }
+
+  for (int i = 0; i < threadCount; i++) {
+    uv_thread_create(&workers[i].thread, Run, &workers[i]);
+  }
+
+  started = true;
+}
+
+void WorkPool::Push(worker_t *worker, job_t *job)
+{
+  uv_mutex_lock(&worker->mutex);
+
+  if (worker->count == worker->capacity) {
+    // Grow and unwrap the ring buffer
+    job_t **jobs = (job_t **) malloc(sizeof(job_t *) * worker->capacity * 2);
+    for (unsigned int i = 0; i < worker->count; i++) {
+      jobs[i] = worker->jobs[(worker->head + i) % worker->capacity];
+    }
+    free(worker->jobs);
+    worker->jobs = jobs;
+    worker->head = 0;
+    worker->capacity *= 2;
+  }
+
+  worker->jobs[(worker->head + worker->count) % worker->capacity] = job;
+  worker->count++;
+
+  uv_mutex_unlock(&worker->mutex);
+}
+
+WorkPool::job_t *WorkPool::Pop(worker_t *worker)
+{
+  job_t *job = NULL;
+
+  // Owners take the oldest job from the front
+  uv_mutex_lock(&worker->mutex);
+  if (worker->count) {
+    job = worker->jobs[worker->head];
+    worker->head = (worker->head + 1) % worker->capacity;
+    worker->count--;
+  }
+  uv_mutex_unlock(&worker->mutex);
+
+  return job;
+}
+
+WorkPool::job_t *WorkPool::Steal(worker_t *victim)
+{
+  job_t *job = NULL;
+
+  // Thieves take from the back, away from the owner
+  if (uv_mutex_trylock(&victim->mutex) != 0) {
+    return NULL;
+  }
+  if (victim->count) {
+    victim->count--;
+    job = victim->jobs[(victim->head + victim->count) % victim->capacity];
+  }
+  uv_mutex_unlock(&victim->mutex);
+
+  return job;
+}
+
+void WorkPool::Run(void *arg)
+{
+  worker_t *self = static_cast<worker_t *>(arg);
+
+  for (;;) {
+    job_t *job = Pop(self);
+
+    for (int i = 1; job == NULL && i < threadCount; i++) {
+      job = Steal(&workers[(self->index + i) % threadCount]);
+    }
+
+    if (job != NULL) {
+      __sync_fetch_and_sub(&queued, 1);
+      job->work(job->req);
+      Complete(job);
+      continue;
+    }
+
+    uv_mutex_lock(&sleepMutex);
+    while (queued <= 0) {
+      uv_cond_wait(&sleepCond, &sleepMutex);
+    }
+    uv_mutex_unlock(&sleepMutex);
+  }
+}
+
+void WorkPool::Complete(job_t *job)
+{
+  job_t *head;
+  do {
+    head = completed;
+    job->next = head;
+  } while (!__sync_bool_compare_and_swap(&completed, head, job));
+
+  uv_async_send(&async);
+}
+
+void WorkPool::OnComplete(uv_async_t *handle, int status)
+{
+  job_t *list = __sync_lock_test_and_set(&completed, (job_t *) NULL);
+
+  // The stack hands us the jobs newest first
+  job_t *job = NULL;
+  while (list != NULL) {
+    job_t *next = list->next;
+    list->next = job;
+    job = list;
+    list = next;
+  }
+
+  while (job != NULL) {
+    job_t *next = job->next;
+
+    outstanding--;
+    job->done(job->req, 0);
+    free(job);
+
+    job = next;
+  }
+
+  if (outstanding == 0) {
+    uv_unref((uv_handle_t *) &async);
+  }
+}
+
+int WorkPool::Queue(uv_work_t *req, uv_work_cb work, uv_after_work_cb done)
+{
+  if (!started) {
+    Start();
+  }
+
+  job_t *job = (job_t *) malloc(sizeof(job_t));
+  job->req = req;
+  job->work = work;
+  job->done = done;
+  job->next = NULL;
+
+  if (outstanding++ == 0) {
+    uv_ref((uv_handle_t *) &async);
+  }
+
+  __sync_fetch_and_add(&queued, 1);
+  Push(&workers[nextWorker++ % threadCount], job);
+
+  uv_mutex_lock(&sleepMutex);
+  uv_cond_signal(&sleepCond);
+  uv_mutex_unlock(&sleepMutex);
+
+  return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_WORKPOOL_H_
+#define BITCOINJS_SERVER_INCLUDE_WORKPOOL_H_
+
+#include <uv.h>
+
+/**
+ * Thread pool for CPU bound work like signature verification.
+ *
+ * The libuv thread pool is small and shared with file system and DNS
+ * requests, so heavy verification would stall storage I/O. This pool is
+ * owned by the addon and sized to the number of cores by default.
+ *
+ * Every worker has its own job queue. Jobs are distributed round-robin and
+ * idle workers steal from the back of other workers' queues. Finished jobs
+ * are pushed onto a lock-free completion stack that the event loop drains
+ * through a single uv_async_t.
+ *
+ * Queue() has the same signature as uv_queue_work() (minus the loop) and
+ * must only be called from the event loop thread.
+ */
+class WorkPool
+{
+private:
+
+  struct job_t {
+    uv_work_t *req;
+    uv_work_cb work;
+    uv_after_work_cb done;
+    job_t *next;
+  };
+
+  struct worker_t {
+    uv_thread_t thread;
+    uv_mutex_t mutex;
+
+    // Ring buffer of queued jobs
+    job_t **jobs;
+    unsigned int head;
+    unsigned int count;
+    unsigned int capacity;
+
+    int index;
+  };
+
+  static worker_t *workers;
+  static int threadCount;
+  static bool started;
+
+  // Jobs queued but not yet picked up by a worker
+  static volatile int queued;
+  static unsigned int nextWorker;
+
+  static uv_mutex_t sleepMutex;
+  static uv_cond_t sleepCond;
+
+  // Completion stack, pushed by the workers, drained by the loop
+  static job_t * volatile completed;
+  static uv_async_t async;
+
+  // Jobs queued and not yet reported back (loop thread only)
+  static int outstanding;
+
+  static void Start();
+  static void Run(void *arg);
+  static job_t *Pop(worker_t *worker);
+  static job_t *Steal(worker_t *victim);
+  static void Push(worker_t *worker, job_t *job);
+  static void Complete(job_t *job);
+  static void OnComplete(uv_async_t *handle, int status);
+
+public:
+
+  static void Init();
+
+  static int Queue(uv_work_t *req, uv_work_cb work, uv_after_work_cb done);
+
+  static int GetThreadCount();
+
+  /**
+   * Set the number of worker threads.
+   *
+   * Only possible before the first job has been queued. A count of zero
+   * selects one thread per core. Returns 0 on success.
+   */
+  static int SetThreadCount(int count);
+};
+
+#endif
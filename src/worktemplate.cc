@@ -0,0 +1,361 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <v8.h>
+
+#include <node.h>
+#include <node_buffer.h>
+
+#include "common.h"
+#include "sha256.h"
+#include "uint256.h"
+#include "worktemplate.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+
+// Number of sets in the table of issued units (four entries each)
+#define UNIT_SETS (1 << 16)
+
+// Most work units handed out by one getWork() call
+#define MAX_UNITS_PER_CALL 4096
+
+WorkTemplate::unit_t *WorkTemplate::units = NULL;
+unsigned int WorkTemplate::setMask = UNIT_SETS - 1;
+uint64_t WorkTemplate::nextSeq = 0;
+uint32_t WorkTemplate::nextId = 0;
+
+Persistent<FunctionTemplate> WorkTemplate::s_ct;
+
+static const char hexDigits[] = "0123456789abcdef";
+
+static void
+to_hex (char *out, const unsigned char *data, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    out[2 * i] = hexDigits[data[i] >> 4];
+    out[2 * i + 1] = hexDigits[data[i] & 0xf];
+  }
+}
+
+void WorkTemplate::Init(Handle<Object> target)
+{
+  HandleScope scope;
+  Local<FunctionTemplate> t = FunctionTemplate::New(New);
+
+  s_ct = Persistent<FunctionTemplate>::New(t);
+  s_ct->InstanceTemplate()->SetInternalFieldCount(1);
+  s_ct->SetClassName(String::NewSymbol("WorkTemplate"));
+
+  // Methods
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "getWork", GetWork);
+  NODE_SET_PROTOTYPE_METHOD(s_ct, "getExtranonce", GetExtranonce);
+
+  // Static methods
+  NODE_SET_METHOD(s_ct->GetFunction(), "find", Find);
+
+  target->Set(String::NewSymbol("WorkTemplate"),
+              s_ct->GetFunction());
+}
+
+WorkTemplate::WorkTemplate() :
+  coinbase1(NULL),
+  coinbase2(NULL),
+  branch(NULL),
+  extranonce(0)
+{
+  id = ++nextId;
+}
+
+WorkTemplate::~WorkTemplate()
+{
+  free(coinbase1);
+  free(coinbase2);
+  free(branch);
+}
+
+/**
+ * Remember an issued unit, replacing the oldest one in its set if needed.
+ */
+void WorkTemplate::Remember(const unsigned char *root, uint32_t id,
+                            uint32_t time, uint64_t extranonce)
+{
+  if (units == NULL) {
+    // Only allocated once a node actually hands out work
+    units = (unit_t *) calloc(UNIT_SETS * WAYS, sizeof(unit_t));
+  }
+
+  uint64_t key;
+  memcpy(&key, root, sizeof(key));
+
+  // The root is a hash, so its bytes are already well distributed
+  unit_t *set = &units[(key & setMask) * WAYS];
+  unit_t *victim = &set[0];
+  for (int i = 0; i < WAYS; i++) {
+    if (set[i].seq < victim->seq) {
+      victim = &set[i];
+    }
+  }
+
+  victim->key = key;
+  victim->id = id;
+  victim->time = time;
+  victim->extranonce = extranonce;
+  victim->seq = ++nextSeq;
+}
+
+/**
+ * Merkle roots for count consecutive extranonces, starting at first.
+ */
+void WorkTemplate::ComputeRoots(unsigned char *roots, uint64_t first, size_t count) const
+{
+  // Build all coinbases, so they are hashed side by side
+  size_t coinbaseLen = coinbase1Len + extranonceSize + coinbase2Len;
+  unsigned char *coinbases = (unsigned char *) malloc(coinbaseLen * count);
+  const unsigned char **ptrs = new const unsigned char *[count];
+  size_t *lens = new size_t[count];
+
+  for (size_t i = 0; i < count; i++) {
+    unsigned char *coinbase = coinbases + coinbaseLen * i;
+    uint64_t value = first + i;
+
+    memcpy(coinbase, coinbase1, coinbase1Len);
+    for (int j = 0; j < extranonceSize; j++) {
+      coinbase[coinbase1Len + j] = (value >> (8 * j)) & 0xff;
+    }
+    memcpy(coinbase + coinbase1Len + extranonceSize, coinbase2, coinbase2Len);
+
+    ptrs[i] = coinbase;
+    lens[i] = coinbaseLen;
+  }
+
+  Sha256::DoubleMany(roots, ptrs, lens, count);
+
+  free(coinbases);
+  delete [] ptrs;
+  delete [] lens;
+
+  // The coinbase is the first leaf, so it is always the left half of its
+  // pair. One level at a time for all units at once.
+  unsigned char *pairs = (unsigned char *) malloc(64 * count);
+  for (size_t level = 0; level < branchLen; level++) {
+    for (size_t i = 0; i < count; i++) {
+      memcpy(pairs + 64 * i, roots + 32 * i, 32);
+      memcpy(pairs + 64 * i + 32, branch + 32 * level, 32);
+    }
+    Sha256::Double64(roots, pairs, count);
+  }
+  free(pairs);
+}
+
+Handle<Value>
+WorkTemplate::New(const Arguments& args)
+{
+  if (!args.IsConstructCall()) {
+    return FromConstructorTemplate(s_ct, args);
+  }
+
+  HandleScope scope;
+
+  if (args.Length() != 1 || !args[0]->IsObject()) {
+    return VException("One argument expected: options Object");
+  }
+  Local<Object> options = args[0]->ToObject();
+
+  Local<Value> version = options->Get(String::NewSymbol("version"));
+  Local<Value> prevHash = options->Get(String::NewSymbol("prevHash"));
+  Local<Value> bits = options->Get(String::NewSymbol("bits"));
+  Local<Value> coinbase1 = options->Get(String::NewSymbol("coinbase1"));
+  Local<Value> coinbase2 = options->Get(String::NewSymbol("coinbase2"));
+  Local<Value> branch = options->Get(String::NewSymbol("branch"));
+  Local<Value> extranonce = options->Get(String::NewSymbol("extranonce"));
+  Local<Value> extranonceSize = options->Get(String::NewSymbol("extranonceSize"));
+
+  if (!version->IsUint32()) {
+    return VException("Option 'version' must be a Number");
+  }
+  if (!Buffer::HasInstance(prevHash) || Buffer::Length(prevHash) != 32) {
+    return VException("Option 'prevHash' must be Buffer of length 32 bytes");
+  }
+  if (!bits->IsUint32()) {
+    return VException("Option 'bits' must be a Number");
+  }
+
+  // Blocks must carry the canonical encoding of a positive target
+  uint64_t target[4];
+  if (!UInt256::SetCompact(target, bits->Uint32Value()) ||
+      UInt256::IsZero(target) ||
+      UInt256::GetCompact(target) != bits->Uint32Value()) {
+    return VException("Option 'bits' is not a valid difficulty target");
+  }
+  if (!Buffer::HasInstance(coinbase1) || !Buffer::HasInstance(coinbase2)) {
+    return VException("Options 'coinbase1' and 'coinbase2' must be of type Buffer");
+  }
+  if (!Buffer::HasInstance(branch) || Buffer::Length(branch) % 32) {
+    return VException("Option 'branch' must be a Buffer of 32 byte hashes");
+  }
+  if (!extranonce->IsUndefined() &&
+      (!extranonce->IsNumber() || extranonce->NumberValue() < 0)) {
+    return VException("Option 'extranonce' must be a positive Number");
+  }
+  if (!extranonceSize->IsUndefined() &&
+      (!extranonceSize->IsUint32() || extranonceSize->Uint32Value() < 1 ||
+       extranonceSize->Uint32Value() > 8)) {
+    return VException("Option 'extranonceSize' must be a Number from 1 to 8");
+  }
+
+  WorkTemplate* tmpl = new WorkTemplate();
+  tmpl->version = version->Uint32Value();
+  memcpy(tmpl->prevHash, Buffer::Data(prevHash), 32);
+  tmpl->bits = bits->Uint32Value();
+  for (int i = 0; i < 32; i++) {
+    tmpl->target[i] = (unsigned char) (target[i / 8] >> (8 * (i % 8)));
+  }
+
+  tmpl->coinbase1Len = Buffer::Length(coinbase1);
+  tmpl->coinbase1 = (unsigned char *) malloc(tmpl->coinbase1Len + 1);
+  memcpy(tmpl->coinbase1, Buffer::Data(coinbase1), tmpl->coinbase1Len);
+
+  tmpl->coinbase2Len = Buffer::Length(coinbase2);
+  tmpl->coinbase2 = (unsigned char *) malloc(tmpl->coinbase2Len + 1);
+  memcpy(tmpl->coinbase2, Buffer::Data(coinbase2), tmpl->coinbase2Len);
+
+  tmpl->branchLen = Buffer::Length(branch) / 32;
+  tmpl->branch = (unsigned char *) malloc(32 * tmpl->branchLen + 1);
+  memcpy(tmpl->branch, Buffer::Data(branch), 32 * tmpl->branchLen);
+
+  tmpl->extranonce = extranonce->IsUndefined() ? 0 : (uint64_t) extranonce->NumberValue();
+  tmpl->extranonceSize = extranonceSize->IsUndefined() ? 4 : extranonceSize->Uint32Value();
+
+  tmpl->Wrap(args.Holder());
+  args.This()->Set(String::NewSymbol("id"), Integer::NewFromUnsigned(tmpl->id));
+
+  return scope.Close(args.This());
+}
+
+Handle<Value>
+WorkTemplate::GetWork(const Arguments& args)
+{
+  HandleScope scope;
+  WorkTemplate* tmpl = ObjectWrap::Unwrap<WorkTemplate>(args.This());
+
+  if (args.Length() != 2) {
+    return VException("Two arguments expected: count, time");
+  }
+  if (!args[0]->IsUint32() || args[0]->Uint32Value() < 1 ||
+      args[0]->Uint32Value() > MAX_UNITS_PER_CALL) {
+    return VException("Argument 'count' must be a Number from 1 to 4096");
+  }
+  if (!args[1]->IsUint32()) {
+    return VException("Argument 'time' must be a Number");
+  }
+
+  size_t count = args[0]->Uint32Value();
+  uint32_t time = args[1]->Uint32Value();
+
+  unsigned char *roots = (unsigned char *) malloc(32 * count);
+  tmpl->ComputeRoots(roots, tmpl->extranonce + 1, count);
+
+  Local<String> data_sym = String::NewSymbol("data");
+  Local<String> midstate_sym = String::NewSymbol("midstate");
+  Local<String> target_sym = String::NewSymbol("target");
+  Local<String> hash1_sym = String::NewSymbol("hash1");
+
+  char hex[256];
+  to_hex(hex, tmpl->target, 32);
+  Local<String> target = String::New(hex, 64);
+  Local<String> hash1 = String::New(
+    "0000000000000000000000000000000000000000000000000000000000000000"
+    "0000008000000000000000000000000000000000000000000000000000010000");
+
+  // Header followed by the SHA-256 padding of an 80 byte message
+  unsigned char block[128];
+  memset(block, 0, sizeof(block));
+  WriteLE32(block, tmpl->version);
+  memcpy(block + 4, tmpl->prevHash, 32);
+  WriteLE32(block + 68, time);
+  WriteLE32(block + 72, tmpl->bits);
+  block[80] = 0x80;
+  block[126] = 0x02;
+  block[127] = 0x80;
+
+  Local<Array> result = Array::New(count);
+  for (size_t i = 0; i < count; i++) {
+    const unsigned char *root = roots + 32 * i;
+    memcpy(block + 36, root, 32);
+
+    uint32_t state[8];
+    Sha256::Initialize(state);
+    Sha256::Transform(state, block, 1);
+
+    // getwork sends every word of the data byte swapped
+    unsigned char swapped[128];
+    for (size_t j = 0; j < sizeof(block); j += 4) {
+      swapped[j] = block[j + 3];
+      swapped[j + 1] = block[j + 2];
+      swapped[j + 2] = block[j + 1];
+      swapped[j + 3] = block[j];
+    }
+
+    Local<Object> unit = Object::New();
+    to_hex(hex, swapped, sizeof(swapped));
+    unit->Set(data_sym, String::New(hex, 256));
+    to_hex(hex, (const unsigned char *) state, 32);
+    unit->Set(midstate_sym, String::New(hex, 64));
+    unit->Set(target_sym, target);
+    unit->Set(hash1_sym, hash1);
+    result->Set(i, unit);
+
+    Remember(root, tmpl->id, time, tmpl->extranonce + 1 + i);
+  }
+
+  tmpl->extranonce += count;
+  free(roots);
+
+  return scope.Close(result);
+}
+
+Handle<Value>
+WorkTemplate::GetExtranonce(const Arguments& args)
+{
+  HandleScope scope;
+  WorkTemplate* tmpl = ObjectWrap::Unwrap<WorkTemplate>(args.This());
+
+  return scope.Close(Number::New((double) tmpl->extranonce));
+}
+
+Handle<Value>
+WorkTemplate::Find(const Arguments& args)
+{
+  HandleScope scope;
+
+  if (args.Length() != 1) {
+    return VException("One argument expected: header");
+  }
+  if (!Buffer::HasInstance(args[0]) || Buffer::Length(args[0]) < 80) {
+    return VException("Argument 'header' must be a Buffer of at least 80 bytes");
+  }
+
+  const unsigned char *header = (const unsigned char *) Buffer::Data(args[0]);
+  if (units == NULL) {
+    return scope.Close(Null());
+  }
+
+  uint64_t key;
+  memcpy(&key, header + 36, sizeof(key));
+
+  unit_t *set = &units[(key & setMask) * WAYS];
+  for (int i = 0; i < WAYS; i++) {
+    if (set[i].seq != 0 && set[i].key == key) {
+      Local<Object> result = Object::New();
+      result->Set(String::NewSymbol("id"), Integer::NewFromUnsigned(set[i].id));
+      result->Set(String::NewSymbol("extranonce"), Number::New((double) set[i].extranonce));
+      result->Set(String::NewSymbol("time"), Integer::NewFromUnsigned(set[i].time));
+      result->Set(String::NewSymbol("nonce"), Integer::NewFromUnsigned(ReadLE32(header + 76)));
+      return scope.Close(result);
+    }
+  }
+
+  return scope.Close(Null());
+}
@@ -0,0 +1,104 @@
+#ifndef BITCOINJS_SERVER_INCLUDE_WORKTEMPLATE_H_
+#define BITCOINJS_SERVER_INCLUDE_WORKTEMPLATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+using namespace node;
+
+/**
+ * Block template for getwork that hands out work units with a rolling
+ * extranonce.
+ *
+ * The coinbase is kept split around its extranonce, together with the
+ * merkle branch of the coinbase. Every work unit gets the next extranonce,
+ * so its merkle root costs the coinbase hash plus one hash per level of
+ * the branch instead of a whole tree. Units are returned in the format of
+ * a getwork reply.
+ *
+ * Every issued unit is remembered in a table shared by all templates,
+ * keyed by its merkle root. A submitted header is mapped back to the
+ * template id, extranonce and time with a single lookup. The table is a
+ * fixed size, four-way set associative, and replaces the oldest entry of
+ * a full set.
+ *
+ * JavaScript API:
+ *
+ *   new WorkTemplate({version, prevHash, bits, coinbase1, coinbase2,
+ *                     branch[, extranonce, extranonceSize]})
+ *   tmpl.id                         -> Number, unique per template
+ *   tmpl.getWork(count, time)       -> Array of {data, midstate, target, hash1}
+ *   tmpl.getExtranonce()            -> last extranonce handed out
+ *   WorkTemplate.find(header)       -> {id, extranonce, time, nonce} or null
+ *
+ * The coinbase is coinbase1 + extranonce (extranonceSize bytes, little
+ * endian, default 4) + coinbase2. branch is the concatenated 32 byte
+ * hashes of the coinbase's merkle branch. header is the 80 byte header
+ * in normal byte order, i.e. the getwork data after swapping the bytes of
+ * every word.
+ */
+class WorkTemplate : ObjectWrap
+{
+private:
+
+  struct unit_t {
+    // First 8 bytes of the merkle root
+    uint64_t key;
+    uint32_t id;
+    uint32_t time;
+    uint64_t extranonce;
+    uint64_t seq;
+  };
+
+  // Entries per set
+  static const int WAYS = 4;
+
+  static unit_t *units;
+  static unsigned int setMask;
+  static uint64_t nextSeq;
+  static uint32_t nextId;
+
+  static void Remember(const unsigned char *root, uint32_t id,
+                       uint32_t time, uint64_t extranonce);
+
+  uint32_t id;
+  uint32_t version;
+  unsigned char prevHash[32];
+  uint32_t bits;
+
+  unsigned char *coinbase1;
+  size_t coinbase1Len;
+  unsigned char *coinbase2;
+  size_t coinbase2Len;
+  int extranonceSize;
+
+  unsigned char *branch;
+  size_t branchLen;
+
+  uint64_t extranonce;
+
+  // Little endian target, as getwork reports it
+  unsigned char target[32];
+
+  WorkTemplate();
+  ~WorkTemplate();
+
+  void ComputeRoots(unsigned char *roots, uint64_t first, size_t count) const;
+
+public:
+
+  static Persistent<FunctionTemplate> s_ct;
+
+  static void Init(Handle<Object> target);
+
+  static Handle<Value> New(const Arguments& args);
+  static Handle<Value> GetWork(const Arguments& args);
+  static Handle<Value> GetExtranonce(const Arguments& args);
+  static Handle<Value> Find(const Arguments& args);
+};
+
+#endif
@@ -5,6 +5,7 @@ var Storage = require('../lib/storage').Storage;
 var Settings = require('../lib/settings').Settings;
 var BlockChain = require('../lib/blockchain').BlockChain;
 var Miner = require('../lib/miner/javascript.js').JavaScriptMiner;
+var NativeMiner = require('../lib/miner/native.js').NativeMiner;
 var encodeHex = require('../lib/util').encodeHex;
 
 var Block = require('../lib/schema/block').Block;
@@ -87,6 +88,26 @@ function testEngine(label, uri) {
         assert.equal(topic.chain.getTopBlock().height, 1);
       }
     }
+  }).addBatch({
+    'A chain mined with the native miner': {
+      topic: makeTestChain({
+        miner: NativeMiner,
+        blocks: [
+          // O -> A -> B
+          ['O', 'A'],
+          ['A', 'B']
+        ]
+      }),
+
+      'has a height of two': function (topic) {
+        assert.equal(topic.chain.getTopBlock().height, 2);
+      },
+
+      'has B as the top block': function (topic) {
+        assert.equal(encodeHex(topic.chain.getTopBlock().getHash()),
+                     encodeHex(topic.blocks.B.getHash()));
+      }
+    }
   }).addBatch({
     'A chain downloaded in the wrong order': {
       topic: makeTestChain({
@@ -310,7 +331,8 @@ function testEngine(label, uri) {
       return function (err, chain) {
         if (err) throw err;
 
-        createBlock(blocks[blockDesc.parent], chain, this);
+        createBlock(blocks[blockDesc.parent], chain,
+                    descriptor.miner || Miner, this);
       };
     };
 
@@ -462,7 +484,7 @@ function testEngine(label, uri) {
     });
   };
 
-  function createBlock(block, chain, callback) {
+  function createBlock(block, chain, MinerClass, callback) {
     var fakeBeneficiary = new Buffer(65).clear();
     fakeBeneficiary[0] = 0x04;
     for (var i = 1, l = fakeBeneficiary.length; i < l; i++) {
@@ -473,7 +495,7 @@ function testEngine(label, uri) {
       chain,
       fakeBeneficiary,
       null, // Use default time
-      new Miner(),
+      new MinerClass(),
       function (err, newBlock, txs) {
         if (err) {
           callback(err);
@@ -7,6 +7,13 @@ var Util = require('../lib/util');
 var encodeHex = Util.encodeHex;
 var decodeHex = Util.decodeHex;
 
+// A public key, its signature of HASH, and a hash the signature doesn't
+// match
+var PUBKEY = decodeHex("04a19c1f07c7a0868d86dbb37510305843cc730eb3bea8a99d92131f44950cecd923788419bfef2f635fad621d753f30d4b4b63b29da44b4f3d92db974537ad5a4");
+var HASH = decodeHex("230aba77ccde46bb17fcb0295a92c0cc42a6ea9f439aaadeb0094625f49e6ed8");
+var SIG = decodeHex("3046022100a3ee5408f0003d8ef00ff2e0537f54ba09771626ff70dca1f01296b05c510e85022100d4dc70a5bb50685b65833a97e536909a6951dd247a2fdbde6688c33ba6d6407501");
+var BAD_HASH = decodeHex("330aba77ccde46bb17fcb0295a92c0cc42a6ea9f439aaadeb0094625f49e6ed8");
+
 vows.describe('BitcoinKey').addBatch({
   'A generated key': {
     topic: function () {
@@ -98,6 +105,65 @@ vows.describe('BitcoinKey').addBatch({
     }
   },
 
+  'A key signing deterministically': {
+    topic: function () {
+      var key = new BitcoinKey();
+      key.private = decodeHex("0000000000000000000000000000000000000000000000000000000000000001");
+      var hash = Util.sha256(new Buffer("Satoshi Nakamoto", 'utf8'));
+      var cb = this.callback;
+      key.sign(hash, function (err, sig) {
+        cb(err, {sig: sig, sigSync: key.signSync(hash)});
+      });
+    },
+
+    'gives the RFC 6979 signature': function (topic) {
+      assert.equal(encodeHex(topic.sig), "3045022100934b1ea10a4b3c1757e2b0c017d0b6143ce3c9a7e6a4a49860d7a6ab210ee3d802202442ce9d2b916064108014783e923ec36b49743e2ffa1c4496f01a512aafd9e5");
+    },
+
+    'gives the same signature synchronously': function (topic) {
+      assert.equal(encodeHex(topic.sigSync), encodeHex(topic.sig));
+    }
+  },
+
+  'A batch of signing requests': {
+    topic: function () {
+      var keys = [];
+      var items = [];
+      for (var i = 0; i < 20; i++) {
+        var key = BitcoinKey.generateSync();
+        keys.push(key);
+        items.push({privkey: key.private,
+                    hash: Util.sha256(new Buffer([i]))});
+      }
+      var cb = this.callback;
+      BitcoinKey.signMany(items, function (err, sigs) {
+        cb(err, {keys: keys, items: items, sigs: sigs});
+      });
+    },
+
+    'returns a valid signature per item': function (topic) {
+      assert.equal(topic.sigs.length, 20);
+      topic.sigs.forEach(function (sig, i) {
+        assert.isTrue(topic.keys[i].verifySignatureSync(topic.items[i].hash, sig));
+      });
+    }
+  },
+
+  'A batch of generated keys': {
+    topic: function () {
+      BitcoinKey.generate(10, this.callback);
+    },
+
+    'contains BitcoinKeys with public keys': function (topic) {
+      assert.equal(topic.length, 10);
+      topic.forEach(function (key) {
+        assert.instanceOf(key, BitcoinKey);
+        assert.equal(key.public.length, 65);
+        assert.equal(key.private.length, 32);
+      });
+    }
+  },
+
   'A predefined public key': {
     topic: function () {
       var key = new BitcoinKey();
@@ -124,6 +190,184 @@ vows.describe('BitcoinKey').addBatch({
         assert.isTrue(topic);
       }
     }
+  },
+
+  'The public key cache': {
+    topic: function () {
+      var pubkey = decodeHex("0478314155256b51105268fd1ef12f63a6deb4ac7955489cd023f6e0137f0e3889c54f533d3212d9d65636825f11b2d1e0a0da20504b010370008c7c8a945333be");
+      var before = ccmodule.pubkey_cache_stats();
+      for (var i = 0; i < 3; i++) {
+        var key = new BitcoinKey();
+        key.public = pubkey;
+      }
+      return {before: before, after: ccmodule.pubkey_cache_stats(), key: key};
+    },
+
+    'decodes a repeated key only once': function (topic) {
+      assert.equal(topic.after.hits - topic.before.hits, 2);
+      assert.isTrue(topic.after.size <= topic.after.capacity);
+    },
+
+    'returns the same public key': function (topic) {
+      assert.equal(encodeHex(topic.key.public),
+                   "0478314155256b51105268fd1ef12f63a6deb4ac7955489cd023f6e0137f0e3889c54f533d3212d9d65636825f11b2d1e0a0da20504b010370008c7c8a945333be");
+    }
+  },
+
+  'The signature cache': {
+    topic: function () {
+      var key = new BitcoinKey();
+      key.public = PUBKEY;
+
+      var before = ccmodule.sig_cache_stats();
+      var results = [key.verifySignatureSync(HASH, SIG),
+                     key.verifySignatureSync(HASH, SIG)];
+      return {before: before, after: ccmodule.sig_cache_stats(), results: results};
+    },
+
+    'answers a repeated signature from the cache': function (topic) {
+      assert.deepEqual(topic.results, [true, true]);
+      assert.isTrue(topic.after.hits - topic.before.hits >= 1);
+      assert.isTrue(topic.after.size <= topic.after.capacity);
+    }
+  },
+
+  'A batch of signatures': {
+    topic: function () {
+      var items = [];
+      for (var i = 0; i < 40; i++) {
+        items.push({pubkey: PUBKEY, hash: i % 3 ? HASH : BAD_HASH, sig: SIG});
+      }
+      BitcoinKey.verifyBatch(items, this.callback);
+    },
+
+    'returns a bitmap of valid signatures': function (topic) {
+      assert.equal(topic.length, 5);
+      for (var i = 0; i < 40; i++) {
+        assert.equal(!!(topic[i >> 3] & (1 << (i & 7))), !!(i % 3));
+      }
+    }
+  },
+
+  'The native statistics': {
+    topic: function () {
+      var key = new BitcoinKey();
+      key.public = PUBKEY;
+
+      ccmodule.reset_stats();
+      key.verifySignatureSync(HASH, SIG);
+      key.verifySignatureSync(BAD_HASH, SIG);
+      return ccmodule.stats();
+    },
+
+    'count good and bad signatures': function (topic) {
+      if (!topic.enabled) return;
+      var verify = topic.ops.verifySignatureSync;
+      assert.equal(verify.good, 1);
+      assert.equal(verify.bad, 1);
+      assert.equal(verify.error, 0);
+    },
+
+    'record the run time': function (topic) {
+      if (!topic.enabled) return;
+      var run = topic.ops.verifySignatureSync.run;
+      assert.equal(run.count, 2);
+      assert.equal(run.buckets.reduce(function (a, b) { return a + b; }), 2);
+    }
+  },
+
+  'A signature verified without a key object': {
+    topic: function () {
+      var sync = [BitcoinKey.verify(PUBKEY, HASH, SIG),
+                  BitcoinKey.verify(PUBKEY, BAD_HASH, SIG)];
+      var callback = this.callback;
+      BitcoinKey.verify(PUBKEY, HASH, SIG, function (err, result) {
+        callback(err, {sync: sync, async: result});
+      });
+    },
+
+    'is checked synchronously': function (topic) {
+      assert.deepEqual(topic.sync, [true, false]);
+    },
+
+    'is checked asynchronously': function (topic) {
+      assert.isTrue(topic.async);
+    }
+  },
+
+  'Laxly encoded signatures': {
+    topic: function () {
+      var r = SIG.slice(5, 37), s = SIG.slice(40, 72);
+      // r and s without their sign bytes, and padded with extra zeros
+      var sigs = [
+        Buffer.concat([new Buffer([0x30, 0x44, 0x02, 0x20]), r,
+                       new Buffer([0x02, 0x20]), s]),
+        Buffer.concat([new Buffer([0x30, 0x48, 0x02, 0x22, 0x00, 0x00]), r,
+                       new Buffer([0x02, 0x22, 0x00, 0x00]), s])
+      ];
+      var key = new BitcoinKey();
+      key.public = PUBKEY;
+      var result = {
+        sync: sigs.map(function (sig) { return key.verifySignatureSync(HASH, sig); }),
+        verify: sigs.map(function (sig) { return BitcoinKey.verify(PUBKEY, HASH, sig); })
+      };
+      var callback = this.callback;
+      BitcoinKey.verifyBatch(sigs.map(function (sig) {
+        return {pubkey: PUBKEY, hash: HASH, sig: sig};
+      }), function (err, bitmap) {
+        result.batch = bitmap;
+        callback(err, result);
+      });
+    },
+
+    'verify like the JavaScript verifier': function (topic) {
+      assert.deepEqual(topic.sync, [true, true]);
+      assert.deepEqual(topic.verify, [true, true]);
+      assert.equal(topic.batch[0], 3);
+    }
+  },
+
+  'Writing into a caller\'s buffer': {
+    topic: function () {
+      var key = BitcoinKey.generateSync();
+      var arena = new Buffer(256);
+      arena.fill(0);
+
+      var pubLen = key.getPublicInto(arena, 10);
+      var hashOffset = 10 + pubLen;
+      arena.fill(7, hashOffset, hashOffset + 32);
+      var sigOffset = hashOffset + 32;
+      var sigLen = key.signInto(arena, hashOffset, arena, sigOffset);
+
+      return {
+        key: key,
+        arena: arena,
+        pub: arena.slice(10, 10 + pubLen),
+        hash: arena.slice(hashOffset, hashOffset + 32),
+        sig: arena.slice(sigOffset, sigOffset + sigLen),
+        midstateLen: ccmodule.sha256_midstate_into(arena, 10, pubLen, arena, 200)
+      };
+    },
+
+    'gives the same public key': function (topic) {
+      assert.equal(encodeHex(topic.pub), encodeHex(topic.key.public));
+    },
+
+    'gives a valid signature': function (topic) {
+      assert.isTrue(topic.key.verifySignatureSync(topic.hash, topic.sig));
+    },
+
+    'gives the same midstate': function (topic) {
+      assert.equal(topic.midstateLen, 32);
+      assert.equal(encodeHex(topic.arena.slice(200, 232)),
+                   encodeHex(ccmodule.sha256_midstate(topic.pub)));
+    },
+
+    'refuses ranges outside the buffer': function (topic) {
+      assert.throws(function () {
+        topic.key.getPrivateInto(topic.arena, 240);
+      });
+    }
   }
 }).export(module);
 
@@ -283,6 +283,36 @@ suite.addBatch({ "Script with": {
 suite.addBatch(generateSuite('script_valid.json'));
 suite.addBatch(generateSuite('script_invalid.json', true));
 
+suite.addBatch({ 'Signature checks in one batch': {
+  topic: function () {
+    var cb = this.callback;
+    var verifyBatch = BitcoinKey.verifyBatch;
+    BitcoinKey.verifyBatch = function () {
+      throw new Error("Argument 'pubkey' must be of type Buffer");
+    };
+
+    var sig = Util.decodeHex('3045022100c044d2877e14ffd0d1a832fd65f8670937d26c15e9049d384febdfe53616a29d022073983873504caf70c9468147497dddc027cb895ab2548095069daeca5dc0c08301');
+    var pubkey = Util.decodeHex('04cbcdfa318634d9a31a0d43e0e266914cde11ae9eb15d39ebcb9d5169483826dd74a0af31b36fea6648e1d55862a7d7799f5b3f44bb4901b0ab555c648cb509');
+    var scriptCode = new Script(new Buffer([OP_1]));
+    var errors = [];
+    for (var i = 0; i < 3; i++) {
+      ScriptInterpreter.checkSig(sig, pubkey, scriptCode, defaultTx, 0, 0, function (err) {
+        errors.push(err);
+        if (errors.length == 3) {
+          BitcoinKey.verifyBatch = verifyBatch;
+          cb(null, errors);
+        }
+      });
+    }
+  },
+
+  'all fail if the batch throws': function (topic) {
+    topic.forEach(function (err) {
+      assert.instanceOf(err, Error);
+    });
+  }
+}});
+
 suite.export(module);
 
 function generateSuite(filename, shouldFail)
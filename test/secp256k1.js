@@ -0,0 +1,130 @@
+var vows = require('vows'),
+    assert = require('assert');
+
+var ccmodule = require('../lib/binding');
+var BitcoinKey = ccmodule.BitcoinKey;
+var Util = require('../lib/util');
+var decodeHex = Util.decodeHex;
+
+function compress(pubkey) {
+  var result = new Buffer(33);
+  result[0] = 2 + (pubkey[64] & 1);
+  pubkey.copy(result, 1, 1, 33);
+  return result;
+}
+
+vows.describe('secp256k1').addBatch({
+  'Signatures made by OpenSSL': {
+    topic: function () {
+      var cases = [];
+      for (var i = 0; i < 20; i++) {
+        var key = BitcoinKey.generateSync();
+        var hash = Util.sha256(new Buffer('message ' + i));
+        cases.push({
+          key: key,
+          pubkey: key.public,
+          hash: hash,
+          sig: key.signSync(hash)
+        });
+      }
+      return cases;
+    },
+
+    'verify with uncompressed keys': function (topic) {
+      topic.forEach(function (c) {
+        assert.isTrue(ccmodule.secp256k1_verify(c.pubkey, c.hash, c.sig));
+      });
+    },
+
+    'verify with compressed keys': function (topic) {
+      topic.forEach(function (c) {
+        assert.isTrue(ccmodule.secp256k1_verify(compress(c.pubkey), c.hash, c.sig));
+      });
+    },
+
+    'agree with OpenSSL': function (topic) {
+      topic.forEach(function (c) {
+        assert.equal(ccmodule.secp256k1_verify(c.pubkey, c.hash, c.sig),
+                     c.key.verifySignatureSync(c.hash, c.sig));
+      });
+    },
+
+    'fail for a different hash': function (topic) {
+      topic.forEach(function (c) {
+        var hash = new Buffer(c.hash);
+        hash[0] ^= 1;
+        assert.isFalse(ccmodule.secp256k1_verify(c.pubkey, hash, c.sig));
+      });
+    },
+
+    'fail for a tampered signature': function (topic) {
+      topic.forEach(function (c) {
+        var sig = new Buffer(c.sig);
+        sig[sig.length - 1] ^= 1;
+        assert.isFalse(ccmodule.secp256k1_verify(c.pubkey, c.hash, sig));
+      });
+    },
+
+    'fail for a different key': function (topic) {
+      assert.isFalse(ccmodule.secp256k1_verify(topic[1].pubkey, topic[0].hash, topic[0].sig));
+    }
+  },
+
+  'Malformed input': {
+    topic: function () {
+      return {
+        pubkey: decodeHex("04a19c1f07c7a0868d86dbb37510305843cc730eb3bea8a99d92131f44950cecd923788419bfef2f635fad621d753f30d4b4b63b29da44b4f3d92db974537ad5a4"),
+        hash: decodeHex("230aba77ccde46bb17fcb0295a92c0cc42a6ea9f439aaadeb0094625f49e6ed8"),
+        sig: decodeHex("3046022100a3ee5408f0003d8ef00ff2e0537f54ba09771626ff70dca1f01296b05c510e85022100d4dc70a5bb50685b65833a97e536909a6951dd247a2fdbde6688c33ba6d6407501")
+      };
+    },
+
+    'verifies with the hash type byte still attached': function (topic) {
+      assert.isTrue(ccmodule.secp256k1_verify(topic.pubkey, topic.hash, topic.sig));
+    },
+
+    'verifies with r and s missing their sign bytes': function (topic) {
+      // Both have the high bit set, so in strict DER they'd be negative
+      var r = topic.sig.slice(5, 37), s = topic.sig.slice(40, 72);
+      var sig = Buffer.concat([new Buffer([0x30, 0x44, 0x02, 0x20]), r,
+                               new Buffer([0x02, 0x20]), s]);
+      assert.isTrue(ccmodule.secp256k1_verify(topic.pubkey, topic.hash, sig));
+    },
+
+    'verifies with superfluous zero padding': function (topic) {
+      var r = topic.sig.slice(4, 37), s = topic.sig.slice(39, 72);
+      var sig = Buffer.concat([new Buffer([0x30, 0x48, 0x02, 0x22, 0x00]), r,
+                               new Buffer([0x02, 0x22, 0x00]), s]);
+      assert.isTrue(ccmodule.secp256k1_verify(topic.pubkey, topic.hash, sig));
+    },
+
+    'verifies with long form lengths': function (topic) {
+      var r = topic.sig.slice(4, 37), s = topic.sig.slice(39, 72);
+      var sig = Buffer.concat([new Buffer([0x30, 0x81, 0x49, 0x02, 0x81, 0x21]), r,
+                               new Buffer([0x02, 0x82, 0x00, 0x21]), s]);
+      assert.isTrue(ccmodule.secp256k1_verify(topic.pubkey, topic.hash, sig));
+    },
+
+    'is rejected for a truncated key': function (topic) {
+      assert.isFalse(ccmodule.secp256k1_verify(topic.pubkey.slice(0, 64), topic.hash, topic.sig));
+    },
+
+    'is rejected for a point off the curve': function (topic) {
+      var pubkey = new Buffer(topic.pubkey);
+      pubkey[64] ^= 1;
+      assert.isFalse(ccmodule.secp256k1_verify(pubkey, topic.hash, topic.sig));
+    },
+
+    'is rejected for a signature with a bad length': function (topic) {
+      var sig = new Buffer(topic.sig);
+      sig[1]++;
+      assert.isFalse(ccmodule.secp256k1_verify(topic.pubkey, topic.hash, sig));
+    },
+
+    'throws for a short hash': function (topic) {
+      assert.throws(function () {
+        ccmodule.secp256k1_verify(topic.pubkey, topic.hash.slice(0, 20), topic.sig);
+      });
+    }
+  }
+}).export(module);
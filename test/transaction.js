@@ -4,10 +4,29 @@ var vows = require('vows'),
 var Connection = require('../lib/connection').Connection;
 var Script = require('../lib/script').Script;
 var Transaction = require('../lib/schema/transaction').Transaction;
+var TransactionStore = require('../lib/transactionstore').TransactionStore;
 var Util = require('../lib/util');
 var encodeHex = Util.encodeHex;
 var decodeHex = Util.decodeHex;
 
+// Pay-to-pubkey scriptPubKey of the output spent by the block 170
+// transaction, which is also the script of its second output
+var P2PK_SCRIPT = "410411db93e1dcdb8a016b49840f8c53bc1eb68a382e97b1482ecad7b148a6909a5cb2e0eaddfb84ccf9744464f82e160bfa9b8b64f9d4c03f999b8643f656b412a3ac";
+
+/**
+ * Transaction.hashForSignature() with the native sighash turned off, so the
+ * digest comes from the JavaScript serializer.
+ */
+function jsHashForSignature(tx, script, inIndex, hashType) {
+  var SigHashTx = Util.ccmodule.SigHashTx;
+  Util.ccmodule.SigHashTx = null;
+  try {
+    return tx.hashForSignature(script, inIndex, hashType);
+  } finally {
+    Util.ccmodule.SigHashTx = SigHashTx;
+  }
+};
+
 vows.describe('Transaction').addBatch({
   'An example transaction': {
     topic: function () {
@@ -23,6 +42,23 @@ vows.describe('Transaction').addBatch({
       assert.instanceOf(topic, Transaction);
     },
 
+    'has the correct hash': function (topic) {
+      assert.equal(
+        Util.formatHashFull(topic.getHash()),
+        "f4184fc596403b9d638783cf57adfe4c75c605f6356fbc91338530e9831e9e16");
+    },
+
+    'decodes inputs and outputs': function (topic) {
+      assert.equal(topic.ins.length, 1);
+      assert.equal(topic.ins[0].getOutpointIndex(), 0);
+      assert.equal(topic.ins[0].q, 0xffffffff);
+      assert.equal(topic.outs.length, 2);
+      assert.equal(Util.valueToBigInt(topic.outs[0].v).toString(), "1000000000");
+
+      var original = topic.getBuffer();
+      assert.equal(encodeHex(topic.serialize()), encodeHex(original));
+    },
+
     'hashes for signature correctly': function (topic) {
       var scriptData = decodeHex("410411db93e1dcdb8a016b49840f8c53bc1eb68a382e97b1482ecad7b148a6909a5cb2e0eaddfb84ccf9744464f82e160bfa9b8b64f9d4c03f999b8643f656b412a3ac");
       var script = new Script(scriptData);
@@ -30,6 +66,252 @@ vows.describe('Transaction').addBatch({
       assert.equal(
         encodeHex(hash),
         "7a05c6145f10101e9d6325494245adf1297d80f8f38d4d576d57cdba220bcb19");
+    },
+
+    'hashes for signature with other hash types': function (topic) {
+      var scriptData = decodeHex(P2PK_SCRIPT);
+      var expected = {
+        0x02: "0c75c3ac059ee8e19758c58c757d88bcb18d447517ce4d1c3b5a6b7183b41698",
+        0x03: "2c836064b405a0d6658da729df4b73667d864c2861601a6d1cfc4264556fc203",
+        0x81: "45692ee72fe2285c88b2339c47d2f7d01f0b130494fd42be524a23672421d3f9"
+      };
+      Object.keys(expected).forEach(function (hashType) {
+        var hash = topic.hashForSignature(new Script(scriptData), 0, +hashType);
+        assert.equal(encodeHex(hash), expected[hashType]);
+      });
+    },
+
+    'hashes all inputs for signature at once': function (topic) {
+      var scriptData = decodeHex(P2PK_SCRIPT);
+      var hashes = topic.hashesForSignature([new Script(scriptData)], 1);
+      assert.equal(hashes.length, 1);
+      assert.equal(
+        encodeHex(hashes[0]),
+        "7a05c6145f10101e9d6325494245adf1297d80f8f38d4d576d57cdba220bcb19");
+    },
+
+    'when verifying its input': {
+      topic: function (topic) {
+        var scriptData = decodeHex(P2PK_SCRIPT);
+        topic.verifyInput(0, new Script(scriptData), this.callback);
+      },
+
+      'accepts the signature': function (err, result) {
+        assert.isNull(err);
+        assert.isTrue(result);
+      }
+    },
+
+    'when verifying all inputs natively': {
+      topic: function (topic) {
+        var verify = Util.ccmodule.verify_transaction;
+        if ("function" !== typeof verify) {
+          this.callback(null, [true]);
+          return;
+        }
+
+        var scriptData = decodeHex(P2PK_SCRIPT);
+        verify(topic.getBuffer(), [scriptData], this.callback);
+      },
+
+      'accepts the signature': function (err, results) {
+        assert.isNull(err);
+        assert.deepEqual(results, [true]);
+      }
+    },
+
+    'when connected to a coin cache': {
+      topic: function (topic) {
+        var CoinCache = Util.ccmodule.CoinCache;
+        if ("function" !== typeof CoinCache) return null;
+
+        var cache = new CoinCache(1024 * 1024);
+        cache.connect([topic.getBuffer()], 170);
+
+        var outpoints = new Buffer(72);
+        topic.getHash().copy(outpoints, 0);
+        outpoints.writeUInt32LE(1, 32);
+        topic.ins[0].o.copy(outpoints, 36);
+
+        return {coins: cache.getMany(outpoints), batch: cache.flush(),
+                stats: cache.stats()};
+      },
+
+      'returns its outputs': function (result) {
+        if (!result) return;
+        assert.equal(result.coins[0].height, 170);
+        assert.equal(encodeHex(result.coins[0].v), "00286bee00000000");
+        assert.equal(encodeHex(result.coins[0].s), P2PK_SCRIPT);
+        assert.isNull(result.coins[1]);
+      },
+
+      'flushes a delete for the spent coin and puts for the outputs': function (result) {
+        if (!result) return;
+        assert.deepEqual(result.batch.map(function (op) { return op.type; }),
+                         ['del', 'put', 'put']);
+        assert.equal(result.batch[0].key.length, 37);
+        assert.equal(result.batch[1].value.length, 16 + 67);
+        assert.equal(result.stats.pending, 0);
+      }
+    },
+
+    'leaves non-standard scripts to the interpreter': function (topic) {
+      var verify = Util.ccmodule.verify_standard_input;
+      if ("function" !== typeof verify) return;
+
+      var scriptSig = topic.ins[0].s;
+      var scriptPubKey = decodeHex("51");
+      var called = false;
+      assert.isFalse(verify(topic.getBuffer(), 0, scriptSig, scriptPubKey,
+                            function () { called = true; }));
+      assert.isFalse(called);
+    },
+
+    'when put in a memory pool': {
+      topic: function (tx) {
+        var pool = new Util.ccmodule.MemPool(100);
+        var otherHash = new Buffer(32);
+        otherHash.fill(1);
+
+        var results = {
+          added: pool.put(tx.getHash(), tx, tx.getBuffer().length, tx.ins[0].o),
+          addedAgain: pool.put(tx.getHash(), tx, tx.getBuffer().length, tx.ins[0].o),
+          known: pool.hasMany([tx.getHash(), otherHash]),
+          found: pool.getMany([otherHash, tx.getHash()]),
+          spenders: pool.getSpenders(Buffer.concat([tx.ins[0].o, tx.ins[0].o]))
+        };
+
+        // A second, pending entry pushes the pool over its limit
+        pool.put(otherHash, [], 0, new Buffer(0));
+        results.stats = pool.stats();
+        results.evicted = pool.trim();
+        results.count = pool.count();
+        results.tx = tx;
+        return results;
+      },
+
+      'indexes transactions by hash': function (topic) {
+        assert.isTrue(topic.added);
+        assert.isFalse(topic.addedAgain);
+        assert.deepEqual(topic.known, [true, false]);
+        assert.isUndefined(topic.found[0]);
+        assert.strictEqual(topic.found[1], topic.tx);
+      },
+
+      'indexes spent outpoints': function (topic) {
+        assert.equal(topic.spenders.length, 2);
+        assert.equal(encodeHex(topic.spenders[0]), encodeHex(topic.tx.getHash()));
+      },
+
+      'evicts verified transactions over its limit': function (topic) {
+        assert.isTrue(topic.stats.memory > 100);
+        assert.equal(topic.evicted.length, 1);
+        assert.strictEqual(topic.evicted[0], topic.tx);
+        assert.equal(topic.count, 1);
+      }
+    }
+  },
+
+  'A transaction with three inputs and two outputs': {
+    topic: function () {
+      // Inputs with different scriptSigs and sequences, so that blanking
+      // them matters
+      return new Transaction(Connection.parseTx(decodeHex("0100000003111111111111111111111111111111111111111111111111111111111111111100000000020151ffffffff22222222222222222222222222222222222222222222222222222222222222220100000003020152010000003333333333333333333333333333333333333333333333333333333333333333020000000403010203feffffff0250c30000000000001976a914a0a0a0a0a0a0a0a0a0a0a0a0a0a0a0a0a0a0a0a088aca0860100000000001976a914a1a1a1a1a1a1a1a1a1a1a1a1a1a1a1a1a1a1a1a188ac00000000")));
+    },
+
+    'hashes all inputs like the JavaScript serializer': function (topic) {
+      var sighashMany = Util.ccmodule.sighash_many;
+      if ("function" !== typeof sighashMany) return;
+
+      var scripts = ["c0", "c1", "c2"].map(function (b) {
+        return decodeHex("76a914" + new Array(21).join(b) + "88ac");
+      });
+      [1, 2, 0x81, 0x82, [3, 0x83, 2], [0x83, 3, 0x81]].forEach(function (hashTypes) {
+        var hashes = sighashMany(topic.getBuffer(), scripts, hashTypes);
+        assert.equal(hashes.length, 3 * 32);
+        scripts.forEach(function (script, i) {
+          var hashType = Array.isArray(hashTypes) ? hashTypes[i] : hashTypes;
+          assert.equal(encodeHex(hashes.slice(32 * i, 32 * (i + 1))),
+                       encodeHex(jsHashForSignature(topic, new Script(script),
+                                                    i, hashType)));
+        });
+      });
+    },
+
+    'parses itself once for the hashes of all inputs': function (topic) {
+      if (!Util.ccmodule.SigHashTx) return;
+
+      var tx = new Transaction(Connection.parseTx(topic.getBuffer()));
+      var script = decodeHex("76a914" + new Array(21).join("c0") + "88ac");
+      var parsed = null;
+      [1, 2, 0x81, 0x82].forEach(function (hashType) {
+        for (var i = 0; i < 3; i++) {
+          assert.equal(encodeHex(tx.hashForSignature(new Script(script), i, hashType)),
+                       encodeHex(jsHashForSignature(tx, new Script(script), i, hashType)));
+          parsed = parsed || tx._sigHashTx;
+          assert.strictEqual(tx._sigHashTx, parsed);
+        }
+      });
+
+      // Serializing again after a change gets the transaction parsed again
+      tx.ins[1].q = 0;
+      tx.serialize();
+      assert.equal(encodeHex(tx.hashForSignature(new Script(script), 0, 1)),
+                   encodeHex(jsHashForSignature(tx, new Script(script), 0, 1)));
+      assert.notStrictEqual(tx._sigHashTx, parsed);
+    },
+
+    'refuses SIGHASH_SINGLE for an input without a matching output': function (topic) {
+      var sighashMany = Util.ccmodule.sighash_many;
+      if ("function" !== typeof sighashMany) return;
+
+      var script = decodeHex("51");
+      assert.throws(function () {
+        sighashMany(topic.getBuffer(), [script, script, script], 3);
+      }, /SIGHASH_SINGLE/);
+      assert.throws(function () {
+        jsHashForSignature(topic, new Script(script), 2, 3);
+      }, /SIGHASH_SINGLE/);
+    }
+  },
+
+  'An orphan pool filled past its limit': {
+    topic: function () {
+      var store = new TransactionStore({
+        getBlockChain: function () { return null; }
+      });
+      store.orphans = new Util.ccmodule.MemPool(8192);
+
+      // Orphans of 1000 bytes each, waiting for one of five parents
+      for (var i = 0; i < 50; i++) {
+        var hash = new Buffer(32);
+        hash.fill(0);
+        hash.writeUInt32LE(i, 0);
+        store.addOrphan({
+          hash: hash,
+          getHash: function () { return this.hash; },
+          getBuffer: function () { return new Buffer(1000); }
+        }, 'parent' + (i % 5));
+      }
+      return store;
+    },
+
+    'stays within its limit': function (store) {
+      var stats = store.orphans.stats();
+      assert.isTrue(stats.memory <= stats.maxBytes);
+      assert.isTrue(store.orphans.count() > 0);
+      assert.isTrue(store.orphans.count() < 50);
+    },
+
+    'only indexes orphans it still holds': function (store) {
+      var indexed = 0;
+      Object.keys(store.orphanTxByPrev).forEach(function (prev) {
+        store.orphanTxByPrev[prev].forEach(function (tx) {
+          assert.isTrue(store.orphans.has(tx.getHash()));
+          indexed++;
+        });
+      });
+      assert.equal(indexed, store.orphans.count());
     }
   }
 }).export(module);
@@ -5,10 +5,42 @@ var Binary = require('binary');
 var bignum = require('bignum');
 
 var Util = require('../lib/util');
+var Block = require('../lib/schema/block').Block;
 var logger = require('../lib/logger');
 
 logger.disable();
 
+var FRAMER_MAGIC = Util.decodeHex('f9beb4d9');
+
+// A P2P message with a checksummed header
+function frameMessage(command, payload, badChecksum) {
+  var header = new Buffer(24).clear();
+  FRAMER_MAGIC.copy(header, 0);
+  header.write(command, 4, 'ascii');
+  header.writeUInt32LE(payload.length, 16);
+  Util.twoSha256(payload).copy(header, 20, 0, 4);
+  if (badChecksum) header[20] ^= 1;
+  return Buffer.concat([header, payload]);
+}
+
+// Frame a stream pushed in chunks ending at the given offsets
+function frameChunks(stream, ends, count, callback) {
+  var frames = [];
+  var framer = new Util.ccmodule.Framer(FRAMER_MAGIC, function (err, command, payload) {
+    frames.push({err: err, command: command, payload: payload});
+    if (frames.length == count) {
+      callback(null, frames);
+    }
+  });
+  framer.checksum = true;
+
+  var start = 0;
+  ends.concat([stream.length]).forEach(function (end) {
+    framer.push(stream.slice(start, end));
+    start = end;
+  });
+}
+
 vows.describe('Bitcoin Utils').addBatch({
   'A Bitcoin address': {
     topic: "12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX",
@@ -21,6 +53,74 @@ vows.describe('Bitcoin Utils').addBatch({
     'is re-encoded correctly': function (topic) {
       var addrHash = Util.addressToPubKeyHash(topic);
       assert.equal(Util.pubKeyHashToAddress(addrHash), topic);
+    },
+    'fails with a bad checksum': function (topic) {
+      assert.isNull(Util.addressToPubKeyHash("12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJY"));
+    },
+    'is decoded in batches': function (topic) {
+      var hashes = Util.addressesToPubKeyHashes([topic, "not an address", topic]);
+      assert.equal(hashes.length, 3);
+      assert.equal(Util.encodeHex(hashes[0]), '119b098e2e980a229e139a9ed01a469e518e6f26');
+      assert.isNull(hashes[1]);
+      assert.equal(Util.encodeHex(hashes[2]), '119b098e2e980a229e139a9ed01a469e518e6f26');
+    }
+  },
+
+  'Base58': {
+    topic: function () {
+      var data = new Buffer(100);
+      for (var i = 0; i < data.length; i++) data[i] = i;
+      return data;
+    },
+    'encodes long inputs with leading zeros': function (topic) {
+      var encoded = "1WrVfCvV4mZzThKiNX9EMwo5Hkrcn5fgDuGfuVruv7XBDiHSGXRsaBv5iX9YF6ZPpq3ywpbtUMJaUbYQH9brAdofH9fR7VMbH7CYfngCFqprJSvF7g6QtxpgTYNREb6KSJKetsU";
+      assert.equal(Util.encodeBase58(topic), encoded);
+      assert.equal(Util.encodeHex(Util.decodeBase58(encoded)), Util.encodeHex(topic));
+    },
+    'round trips with a checksum': function (topic) {
+      var encoded = Util.encodeBase58Check(topic);
+      assert.equal(Util.encodeHex(Util.decodeBase58Check(encoded)), Util.encodeHex(topic));
+    },
+    'encodes and decodes in batches': function (topic) {
+      var ccmodule = Util.ccmodule;
+      if (!ccmodule.base58check_encode_many) return;
+
+      var values = [topic, topic.slice(0, 1), new Buffer(0)];
+      var encoded = ccmodule.base58check_encode_many(values);
+      var decoded = ccmodule.base58check_decode_many(encoded);
+      values.forEach(function (value, i) {
+        assert.equal(encoded[i], Util.encodeBase58Check(value));
+        assert.equal(Util.encodeHex(decoded[i]), Util.encodeHex(value));
+      });
+    }
+  },
+
+  'Pubkey hashes': {
+    topic: function () {
+      return [
+        Util.decodeHex('0279be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d959f2815b16f81798'),
+        Util.decodeHex('0479be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d959f2815b16f8179' +
+                       '8483ada7726a3c4655da4fbfc0e1108a8fd17b448a68554199c47d08ffb10d4b8')
+      ];
+    },
+    'are computed in batches': function (topic) {
+      var hashes = Util.sha256ripe160Many(topic);
+      assert.equal(hashes.length, 2);
+      assert.equal(Util.encodeHex(hashes[0]), '751e76e8199196d454941c45d1b3a323f1433bd6');
+      assert.equal(Util.encodeHex(hashes[1]), '91b24bf9f5288532960ac687abb035127b1d28a5');
+      assert.equal(Util.sha256ripe160Many([]).length, 0);
+    },
+    'are converted to addresses in batches': function (topic) {
+      var hashes = Util.sha256ripe160Many(topic);
+      assert.deepEqual(Util.pubKeyHashesToAddresses(hashes),
+                       ['1BgGZ9tcN4rm9KBzDn7KprQz87SZ26SAMH',
+                        '1EHNa6Q4Jz2uvNExL497mE43ikXhwF6kZm']);
+      assert.deepEqual(Util.pubKeyHashesToAddresses(hashes.slice(0, 1), 0x6f),
+                       ['mrCDrCybB6J1vRfbwM5hemdJz73FwDBC8r']);
+    },
+    'are versioned by pubkey_to_address256': function (topic) {
+      var address256 = Util.ccmodule.pubkey_to_address256(topic[0], 0x6f);
+      assert.equal(Util.encodeBase58(address256), 'mrCDrCybB6J1vRfbwM5hemdJz73FwDBC8r');
     }
   },
 
@@ -46,6 +146,250 @@ vows.describe('Bitcoin Utils').addBatch({
     }
   },
 
+  'The genesis block header': {
+    topic: Util.decodeHex(
+        '0100000000000000000000000000000000000000000000000000000000000000'
+      + '000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa'
+      + '4b1e5e4a29ab5f49ffff001d1dac2b7c'),
+    'double hashes to the genesis hash': function (topic) {
+      assert.equal(Util.formatHashFull(Util.twoSha256(topic)),
+                   "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f");
+    },
+    'double hashes the same with every implementation': function (topic) {
+      var ccmodule = Util.ccmodule;
+      if (!ccmodule.sha256_implementation) return;
+
+      var original = ccmodule.sha256_implementation();
+      var messages = [];
+      for (var i = 0; i < 37; i++) {
+        // Runs of equal lengths with a few odd ones in between
+        messages.push(topic.slice(0, i % 9 == 8 ? 41 + i : 80 - (i >> 4) * 16));
+      }
+      var expected = messages.map(function (msg) {
+        return Util.sha256(Util.sha256(msg)).toString('hex');
+      });
+
+      ['portable', 'sse41', 'avx2', 'shani'].forEach(function (name) {
+        try {
+          ccmodule.sha256_implementation(name);
+        } catch (e) {
+          // Not supported by this CPU
+          return;
+        }
+        assert.equal(ccmodule.sha256d(topic).toString('hex'),
+                     Util.sha256(Util.sha256(topic)).toString('hex'));
+
+        var hashes = Util.twoSha256Many(messages);
+        for (var i = 0; i < messages.length; i++) {
+          assert.equal(hashes.slice(i * 32, i * 32 + 32).toString('hex'),
+                       expected[i]);
+        }
+      });
+      ccmodule.sha256_implementation(original);
+    },
+    'can be hashed in fixed size chunks': function (topic) {
+      var hashes = Util.twoSha256Many(topic, 16);
+      assert.equal(hashes.length, 5 * 32);
+      assert.equal(hashes.slice(32, 64).toString('hex'),
+                   Util.twoSha256(topic.slice(16, 32)).toString('hex'));
+    }
+  },
+
+  'A merkle tree': {
+    topic: function () {
+      var leaves = [];
+      for (var i = 0; i < 11; i++) {
+        leaves.push(Util.sha256(new Buffer('leaf ' + i)));
+      }
+      return leaves;
+    },
+    'has the same root as the reference implementation': function (topic) {
+      var ccmodule = Util.ccmodule;
+      if (!ccmodule.merkle_root) return;
+
+      for (var n = 1; n <= topic.length; n++) {
+        // Duplicate the last node on odd levels like CBlock::BuildMerkleTree
+        var level = topic.slice(0, n);
+        while (level.length > 1) {
+          var next = [];
+          for (var i = 0; i < level.length; i += 2) {
+            var right = level[Math.min(i + 1, level.length - 1)];
+            next.push(Util.sha256(Util.sha256(Buffer.concat([level[i], right]))));
+          }
+          level = next;
+        }
+        assert.equal(ccmodule.merkle_root(Buffer.concat(topic.slice(0, n))).toString('hex'),
+                     level[0].toString('hex'));
+      }
+    },
+    'has branches that lead to the root': function (topic) {
+      var ccmodule = Util.ccmodule;
+      if (!ccmodule.merkle_branch) return;
+
+      var hashes = Buffer.concat(topic);
+      var root = ccmodule.merkle_root(hashes);
+      for (var index = 0; index < topic.length; index++) {
+        var branch = ccmodule.merkle_branch(hashes, index);
+        var hash = topic[index];
+        for (var k = 0, i = index; k < branch.length; k += 32, i >>= 1) {
+          var sibling = branch.slice(k, k + 32);
+          hash = Util.twoSha256(i & 1 ? Buffer.concat([sibling, hash])
+                                      : Buffer.concat([hash, sibling]));
+        }
+        assert.equal(hash.toString('hex'), root.toString('hex'));
+      }
+    },
+    'contains all levels': function (topic) {
+      var ccmodule = Util.ccmodule;
+      if (!ccmodule.merkle_tree) return;
+
+      // 11 + 6 + 3 + 2 + 1 nodes
+      assert.equal(ccmodule.merkle_tree(Buffer.concat(topic)).length, 23 * 32);
+      assert.equal(ccmodule.merkle_root(new Buffer(0)).toString('hex'),
+                   Util.NULL_HASH.toString('hex'));
+    }
+  },
+
+  'A nonce scan': {
+    topic: function () {
+      var header = Util.decodeHex(
+          '0100000000000000000000000000000000000000000000000000000000000000'
+        + '000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa'
+        + '4b1e5e4a29ab5f49ffff001d00000000');
+      // One in 256 hashes is below this target
+      var target = new Buffer(32).clear();
+      target[0] = 0x01;
+
+      if (!Util.ccmodule.scan_nonce) {
+        this.callback(null, null);
+        return;
+      }
+
+      var callback = this.callback;
+      Util.ccmodule.scan_nonce(header, target, 2, function (err, nonce, stats) {
+        callback(err, {header: header, target: target, nonce: nonce, stats: stats});
+      });
+    },
+    'finds a nonce below the target': function (topic) {
+      if (!topic) return;
+
+      var header = new Buffer(topic.header);
+      header.writeUInt32LE(topic.nonce, 76);
+      var hash = Util.twoSha256(header);
+      hash.reverse();
+      assert.isTrue(hash.compare(topic.target) < 0);
+      assert.isTrue(topic.stats.hashes > 0);
+    },
+    'can be cancelled': {
+      topic: function (topic) {
+        if (!topic) {
+          this.callback(null, null);
+          return;
+        }
+
+        // Nothing is below a zero target
+        var callback = this.callback;
+        var id = Util.ccmodule.scan_nonce(topic.header, new Buffer(32).clear(), 2,
+                                          function (err, nonce, stats) {
+          callback(null, {err: err, nonce: nonce});
+        });
+        Util.ccmodule.scan_nonce_cancel(id);
+      },
+      'and reports an error': function (result) {
+        if (!result) return;
+
+        assert.instanceOf(result.err, Error);
+        assert.isNull(result.nonce);
+      }
+    }
+  },
+
+  'A message framer': {
+    topic: function () {
+      var Framer = Util.ccmodule.Framer;
+      if (!Framer) {
+        this.callback(null, null);
+        return;
+      }
+
+      var magic = FRAMER_MAGIC;
+      var message = frameMessage;
+
+      var big = new Buffer(100000);
+      for (var i = 0; i < big.length; i++) big[i] = i & 0xff;
+
+      var stream = Buffer.concat([
+        new Buffer('garbage'),
+        message('verack', new Buffer(0)),
+        message('ping', Util.decodeHex('0102030405060708')),
+        message('block', big),
+        message('tx', new Buffer('abc'), true)
+      ]);
+
+      var callback = this.callback;
+      var frames = [];
+      var framer = new Framer(magic, function (err, command, payload) {
+        frames.push({err: err, command: command, payload: payload});
+        if (frames.length == 4) {
+          callback(null, {frames: frames, big: big, length: framer.length});
+        }
+      });
+      framer.checksum = true;
+
+      // Feed the stream in uneven chunks
+      for (var pos = 0, size = 1; pos < stream.length; pos += size, size *= 3) {
+        framer.push(stream.slice(pos, pos + size));
+      }
+    },
+    'delivers messages in order': function (topic) {
+      if (!topic) return;
+
+      assert.deepEqual(topic.frames.map(function (frame) {
+        return frame.command;
+      }), ['verack', 'ping', 'block', 'tx']);
+      assert.equal(topic.frames[1].payload.toString('hex'), '0102030405060708');
+      assert.equal(topic.frames[2].payload.toString('hex'),
+                   topic.big.toString('hex'));
+      assert.equal(topic.length, 0);
+    },
+    'reports checksum failures': function (topic) {
+      if (!topic) return;
+
+      assert.isNull(topic.frames[2].err);
+      assert.instanceOf(topic.frames[3].err, Error);
+    }
+  },
+
+  'A payload that spans chunks after the first': {
+    topic: function () {
+      if (!Util.ccmodule.Framer) {
+        this.callback(null, null);
+        return;
+      }
+
+      var payload = new Buffer(40);
+      for (var i = 0; i < payload.length; i++) payload[i] = 24 + i;
+      var message = frameMessage('tx', payload);
+      var callback = this.callback;
+
+      // The header ends at a chunk boundary, then it straddles one
+      frameChunks(Buffer.concat([message, message]),
+                  [24, 40, 64 + 20, 64 + 34], 2, function (err, frames) {
+        callback(err, {frames: frames, payload: payload});
+      });
+    },
+    'is copied from the right place': function (topic) {
+      if (!topic) return;
+
+      topic.frames.forEach(function (frame) {
+        assert.isNull(frame.err);
+        assert.equal(frame.command, 'tx');
+        assert.equal(frame.payload.toString('hex'),
+                     topic.payload.toString('hex'));
+      });
+    }
+  },
+
   'A block header': {
     topic: Util.decodeHex(
         '0100000057cb9e9826b22b9cfa59d374d8cd9acd4759d6cd326583b412080000'
@@ -58,5 +402,164 @@ vows.describe('Bitcoin Utils').addBatch({
                    "2a7ce7ed41c789515649417421a5f260" +
                    "576461a477d440cda7355ddbab651f8c");
     }
+  },
+
+  'A native 256 bit integer': {
+    topic: function () {
+      return Util.ccmodule.UInt256 || null;
+    },
+    'expands compact difficulty bits': function (UInt256) {
+      if (!UInt256) return;
+
+      var target = UInt256.fromCompact(0x1d00ffff);
+      assert.equal(target.toString(16), 'ffff' + new Array(53).join('0'));
+      assert.equal(target.toCompact(), 0x1d00ffff);
+      assert.equal(UInt256.fromCompact(0x1b0404cb).toCompact(), 0x1b0404cb);
+      assert.equal(new UInt256(0x80).toCompact(), 0x02008000);
+      assert.throws(function () { UInt256.fromCompact(0x04923456); });
+    },
+    'computes the work of a target': function (UInt256) {
+      if (!UInt256) return;
+
+      assert.equal(UInt256.fromCompact(0x1d00ffff).getWork().toString(),
+                   '4295032833');
+      assert.equal(Util.calcDifficulty(0x1b0404cb), 16307);
+    },
+    'does arithmetic like bignum': function (UInt256) {
+      if (!UInt256) return;
+
+      var a = UInt256.fromBuffer(new Buffer('0100000000000000000000', 'hex'));
+      var b = a.add(a).sub(1);
+      assert.equal(b.toString(16), '1ffffffffffffffffffff');
+      assert.equal(b.mul(2).div(a).toNumber(), 3);
+      assert.equal(a.cmp(b), -1);
+      assert.equal(b.cmp(a), 1);
+      assert.equal(a.cmp(new UInt256(a)), 0);
+      assert.throws(function () { a.sub(b); });
+      assert.equal(a.toBuffer().toString('hex'), '0100000000000000000000');
+      assert.equal(a.toBuffer({endian: 'little'}).toString('hex'),
+                   '0000000000000000000001' + new Array(43).join('0'));
+      assert.equal(new UInt256().toBuffer().toString('hex'), '00');
+    },
+    'sums output values': function (UInt256) {
+      if (!UInt256) return;
+
+      var values = [
+        new Buffer('00f2052a01000000', 'hex'),
+        new Buffer('ffffffffffffffff', 'hex'),
+        new Buffer('0100000000000000', 'hex')
+      ];
+      assert.equal(UInt256.sumValues(values).toString(), '18446744078709551616');
+      assert.equal(UInt256.sumValues(Buffer.concat(values)).toString(),
+                   '18446744078709551616');
+    }
+  },
+
+  'A run of block headers': {
+    topic: Util.decodeHex(
+        '0100000000000000000000000000000000000000000000000000000000000000'
+      + '000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa'
+      + '4b1e5e4a29ab5f49ffff001d1dac2b7c'),
+    'is valid from the genesis block': function (topic) {
+      var result = Block.validateHeaders(topic, Util.NULL_HASH, new Buffer(0));
+      assert.equal(result.failed, -1);
+      assert.isNull(result.error);
+      assert.equal(Util.formatHashFull(result.hash),
+                   '000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f');
+      assert.equal(result.chainWork.toString('hex'), '0100010001');
+    },
+    'adds to the previous chain work': function (topic) {
+      var result = Block.validateHeaders(topic, Util.NULL_HASH,
+                                         new Buffer('0100000000', 'hex'));
+      assert.equal(result.chainWork.toString('hex'), '0200010001');
+    },
+    'fails on a broken link': function (topic) {
+      var result = Block.validateHeaders(topic, Util.sha256(topic), new Buffer(0));
+      assert.equal(result.failed, 0);
+      assert.equal(result.error, 'Header does not link to the previous one');
+    },
+    'fails on a missed target': function (topic) {
+      var header = new Buffer(topic);
+      header[79] ^= 1;
+      var result = Block.validateHeaders(header, Util.NULL_HASH, new Buffer(0));
+      assert.equal(result.failed, 0);
+      assert.equal(result.error, 'Difficulty target not met');
+    }
+  },
+
+  'A getwork template': {
+    topic: function () {
+      var WorkTemplate = Util.ccmodule.WorkTemplate;
+      if (!WorkTemplate) return null;
+
+      var topic = {
+        coinbase1: new Buffer('01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff08ffff001d', 'hex'),
+        coinbase2: new Buffer('ffffffff0100f2052a010000000000000000', 'hex'),
+        branch: Buffer.concat([Util.sha256(new Buffer('a')),
+                               Util.sha256(new Buffer('b'))])
+      };
+      topic.tmpl = new WorkTemplate({
+        version: 2,
+        prevHash: Util.sha256(new Buffer('prev')),
+        bits: 0x1d00ffff,
+        coinbase1: topic.coinbase1,
+        coinbase2: topic.coinbase2,
+        branch: topic.branch
+      });
+      topic.work = topic.tmpl.getWork(3, 1234567890);
+      return topic;
+    },
+    'rolls the extranonce into the merkle root': function (topic) {
+      if (!topic) return;
+
+      assert.equal(topic.work.length, 3);
+      assert.equal(topic.tmpl.getExtranonce(), 3);
+      topic.work.forEach(function (unit, i) {
+        var enonce = Binary.put().word32le(i + 1).buffer();
+        var root = Util.twoSha256(Buffer.concat([topic.coinbase1, enonce,
+                                                 topic.coinbase2]));
+        for (var j = 0; j < topic.branch.length; j += 32) {
+          root = Util.twoSha256(Buffer.concat([root,
+                                               topic.branch.slice(j, j + 32)]));
+        }
+
+        var header = Util.reverseBytes32(Util.decodeHex(unit.data));
+        assert.equal(header.slice(36, 68).toString('hex'), root.toString('hex'));
+        assert.equal(unit.midstate, Util.sha256midstate(header).toString('hex'));
+        assert.equal(unit.target.slice(-16), '0000ffff00000000');
+      });
+    },
+    'finds submitted work': function (topic) {
+      if (!topic) return;
+
+      var header = Util.reverseBytes32(Util.decodeHex(topic.work[1].data));
+      header.writeUInt32LE(42, 76);
+      assert.deepEqual(Util.ccmodule.WorkTemplate.find(header), {
+        id: topic.tmpl.id,
+        extranonce: 2,
+        time: 1234567890,
+        nonce: 42
+      });
+
+      header[40] ^= 1;
+      assert.isNull(Util.ccmodule.WorkTemplate.find(header));
+    },
+    'rejects invalid difficulty bits': function (topic) {
+      if (!topic) return;
+
+      // Negative, overflowing, zero and non-canonical targets
+      [0x1d80ffff, 0x2200ffff, 0x1d000000, 0x1e0000ff].forEach(function (bits) {
+        assert.throws(function () {
+          new Util.ccmodule.WorkTemplate({
+            version: 2,
+            prevHash: Util.sha256(new Buffer('prev')),
+            bits: bits,
+            coinbase1: topic.coinbase1,
+            coinbase2: topic.coinbase2,
+            branch: topic.branch
+          });
+        });
+      });
+    }
   }
 }).export(module);